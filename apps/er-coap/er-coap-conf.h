@@ -53,6 +53,24 @@
 #define COAP_MAX_OPEN_TRANSACTIONS     4
 #endif /* COAP_MAX_OPEN_TRANSACTIONS */
 
+/* Retransmissions that fall due within this many clock ticks of each other are sent in one go. */
+#ifndef COAP_RETRANSMIT_BATCH
+#define COAP_RETRANSMIT_BATCH          0
+#endif /* COAP_RETRANSMIT_BATCH */
+
+/* Derive the initial retransmission timeout from measured round-trip times instead of using COAP_RESPONSE_TIMEOUT. */
+#ifndef COAP_ADAPTIVE_TIMEOUT
+#define COAP_ADAPTIVE_TIMEOUT          0
+#endif /* COAP_ADAPTIVE_TIMEOUT */
+
+/* Bounds for the adaptive retransmission timeout, in clock ticks */
+#ifndef COAP_ADAPTIVE_TIMEOUT_MIN
+#define COAP_ADAPTIVE_TIMEOUT_MIN      (CLOCK_SECOND)
+#endif /* COAP_ADAPTIVE_TIMEOUT_MIN */
+#ifndef COAP_ADAPTIVE_TIMEOUT_MAX
+#define COAP_ADAPTIVE_TIMEOUT_MAX      (2 * CLOCK_SECOND * COAP_RESPONSE_TIMEOUT)
+#endif /* COAP_ADAPTIVE_TIMEOUT_MAX */
+
 /* Maximum number of failed request attempts before action */
 #ifndef COAP_MAX_ATTEMPTS
 #define COAP_MAX_ATTEMPTS              4
@@ -71,4 +89,9 @@
 /* Interval in notifies in which NON notifies are changed to CON notifies to check client. */
 #define COAP_OBSERVE_REFRESH_INTERVAL  20
 
+/* Clock ticks over which the notifications for one resource change are spread out, 0 to send them all at once. */
+#ifndef COAP_OBSERVE_PACING_WINDOW
+#define COAP_OBSERVE_PACING_WINDOW     0
+#endif /* COAP_OBSERVE_PACING_WINDOW */
+
 #endif /* ER_COAP_CONF_H_ */
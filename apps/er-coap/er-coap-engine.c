@@ -244,6 +244,7 @@ coap_receive(void)
           restful_response_handler callback = transaction->callback;
           void *callback_data = transaction->callback_data;
 
+          coap_transaction_answered(transaction);
           coap_clear_transaction(transaction);
 
           /* check if someone registered for the response */
@@ -56,6 +56,39 @@
 MEMB(observers_memb, coap_observer_t, COAP_MAX_OBSERVERS);
 LIST(observers_list);
 /*---------------------------------------------------------------------------*/
+/*
+ * A notification is serialized once without a Token into a template. The
+ * Observe option and payload are shared by all observers, so each of them
+ * only gets its own header and Token written in front of the template body.
+ */
+static uint8_t notification_buffer[COAP_TOKEN_LEN + COAP_MAX_PACKET_SIZE + 1];
+static uint8_t notification_header[COAP_HEADER_LEN];
+static uint16_t notification_len;    /* template length without header */
+static const char *notification_url; /* pending resource, NULL if none */
+static clock_time_t notification_time;
+static uint32_t observe_seq;
+
+static coap_observe_stats_t observe_stats;
+
+#if COAP_OBSERVE_PACING_WINDOW
+PROCESS_NAME(coap_engine);
+
+static struct ctimer pacing_timer;
+static coap_observer_t *next_observer;
+static clock_time_t pacing_interval;
+#endif /* COAP_OBSERVE_PACING_WINDOW */
+/*---------------------------------------------------------------------------*/
+static coap_observer_t *
+next_matching(coap_observer_t *obs)
+{
+  for(; obs; obs = obs->next) {
+    if(obs->url == notification_url) {
+      break;
+    }
+  }
+  return obs;
+}
+/*---------------------------------------------------------------------------*/
 /*- Internal API ------------------------------------------------------------*/
 /*---------------------------------------------------------------------------*/
 coap_observer_t *
@@ -74,6 +107,7 @@ coap_add_observer(uip_ipaddr_t *addr, uint16_t port, const uint8_t *token,
     o->token_len = token_len;
     memcpy(o->token, token, token_len);
     o->last_mid = 0;
+    o->obs_counter = 0;
 
     PRINTF("Adding observer (%u/%u) for /%s [0x%02X%02X]\n",
            list_length(observers_list) + 1, COAP_MAX_OBSERVERS,
@@ -92,6 +126,12 @@ coap_remove_observer(coap_observer_t *o)
   PRINTF("Removing observer for /%s [0x%02X%02X]\n", o->url, o->token[0],
          o->token[1]);
 
+#if COAP_OBSERVE_PACING_WINDOW
+  if(o == next_observer) {
+    next_observer = next_matching(o->next);
+  }
+#endif /* COAP_OBSERVE_PACING_WINDOW */
+
   memb_free(&observers_memb, o);
   list_remove(observers_list, o);
 }
@@ -175,56 +215,159 @@ coap_remove_observer_by_mid(uip_ipaddr_t *addr, uint16_t port, uint16_t mid)
 /*---------------------------------------------------------------------------*/
 /*- Notification ------------------------------------------------------------*/
 /*---------------------------------------------------------------------------*/
+/*---------------------------------------------------------------------------*/
+static void
+send_notification(coap_observer_t *obs)
+{
+  uint8_t *packet;
+  uint16_t packet_len;
+  coap_message_type_t type = COAP_TYPE_NON;
+  coap_transaction_t *transaction;
+  clock_time_t latency;
+
+  /* prepend header and Token to the shared options and payload */
+  packet = notification_buffer + COAP_TOKEN_LEN - obs->token_len;
+  packet_len = COAP_HEADER_LEN + obs->token_len + notification_len;
+
+  if(obs->obs_counter % COAP_OBSERVE_REFRESH_INTERVAL == 0) {
+    PRINTF("           Force Confirmable for\n");
+    type = COAP_TYPE_CON;
+  }
+  obs->obs_counter++;
+
+  PRINTF("           Observer ");
+  PRINT6ADDR(&obs->addr);
+  PRINTF(":%u\n", obs->port);
+
+  packet[0] = (notification_header[0] & COAP_HEADER_VERSION_MASK)
+    | (COAP_HEADER_TYPE_MASK & type << COAP_HEADER_TYPE_POSITION)
+    | (COAP_HEADER_TOKEN_LEN_MASK
+       & obs->token_len << COAP_HEADER_TOKEN_LEN_POSITION);
+  packet[1] = notification_header[1];
+  memcpy(packet + COAP_HEADER_LEN, obs->token, obs->token_len);
+
+  if(type == COAP_TYPE_CON) {
+    transaction = coap_new_transaction(coap_get_mid(), &obs->addr, obs->port);
+    if(transaction == NULL) {
+      PRINTF("           No transaction, dropped\n");
+      observe_stats.drops++;
+      return;
+    }
+    obs->last_mid = transaction->mid;
+    packet[2] = (uint8_t)(transaction->mid >> 8);
+    packet[3] = (uint8_t)(transaction->mid);
+    memcpy(transaction->packet, packet, packet_len);
+    transaction->packet_len = packet_len;
+    coap_send_transaction(transaction);
+  } else {
+    /* update last MID for RST matching */
+    obs->last_mid = coap_get_mid();
+    packet[2] = (uint8_t)(obs->last_mid >> 8);
+    packet[3] = (uint8_t)(obs->last_mid);
+    coap_send_message(&obs->addr, obs->port, packet, packet_len);
+  }
+
+  latency = clock_time() - notification_time;
+  observe_stats.notifications++;
+  observe_stats.latency_sum += latency;
+  if(latency > observe_stats.max_latency) {
+    observe_stats.max_latency = latency;
+  }
+}
+/*---------------------------------------------------------------------------*/
+#if COAP_OBSERVE_PACING_WINDOW
+static void
+pace_notification(void *ptr)
+{
+  coap_observer_t *obs = next_observer;
+
+  next_observer = obs ? next_matching(obs->next) : NULL;
+  if(obs) {
+    send_notification(obs);
+  }
+  if(next_observer) {
+    ctimer_reset(&pacing_timer);
+  } else {
+    notification_url = NULL;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+flush_notification(void)
+{
+  ctimer_stop(&pacing_timer);
+  while(next_observer) {
+    pace_notification(NULL);
+  }
+  notification_url = NULL;
+}
+#endif /* COAP_OBSERVE_PACING_WINDOW */
+/*---------------------------------------------------------------------------*/
 void
 coap_notify_observers(resource_t *resource)
 {
   /* build notification */
   coap_packet_t notification[1]; /* this way the packet can be treated as pointer as usual */
-  coap_init_message(notification, COAP_TYPE_NON, CONTENT_2_05, 0);
   coap_observer_t *obs = NULL;
+  uint8_t *buffer = notification_buffer + COAP_TOKEN_LEN;
+  size_t len;
+  int count;
 
   PRINTF("Observe: Notification from %s\n", resource->url);
 
-  /* iterate over observers */
-  for(obs = (coap_observer_t *)list_head(observers_list); obs;
-      obs = obs->next) {
-    if(obs->url == resource->url) {     /* using RESOURCE url pointer as handle */
-      coap_transaction_t *transaction = NULL;
-
-      /*TODO implement special transaction for CON, sharing the same buffer to allow for more observers */
-
-      if((transaction = coap_new_transaction(coap_get_mid(), &obs->addr, obs->port))) {
-        if(obs->obs_counter % COAP_OBSERVE_REFRESH_INTERVAL == 0) {
-          PRINTF("           Force Confirmable for\n");
-          notification->type = COAP_TYPE_CON;
-        }
-
-        PRINTF("           Observer ");
-        PRINT6ADDR(&obs->addr);
-        PRINTF(":%u\n", obs->port);
-
-        /* update last MID for RST matching */
-        obs->last_mid = transaction->mid;
-
-        /* prepare response */
-        notification->mid = transaction->mid;
+#if COAP_OBSERVE_PACING_WINDOW
+  /* the template is shared, so a pending notification must go out first */
+  if(notification_url != NULL) {
+    flush_notification();
+  }
+#endif /* COAP_OBSERVE_PACING_WINDOW */
 
-        resource->get_handler(NULL, notification,
-                              transaction->packet + COAP_MAX_HEADER_SIZE,
-                              REST_MAX_CHUNK_SIZE, NULL);
+  notification_url = resource->url; /* using RESOURCE url pointer as handle */
+  obs = next_matching((coap_observer_t *)list_head(observers_list));
+  if(obs == NULL) {
+    notification_url = NULL;
+    return;
+  }
 
-        if(notification->code < BAD_REQUEST_4_00) {
-          coap_set_header_observe(notification, (obs->obs_counter)++);
-        }
-        coap_set_token(notification, obs->token, obs->token_len);
+  coap_init_message(notification, COAP_TYPE_NON, CONTENT_2_05, 0);
+  resource->get_handler(NULL, notification, buffer + COAP_MAX_HEADER_SIZE,
+                        REST_MAX_CHUNK_SIZE, NULL);
+  if(notification->code < BAD_REQUEST_4_00) {
+    observe_seq = (observe_seq + 1) & 0xFFFFFF;
+    coap_set_header_observe(notification, observe_seq);
+  }
 
-        transaction->packet_len =
-          coap_serialize_message(notification, transaction->packet);
+  len = coap_serialize_message(notification, buffer);
+  if(len == 0) {
+    PRINTF("Observe: %s\n", coap_error_message);
+    notification_url = NULL;
+    return;
+  }
+  memcpy(notification_header, buffer, COAP_HEADER_LEN);
+  notification_len = len - COAP_HEADER_LEN;
+  notification_time = clock_time();
 
-        coap_send_transaction(transaction);
-      }
-    }
+#if COAP_OBSERVE_PACING_WINDOW
+  for(count = 0; obs; obs = next_matching(obs->next)) {
+    ++count;
+  }
+  pacing_interval = COAP_OBSERVE_PACING_WINDOW / count;
+  next_observer = next_matching((coap_observer_t *)list_head(observers_list));
+  pace_notification(NULL);
+  if(next_observer) {
+    PROCESS_CONTEXT_BEGIN(&coap_engine);
+    ctimer_set(&pacing_timer, pacing_interval, pace_notification, NULL);
+    PROCESS_CONTEXT_END(&coap_engine);
   }
+#else /* COAP_OBSERVE_PACING_WINDOW */
+  for(count = 0; obs; obs = next_matching(obs->next)) {
+    send_notification(obs);
+    ++count;
+  }
+  notification_url = NULL;
+#endif /* COAP_OBSERVE_PACING_WINDOW */
+
+  PRINTF("Observe: %d notifications for %s\n", count, resource->url);
 }
 /*---------------------------------------------------------------------------*/
 void
@@ -243,7 +386,8 @@ coap_observe_handler(resource_t *resource, void *request, void *response)
                                 coap_req->token, coap_req->token_len,
                                 resource->url);
        if(obs) {
-          coap_set_header_observe(coap_res, (obs->obs_counter)++);
+          coap_set_header_observe(coap_res, observe_seq);
+          obs->obs_counter++;
           /*
            * Following payload is for demonstration purposes only.
            * A subscription should return the same representation as a normal GET.
@@ -271,3 +415,9 @@ coap_observe_handler(resource_t *resource, void *request, void *response)
   }
 }
 /*---------------------------------------------------------------------------*/
+const coap_observe_stats_t *
+coap_get_observe_stats(void)
+{
+  return &observe_stats;
+}
+/*---------------------------------------------------------------------------*/
@@ -67,6 +67,14 @@ typedef struct coap_observer {
   uint8_t retrans_counter;
 } coap_observer_t;
 
+/* notification counters */
+typedef struct coap_observe_stats {
+  uint32_t notifications;       /* notifications sent */
+  uint32_t drops;               /* notifications not sent for lack of a transaction */
+  uint32_t latency_sum;         /* clock ticks from the resource change to the sending */
+  clock_time_t max_latency;
+} coap_observe_stats_t;
+
 list_t coap_get_observers(void);
 
 coap_observer_t *coap_add_observer(uip_ipaddr_t *addr, uint16_t port,
@@ -87,4 +95,6 @@ void coap_notify_observers(resource_t *resource);
 void coap_observe_handler(resource_t *resource, void *request,
                           void *response);
 
+const coap_observe_stats_t *coap_get_observe_stats(void);
+
 #endif /* COAP_OBSERVE_H_ */
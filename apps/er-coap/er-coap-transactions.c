@@ -55,9 +55,69 @@
 
 /*---------------------------------------------------------------------------*/
 MEMB(transactions_memb, coap_transaction_t, COAP_MAX_OPEN_TRANSACTIONS);
+/* scheduled transactions come first, ordered by retransmission time */
 LIST(transactions_list);
 
 static struct process *transaction_handler_process = NULL;
+/* single timer for the earliest retransmission */
+static struct etimer retrans_timer;
+
+static coap_transaction_stats_t stats;
+/* smoothed round-trip time and variation, scaled by 8 and 4 */
+static clock_time_t srtt_8, rttvar_4;
+
+/* nonzero if time a comes before time b */
+#define TIME_BEFORE(a, b) ((clock_time_t)((a) - (b)) > ((clock_time_t)~0 >> 1))
+
+/*---------------------------------------------------------------------------*/
+static void
+schedule_timer(void)
+{
+  coap_transaction_t *t = (coap_transaction_t *)list_head(transactions_list);
+  clock_time_t now = clock_time();
+
+  PROCESS_CONTEXT_BEGIN(transaction_handler_process);
+  if(t && t->scheduled) {
+    etimer_set(&retrans_timer, TIME_BEFORE(now, t->retrans_time) ?
+               t->retrans_time - now : 0);
+  } else {
+    etimer_stop(&retrans_timer);
+  }
+  PROCESS_CONTEXT_END(transaction_handler_process);
+}
+/*---------------------------------------------------------------------------*/
+static void
+schedule_transaction(coap_transaction_t *t)
+{
+  coap_transaction_t *prev = NULL;
+  coap_transaction_t *n;
+
+  list_remove(transactions_list, t);
+  for(n = (coap_transaction_t *)list_head(transactions_list);
+      n && n->scheduled && !TIME_BEFORE(t->retrans_time, n->retrans_time);
+      n = n->next) {
+    prev = n;
+  }
+  t->scheduled = 1;
+  list_insert(transactions_list, prev, t);
+
+  if(prev == NULL) {
+    schedule_timer();
+  }
+}
+/*---------------------------------------------------------------------------*/
+static clock_time_t
+initial_timeout(void)
+{
+#if COAP_ADAPTIVE_TIMEOUT
+  return stats.rto + random_rand() %
+         (stats.rto * (clock_time_t)((COAP_RESPONSE_RANDOM_FACTOR - 1.0) * 16)
+          / 16 + 1);
+#else /* COAP_ADAPTIVE_TIMEOUT */
+  return COAP_RESPONSE_TIMEOUT_TICKS +
+         (random_rand() % (clock_time_t)COAP_RESPONSE_TIMEOUT_BACKOFF_MASK);
+#endif /* COAP_ADAPTIVE_TIMEOUT */
+}
 
 /*---------------------------------------------------------------------------*/
 /*- Internal API ------------------------------------------------------------*/
@@ -66,6 +126,7 @@ void
 coap_register_as_transaction_handler()
 {
   transaction_handler_process = PROCESS_CURRENT();
+  stats.rto = COAP_RESPONSE_TIMEOUT_TICKS;
 }
 coap_transaction_t *
 coap_new_transaction(uint16_t mid, uip_ipaddr_t *addr, uint16_t port)
@@ -75,6 +136,7 @@ coap_new_transaction(uint16_t mid, uip_ipaddr_t *addr, uint16_t port)
   if(t) {
     t->mid = mid;
     t->retrans_counter = 0;
+    t->scheduled = 0;
 
     /* save client address */
     uip_ipaddr_copy(&t->addr, addr);
@@ -100,33 +162,27 @@ coap_send_transaction(coap_transaction_t *t)
       PRINTF("Keeping transaction %u\n", t->mid);
 
       if(t->retrans_counter == 0) {
-        t->retrans_timer.timer.interval =
-          COAP_RESPONSE_TIMEOUT_TICKS + (random_rand()
-                                         %
-                                         (clock_time_t)
-                                         COAP_RESPONSE_TIMEOUT_BACKOFF_MASK);
+        t->send_time = clock_time();
+        t->retrans_interval = initial_timeout();
         PRINTF("Initial interval %f\n",
-               (float)t->retrans_timer.timer.interval / CLOCK_SECOND);
+               (float)t->retrans_interval / CLOCK_SECOND);
       } else {
-        t->retrans_timer.timer.interval <<= 1;  /* double */
+        t->retrans_interval <<= 1;  /* double */
         PRINTF("Doubled (%u) interval %f\n", t->retrans_counter,
-               (float)t->retrans_timer.timer.interval / CLOCK_SECOND);
+               (float)t->retrans_interval / CLOCK_SECOND);
       }
 
-      /*FIXME
-       * Hack: Setting timer for responsible process.
-       * Maybe there is a better way, but avoid posting everything to the process.
-       */
-      struct process *process_actual = PROCESS_CURRENT();
-
-      process_current = transaction_handler_process;
-      etimer_restart(&t->retrans_timer);        /* interval updated above */
-      process_current = process_actual;
+      t->retrans_time = clock_time() + t->retrans_interval;
+      schedule_transaction(t);
 
       t = NULL;
     } else {
       /* timed out */
       PRINTF("Timeout\n");
+      ++stats.timeouts;
+      /* back off until a new round-trip time sample comes in */
+      stats.rto = stats.rto * 2 < COAP_ADAPTIVE_TIMEOUT_MAX ?
+        stats.rto * 2 : COAP_ADAPTIVE_TIMEOUT_MAX;
       restful_response_handler callback = t->callback;
       void *callback_data = t->callback_data;
 
@@ -150,7 +206,8 @@ coap_clear_transaction(coap_transaction_t *t)
   if(t) {
     PRINTF("Freeing transaction %u: %p\n", t->mid, t);
 
-    etimer_stop(&t->retrans_timer);
+    /* the shared timer is left running; if it was set for this
+       transaction, coap_check_transactions() sets it for the next one */
     list_remove(transactions_list, t);
     memb_free(&transactions_memb, t);
   }
@@ -170,16 +227,65 @@ coap_get_transaction_by_mid(uint16_t mid)
 }
 /*---------------------------------------------------------------------------*/
 void
+coap_transaction_answered(coap_transaction_t *t)
+{
+  clock_time_t rtt, delta;
+
+  /* only messages that were not retransmitted give unambiguous samples */
+  if(!t->scheduled || t->retrans_counter > 0) {
+    return;
+  }
+
+  rtt = clock_time() - t->send_time;
+  if(stats.samples == 0) {
+    srtt_8 = rtt << 3;
+    rttvar_4 = rtt << 1;
+  } else {
+    delta = rtt > (srtt_8 >> 3) ? rtt - (srtt_8 >> 3) : (srtt_8 >> 3) - rtt;
+    rttvar_4 = rttvar_4 - (rttvar_4 >> 2) + delta;
+    srtt_8 = srtt_8 - (srtt_8 >> 3) + rtt;
+  }
+  if(stats.samples < 0xffff) {
+    ++stats.samples;
+  }
+
+  stats.rtt = rtt;
+  stats.srtt = srtt_8 >> 3;
+  stats.rttvar = rttvar_4 >> 2;
+  /* RTO = SRTT + 4 * RTTVAR as in RFC 6298 */
+  stats.rto = stats.srtt + rttvar_4;
+  if(stats.rto < COAP_ADAPTIVE_TIMEOUT_MIN) {
+    stats.rto = COAP_ADAPTIVE_TIMEOUT_MIN;
+  } else if(stats.rto > COAP_ADAPTIVE_TIMEOUT_MAX) {
+    stats.rto = COAP_ADAPTIVE_TIMEOUT_MAX;
+  }
+  PRINTF("RTT sample %u: %lu ticks, RTO %lu ticks\n", t->mid,
+         (unsigned long)rtt, (unsigned long)stats.rto);
+}
+/*---------------------------------------------------------------------------*/
+const coap_transaction_stats_t *
+coap_get_transaction_stats(void)
+{
+  return &stats;
+}
+/*---------------------------------------------------------------------------*/
+void
 coap_check_transactions()
 {
   coap_transaction_t *t = NULL;
+  clock_time_t now = clock_time();
 
-  for(t = (coap_transaction_t *)list_head(transactions_list); t; t = t->next) {
-    if(etimer_expired(&t->retrans_timer)) {
-      ++(t->retrans_counter);
-      PRINTF("Retransmitting %u (%u)\n", t->mid, t->retrans_counter);
-      coap_send_transaction(t);
-    }
+  /* the due transactions are at the head of the list; the ones due
+     within COAP_RETRANSMIT_BATCH ticks are sent along with them */
+  while((t = (coap_transaction_t *)list_head(transactions_list)) &&
+        t->scheduled &&
+        !TIME_BEFORE(now + COAP_RETRANSMIT_BATCH, t->retrans_time)) {
+    t->scheduled = 0;
+    ++(t->retrans_counter);
+    ++stats.retransmissions;
+    PRINTF("Retransmitting %u (%u)\n", t->mid, t->retrans_counter);
+    coap_send_transaction(t);
   }
+  schedule_timer();
 }
 /*---------------------------------------------------------------------------*/
@@ -53,8 +53,11 @@ typedef struct coap_transaction {
   struct coap_transaction *next;        /* for LIST */
 
   uint16_t mid;
-  struct etimer retrans_timer;
+  clock_time_t retrans_interval;
+  clock_time_t retrans_time;            /* when the next retransmission is due */
+  clock_time_t send_time;               /* first transmission, for RTT samples */
   uint8_t retrans_counter;
+  uint8_t scheduled;
 
   uip_ipaddr_t addr;
   uint16_t port;
@@ -67,6 +70,17 @@ typedef struct coap_transaction {
                                                  * Use snprintf(buf, len+1, "", ...) to completely fill payload */
 } coap_transaction_t;
 
+/* round-trip time statistics of confirmable messages */
+typedef struct coap_transaction_stats {
+  clock_time_t rtt;                     /* last sample */
+  clock_time_t srtt;                    /* smoothed round-trip time */
+  clock_time_t rttvar;                  /* round-trip time variation */
+  clock_time_t rto;                     /* initial retransmission timeout */
+  uint16_t samples;
+  uint16_t retransmissions;
+  uint16_t timeouts;
+} coap_transaction_stats_t;
+
 void coap_register_as_transaction_handler();
 
 coap_transaction_t *coap_new_transaction(uint16_t mid, uip_ipaddr_t *addr,
@@ -74,6 +88,8 @@ coap_transaction_t *coap_new_transaction(uint16_t mid, uip_ipaddr_t *addr,
 void coap_send_transaction(coap_transaction_t *t);
 void coap_clear_transaction(coap_transaction_t *t);
 coap_transaction_t *coap_get_transaction_by_mid(uint16_t mid);
+void coap_transaction_answered(coap_transaction_t *t);
+const coap_transaction_stats_t *coap_get_transaction_stats(void);
 
 void coap_check_transactions();
 
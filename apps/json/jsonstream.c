@@ -0,0 +1,317 @@
+/*
+ * Copyright (c) 2015, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         A streaming JSON tokenizer.
+ */
+
+#include "jsonstream.h"
+#include <stddef.h>
+
+enum {
+  STATE_VALUE,          /* a value is expected */
+  STATE_VALUE_OR_END,   /* a value or the end of an empty array */
+  STATE_NAME,           /* a pair name is expected */
+  STATE_NAME_OR_END,    /* a pair name or the end of an empty object */
+  STATE_COLON,
+  STATE_NEXT,           /* a comma or the end of an object or array */
+  STATE_STRING,
+  STATE_NUMBER,
+  STATE_LITERAL,
+  STATE_DONE
+};
+
+static const char *const literals[] = { "true", "false", "null" };
+/*--------------------------------------------------------------------*/
+static int
+in_object(struct jsonstream_state *state)
+{
+  int level = state->depth - 1;
+
+  return (state->stack[level / 8] >> (level % 8)) & 1;
+}
+/*--------------------------------------------------------------------*/
+static int
+push(struct jsonstream_state *state, char c)
+{
+  int level = state->depth;
+
+  if(level >= JSONSTREAM_MAX_DEPTH) {
+    state->error = JSON_ERROR_TOO_DEEP;
+    return 0;
+  }
+  if(c == '{') {
+    state->stack[level / 8] |= 1 << (level % 8);
+    state->state = STATE_NAME_OR_END;
+  } else {
+    state->stack[level / 8] &= ~(1 << (level % 8));
+    state->state = STATE_VALUE_OR_END;
+  }
+  state->depth++;
+  state->callback(state, c, NULL, 0, 0);
+  return 1;
+}
+/*--------------------------------------------------------------------*/
+/* Called when a value is complete, including objects and arrays */
+static void
+end_value(struct jsonstream_state *state)
+{
+  state->state = state->depth == 0 ? STATE_DONE : STATE_NEXT;
+}
+/*--------------------------------------------------------------------*/
+static int
+pop(struct jsonstream_state *state, char c)
+{
+  if(state->depth == 0 || in_object(state) != (c == '}')) {
+    state->error = c == '}' ? JSON_ERROR_SYNTAX :
+      JSON_ERROR_UNEXPECTED_END_OF_ARRAY;
+    return 0;
+  }
+  state->depth--;
+  state->callback(state, c, NULL, 0, 0);
+  end_value(state);
+  return 1;
+}
+/*--------------------------------------------------------------------*/
+static int
+is_number(char c)
+{
+  return (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' ||
+    c == 'e' || c == 'E';
+}
+/*--------------------------------------------------------------------*/
+/* Starts the value beginning with c. Returns the number of characters
+   consumed, or -1 on error. */
+static int
+start_value(struct jsonstream_state *state, char c)
+{
+  switch(c) {
+  case '{':
+  case '[':
+    return push(state, c) ? 1 : -1;
+  case '"':
+    state->vtype = JSON_TYPE_STRING;
+    state->state = STATE_STRING;
+    return 1;
+  case 't':
+  case 'f':
+  case 'n':
+    state->vtype = c == 't' ? JSON_TYPE_TRUE :
+      (c == 'f' ? JSON_TYPE_FALSE : JSON_TYPE_NULL);
+    state->matched = 1;
+    state->state = STATE_LITERAL;
+    return 1;
+  default:
+    if((c >= '0' && c <= '9') || c == '-') {
+      /* The number is consumed by STATE_NUMBER */
+      state->vtype = JSON_TYPE_NUMBER;
+      state->state = STATE_NUMBER;
+      return 0;
+    }
+  }
+  state->error = c == '[' ? JSON_ERROR_UNEXPECTED_ARRAY : JSON_ERROR_SYNTAX;
+  return -1;
+}
+/*--------------------------------------------------------------------*/
+void
+jsonstream_setup(struct jsonstream_state *state,
+                 jsonstream_callback_t callback, void *ptr)
+{
+  state->callback = callback;
+  state->ptr = ptr;
+  state->depth = 0;
+  state->state = STATE_VALUE;
+  state->escape = 0;
+  state->error = JSON_ERROR_OK;
+}
+/*--------------------------------------------------------------------*/
+int
+jsonstream_feed(struct jsonstream_state *state, const char *buf, int len)
+{
+  const char *end = buf + len;
+  const char *start;
+  const char *literal;
+  int n;
+  char c;
+
+  while(buf < end && state->error == JSON_ERROR_OK) {
+    c = *buf;
+
+    switch(state->state) {
+    case STATE_STRING:
+      /* Scan for the closing quote, which ends the string unless it is
+         escaped. Escape sequences are passed on as they are. */
+      start = buf;
+      while(buf < end) {
+        c = *buf;
+        if(state->escape) {
+          state->escape = 0;
+        } else if(c == '\\') {
+          state->escape = 1;
+        } else if(c == '"') {
+          break;
+        }
+        buf++;
+      }
+      if(buf == end) {
+        if(buf > start) {
+          state->callback(state, state->vtype, start, buf - start, 1);
+        }
+        return JSON_ERROR_OK;
+      }
+      state->callback(state, state->vtype, start, buf - start, 0);
+      buf++;
+      if(state->vtype == JSON_TYPE_PAIR_NAME) {
+        state->state = STATE_COLON;
+      } else {
+        end_value(state);
+      }
+      continue;
+
+    case STATE_NUMBER:
+      start = buf;
+      while(buf < end && is_number(*buf)) {
+        buf++;
+      }
+      if(buf == end) {
+        if(buf > start) {
+          state->callback(state, JSON_TYPE_NUMBER, start, buf - start, 1);
+        }
+        return JSON_ERROR_OK;
+      }
+      /* The character after the number is handled by STATE_NEXT */
+      state->callback(state, JSON_TYPE_NUMBER, start, buf - start, 0);
+      end_value(state);
+      continue;
+
+    case STATE_LITERAL:
+      literal = literals[state->vtype == JSON_TYPE_TRUE ? 0 :
+                         (state->vtype == JSON_TYPE_FALSE ? 1 : 2)];
+      if(c != literal[state->matched]) {
+        state->error = JSON_ERROR_SYNTAX;
+        return state->error;
+      }
+      buf++;
+      if(literal[++state->matched] == '\0') {
+        state->callback(state, state->vtype, NULL, 0, 0);
+        end_value(state);
+      }
+      continue;
+    }
+
+    /* Whitespace is only allowed between tokens */
+    if(c == ' ' || c == '\n' || c == '\r' || c == '\t') {
+      buf++;
+      continue;
+    }
+
+    switch(state->state) {
+    case STATE_VALUE_OR_END:
+      if(c == ']') {
+        pop(state, c);
+        buf++;
+        break;
+      }
+      /* fall through */
+    case STATE_VALUE:
+      n = start_value(state, c);
+      if(n > 0) {
+        buf += n;
+      }
+      break;
+    case STATE_NAME_OR_END:
+      if(c == '}') {
+        pop(state, c);
+        buf++;
+        break;
+      }
+      /* fall through */
+    case STATE_NAME:
+      if(c != '"') {
+        state->error = JSON_ERROR_SYNTAX;
+        break;
+      }
+      state->vtype = JSON_TYPE_PAIR_NAME;
+      state->state = STATE_STRING;
+      buf++;
+      break;
+    case STATE_COLON:
+      if(c != ':') {
+        state->error = JSON_ERROR_SYNTAX;
+        break;
+      }
+      state->state = STATE_VALUE;
+      buf++;
+      break;
+    case STATE_NEXT:
+      if(c == ',') {
+        state->state = in_object(state) ? STATE_NAME : STATE_VALUE;
+      } else if(c == '}' || c == ']') {
+        pop(state, c);
+      } else {
+        state->error = JSON_ERROR_SYNTAX;
+      }
+      buf++;
+      break;
+    default:
+      /* Only whitespace may follow the document */
+      state->error = JSON_ERROR_SYNTAX;
+      break;
+    }
+  }
+  return state->error;
+}
+/*--------------------------------------------------------------------*/
+int
+jsonstream_end(struct jsonstream_state *state)
+{
+  if(state->error != JSON_ERROR_OK) {
+    return state->error;
+  }
+  if(state->state == STATE_NUMBER && state->depth == 0) {
+    /* A number at the top level only ends with the document */
+    state->callback(state, JSON_TYPE_NUMBER, NULL, 0, 0);
+    state->state = STATE_DONE;
+  }
+  if(state->state != STATE_DONE) {
+    state->error = JSON_ERROR_INCOMPLETE;
+  }
+  return state->error;
+}
+/*--------------------------------------------------------------------*/
+int
+jsonstream_get_depth(struct jsonstream_state *state)
+{
+  return state->depth;
+}
+/*--------------------------------------------------------------------*/
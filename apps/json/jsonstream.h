@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2015, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         A streaming JSON tokenizer. The document is fed in chunks of
+ *         any size, for example CoAP blocks or TCP segments, and each
+ *         token is reported to a callback as it is found. Values are
+ *         passed as slices of the chunk being fed, without copying.
+ *         The state is two pointers, one bit per nesting level and a
+ *         few single-byte fields, and does not depend on the size of
+ *         the document.
+ */
+
+#ifndef JSONSTREAM_H_
+#define JSONSTREAM_H_
+
+#include "contiki-conf.h"
+#include "json.h"
+
+#ifdef JSONSTREAM_CONF_MAX_DEPTH
+#define JSONSTREAM_MAX_DEPTH JSONSTREAM_CONF_MAX_DEPTH
+#else
+#define JSONSTREAM_MAX_DEPTH 32
+#endif
+
+struct jsonstream_state;
+
+/**
+ * \brief      Called for each token of the document.
+ * \param state The tokenizer state
+ * \param type The token type: JSON_TYPE_OBJECT or JSON_TYPE_ARRAY for
+ *             the start of an object or array, '}' or ']' for its end,
+ *             JSON_TYPE_PAIR_NAME, JSON_TYPE_STRING, JSON_TYPE_NUMBER,
+ *             JSON_TYPE_TRUE, JSON_TYPE_FALSE or JSON_TYPE_NULL
+ * \param value The value of a name, string or number, within the chunk
+ *             being fed. Strings are passed without the quotes and
+ *             with their escape sequences as is.
+ * \param len  The length of the value
+ * \param more Non-zero if the value continues in the next chunk
+ *
+ *             A value that spans several chunks is reported once per
+ *             chunk, with more set for all but the last part. The
+ *             last part may be empty.
+ */
+typedef void (* jsonstream_callback_t)(struct jsonstream_state *state,
+                                       int type, const char *value,
+                                       int len, int more);
+
+struct jsonstream_state {
+  jsonstream_callback_t callback;
+  void *ptr;
+  uint8_t stack[(JSONSTREAM_MAX_DEPTH + 7) / 8]; /* one bit per level,
+                                                    set for objects */
+  uint8_t depth;
+  uint8_t state;
+  uint8_t vtype;
+  uint8_t matched;  /* characters of true/false/null seen */
+  uint8_t escape;
+  char error;
+};
+
+/**
+ * \brief      Initialize a streaming JSON tokenizer.
+ * \param state A pointer to a tokenizer state
+ * \param callback The function called for each token
+ * \param ptr  An opaque pointer for the callback, available as
+ *             state->ptr
+ */
+void jsonstream_setup(struct jsonstream_state *state,
+                      jsonstream_callback_t callback, void *ptr);
+
+/**
+ * \brief      Tokenize the next chunk of a document.
+ * \param state A pointer to a tokenizer state
+ * \param buf  The chunk
+ * \param len  The length of the chunk
+ * \return     JSON_ERROR_OK, or the error that stopped the tokenizer
+ *
+ *             The chunk is only accessed during the call, so the
+ *             buffer can be reused for the next chunk once this
+ *             function returns.
+ */
+int jsonstream_feed(struct jsonstream_state *state, const char *buf,
+                    int len);
+
+/**
+ * \brief      Signal the end of the document.
+ * \param state A pointer to a tokenizer state
+ * \return     JSON_ERROR_OK if a complete document was fed, or an error
+ */
+int jsonstream_end(struct jsonstream_state *state);
+
+/* get the depth of the current object or array, 0 at the top level */
+int jsonstream_get_depth(struct jsonstream_state *state);
+
+#endif /* JSONSTREAM_H_ */
@@ -50,32 +50,90 @@
 #define PRINTF(...)
 #endif
 
+/*---------------------------------------------------------------------------*/
+/* Used for callbacks that write with putchar() to a block */
+static struct jsontree_context *block_context;
+/*---------------------------------------------------------------------------*/
+static void
+output(const struct jsontree_context *js_ctx, const char *data, int len)
+{
+  /* The block output state is updated by the write functions, which
+     take a const context */
+  struct jsontree_context *ctx = (struct jsontree_context *)js_ctx;
+  char *p;
+  int n;
+
+  if(ctx->buf == NULL) {
+    while(len-- > 0) {
+      ctx->putchar(*data++);
+    }
+    return;
+  }
+
+  if(ctx->skip > 0) {
+    n = len < ctx->skip ? len : ctx->skip;
+    ctx->skip -= n;
+    data += n;
+    len -= n;
+  }
+  n = len < ctx->size - ctx->pos ? len : ctx->size - ctx->pos;
+  /* Mostly a few bytes, so copy them here instead of with memcpy() */
+  for(p = &ctx->buf[ctx->pos]; n > 0; n--) {
+    *p++ = *data++;
+  }
+  /* Also counts the bytes that did not fit */
+  ctx->pos += len;
+}
+/*---------------------------------------------------------------------------*/
+static void
+output_char(const struct jsontree_context *js_ctx, char c)
+{
+  struct jsontree_context *ctx = (struct jsontree_context *)js_ctx;
+
+  if(ctx->buf == NULL) {
+    ctx->putchar(c);
+  } else if(ctx->skip == 0 && ctx->pos < ctx->size) {
+    ctx->buf[ctx->pos++] = c;
+  } else {
+    output(js_ctx, &c, 1);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static int
+block_putchar(int c)
+{
+  output_char(block_context, c);
+  return c;
+}
 /*---------------------------------------------------------------------------*/
 void
 jsontree_write_atom(const struct jsontree_context *js_ctx, const char *text)
 {
   if(text == NULL) {
-    js_ctx->putchar('0');
+    output_char(js_ctx, '0');
   } else {
-    while(*text != '\0') {
-      js_ctx->putchar(*text++);
-    }
+    output(js_ctx, text, strlen(text));
   }
 }
 /*---------------------------------------------------------------------------*/
 void
 jsontree_write_string(const struct jsontree_context *js_ctx, const char *text)
 {
-  js_ctx->putchar('"');
+  int len;
+
+  output_char(js_ctx, '"');
   if(text != NULL) {
     while(*text != '\0') {
+      for(len = 0; text[len] != '\0' && text[len] != '"'; len++);
+      output(js_ctx, text, len);
+      text += len;
       if(*text == '"') {
-        js_ctx->putchar('\\');
+        output(js_ctx, "\\\"", 2);
+        text++;
       }
-      js_ctx->putchar(*text++);
     }
   }
-  js_ctx->putchar('"');
+  output_char(js_ctx, '"');
 }
 /*---------------------------------------------------------------------------*/
 void
@@ -85,7 +143,7 @@ jsontree_write_int(const struct jsontree_context *js_ctx, int value)
   int l;
 
   if(value < 0) {
-    js_ctx->putchar('-');
+    output_char(js_ctx, '-');
     value = -value;
   }
 
@@ -95,9 +153,7 @@ jsontree_write_int(const struct jsontree_context *js_ctx, int value)
     value /= 10;
   } while(value > 0 && l >= 0);
 
-  while(++l < sizeof(buf)) {
-    js_ctx->putchar(buf[l]);
-  }
+  output(js_ctx, &buf[l + 1], sizeof(buf) - l - 1);
 }
 /*---------------------------------------------------------------------------*/
 void
@@ -115,6 +171,10 @@ jsontree_reset(struct jsontree_context *js_ctx)
 {
   js_ctx->depth = 0;
   js_ctx->index[0] = 0;
+  js_ctx->buf = NULL;
+  js_ctx->skip = 0;
+  js_ctx->offset = 0;
+  js_ctx->done = 0;
 }
 /*---------------------------------------------------------------------------*/
 const char *
@@ -144,24 +204,23 @@ jsontree_print_next(struct jsontree_context *js_ctx)
 
     index = js_ctx->index[js_ctx->depth];
     if(index == 0) {
-      js_ctx->putchar(v->type);
-      js_ctx->putchar('\n');
+      output_char(js_ctx, v->type);
+      output_char(js_ctx, '\n');
     }
     if(index >= o->count) {
-      js_ctx->putchar('\n');
-      js_ctx->putchar(v->type + 2);
+      output_char(js_ctx, '\n');
+      output_char(js_ctx, v->type + 2);
       /* Default operation: back up one level! */
       break;
     }
 
     if(index > 0) {
-      js_ctx->putchar(',');
-      js_ctx->putchar('\n');
+      output(js_ctx, ",\n", 2);
     }
     if(v->type == JSON_TYPE_OBJECT) {
       jsontree_write_string(js_ctx,
                             ((struct jsontree_object *)o)->pairs[index].name);
-      js_ctx->putchar(':');
+      output_char(js_ctx, ':');
       ov = ((struct jsontree_object *)o)->pairs[index].value;
     } else {
       ov = o->values[index];
@@ -212,6 +271,70 @@ jsontree_print_next(struct jsontree_context *js_ctx)
   return 0;
 }
 /*---------------------------------------------------------------------------*/
+int
+jsontree_print_block(struct jsontree_context *js_ctx, char *buf, int size)
+{
+  int (* putchar)(int);
+  uint32_t skip;
+  uint16_t index, parent_index;
+  uint8_t depth;
+  int callback_state;
+  int start;
+  int more;
+
+  js_ctx->buf = buf;
+  js_ctx->size = size;
+  js_ctx->pos = 0;
+  putchar = js_ctx->putchar;
+  js_ctx->putchar = block_putchar;
+  block_context = js_ctx;
+
+  while(!js_ctx->done && js_ctx->pos < size) {
+    /* Remember the state before the step in case it does not fit */
+    depth = js_ctx->depth;
+    index = js_ctx->index[depth];
+    parent_index = depth > 0 ? js_ctx->index[depth - 1] : 0;
+    callback_state = js_ctx->callback_state;
+    skip = js_ctx->skip;
+    start = js_ctx->pos;
+
+    more = jsontree_print_next(js_ctx) && js_ctx->path <= js_ctx->depth;
+
+    if(js_ctx->pos > size) {
+      /* Take the step again in the next block, skipping the part
+         written to this one */
+      js_ctx->depth = depth;
+      js_ctx->index[depth] = index;
+      if(depth > 0) {
+        js_ctx->index[depth - 1] = parent_index;
+      }
+      js_ctx->callback_state = callback_state;
+      js_ctx->skip = skip + (size - start);
+      js_ctx->pos = size;
+    } else if(!more) {
+      js_ctx->done = 1;
+    }
+  }
+
+  js_ctx->putchar = putchar;
+  js_ctx->buf = NULL;
+  js_ctx->offset += js_ctx->pos;
+  return js_ctx->pos;
+}
+/*---------------------------------------------------------------------------*/
+void
+jsontree_seek(struct jsontree_context *js_ctx, uint32_t offset)
+{
+  if(offset < js_ctx->offset) {
+    /* Start over, the output cannot go back */
+    jsontree_reset(js_ctx);
+  }
+  /* Forward from the current position, nothing to skip if the request
+     is for the next block */
+  js_ctx->skip += offset - js_ctx->offset;
+  js_ctx->offset = offset;
+}
+/*---------------------------------------------------------------------------*/
 static struct jsontree_value *
 find_next(struct jsontree_context *js_ctx)
 {
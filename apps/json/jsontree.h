@@ -56,6 +56,13 @@ struct jsontree_context {
   uint8_t depth;
   uint8_t path;
   int callback_state;
+  /* Output to a buffer, see jsontree_print_block() */
+  char *buf;
+  int size;
+  int pos;
+  uint32_t skip;
+  uint32_t offset; /* of the next block in the document */
+  uint8_t done;
 };
 
 struct jsontree_value {
@@ -136,6 +143,45 @@ void jsontree_write_atom(const struct jsontree_context *js_ctx,
 void jsontree_write_string(const struct jsontree_context *js_ctx,
                            const char *text);
 int jsontree_print_next(struct jsontree_context *js_ctx);
+
+/**
+ * \brief      Write the next block of the JSON document to a buffer.
+ * \param js_ctx The JSON tree context
+ * \param buf  The buffer
+ * \param size The size of the buffer
+ * \return     The number of bytes written, 0 once the whole document
+ *             has been written
+ *
+ *             The buffer is filled completely except for the last
+ *             block of the document. A value that does not fit is
+ *             continued in the next block: it is generated again and
+ *             the part that was already written is skipped. Callbacks
+ *             must therefore produce the same output when called
+ *             again with the same callback_state.
+ *
+ *             Callbacks that write with js_ctx->putchar() also work,
+ *             but the jsontree_write_ functions write directly to the
+ *             buffer and are faster.
+ */
+int jsontree_print_block(struct jsontree_context *js_ctx, char *buf,
+                         int size);
+
+/**
+ * \brief      Set where in the JSON document the next block starts.
+ * \param js_ctx The JSON tree context
+ * \param offset The offset in the document
+ *
+ *             The next call to jsontree_print_block() starts writing
+ *             at offset bytes into the document. A CoAP block2 handler
+ *             that keeps the context between requests calls this with
+ *             the offset of each requested block: the next block in
+ *             order continues where the previous one ended. Other
+ *             offsets, as well as a freshly reset context, make
+ *             jsontree_print_block() generate the document from the
+ *             start and skip the bytes before the offset. Callbacks
+ *             must then produce the same output on every call.
+ */
+void jsontree_seek(struct jsontree_context *js_ctx, uint32_t offset);
 struct jsontree_value *jsontree_find_next(struct jsontree_context *js_ctx,
                                           int type);
 
@@ -57,6 +57,7 @@
 
 #include "lib/assert.h"
 #include "lib/list.h"
+#include "lib/memb.h"
 
 #include <stdlib.h>
 #include <stdio.h>
@@ -127,6 +128,12 @@ typedef enum {
 #define RESPONSE_WAIT_TIMEOUT (CLOCK_SECOND * 10)
 /*---------------------------------------------------------------------------*/
 #define INCREMENT_MID(conn)   (conn)->mid_counter += 2
+#if MQTT_INFLIGHT_WINDOW
+/* Only one (un)subscribe can wait for the output buffer to be sent */
+#define SUB_DEFERRED(conn)    ((conn)->deferred_event != 0)
+#else /* MQTT_INFLIGHT_WINDOW */
+#define SUB_DEFERRED(conn)    0
+#endif /* MQTT_INFLIGHT_WINDOW */
 #define MQTT_STRING_LENGTH(s) (((s)->length) == 0 ? 0 : (MQTT_STRING_LEN_SIZE + (s)->length))
 /*---------------------------------------------------------------------------*/
 /* Protothread send macros */
@@ -189,6 +196,9 @@ static void tcp_event(struct tcp_socket *s, void *ptr,
 static void reset_packet(struct mqtt_in_packet *packet);
 /*---------------------------------------------------------------------------*/
 LIST(mqtt_conn_list);
+#if MQTT_INFLIGHT_WINDOW
+MEMB(out_queue_memb, struct mqtt_queued_msg, MQTT_OUT_QUEUE_LENGTH);
+#endif /* MQTT_INFLIGHT_WINDOW */
 /*---------------------------------------------------------------------------*/
 PROCESS(mqtt_process, "MQTT process");
 /*---------------------------------------------------------------------------*/
@@ -210,14 +220,104 @@ reset_defaults(struct mqtt_connection *conn)
 
   reset_packet(&conn->in_packet);
   conn->out_buffer_sent = 0;
+#if MQTT_INFLIGHT_WINDOW
+  conn->deferred_event = 0;
+#endif /* MQTT_INFLIGHT_WINDOW */
 }
 /*---------------------------------------------------------------------------*/
+#if MQTT_INFLIGHT_WINDOW
+static void
+schedule_publish(struct mqtt_connection *conn)
+{
+  if(!conn->publish_scheduled &&
+     process_post(&mqtt_process, mqtt_do_publish_event, conn) ==
+     PROCESS_ERR_OK) {
+    conn->publish_scheduled = 1;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static struct mqtt_queued_msg *
+next_unsent(struct mqtt_connection *conn)
+{
+  struct mqtt_queued_msg *msg;
+
+  for(msg = list_head(conn->out_queue); msg != NULL; msg = msg->next) {
+    if(!msg->in_flight) {
+      break;
+    }
+  }
+  return msg;
+}
+/*---------------------------------------------------------------------------*/
+static void
+complete_publish(struct mqtt_connection *conn, struct mqtt_queued_msg *msg,
+                 mqtt_status_t status)
+{
+  mqtt_publish_callback_t callback = msg->callback;
+  uint16_t mid = msg->mid;
+  void *ptr = msg->ptr;
+
+  if(msg->in_flight) {
+    conn->in_flight--;
+  }
+  list_remove(conn->out_queue, msg);
+  memb_free(&out_queue_memb, msg);
+
+  if(callback != NULL) {
+    callback(conn, mid, status, ptr);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+in_flight_callback(void *ptr)
+{
+  struct mqtt_connection *conn = ptr;
+  struct mqtt_queued_msg *msg, *next;
+  clock_time_t now = clock_time();
+
+  /* Messages go in flight in queue order, so the oldest one comes first */
+  for(msg = list_head(conn->out_queue); msg != NULL; msg = next) {
+    next = msg->next;
+    if(!msg->in_flight) {
+      continue;
+    }
+    if(now - msg->sent < RESPONSE_WAIT_TIMEOUT) {
+      ctimer_set(&conn->in_flight_timer,
+                 RESPONSE_WAIT_TIMEOUT - (now - msg->sent),
+                 in_flight_callback, conn);
+      break;
+    }
+    DBG("MQTT - Timeout waiting for PUBACK %u\n", msg->mid);
+    complete_publish(conn, msg, MQTT_STATUS_ERROR);
+  }
+
+  if(next_unsent(conn) != NULL) {
+    schedule_publish(conn);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+flush_out_queue(struct mqtt_connection *conn)
+{
+  struct mqtt_queued_msg *msg;
+
+  ctimer_stop(&conn->in_flight_timer);
+  while((msg = list_head(conn->out_queue)) != NULL) {
+    complete_publish(conn, msg, MQTT_STATUS_NOT_CONNECTED_ERROR);
+  }
+}
+#endif /* MQTT_INFLIGHT_WINDOW */
+/*---------------------------------------------------------------------------*/
 static void
 abort_connection(struct mqtt_connection *conn)
 {
   conn->out_buffer_ptr = conn->out_buffer;
   conn->out_queue_full = 0;
 
+#if MQTT_INFLIGHT_WINDOW
+  flush_out_queue(conn);
+#endif /* MQTT_INFLIGHT_WINDOW */
+
   /* Reset outgoing packet */
   memset(&conn->out_packet, 0, sizeof(conn->out_packet));
 
@@ -270,6 +370,9 @@ send_out_buffer(struct mqtt_connection *conn)
 
   tcp_socket_send(&conn->socket, conn->out_buffer,
                   conn->out_buffer_ptr - conn->out_buffer);
+
+  /* Send right away instead of at the next periodic poll */
+  tcpip_poll_tcp(conn->socket.c);
 }
 /*---------------------------------------------------------------------------*/
 static void
@@ -413,16 +516,16 @@ PT_THREAD(connect_pt(struct pt *pt, struct mqtt_connection *conn))
   PT_MQTT_WRITE_BYTE(conn, conn->connect_vhdr_flags);
   PT_MQTT_WRITE_BYTE(conn, (conn->keep_alive >> 8));
   PT_MQTT_WRITE_BYTE(conn, (conn->keep_alive & 0x00FF));
-  PT_MQTT_WRITE_BYTE(conn, conn->client_id.length << 8);
+  PT_MQTT_WRITE_BYTE(conn, conn->client_id.length >> 8);
   PT_MQTT_WRITE_BYTE(conn, conn->client_id.length & 0x00FF);
   PT_MQTT_WRITE_BYTES(conn, (uint8_t *)conn->client_id.string,
                       conn->client_id.length);
   if(conn->connect_vhdr_flags & MQTT_VHDR_WILL_FLAG) {
-    PT_MQTT_WRITE_BYTE(conn, conn->will.topic.length << 8);
+    PT_MQTT_WRITE_BYTE(conn, conn->will.topic.length >> 8);
     PT_MQTT_WRITE_BYTE(conn, conn->will.topic.length & 0x00FF);
     PT_MQTT_WRITE_BYTES(conn, (uint8_t *)conn->will.topic.string,
                         conn->will.topic.length);
-    PT_MQTT_WRITE_BYTE(conn, conn->will.message.length << 8);
+    PT_MQTT_WRITE_BYTE(conn, conn->will.message.length >> 8);
     PT_MQTT_WRITE_BYTE(conn, conn->will.message.length & 0x00FF);
     PT_MQTT_WRITE_BYTES(conn, (uint8_t *)conn->will.message.string,
                         conn->will.message.length);
@@ -433,14 +536,14 @@ PT_THREAD(connect_pt(struct pt *pt, struct mqtt_connection *conn))
         conn->will.message.length);
   }
   if(conn->connect_vhdr_flags & MQTT_VHDR_USERNAME_FLAG) {
-    PT_MQTT_WRITE_BYTE(conn, conn->credentials.username.length << 8);
+    PT_MQTT_WRITE_BYTE(conn, conn->credentials.username.length >> 8);
     PT_MQTT_WRITE_BYTE(conn, conn->credentials.username.length & 0x00FF);
     PT_MQTT_WRITE_BYTES(conn,
                         (uint8_t *)conn->credentials.username.string,
                         conn->credentials.username.length);
   }
   if(conn->connect_vhdr_flags & MQTT_VHDR_PASSWORD_FLAG) {
-    PT_MQTT_WRITE_BYTE(conn, conn->credentials.password.length << 8);
+    PT_MQTT_WRITE_BYTE(conn, conn->credentials.password.length >> 8);
     PT_MQTT_WRITE_BYTE(conn, conn->credentials.password.length & 0x00FF);
     PT_MQTT_WRITE_BYTES(conn,
                         (uint8_t *)conn->credentials.password.string,
@@ -504,6 +607,12 @@ PT_THREAD(subscribe_pt(struct pt *pt, struct mqtt_connection *conn))
 {
   PT_BEGIN(pt);
 
+  conn->out_packet.mid = conn->sub_mid;
+  conn->out_packet.topic = conn->sub_topic;
+  conn->out_packet.topic_length = strlen(conn->sub_topic);
+  conn->out_packet.qos = conn->sub_qos;
+  conn->out_packet.qos_state = MQTT_QOS_STATE_NO_ACK;
+
   DBG("MQTT - Sending subscribe message! topic %s topic_length %i\n",
       conn->out_packet.topic,
       conn->out_packet.topic_length);
@@ -531,7 +640,7 @@ PT_THREAD(subscribe_pt(struct pt *pt, struct mqtt_connection *conn))
                       conn->out_packet.remaining_length_enc,
                       conn->out_packet.remaining_length_enc_bytes);
   /* Write Variable Header */
-  PT_MQTT_WRITE_BYTE(conn, (conn->out_packet.mid << 8));
+  PT_MQTT_WRITE_BYTE(conn, (conn->out_packet.mid >> 8));
   PT_MQTT_WRITE_BYTE(conn, (conn->out_packet.mid & 0x00FF));
   /* Write Payload */
   PT_MQTT_WRITE_BYTE(conn, (conn->out_packet.topic_length >> 8));
@@ -567,6 +676,11 @@ PT_THREAD(unsubscribe_pt(struct pt *pt, struct mqtt_connection *conn))
 {
   PT_BEGIN(pt);
 
+  conn->out_packet.mid = conn->sub_mid;
+  conn->out_packet.topic = conn->sub_topic;
+  conn->out_packet.topic_length = strlen(conn->sub_topic);
+  conn->out_packet.qos_state = MQTT_QOS_STATE_NO_ACK;
+
   DBG("MQTT - Sending unsubscribe message on topic %s topic_length %i\n",
       conn->out_packet.topic,
       conn->out_packet.topic_length);
@@ -593,7 +707,7 @@ PT_THREAD(unsubscribe_pt(struct pt *pt, struct mqtt_connection *conn))
   PT_MQTT_WRITE_BYTES(conn, (uint8_t *)conn->out_packet.remaining_length_enc,
                       conn->out_packet.remaining_length_enc_bytes);
   /* Write Variable Header */
-  PT_MQTT_WRITE_BYTE(conn, (conn->out_packet.mid << 8));
+  PT_MQTT_WRITE_BYTE(conn, (conn->out_packet.mid >> 8));
   PT_MQTT_WRITE_BYTE(conn, (conn->out_packet.mid & 0x00FF));
   /* Write Payload */
   PT_MQTT_WRITE_BYTE(conn, (conn->out_packet.topic_length >> 8));
@@ -666,7 +780,7 @@ PT_THREAD(publish_pt(struct pt *pt, struct mqtt_connection *conn))
   PT_MQTT_WRITE_BYTES(conn, (uint8_t *)conn->out_packet.topic,
                       conn->out_packet.topic_length);
   if(conn->out_packet.qos > MQTT_QOS_LEVEL_0) {
-    PT_MQTT_WRITE_BYTE(conn, (conn->out_packet.mid << 8));
+    PT_MQTT_WRITE_BYTE(conn, (conn->out_packet.mid >> 8));
     PT_MQTT_WRITE_BYTE(conn, (conn->out_packet.mid & 0x00FF));
   }
   /* Write Payload */
@@ -674,6 +788,14 @@ PT_THREAD(publish_pt(struct pt *pt, struct mqtt_connection *conn))
                       conn->out_packet.payload,
                       conn->out_packet.payload_size);
 
+#if MQTT_INFLIGHT_WINDOW
+  /*
+   * Queued messages are sent together by the caller and their PUBACKs are
+   * matched in handle_puback().
+   */
+  PT_EXIT(pt);
+#endif /* MQTT_INFLIGHT_WINDOW */
+
   send_out_buffer(conn);
   timer_set(&conn->t, RESPONSE_WAIT_TIMEOUT);
 
@@ -819,12 +941,33 @@ handle_unsuback(struct mqtt_connection *conn)
 static void
 handle_puback(struct mqtt_connection *conn)
 {
+#if MQTT_INFLIGHT_WINDOW
+  struct mqtt_queued_msg *msg;
+#endif /* MQTT_INFLIGHT_WINDOW */
+
   DBG("MQTT - Got PUBACK\n");
 
-  conn->out_packet.qos_state = MQTT_QOS_STATE_GOT_ACK;
   conn->in_packet.mid = (conn->in_packet.payload[0] << 8) |
     (conn->in_packet.payload[1]);
 
+#if MQTT_INFLIGHT_WINDOW
+  for(msg = list_head(conn->out_queue); msg != NULL; msg = msg->next) {
+    if(msg->in_flight && msg->mid == conn->in_packet.mid) {
+      complete_publish(conn, msg, MQTT_STATUS_OK);
+      break;
+    }
+  }
+  if(msg == NULL) {
+    DBG("MQTT - Warning, got PUBACK for MID %u not in flight.\n",
+        conn->in_packet.mid);
+  }
+  if(next_unsent(conn) != NULL) {
+    schedule_publish(conn);
+  }
+#else /* MQTT_INFLIGHT_WINDOW */
+  conn->out_packet.qos_state = MQTT_QOS_STATE_GOT_ACK;
+#endif /* MQTT_INFLIGHT_WINDOW */
+
   call_event(conn, MQTT_EVENT_PUBACK, &conn->in_packet.mid);
 }
 /*---------------------------------------------------------------------------*/
@@ -908,21 +1051,20 @@ parse_publish_vhdr(struct mqtt_connection *conn,
   }
 }
 /*---------------------------------------------------------------------------*/
-static int
-tcp_input(struct tcp_socket *s,
-          void *ptr,
-          const uint8_t *input_data_ptr,
-          int input_data_len)
+/*
+ * Reads input data up to the end of one packet and handles the packet once it
+ * is complete. Returns the number of bytes consumed.
+ */
+static uint32_t
+input_packet(struct mqtt_connection *conn,
+             const uint8_t *input_data_ptr,
+             int input_data_len)
 {
-  struct mqtt_connection *conn = ptr;
   uint32_t pos = 0;
   uint32_t copy_bytes = 0;
+  uint32_t packet_length;
   uint8_t byte;
 
-  if(input_data_len == 0) {
-    return 0;
-  }
-
   if(conn->in_packet.packet_received) {
     reset_packet(&conn->in_packet);
   }
@@ -937,7 +1079,7 @@ tcp_input(struct tcp_socket *s,
     DBG("MQTT - Read VHDR '%02X'\n", conn->in_packet.fhdr);
 
     if(pos >= input_data_len) {
-      return 0;
+      return pos;
     }
   }
 
@@ -945,7 +1087,7 @@ tcp_input(struct tcp_socket *s,
   if(!conn->in_packet.has_remaining_length) {
     do {
       if(pos >= input_data_len) {
-        return 0;
+        return pos;
       }
 
       byte = input_data_ptr[pos++];
@@ -956,7 +1098,7 @@ tcp_input(struct tcp_socket *s,
       if(conn->in_packet.byte_counter > 5) {
         call_event(conn, MQTT_EVENT_ERROR, NULL);
         DBG("Received more then 4 byte 'remaining lenght'.");
-        return 0;
+        return input_data_len;
       }
 
       conn->in_packet.remaining_length +=
@@ -984,7 +1126,7 @@ tcp_input(struct tcp_socket *s,
        (MQTT_FHDR_SIZE + conn->in_packet.remaining_length)) {
       conn->in_packet.packet_received = 1;
     }
-    return 0;
+    return input_data_len;
   }
 
   /*
@@ -993,17 +1135,20 @@ tcp_input(struct tcp_socket *s,
    * Note: There will always be at least one byte left to read when we enter
    *       this loop.
    */
-  while(conn->in_packet.byte_counter <
-        (MQTT_FHDR_SIZE + conn->in_packet.remaining_length)) {
+  packet_length = MQTT_FHDR_SIZE + conn->in_packet.remaining_length_bytes +
+    conn->in_packet.remaining_length;
+  while(conn->in_packet.byte_counter < packet_length) {
 
     if((conn->in_packet.fhdr & 0xF0) == MQTT_FHDR_MSG_TYPE_PUBLISH &&
        conn->in_packet.topic_received == 0) {
       parse_publish_vhdr(conn, &pos, input_data_ptr, input_data_len);
     }
 
-    /* Read in as much as we can into the packet payload */
+    /* Read in as much as we can of this packet into the packet payload */
     copy_bytes = MIN(input_data_len - pos,
                      MQTT_INPUT_BUFF_SIZE - conn->in_packet.payload_pos);
+    copy_bytes = MIN(copy_bytes,
+                     packet_length - conn->in_packet.byte_counter);
     DBG("- Copied %lu payload bytes\n", copy_bytes);
     memcpy(&conn->in_packet.payload[conn->in_packet.payload_pos],
            &input_data_ptr[pos],
@@ -1032,8 +1177,8 @@ tcp_input(struct tcp_socket *s,
     }
 
     if(pos >= input_data_len &&
-       (conn->in_packet.byte_counter < (MQTT_FHDR_SIZE + conn->in_packet.remaining_length))) {
-      return 0;
+       conn->in_packet.byte_counter < packet_length) {
+      return pos;
     }
   }
 
@@ -1087,6 +1232,23 @@ tcp_input(struct tcp_socket *s,
 
   conn->in_packet.packet_received = 1;
 
+  return pos;
+}
+/*---------------------------------------------------------------------------*/
+static int
+tcp_input(struct tcp_socket *s,
+          void *ptr,
+          const uint8_t *input_data_ptr,
+          int input_data_len)
+{
+  struct mqtt_connection *conn = ptr;
+  uint32_t pos = 0;
+
+  /* A segment may carry several packets, e.g. PUBACKs for queued PUBLISHes */
+  while(pos < input_data_len) {
+    pos += input_packet(conn, &input_data_ptr[pos], input_data_len - pos);
+  }
+
   return 0;
 }
 /*---------------------------------------------------------------------------*/
@@ -1132,6 +1294,15 @@ tcp_event(struct tcp_socket *s, void *ptr, tcp_socket_event_t event)
     if(conn->socket.output_data_len == 0) {
       conn->out_buffer_sent = 1;
       conn->out_buffer_ptr = conn->out_buffer;
+#if MQTT_INFLIGHT_WINDOW
+      if(conn->deferred_event != 0) {
+        process_post(&mqtt_process, conn->deferred_event, conn);
+        conn->deferred_event = 0;
+      }
+      if(next_unsent(conn) != NULL) {
+        schedule_publish(conn);
+      }
+#endif /* MQTT_INFLIGHT_WINDOW */
     }
 
     ctimer_restart(&conn->keep_alive_timer);
@@ -1148,6 +1319,9 @@ tcp_event(struct tcp_socket *s, void *ptr, tcp_socket_event_t event)
 PROCESS_THREAD(mqtt_process, ev, data)
 {
   static struct mqtt_connection *conn;
+#if MQTT_INFLIGHT_WINDOW
+  static struct mqtt_queued_msg *msg;
+#endif /* MQTT_INFLIGHT_WINDOW */
 
   PROCESS_BEGIN();
 
@@ -1223,6 +1397,13 @@ PROCESS_THREAD(mqtt_process, ev, data)
           PT_MQTT_WAIT_SEND();
         }
       }
+#if MQTT_INFLIGHT_WINDOW
+      else if(conn->state == MQTT_CONN_STATE_CONNECTED_TO_BROKER) {
+        /* Queued PUBLISH messages are still being sent, try again when
+           the output buffer has been sent */
+        conn->deferred_event = ev;
+      }
+#endif /* MQTT_INFLIGHT_WINDOW */
     }
     if(ev == mqtt_do_unsubscribe_event) {
       conn = data;
@@ -1236,11 +1417,70 @@ PROCESS_THREAD(mqtt_process, ev, data)
           PT_MQTT_WAIT_SEND();
         }
       }
+#if MQTT_INFLIGHT_WINDOW
+      else if(conn->state == MQTT_CONN_STATE_CONNECTED_TO_BROKER) {
+        /* Queued PUBLISH messages are still being sent, try again when
+           the output buffer has been sent */
+        conn->deferred_event = ev;
+      }
+#endif /* MQTT_INFLIGHT_WINDOW */
     }
     if(ev == mqtt_do_publish_event) {
       conn = data;
       DBG("MQTT - Got mqtt_do_publish_mqtt_event!\n");
 
+#if MQTT_INFLIGHT_WINDOW
+      conn->publish_scheduled = 0;
+
+      /*
+       * Write as many queued messages as the window allows back to back into
+       * the output buffer, which is only sent when it is full or at the end.
+       * The next batch is scheduled when the buffer has been sent or a
+       * PUBACK opens the window.
+       */
+      if(conn->out_buffer_sent == 1 &&
+         conn->state == MQTT_CONN_STATE_CONNECTED_TO_BROKER) {
+        while(conn->in_flight < MQTT_INFLIGHT_WINDOW &&
+              (msg = next_unsent(conn)) != NULL) {
+          conn->out_packet.mid = msg->mid;
+          conn->out_packet.retain = msg->retain;
+          conn->out_packet.topic = msg->topic;
+          conn->out_packet.topic_length = msg->topic_length;
+          conn->out_packet.payload = msg->payload;
+          conn->out_packet.payload_size = msg->payload_size;
+          conn->out_packet.qos = msg->qos;
+          conn->out_packet.qos_state = MQTT_QOS_STATE_NO_ACK;
+
+          PT_INIT(&conn->out_proto_thread);
+          while(publish_pt(&conn->out_proto_thread, conn) < PT_EXITED &&
+                conn->state == MQTT_CONN_STATE_CONNECTED_TO_BROKER) {
+            PT_MQTT_WAIT_SEND();
+          }
+          if(conn->state != MQTT_CONN_STATE_CONNECTED_TO_BROKER) {
+            break;
+          }
+
+          if(conn->out_packet.remaining_length_enc_bytes > 4) {
+            complete_publish(conn, msg, MQTT_STATUS_ERROR);
+          } else if(msg->qos == MQTT_QOS_LEVEL_1) {
+            msg->in_flight = 1;
+            msg->sent = clock_time();
+            conn->in_flight++;
+            if(ctimer_expired(&conn->in_flight_timer)) {
+              ctimer_set(&conn->in_flight_timer, RESPONSE_WAIT_TIMEOUT,
+                         in_flight_callback, conn);
+            }
+          } else {
+            /* There is no ACK to wait for */
+            complete_publish(conn, msg, MQTT_STATUS_OK);
+            process_post(conn->app_process, mqtt_update_event, NULL);
+          }
+        }
+        if(conn->state == MQTT_CONN_STATE_CONNECTED_TO_BROKER) {
+          send_out_buffer(conn);
+        }
+      }
+#else /* MQTT_INFLIGHT_WINDOW */
       if(conn->out_buffer_sent == 1 &&
          conn->state == MQTT_CONN_STATE_CONNECTED_TO_BROKER) {
         PT_INIT(&conn->out_proto_thread);
@@ -1249,6 +1489,7 @@ PROCESS_THREAD(mqtt_process, ev, data)
           PT_MQTT_WAIT_SEND();
         }
       }
+#endif /* MQTT_INFLIGHT_WINDOW */
     }
   }
   PROCESS_END();
@@ -1296,6 +1537,9 @@ mqtt_register(struct mqtt_connection *conn, struct process *app_process,
   conn->app_process = app_process;
   conn->auto_reconnect = 1;
   conn->max_segment_size = max_segment_size;
+#if MQTT_INFLIGHT_WINDOW
+  LIST_STRUCT_INIT(conn, out_queue);
+#endif /* MQTT_INFLIGHT_WINDOW */
   reset_defaults(conn);
 
   mqtt_init();
@@ -1369,18 +1613,17 @@ mqtt_subscribe(struct mqtt_connection *conn, uint16_t *mid, char *topic,
   DBG("MQTT - Call to mqtt_subscribe...\n");
 
   /* Currently don't have a queue, so only one item at a time */
-  if(conn->out_queue_full) {
+  if(conn->out_queue_full || SUB_DEFERRED(conn)) {
     DBG("MQTT - Not accepted!\n");
     return MQTT_STATUS_OUT_QUEUE_FULL;
   }
   conn->out_queue_full = 1;
   DBG("MQTT - Accepted!\n");
 
-  conn->out_packet.mid = INCREMENT_MID(conn);
-  conn->out_packet.topic = topic;
-  conn->out_packet.topic_length = strlen(topic);
-  conn->out_packet.qos = qos_level;
-  conn->out_packet.qos_state = MQTT_QOS_STATE_NO_ACK;
+  /* Queued PUBLISH messages use out_packet until the SUBSCRIBE is written */
+  conn->sub_mid = INCREMENT_MID(conn);
+  conn->sub_topic = topic;
+  conn->sub_qos = qos_level;
 
   process_post(&mqtt_process, mqtt_do_subscribe_event, conn);
   return MQTT_STATUS_OK;
@@ -1395,27 +1638,72 @@ mqtt_unsubscribe(struct mqtt_connection *conn, uint16_t *mid, char *topic)
 
   DBG("MQTT - Call to mqtt_unsubscribe...\n");
   /* Currently don't have a queue, so only one item at a time */
-  if(conn->out_queue_full) {
+  if(conn->out_queue_full || SUB_DEFERRED(conn)) {
     DBG("MQTT - Not accepted!\n");
     return MQTT_STATUS_OUT_QUEUE_FULL;
   }
   conn->out_queue_full = 1;
   DBG("MQTT - Accepted!\n");
 
-  conn->out_packet.mid = INCREMENT_MID(conn);
-  conn->out_packet.topic = topic;
-  conn->out_packet.topic_length = strlen(topic);
-  conn->out_packet.qos_state = MQTT_QOS_STATE_NO_ACK;
+  conn->sub_mid = INCREMENT_MID(conn);
+  conn->sub_topic = topic;
 
   process_post(&mqtt_process, mqtt_do_unsubscribe_event, conn);
   return MQTT_STATUS_OK;
 }
 /*----------------------------------------------------------------------------*/
+#if MQTT_INFLIGHT_WINDOW
+mqtt_status_t
+mqtt_publish_cb(struct mqtt_connection *conn, uint16_t *mid, char *topic,
+                uint8_t *payload, uint32_t payload_size,
+                mqtt_qos_level_t qos_level, mqtt_retain_t retain,
+                mqtt_publish_callback_t callback, void *ptr)
+{
+  struct mqtt_queued_msg *msg;
+
+  if(conn->state != MQTT_CONN_STATE_CONNECTED_TO_BROKER) {
+    return MQTT_STATUS_NOT_CONNECTED_ERROR;
+  }
+
+  DBG("MQTT - Call to mqtt_publish...\n");
+
+  msg = memb_alloc(&out_queue_memb);
+  if(msg == NULL) {
+    DBG("MQTT - Not accepted!\n");
+    return MQTT_STATUS_OUT_QUEUE_FULL;
+  }
+  DBG("MQTT - Accepted!\n");
+
+  msg->mid = INCREMENT_MID(conn);
+  msg->retain = retain;
+  msg->topic = topic;
+  msg->topic_length = strlen(topic);
+  msg->payload = payload;
+  msg->payload_size = payload_size;
+  msg->qos = qos_level;
+  msg->in_flight = 0;
+  msg->callback = callback;
+  msg->ptr = ptr;
+  list_add(conn->out_queue, msg);
+
+  if(mid != NULL) {
+    *mid = msg->mid;
+  }
+
+  schedule_publish(conn);
+  return MQTT_STATUS_OK;
+}
+#endif /* MQTT_INFLIGHT_WINDOW */
+/*----------------------------------------------------------------------------*/
 mqtt_status_t
 mqtt_publish(struct mqtt_connection *conn, uint16_t *mid, char *topic,
              uint8_t *payload, uint32_t payload_size,
              mqtt_qos_level_t qos_level, mqtt_retain_t retain)
 {
+#if MQTT_INFLIGHT_WINDOW
+  return mqtt_publish_cb(conn, mid, topic, payload, payload_size, qos_level,
+                         retain, NULL, NULL);
+#else /* MQTT_INFLIGHT_WINDOW */
   if(conn->state != MQTT_CONN_STATE_CONNECTED_TO_BROKER) {
     return MQTT_STATUS_NOT_CONNECTED_ERROR;
   }
@@ -1441,6 +1729,7 @@ mqtt_publish(struct mqtt_connection *conn, uint16_t *mid, char *topic,
 
   process_post(&mqtt_process, mqtt_do_publish_event, conn);
   return MQTT_STATUS_OK;
+#endif /* MQTT_INFLIGHT_WINDOW */
 }
 /*----------------------------------------------------------------------------*/
 void
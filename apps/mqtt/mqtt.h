@@ -117,6 +117,25 @@
 #define MQTT_PROTOCOL_VERSION 3
 #define MQTT_PROTOCOL_NAME "MQIsdp"
 #define MQTT_TOPIC_MAX_LENGTH 128
+
+/*
+ * Number of QoS 1 PUBLISH messages that may wait for their PUBACK at the same
+ * time. With a window, mqtt_publish() queues the message and queued messages
+ * are written back to back into the TCP output buffer. With 0, one operation
+ * is outstanding at a time and mqtt_publish() is refused until it completes.
+ */
+#ifdef MQTT_CONF_INFLIGHT_WINDOW
+#define MQTT_INFLIGHT_WINDOW MQTT_CONF_INFLIGHT_WINDOW
+#else
+#define MQTT_INFLIGHT_WINDOW 0
+#endif
+
+/* Number of queued PUBLISH messages, shared by all connections */
+#ifdef MQTT_CONF_OUT_QUEUE_LENGTH
+#define MQTT_OUT_QUEUE_LENGTH MQTT_CONF_OUT_QUEUE_LENGTH
+#else
+#define MQTT_OUT_QUEUE_LENGTH (2 * MQTT_INFLIGHT_WINDOW)
+#endif
 /*---------------------------------------------------------------------------*/
 /*
  * Debug configuration, this is similar but not exactly like the Debugging
@@ -301,6 +320,41 @@ typedef void (*mqtt_event_callback_t)(struct mqtt_connection *m,
 
 typedef void (*mqtt_topic_callback_t)(struct mqtt_connection *m,
                                       struct mqtt_message *msg);
+
+/**
+ * \brief           MQTT publish callback function
+ * \param m         A pointer to a MQTT connection
+ * \param mid       The message ID of the PUBLISH message
+ * \param status    MQTT_STATUS_OK when the message was acknowledged (QoS 1)
+ *                  or written (QoS 0), an error status otherwise
+ * \param ptr       The pointer given to mqtt_publish_cb()
+ *
+ * Called once per queued PUBLISH message. The topic and payload of the
+ * message may be reused after this call.
+ */
+typedef void (*mqtt_publish_callback_t)(struct mqtt_connection *m,
+                                        uint16_t mid,
+                                        mqtt_status_t status,
+                                        void *ptr);
+/*---------------------------------------------------------------------------*/
+/*
+ * A PUBLISH message in the outbound queue. The topic and payload are not
+ * copied, so they must stay valid until the message's callback is called.
+ */
+struct mqtt_queued_msg {
+  struct mqtt_queued_msg *next;
+  clock_time_t sent;
+  char *topic;
+  uint16_t topic_length;
+  uint8_t *payload;
+  uint32_t payload_size;
+  uint16_t mid;
+  mqtt_qos_level_t qos;
+  mqtt_retain_t retain;
+  uint8_t in_flight;
+  mqtt_publish_callback_t callback;
+  void *ptr;
+};
 /*---------------------------------------------------------------------------*/
 struct mqtt_will {
   struct mqtt_string topic;
@@ -349,6 +403,22 @@ struct mqtt_connection {
   uint32_t out_write_pos;
   uint16_t max_segment_size;
 
+  /* The pending SUBSCRIBE or UNSUBSCRIBE, copied into out_packet when it is
+     written */
+  uint16_t sub_mid;
+  char *sub_topic;
+  mqtt_qos_level_t sub_qos;
+
+#if MQTT_INFLIGHT_WINDOW
+  /* Queued PUBLISH messages, in the order of the mqtt_publish() calls */
+  LIST_STRUCT(out_queue);
+  uint8_t in_flight;
+  uint8_t publish_scheduled;
+  /* A (un)subscribe event to process once the output buffer is sent */
+  process_event_t deferred_event;
+  struct ctimer in_flight_timer;
+#endif /* MQTT_INFLIGHT_WINDOW */
+
   /* Incoming data related */
   uint8_t in_buffer[MQTT_TCP_INPUT_BUFF_SIZE];
   struct mqtt_in_packet in_packet;
@@ -451,6 +521,11 @@ mqtt_status_t mqtt_unsubscribe(struct mqtt_connection *conn,
  * \return MQTT_STATUS_OK or some error status
  *
  * This function publishes to a topic on a MQTT broker.
+ *
+ * With MQTT_INFLIGHT_WINDOW the message is only queued, and neither the
+ * topic nor the payload is copied. Both must stay valid until the message
+ * has been acknowledged (QoS 1) or written (QoS 0). Use mqtt_publish_cb()
+ * to be told when that is.
  */
 mqtt_status_t mqtt_publish(struct mqtt_connection *conn,
                            uint16_t *mid,
@@ -460,6 +535,35 @@ mqtt_status_t mqtt_publish(struct mqtt_connection *conn,
                            mqtt_qos_level_t qos_level,
                            mqtt_retain_t retain);
 /*---------------------------------------------------------------------------*/
+#if MQTT_INFLIGHT_WINDOW
+/**
+ * \brief Queue a PUBLISH message with a completion callback.
+ * \param conn A pointer to the MQTT connection.
+ * \param mid A pointer to store the message ID in, or NULL.
+ * \param topic A pointer to the topic to publish to.
+ * \param payload A pointer to the topic payload.
+ * \param payload_size Payload size.
+ * \param qos_level Quality Of Service level to use. Currently supports 0, 1.
+ * \param retain The RETAIN flag, see mqtt_publish().
+ * \param callback Function to call when the message is done, or NULL.
+ * \param ptr A user-defined pointer passed to the callback.
+ * \return MQTT_STATUS_OK, MQTT_STATUS_OUT_QUEUE_FULL or some error status
+ *
+ * The message is sent once up to MQTT_INFLIGHT_WINDOW earlier QoS 1 messages
+ * are acknowledged. The topic and payload must stay valid until the callback
+ * has been called. mqtt_publish() is the same without a callback.
+ */
+mqtt_status_t mqtt_publish_cb(struct mqtt_connection *conn,
+                              uint16_t *mid,
+                              char *topic,
+                              uint8_t *payload,
+                              uint32_t payload_size,
+                              mqtt_qos_level_t qos_level,
+                              mqtt_retain_t retain,
+                              mqtt_publish_callback_t callback,
+                              void *ptr);
+#endif /* MQTT_INFLIGHT_WINDOW */
+/*---------------------------------------------------------------------------*/
 /**
  * \brief Set the user name and password for a MQTT client.
  * \param conn A pointer to the MQTT connection.
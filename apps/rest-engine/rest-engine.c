@@ -58,6 +58,21 @@ PROCESS(rest_engine_process, "REST Engine");
 /*---------------------------------------------------------------------------*/
 LIST(restful_services);
 LIST(restful_periodic_services);
+
+#if REST_RESOURCE_HASH_SIZE
+/*
+ * Resources are also chained into hash buckets by the hash of their URI path,
+ * in the order in which they were activated. Parent resources are found by
+ * looking up the prefixes of the request URI path that have the length of a
+ * parent URI path; parent_lengths has bit n set for a parent URI path of
+ * length n < 32, and long_parents is set if there are longer ones.
+ */
+static resource_t *resource_hash[REST_RESOURCE_HASH_SIZE];
+static uint32_t parent_lengths;
+static uint8_t long_parents;
+
+#define URL_HASH_NEXT(hash, c) ((uint16_t)((hash) * 31 + (uint8_t)(c)))
+#endif /* REST_RESOURCE_HASH_SIZE */
 /*---------------------------------------------------------------------------*/
 /*- REST Engine API ---------------------------------------------------------*/
 /*---------------------------------------------------------------------------*/
@@ -71,6 +86,11 @@ void
 rest_init_engine(void)
 {
   list_init(restful_services);
+#if REST_RESOURCE_HASH_SIZE
+  memset(resource_hash, 0, sizeof(resource_hash));
+  parent_lengths = 0;
+  long_parents = 0;
+#endif /* REST_RESOURCE_HASH_SIZE */
 
   REST.set_service_callback(rest_invoke_restful_service);
 
@@ -81,6 +101,52 @@ rest_init_engine(void)
   process_start(&rest_engine_process, NULL);
 }
 /*---------------------------------------------------------------------------*/
+#if REST_RESOURCE_HASH_SIZE
+static resource_t **
+hash_bucket(const char *url, int len)
+{
+  uint16_t hash = 0;
+
+  while(len-- > 0) {
+    hash = URL_HASH_NEXT(hash, *url++);
+  }
+  return &resource_hash[hash % REST_RESOURCE_HASH_SIZE];
+}
+/*---------------------------------------------------------------------------*/
+static void
+hash_resource(resource_t *resource)
+{
+  resource_t **r;
+  int len = strlen(resource->url);
+
+  for(r = hash_bucket(resource->url, len); *r; r = &(*r)->hash_next);
+  *r = resource;
+  resource->hash_next = NULL;
+
+  if(resource->flags & HAS_SUB_RESOURCES) {
+    if(len < 32) {
+      parent_lengths |= (uint32_t)1 << len;
+    } else {
+      long_parents = 1;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+unhash_resource(resource_t *resource)
+{
+  resource_t **r;
+
+  for(r = hash_bucket(resource->url, strlen(resource->url)); *r;
+      r = &(*r)->hash_next) {
+    if(*r == resource) {
+      *r = resource->hash_next;
+      return;
+    }
+  }
+}
+#endif /* REST_RESOURCE_HASH_SIZE */
+/*---------------------------------------------------------------------------*/
 /**
  * \brief Makes a resource available under the given URI path
  * \param resource A pointer to a resource implementation
@@ -93,8 +159,23 @@ rest_init_engine(void)
 void
 rest_activate_resource(resource_t *resource, char *path)
 {
+#if REST_RESOURCE_HASH_SIZE
+  resource_t *r;
+
+  /* a resource that is activated again moves to its new URI path */
+  for(r = (resource_t *)list_head(restful_services); r; r = r->next) {
+    if(r == resource) {
+      unhash_resource(resource);
+      break;
+    }
+  }
+#endif /* REST_RESOURCE_HASH_SIZE */
+
   resource->url = path;
   list_add(restful_services, resource);
+#if REST_RESOURCE_HASH_SIZE
+  hash_resource(resource);
+#endif /* REST_RESOURCE_HASH_SIZE */
 
   PRINTF("Activating: %s\n", resource->url);
 
@@ -115,6 +196,64 @@ rest_get_resources(void)
   return restful_services;
 }
 /*---------------------------------------------------------------------------*/
+#if REST_RESOURCE_HASH_SIZE
+/*
+ * Returns the resource activated first with exactly the given URI path or,
+ * if there is none, the parent resource with the longest matching prefix.
+ */
+static resource_t *
+find_resource(const char *url, int url_len)
+{
+  resource_t *resource;
+  resource_t *parent = NULL;
+  uint16_t hash = 0;
+  int len;
+
+  for(len = 0; len <= url_len; len++) {
+    if(len > 0) {
+      hash = URL_HASH_NEXT(hash, url[len - 1]);
+    }
+    if(len < url_len && !(len < 32 ? parent_lengths & ((uint32_t)1 << len)
+                          : long_parents)) {
+      continue;
+    }
+    for(resource = resource_hash[hash % REST_RESOURCE_HASH_SIZE]; resource;
+        resource = resource->hash_next) {
+      if((len == url_len || (resource->flags & HAS_SUB_RESOURCES))
+         && strncmp(resource->url, url, len) == 0
+         && resource->url[len] == '\0') {
+        if(len == url_len) {
+          return resource;
+        }
+        parent = resource;
+        break;
+      }
+    }
+  }
+  return parent;
+}
+#else /* REST_RESOURCE_HASH_SIZE */
+static resource_t *
+find_resource(const char *url, int url_len)
+{
+  resource_t *resource;
+  int len;
+
+  for(resource = (resource_t *)list_head(restful_services);
+      resource; resource = resource->next) {
+    len = strlen(resource->url);
+
+    /* if the web service handles that kind of requests and urls matches */
+    if((url_len == len
+        || (url_len > len && (resource->flags & HAS_SUB_RESOURCES)))
+       && strncmp(resource->url, url, len) == 0) {
+      return resource;
+    }
+  }
+  return NULL;
+}
+#endif /* REST_RESOURCE_HASH_SIZE */
+/*---------------------------------------------------------------------------*/
 int
 rest_invoke_restful_service(void *request, void *response, uint8_t *buffer,
                             uint16_t buffer_size, int32_t *offset)
@@ -124,40 +263,33 @@ rest_invoke_restful_service(void *request, void *response, uint8_t *buffer,
 
   resource_t *resource = NULL;
   const char *url = NULL;
+  int url_len = REST.get_url(request, &url);
 
-  for(resource = (resource_t *)list_head(restful_services);
-      resource; resource = resource->next) {
+  resource = find_resource(url, url_len);
+  if(resource) {
+    found = 1;
+    rest_resource_flags_t method = REST.get_method_type(request);
 
-    /* if the web service handles that kind of requests and urls matches */
-    if((REST.get_url(request, &url) == strlen(resource->url)
-        || (REST.get_url(request, &url) > strlen(resource->url)
-            && (resource->flags & HAS_SUB_RESOURCES)))
-       && strncmp(resource->url, url, strlen(resource->url)) == 0) {
-      found = 1;
-      rest_resource_flags_t method = REST.get_method_type(request);
-
-      PRINTF("/%s, method %u, resource->flags %u\n", resource->url,
-             (uint16_t)method, resource->flags);
-
-      if((method & METHOD_GET) && resource->get_handler != NULL) {
-        /* call handler function */
-        resource->get_handler(request, response, buffer, buffer_size, offset);
-      } else if((method & METHOD_POST) && resource->post_handler != NULL) {
-        /* call handler function */
-        resource->post_handler(request, response, buffer, buffer_size,
+    PRINTF("/%s, method %u, resource->flags %u\n", resource->url,
+           (uint16_t)method, resource->flags);
+
+    if((method & METHOD_GET) && resource->get_handler != NULL) {
+      /* call handler function */
+      resource->get_handler(request, response, buffer, buffer_size, offset);
+    } else if((method & METHOD_POST) && resource->post_handler != NULL) {
+      /* call handler function */
+      resource->post_handler(request, response, buffer, buffer_size,
+                             offset);
+    } else if((method & METHOD_PUT) && resource->put_handler != NULL) {
+      /* call handler function */
+      resource->put_handler(request, response, buffer, buffer_size, offset);
+    } else if((method & METHOD_DELETE) && resource->delete_handler != NULL) {
+      /* call handler function */
+      resource->delete_handler(request, response, buffer, buffer_size,
                                offset);
-      } else if((method & METHOD_PUT) && resource->put_handler != NULL) {
-        /* call handler function */
-        resource->put_handler(request, response, buffer, buffer_size, offset);
-      } else if((method & METHOD_DELETE) && resource->delete_handler != NULL) {
-        /* call handler function */
-        resource->delete_handler(request, response, buffer, buffer_size,
-                                 offset);
-      } else {
-        allowed = 0;
-        REST.set_response_status(response, REST.status.METHOD_NOT_ALLOWED);
-      }
-      break;
+    } else {
+      allowed = 0;
+      REST.set_response_status(response, REST.status.METHOD_NOT_ALLOWED);
     }
   }
   if(!found) {
@@ -62,6 +62,14 @@
 #define REST_MAX_CHUNK_SIZE     64
 #endif
 
+/*
+ * The number of hash buckets used to find the resource for a request URI path.
+ * With 0, all resources are compared with the URI path of every request.
+ */
+#ifndef REST_RESOURCE_HASH_SIZE
+#define REST_RESOURCE_HASH_SIZE 0
+#endif
+
 #ifndef MIN
 #define MIN(a, b) ((a) < (b) ? (a) : (b))
 #endif /* MIN */
@@ -99,6 +107,9 @@ struct resource_s {
     restful_trigger_handler trigger;
     restful_trigger_handler resume;
   };
+#if REST_RESOURCE_HASH_SIZE
+  struct resource_s *hash_next;   /* next resource in the same hash bucket */
+#endif /* REST_RESOURCE_HASH_SIZE */
 };
 typedef struct resource_s resource_t;
 
@@ -58,6 +58,9 @@
 #include "cfs/cfs.h"
 #include "cfs-coffee-arch.h"
 #include "cfs/cfs-coffee.h"
+#if COFFEE_GC_INCREMENTAL
+#include "sys/process.h"
+#endif
 
 /* Micro logs enable modifications on storage types that do not support
    in-place updates. This applies primarily to flash memories. */
@@ -90,6 +93,32 @@
 #define COFFEE_EXTENDED_WEAR_LEVELLING  1
 #endif
 
+/*
+ * A RAM-resident index that maps file names to the pages of their
+ * headers, so that opening a file does not require a scan of the
+ * storage. The size is given in index slots; 0 disables the index.
+ * The index is built on first use and kept up to date when files are
+ * reserved and removed. If there are more files than slots, Coffee
+ * falls back to scanning until files have been removed.
+ */
+#ifndef COFFEE_NAME_INDEX_SIZE
+#define COFFEE_NAME_INDEX_SIZE 0
+#endif
+
+/*
+ * Reclaim obsolete sectors in the background, one sector erasure per
+ * poll of a process, instead of only when a reservation fails. A pass
+ * starts once COFFEE_GC_WATERMARK more pages have become obsolete
+ * since the previous pass, and ends when no sector can be erased.
+ */
+#ifndef COFFEE_GC_INCREMENTAL
+#define COFFEE_GC_INCREMENTAL 0
+#endif
+
+#ifndef COFFEE_GC_WATERMARK
+#define COFFEE_GC_WATERMARK COFFEE_PAGES_PER_SECTOR
+#endif
+
 #if COFFEE_START & (COFFEE_SECTOR_SIZE - 1)
 #error COFFEE_START must point to the first byte in a sector.
 #endif
@@ -212,6 +241,35 @@ static struct protected_mem_t {
   coffee_page_t next_free;
   char gc_wait;
 } protected_mem;
+#if COFFEE_NAME_INDEX_SIZE > 0
+/* An entry of the name index: the header page of an active file and
+   the hash of its name. */
+struct name_index_entry {
+  coffee_page_t page;
+  uint16_t hash;
+};
+
+#define NAME_INDEX_INVALID  0 /* Must be rebuilt before use. */
+#define NAME_INDEX_VALID    1
+#define NAME_INDEX_OVERFLOW 2 /* Too many files; not used. */
+
+static struct name_index_entry name_index[COFFEE_NAME_INDEX_SIZE];
+static uint16_t name_index_count;
+static uint8_t name_index_state;
+#endif /* COFFEE_NAME_INDEX_SIZE > 0 */
+
+static struct cfs_coffee_gc_stats gc_stats;
+
+#if COFFEE_GC_INCREMENTAL
+/* Obsolete pages, as counted by the last background step and updated
+   on removals since then. */
+static coffee_page_t obsolete_pages;
+/* Obsolete pages that were left when the last pass ended. */
+static coffee_page_t obsolete_after_pass;
+
+PROCESS(coffee_gc_process, "Coffee GC");
+#endif /* COFFEE_GC_INCREMENTAL */
+
 static struct file *const coffee_files = protected_mem.coffee_files;
 static struct file_desc *const coffee_fd_set = protected_mem.coffee_fd_set;
 static coffee_page_t *const next_free = &protected_mem.next_free;
@@ -362,12 +420,33 @@ isolate_pages(coffee_page_t start, coffee_page_t skip_pages)
 }
 /*---------------------------------------------------------------------------*/
 static void
+erase_sector(uint16_t sector, coffee_page_t isolation_count)
+{
+  coffee_page_t first_page;
+
+  first_page = sector * COFFEE_PAGES_PER_SECTOR;
+  if(first_page < *next_free) {
+    *next_free = first_page;
+  }
+
+  if(isolation_count > 0) {
+    isolate_pages(first_page + COFFEE_PAGES_PER_SECTOR, isolation_count);
+    gc_stats.pages_isolated += isolation_count;
+  }
+
+  COFFEE_ERASE(sector);
+  gc_stats.sectors_erased++;
+  PRINTF("Coffee: Erased sector %d!\n", sector);
+}
+/*---------------------------------------------------------------------------*/
+static void
 collect_garbage(int mode)
 {
   uint16_t sector;
   struct sector_status stats;
-  coffee_page_t first_page, isolation_count;
+  coffee_page_t isolation_count;
 
+  gc_stats.collections++;
   PRINTF("Coffee: Running the file system garbage collector in %s mode\n",
          mode == GC_RELUCTANT ? "reluctant" : "greedy");
   /*
@@ -386,17 +465,7 @@ collect_garbage(int mode)
 
     if((mode == GC_RELUCTANT && stats.free == 0) ||
        (mode == GC_GREEDY && stats.obsolete > 0)) {
-      first_page = sector * COFFEE_PAGES_PER_SECTOR;
-      if(first_page < *next_free) {
-        *next_free = first_page;
-      }
-
-      if(isolation_count > 0) {
-        isolate_pages(first_page + COFFEE_PAGES_PER_SECTOR, isolation_count);
-      }
-
-      COFFEE_ERASE(sector);
-      PRINTF("Coffee: Erased sector %d!\n", sector);
+      erase_sector(sector, isolation_count);
 
       if(mode == GC_RELUCTANT && isolation_count > 0) {
         break;
@@ -405,6 +474,65 @@ collect_garbage(int mode)
   }
 }
 /*---------------------------------------------------------------------------*/
+#if COFFEE_GC_INCREMENTAL
+/*
+ * Erase the first sector that contains obsolete pages but no active
+ * ones, and count the obsolete pages in the other sectors. The sectors
+ * are scanned from the start in each step, since files may have been
+ * reserved or removed between two steps.
+ */
+static int
+collect_garbage_step(void)
+{
+  uint16_t sector;
+  struct sector_status stats;
+  coffee_page_t isolation_count;
+  int erased;
+
+  erased = 0;
+  obsolete_pages = 0;
+  for(sector = 0; sector < COFFEE_SECTOR_COUNT; sector++) {
+    isolation_count = get_sector_status(sector, &stats);
+    if(!erased && stats.active == 0 && stats.obsolete > 0) {
+      erase_sector(sector, isolation_count);
+      erased = 1;
+    } else {
+      obsolete_pages += stats.obsolete;
+    }
+  }
+  return erased;
+}
+/*---------------------------------------------------------------------------*/
+static void
+add_obsolete_pages(coffee_page_t pages)
+{
+  obsolete_pages += pages;
+  if(obsolete_pages >= obsolete_after_pass + COFFEE_GC_WATERMARK) {
+    if(!process_is_running(&coffee_gc_process)) {
+      process_start(&coffee_gc_process, NULL);
+    }
+    process_poll(&coffee_gc_process);
+  }
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(coffee_gc_process, ev, data)
+{
+  PROCESS_BEGIN();
+
+  for(;;) {
+    PROCESS_WAIT_EVENT_UNTIL(ev == PROCESS_EVENT_POLL);
+    if(collect_garbage_step()) {
+      gc_stats.background_steps++;
+      process_poll(&coffee_gc_process);
+    } else {
+      obsolete_after_pass = obsolete_pages;
+    }
+  }
+
+  PROCESS_END();
+}
+#endif /* COFFEE_GC_INCREMENTAL */
+/*---------------------------------------------------------------------------*/
 static coffee_page_t
 next_file(coffee_page_t page, struct file_header *hdr)
 {
@@ -426,6 +554,135 @@ next_file(coffee_page_t page, struct file_header *hdr)
   return page + hdr->max_pages;
 }
 /*---------------------------------------------------------------------------*/
+#if COFFEE_NAME_INDEX_SIZE > 0
+static uint16_t
+name_hash(const char *name)
+{
+  uint16_t hash;
+
+  /* The 16-bit variant of the FNV-1a hash. */
+  for(hash = 0x9dc5; *name != '\0'; name++) {
+    hash = (hash ^ (unsigned char)*name) * 0x0193;
+  }
+  return hash;
+}
+/*---------------------------------------------------------------------------*/
+static void
+name_index_add(const char *name, coffee_page_t page)
+{
+  uint16_t hash;
+  unsigned slot;
+
+  if(name_index_state != NAME_INDEX_VALID) {
+    return;
+  }
+  if(name_index_count == COFFEE_NAME_INDEX_SIZE) {
+    name_index_state = NAME_INDEX_OVERFLOW;
+    return;
+  }
+
+  hash = name_hash(name);
+  for(slot = hash % COFFEE_NAME_INDEX_SIZE;
+      name_index[slot].page != INVALID_PAGE;
+      slot = (slot + 1) % COFFEE_NAME_INDEX_SIZE);
+  name_index[slot].page = page;
+  name_index[slot].hash = hash;
+  name_index_count++;
+}
+/*---------------------------------------------------------------------------*/
+static void
+name_index_remove(const char *name, coffee_page_t page)
+{
+  unsigned slot, next, home;
+  unsigned i;
+
+  if(name_index_state == NAME_INDEX_OVERFLOW) {
+    /* There may be room for all files now. */
+    name_index_state = NAME_INDEX_INVALID;
+  }
+  if(name_index_state != NAME_INDEX_VALID) {
+    return;
+  }
+
+  slot = name_hash(name) % COFFEE_NAME_INDEX_SIZE;
+  for(i = 0; name_index[slot].page != page; i++) {
+    if(name_index[slot].page == INVALID_PAGE ||
+       i == COFFEE_NAME_INDEX_SIZE) {
+      return;
+    }
+    slot = (slot + 1) % COFFEE_NAME_INDEX_SIZE;
+  }
+
+  /*
+   * Shift the following entries of the probe sequence back instead of
+   * leaving a deleted marker, so that lookups of missing names stop
+   * at the first empty slot.
+   */
+  for(next = (slot + 1) % COFFEE_NAME_INDEX_SIZE;
+      name_index[next].page != INVALID_PAGE && next != slot;
+      next = (next + 1) % COFFEE_NAME_INDEX_SIZE) {
+    home = name_index[next].hash % COFFEE_NAME_INDEX_SIZE;
+    if((next > slot && (home <= slot || home > next)) ||
+       (next < slot && home <= slot && home > next)) {
+      name_index[slot] = name_index[next];
+      slot = next;
+    }
+  }
+  name_index[slot].page = INVALID_PAGE;
+  name_index_count--;
+}
+/*---------------------------------------------------------------------------*/
+static void
+name_index_rebuild(void)
+{
+  struct file_header hdr;
+  coffee_page_t page;
+  unsigned i;
+
+  for(i = 0; i < COFFEE_NAME_INDEX_SIZE; i++) {
+    name_index[i].page = INVALID_PAGE;
+  }
+  name_index_count = 0;
+  name_index_state = NAME_INDEX_VALID;
+
+  for(page = 0; page < COFFEE_PAGE_COUNT; page = next_file(page, &hdr)) {
+    read_header(&hdr, page);
+    if(HDR_ACTIVE(hdr) && !HDR_LOG(hdr)) {
+      name_index_add(hdr.name, page);
+      if(name_index_state != NAME_INDEX_VALID) {
+        PRINTF("Coffee: Too many files for the name index\n");
+        return;
+      }
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static coffee_page_t
+name_index_find(const char *name, struct file_header *hdr)
+{
+  uint16_t hash;
+  unsigned slot;
+  unsigned i;
+
+  hash = name_hash(name);
+  slot = hash % COFFEE_NAME_INDEX_SIZE;
+  for(i = 0; i < COFFEE_NAME_INDEX_SIZE; i++) {
+    if(name_index[slot].page == INVALID_PAGE) {
+      break;
+    }
+    /* Only the headers of files with the same hash are read. */
+    if(name_index[slot].hash == hash) {
+      read_header(hdr, name_index[slot].page);
+      if(HDR_ACTIVE(*hdr) && !HDR_LOG(*hdr) && strcmp(name, hdr->name) == 0) {
+        return name_index[slot].page;
+      }
+    }
+    slot = (slot + 1) % COFFEE_NAME_INDEX_SIZE;
+  }
+  return INVALID_PAGE;
+}
+#endif /* COFFEE_NAME_INDEX_SIZE > 0 */
+/*---------------------------------------------------------------------------*/
 static struct file *
 load_file(coffee_page_t start, struct file_header *hdr)
 {
@@ -475,6 +732,25 @@ find_file(const char *name)
   struct file_header hdr;
   coffee_page_t page;
 
+#if COFFEE_NAME_INDEX_SIZE > 0
+  if(name_index_state == NAME_INDEX_INVALID) {
+    name_index_rebuild();
+  }
+  if(name_index_state == NAME_INDEX_VALID) {
+    page = name_index_find(name, &hdr);
+    if(page == INVALID_PAGE) {
+      return NULL;
+    }
+    /* Use the cached file metadata if there is any. */
+    for(i = 0; i < COFFEE_MAX_OPEN_FILES; i++) {
+      if(!FILE_FREE(&coffee_files[i]) && coffee_files[i].page == page) {
+        return &coffee_files[i];
+      }
+    }
+    return load_file(page, &hdr);
+  }
+#endif /* COFFEE_NAME_INDEX_SIZE > 0 */
+
   /* First check if the file metadata is cached. */
   for(i = 0; i < COFFEE_MAX_OPEN_FILES; i++) {
     if(FILE_FREE(&coffee_files[i])) {
@@ -589,6 +865,12 @@ remove_by_page(coffee_page_t page, int remove_log, int close_fds,
   hdr.flags |= HDR_FLAG_OBSOLETE;
   write_header(&hdr, page);
 
+#if COFFEE_NAME_INDEX_SIZE > 0
+  if(!HDR_LOG(hdr)) {
+    name_index_remove(hdr.name, page);
+  }
+#endif
+
   *gc_wait = 0;
 
   /* Close all file descriptors that reference the removed file. */
@@ -608,7 +890,9 @@ remove_by_page(coffee_page_t page, int remove_log, int close_fds,
     }
   }
 
-#if !COFFEE_EXTENDED_WEAR_LEVELLING
+#if COFFEE_GC_INCREMENTAL
+  add_obsolete_pages(hdr.max_pages);
+#elif !COFFEE_EXTENDED_WEAR_LEVELLING
   if(gc_allowed) {
     collect_garbage(GC_RELUCTANT);
   }
@@ -655,6 +939,12 @@ reserve(const char *name, coffee_page_t pages,
   hdr.flags = HDR_FLAG_ALLOCATED | flags;
   write_header(&hdr, page);
 
+#if COFFEE_NAME_INDEX_SIZE > 0
+  if(!HDR_LOG(hdr)) {
+    name_index_add(hdr.name, page);
+  }
+#endif
+
   PRINTF("Coffee: Reserved %u pages starting from %u for file %s\n",
          pages, page, name);
 
@@ -1357,12 +1647,24 @@ cfs_coffee_format(void)
 
   /* Formatting invalidates the file information. */
   memset(&protected_mem, 0, sizeof(protected_mem));
+#if COFFEE_GC_INCREMENTAL
+  obsolete_pages = obsolete_after_pass = 0;
+#endif
+#if COFFEE_NAME_INDEX_SIZE > 0
+  name_index_state = NAME_INDEX_INVALID;
+#endif
 
   PRINTF(" done!\n");
 
   return 0;
 }
 /*---------------------------------------------------------------------------*/
+void
+cfs_coffee_get_gc_stats(struct cfs_coffee_gc_stats *stats)
+{
+  memcpy(stats, &gc_stats, sizeof(*stats));
+}
+/*---------------------------------------------------------------------------*/
 void *
 cfs_coffee_get_protected_mem(unsigned *size)
 {
@@ -126,6 +126,29 @@ int cfs_coffee_set_io_semantics(int fd, unsigned flags);
  */
 int cfs_coffee_format(void);
 
+/**
+ * Garbage collection statistics. Coffee never copies file data when
+ * collecting garbage: it erases sectors that hold no active pages, and
+ * marks pages of obsolete files that extend into such a sector as
+ * isolated first.
+ */
+struct cfs_coffee_gc_stats {
+  /** Sectors erased. */
+  unsigned long sectors_erased;
+  /** Pages marked as isolated before erasing a sector. */
+  unsigned long pages_isolated;
+  /** Synchronous collections, e.g. when a reservation fails. */
+  unsigned long collections;
+  /** Sectors erased in the background (COFFEE_GC_INCREMENTAL). */
+  unsigned long background_steps;
+};
+
+/**
+ * \brief Get the garbage collection statistics.
+ * \param stats The structure that the statistics are copied to.
+ */
+void cfs_coffee_get_gc_stats(struct cfs_coffee_gc_stats *stats);
+
 /**
  * \brief Points out a memory region that may not be altered during
  * checkpointing operations that use the file system.
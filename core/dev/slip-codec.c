@@ -0,0 +1,182 @@
+/*
+ * Copyright (c) 2015, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         SLIP encoder and decoder for block I/O.
+ */
+
+#include "slip-codec.h"
+
+#include <stddef.h>
+#include <string.h>
+
+/*---------------------------------------------------------------------------*/
+void
+slip_decoder_init(struct slip_decoder *d)
+{
+  memset(d, 0, sizeof(*d));
+}
+/*---------------------------------------------------------------------------*/
+static void
+append(struct slip_decoder *d, struct slip_codec_frame *f,
+       const uint8_t *data, int len)
+{
+  if(d->overflow || f->len + len > SLIP_CODEC_FRAME_SIZE) {
+    d->overflow = 1;
+    return;
+  }
+  memcpy(&f->data[f->len], data, len);
+  f->len += len;
+}
+/*---------------------------------------------------------------------------*/
+int
+slip_decoder_input(struct slip_decoder *d, const uint8_t *data, int len)
+{
+  struct slip_codec_frame *f;
+  const uint8_t *p;
+  const uint8_t *end;
+  const uint8_t *run;
+  uint8_t c;
+
+  p = data;
+  end = data + len;
+  while(p < end && d->count < SLIP_CODEC_FRAMES) {
+    f = &d->frames[(d->first + d->count) % SLIP_CODEC_FRAMES];
+
+    if(d->esc) {
+      d->esc = 0;
+      c = *p++;
+      if(c == SLIP_CODEC_ESC_END) {
+        c = SLIP_CODEC_END;
+      } else if(c == SLIP_CODEC_ESC_ESC) {
+        c = SLIP_CODEC_ESC;
+      }
+      append(d, f, &c, 1);
+      continue;
+    }
+
+    /* Copy the bytes up to the next special byte in one go */
+    run = p;
+    while(p < end && *p != SLIP_CODEC_END && *p != SLIP_CODEC_ESC) {
+      p++;
+    }
+    if(p > run) {
+      append(d, f, run, p - run);
+    }
+    if(p == end) {
+      break;
+    }
+
+    if(*p++ == SLIP_CODEC_ESC) {
+      d->esc = 1;
+    } else if(d->overflow) {
+      d->overflow = 0;
+      d->dropped++;
+      f->len = 0;
+    } else if(f->len > 0) {
+      d->count++;
+      if(d->count < SLIP_CODEC_FRAMES) {
+        d->frames[(d->first + d->count) % SLIP_CODEC_FRAMES].len = 0;
+      }
+    }
+  }
+  return p - data;
+}
+/*---------------------------------------------------------------------------*/
+struct slip_codec_frame *
+slip_decoder_frame(struct slip_decoder *d)
+{
+  return d->count > 0 ? &d->frames[d->first] : NULL;
+}
+/*---------------------------------------------------------------------------*/
+void
+slip_decoder_release(struct slip_decoder *d)
+{
+  if(d->count == 0) {
+    return;
+  }
+  if(d->count == SLIP_CODEC_FRAMES) {
+    /* The released frame is where the next frame is received */
+    d->frames[d->first].len = 0;
+  }
+  d->first = (d->first + 1) % SLIP_CODEC_FRAMES;
+  d->count--;
+}
+/*---------------------------------------------------------------------------*/
+struct slip_codec_frame *
+slip_decoder_partial(struct slip_decoder *d)
+{
+  if(d->count == SLIP_CODEC_FRAMES) {
+    return NULL;
+  }
+  return &d->frames[(d->first + d->count) % SLIP_CODEC_FRAMES];
+}
+/*---------------------------------------------------------------------------*/
+int
+slip_encode(const uint8_t *data, int len, uint8_t *buf, int size)
+{
+  const uint8_t *p;
+  const uint8_t *end;
+  const uint8_t *run;
+  int pos;
+
+  p = data;
+  end = data + len;
+  pos = 0;
+  while(p < end) {
+    run = p;
+    while(p < end && *p != SLIP_CODEC_END && *p != SLIP_CODEC_ESC) {
+      p++;
+    }
+    if(pos + (p - run) > size) {
+      return -1;
+    }
+    memcpy(&buf[pos], run, p - run);
+    pos += p - run;
+
+    if(p < end) {
+      if(pos + 2 > size) {
+        return -1;
+      }
+      buf[pos++] = SLIP_CODEC_ESC;
+      buf[pos++] = *p++ == SLIP_CODEC_END ?
+        SLIP_CODEC_ESC_END : SLIP_CODEC_ESC_ESC;
+    }
+  }
+  if(pos + 1 > size) {
+    return -1;
+  }
+  buf[pos++] = SLIP_CODEC_END;
+  return pos;
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2015, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         SLIP encoder and decoder for host tools that read and write
+ *         the serial line in blocks, such as tunslip6 and the native
+ *         border router. The decoder takes whole read() chunks and
+ *         keeps a ring of decoded frames. Does not depend on the rest
+ *         of Contiki.
+ */
+
+#ifndef SLIP_CODEC_H_
+#define SLIP_CODEC_H_
+
+#include <stdint.h>
+
+#define SLIP_CODEC_END     0300
+#define SLIP_CODEC_ESC     0333
+#define SLIP_CODEC_ESC_END 0334
+#define SLIP_CODEC_ESC_ESC 0335
+
+/* Largest decoded frame; longer frames are dropped */
+#define SLIP_CODEC_FRAME_SIZE 2048
+/* Number of frames in the decoder ring */
+#define SLIP_CODEC_FRAMES     8
+
+/* The largest encoding of a frame of len bytes */
+#define SLIP_CODEC_ENCODED_SIZE(len) (2 * (len) + 1)
+
+struct slip_codec_frame {
+  uint16_t len;
+  uint8_t data[SLIP_CODEC_FRAME_SIZE];
+};
+
+struct slip_decoder {
+  struct slip_codec_frame frames[SLIP_CODEC_FRAMES];
+  uint8_t first;
+  uint8_t count;
+  uint8_t esc;
+  uint8_t overflow;
+  /* Frames dropped because they were longer than SLIP_CODEC_FRAME_SIZE */
+  uint32_t dropped;
+};
+
+/**
+ * Initialize a decoder.
+ */
+void slip_decoder_init(struct slip_decoder *d);
+
+/**
+ * Decode a block of SLIP data.
+ *
+ * \param d    The decoder
+ * \param data The received data
+ * \param len  The number of bytes received
+ * \return     The number of bytes decoded. This is less than len when
+ *             the ring of decoded frames is full; release frames with
+ *             slip_decoder_release() and pass the rest again.
+ */
+int slip_decoder_input(struct slip_decoder *d, const uint8_t *data, int len);
+
+/**
+ * Get the oldest decoded frame.
+ *
+ * \return The frame, or NULL if no complete frame has been received
+ */
+struct slip_codec_frame *slip_decoder_frame(struct slip_decoder *d);
+
+/**
+ * Release the frame returned by slip_decoder_frame().
+ */
+void slip_decoder_release(struct slip_decoder *d);
+
+/**
+ * Get the frame that is being received.
+ *
+ * The bytes received so far can be inspected and removed, for example
+ * to print debug lines that are not followed by a SLIP_END.
+ *
+ * \return The frame, or NULL if the ring is full
+ */
+struct slip_codec_frame *slip_decoder_partial(struct slip_decoder *d);
+
+/**
+ * Encode a frame, followed by SLIP_END.
+ *
+ * \param data The frame
+ * \param len  The length of the frame
+ * \param buf  The buffer for the encoded frame
+ * \param size The size of the buffer; SLIP_CODEC_ENCODED_SIZE(len) is
+ *             always enough
+ * \return     The length of the encoded frame, or -1 if it does not fit
+ */
+int slip_encode(const uint8_t *data, int len, uint8_t *buf, int size);
+
+#endif /* SLIP_CODEC_H_ */
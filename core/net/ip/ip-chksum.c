@@ -0,0 +1,191 @@
+/*
+ * Copyright (c) 2015, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Internet checksum computation and incremental update.
+ */
+
+#include "net/ip/ip-chksum.h"
+#include "net/ip/uip.h"
+
+#include <string.h>
+
+#ifdef IP_CHKSUM_CONF_WIDE
+#define IP_CHKSUM_WIDE IP_CHKSUM_CONF_WIDE
+#else /* IP_CHKSUM_CONF_WIDE */
+#define IP_CHKSUM_WIDE 0
+#endif /* IP_CHKSUM_CONF_WIDE */
+
+#if IP_CHKSUM_WIDE
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+#endif /* IP_CHKSUM_WIDE */
+
+/*---------------------------------------------------------------------------*/
+uint16_t
+ip_chksum_add16(uint16_t sum, uint16_t word)
+{
+  sum += word;
+  if(sum < word) {
+    sum++;      /* carry */
+  }
+  return sum;
+}
+/*---------------------------------------------------------------------------*/
+#if IP_CHKSUM_WIDE
+/* The ones' complement sum does not depend on the byte order (RFC
+   1071), so the data is summed in 32-bit words of host byte order and
+   the carries are added back only at the end. The accumulator cannot
+   overflow, as at most 2^14 words are added. */
+uint16_t
+ip_chksum_add(uint16_t sum, const void *data, uint16_t len)
+{
+  const uint8_t *dataptr;
+  uint64_t acc;
+  uint32_t w;
+  uint16_t h;
+
+  dataptr = data;
+  acc = 0;
+
+#if defined(__SSE2__)
+  if(len >= 16) {
+    __m128i zero, v, lanes;
+    uint32_t l[4];
+
+    /* Each of the four 32-bit lanes takes two 16-bit words per
+       round, which adds up to less than 2^30 for 64 kilobytes. */
+    zero = _mm_setzero_si128();
+    lanes = zero;
+    while(len >= 16) {
+      v = _mm_loadu_si128((const __m128i *)dataptr);
+      lanes = _mm_add_epi32(lanes, _mm_unpacklo_epi16(v, zero));
+      lanes = _mm_add_epi32(lanes, _mm_unpackhi_epi16(v, zero));
+      dataptr += 16;
+      len -= 16;
+    }
+    _mm_storeu_si128((__m128i *)l, lanes);
+    acc = (uint64_t)l[0] + l[1] + l[2] + l[3];
+  }
+#elif defined(__ARM_NEON)
+  if(len >= 16) {
+    uint32x4_t lanes;
+    uint64x2_t pairs;
+
+    lanes = vdupq_n_u32(0);
+    while(len >= 16) {
+      lanes = vpadalq_u16(lanes, vreinterpretq_u16_u8(vld1q_u8(dataptr)));
+      dataptr += 16;
+      len -= 16;
+    }
+    pairs = vpaddlq_u32(lanes);
+    acc = vgetq_lane_u64(pairs, 0) + vgetq_lane_u64(pairs, 1);
+  }
+#endif
+
+  while(len >= 4) {
+    memcpy(&w, dataptr, sizeof(w));
+    acc += w;
+    dataptr += 4;
+    len -= 4;
+  }
+  if(len >= 2) {
+    memcpy(&h, dataptr, sizeof(h));
+    acc += h;
+    dataptr += 2;
+    len -= 2;
+  }
+  if(len > 0) {
+    /* The last byte is the high-order byte of a word padded with a
+       zero byte. */
+#if UIP_BYTE_ORDER == UIP_BIG_ENDIAN
+    acc += (uint16_t)(dataptr[0] << 8);
+#else
+    acc += dataptr[0];
+#endif
+  }
+
+  while(acc >> 16) {
+    acc = (acc & 0xffff) + (acc >> 16);
+  }
+
+  /* Return sum in host byte order. */
+  return ip_chksum_add16(sum, uip_ntohs((uint16_t)acc));
+}
+#else /* IP_CHKSUM_WIDE */
+uint16_t
+ip_chksum_add(uint16_t sum, const void *data, uint16_t len)
+{
+  uint16_t t;
+  const uint8_t *dataptr;
+  const uint8_t *last_byte;
+
+  dataptr = data;
+  last_byte = dataptr + len - 1;
+
+  while(dataptr < last_byte) {   /* At least two more bytes */
+    t = (dataptr[0] << 8) + dataptr[1];
+    sum += t;
+    if(sum < t) {
+      sum++;      /* carry */
+    }
+    dataptr += 2;
+  }
+
+  if(dataptr == last_byte) {
+    t = (dataptr[0] << 8) + 0;
+    sum += t;
+    if(sum < t) {
+      sum++;      /* carry */
+    }
+  }
+
+  /* Return sum in host byte order. */
+  return sum;
+}
+#endif /* IP_CHKSUM_WIDE */
+/*---------------------------------------------------------------------------*/
+uint16_t
+ip_chksum_update(uint16_t chksum, uint16_t old_sum, uint16_t new_sum)
+{
+  uint16_t sum;
+
+  /* HC' = ~(~HC + ~m + m'), RFC 1624 equation 3. */
+  sum = ip_chksum_add16(~uip_ntohs(chksum), ~old_sum);
+  sum = ip_chksum_add16(sum, new_sum);
+  return uip_htons(~sum);
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2015, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \addtogroup uip
+ * @{
+ */
+
+/**
+ * \defgroup ipchksum Internet checksum
+ * @{
+ *
+ * The Internet checksum (RFC 1071) used by IPv4, ICMP, UDP and TCP,
+ * shared by uIP and ip64.
+ *
+ * Sums are ones' complement sums kept in host byte order; the value
+ * stored in a header is the complement of the sum, in network byte
+ * order. Besides summing data, the module can patch a checksum after
+ * part of the data it covers has been rewritten (RFC 1624), so that
+ * packets that are forwarded or translated need not be summed again.
+ *
+ * By default the data is summed 16 bits at a time. Hosts with a
+ * 32-bit or 64-bit CPU can set IP_CHKSUM_CONF_WIDE to sum 32 bits at
+ * a time into a 64-bit accumulator, and 128 bits at a time when the
+ * compiler targets SSE2 or NEON.
+ */
+
+/**
+ * \file
+ *         Internet checksum computation and incremental update.
+ */
+
+#ifndef IP_CHKSUM_H_
+#define IP_CHKSUM_H_
+
+#include "contiki-conf.h"
+
+/**
+ * Add data to a ones' complement sum.
+ *
+ * \param sum The sum so far, in host byte order, or 0.
+ * \param data The data, in network byte order. Need not be aligned.
+ * \param len The length of the data. Only the last block of data
+ *            added to a sum may have an odd length.
+ * \return The new sum, in host byte order.
+ */
+uint16_t ip_chksum_add(uint16_t sum, const void *data, uint16_t len);
+
+/**
+ * Add a 16-bit word to a ones' complement sum.
+ *
+ * \param sum The sum so far, in host byte order.
+ * \param word The word, in host byte order. This may also be the
+ *             sum of other data.
+ * \return The new sum, in host byte order.
+ */
+uint16_t ip_chksum_add16(uint16_t sum, uint16_t word);
+
+/**
+ * Update a checksum after the data it covers has changed (RFC 1624).
+ *
+ * The old and new sums only cover the data that has changed, which
+ * must start at an even offset into the checksummed data. They may
+ * cover different amounts of data, for example when the IPv6 pseudo
+ * header is replaced by an IPv4 pseudo header.
+ *
+ * \param chksum The checksum field, as found in the header.
+ * \param old_sum The sum of the data that was replaced.
+ * \param new_sum The sum of the data that replaced it.
+ * \return The new value of the checksum field.
+ */
+uint16_t ip_chksum_update(uint16_t chksum, uint16_t old_sum, uint16_t new_sum);
+
+#endif /* IP_CHKSUM_H_ */
+
+/** @} */
+/** @} */
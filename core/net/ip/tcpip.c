@@ -413,7 +413,7 @@ eventhandler(process_event_t ev, process_data_t data)
         for(cptr = &uip_udp_conns[0];
             cptr < &uip_udp_conns[UIP_UDP_CONNS]; ++cptr) {
           if(cptr->appstate.p == p) {
-            cptr->lport = 0;
+            uip_udp_remove(cptr);
           }
         }
       }
@@ -541,6 +541,10 @@ tcpip_ipv6_output(void)
 {
   uip_ds6_nbr_t *nbr = NULL;
   uip_ipaddr_t *nexthop;
+#if UIP_CONF_IPV6_RPL
+  uip_ipaddr_t srh_nexthop;
+  int srh;
+#endif /* UIP_CONF_IPV6_RPL */
 
   if(uip_len == 0) {
     return;
@@ -572,6 +576,17 @@ tcpip_ipv6_output(void)
       /* Check if we have a route to the destination address. */
       route = uip_ds6_route_lookup(&UIP_IP_BUF->destipaddr);
 
+#if UIP_CONF_IPV6_RPL
+      /* In RPL non-storing mode, the route down is carried in a source
+         routing header. */
+      if(route == NULL && (srh = rpl_srh_get_next_hop(&srh_nexthop)) != 0) {
+        if(srh < 0) {
+          uip_len = 0;
+          return;
+        }
+        nexthop = &srh_nexthop;
+      } else
+#endif /* UIP_CONF_IPV6_RPL */
       /* No route was found - we send to the default route instead. */
       if(route == NULL) {
         PRINTF("tcpip_ipv6_output: no route found, using default route\n");
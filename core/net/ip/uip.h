@@ -835,11 +835,17 @@ CCIF void uip_send(const void *data, int len);
  * The current maximum segment size that can be sent on the
  * connection is computed from the receiver's window and the MSS of
  * the connection (which also is available by calling
- * uip_initialmss()).
+ * uip_initialmss()). With UIP_TCP_SEND_WINDOW, it is also limited to
+ * what is left of the receiver's window while segments are in flight.
  *
  * \hideinitializer
  */
+#if UIP_TCP_SEND_WINDOW
+#define uip_mss()             (uip_conn->mss < uip_conn->wnd_mss ? \
+                               uip_conn->mss : uip_conn->wnd_mss)
+#else /* UIP_TCP_SEND_WINDOW */
 #define uip_mss()             (uip_conn->mss)
+#endif /* UIP_TCP_SEND_WINDOW */
 
 /**
  * Set up a new UDP connection.
@@ -877,7 +883,11 @@ struct uip_udp_conn *uip_udp_new(const uip_ipaddr_t *ripaddr, uint16_t rport);
  *
  * \hideinitializer
  */
+#if UIP_CONN_HASH
+#define uip_udp_remove(conn) uip_udp_bind(conn, 0)
+#else /* UIP_CONN_HASH */
 #define uip_udp_remove(conn) (conn)->lport = 0
+#endif /* UIP_CONN_HASH */
 
 /**
  * Bind a UDP connection to a local port.
@@ -889,7 +899,11 @@ struct uip_udp_conn *uip_udp_new(const uip_ipaddr_t *ripaddr, uint16_t rport);
  *
  * \hideinitializer
  */
+#if UIP_CONN_HASH
+void uip_udp_bind(struct uip_udp_conn *conn, uint16_t port);
+#else /* UIP_CONN_HASH */
 #define uip_udp_bind(conn, port) (conn)->lport = port
+#endif /* UIP_CONN_HASH */
 
 /**
  * Send a UDP datagram of length len on the current connection.
@@ -1353,6 +1367,10 @@ struct uip_conn {
 			 connection. */
   uint16_t initialmss;   /**< Initial maximum segment size for the
 			 connection. */
+#if UIP_TCP_SEND_WINDOW
+  uint16_t wnd_mss;      /**< The maximum segment size that fits in
+                            what is left of the receiver's window. */
+#endif /* UIP_TCP_SEND_WINDOW */
   uint8_t sa;            /**< Retransmission time-out calculation state
 			 variable. */
   uint8_t sv;            /**< Retransmission time-out calculation state
@@ -435,6 +435,35 @@ void uip_log(char *msg);
 #define UIP_LISTENPORTS (UIP_CONF_MAX_LISTENPORTS)
 #endif /* UIP_CONF_MAX_LISTENPORTS */
 
+/**
+ * Toggles hash tables for finding the connection an incoming TCP
+ * segment or UDP datagram belongs to (IPv6 only).
+ *
+ * By default, uIP searches the connection tables linearly for every
+ * incoming packet. With this option, TCP connections are hashed on
+ * their addresses and ports, and UDP connections and listening TCP
+ * ports on their local port, so that the search takes constant time.
+ * Each table entry requires one additional byte of memory.
+ *
+ * \hideinitializer
+ */
+#ifdef UIP_CONF_CONN_HASH
+#define UIP_CONN_HASH (UIP_CONF_CONN_HASH && NETSTACK_CONF_WITH_IPV6)
+#else /* UIP_CONF_CONN_HASH */
+#define UIP_CONN_HASH 0
+#endif /* UIP_CONF_CONN_HASH */
+
+/**
+ * The number of buckets in each of the connection hash tables.
+ *
+ * \hideinitializer
+ */
+#ifdef UIP_CONF_CONN_HASH_SIZE
+#define UIP_CONN_HASH_SIZE (UIP_CONF_CONN_HASH_SIZE)
+#else /* UIP_CONF_CONN_HASH_SIZE */
+#define UIP_CONN_HASH_SIZE 16
+#endif /* UIP_CONF_CONN_HASH_SIZE */
+
 /**
  * Determines if support for TCP urgent data notification should be
  * compiled in.
@@ -485,6 +514,27 @@ void uip_log(char *msg);
 #define UIP_TCP_MSS     (UIP_BUFSIZE - UIP_LLH_LEN - UIP_TCPIP_HLEN)
 #endif /* UIP_CONF_TCP_MSS */
 
+/**
+ * The number of unacknowledged segments a TCP connection may have in
+ * flight (IPv6 only).
+ *
+ * When set to zero, uIP sends a single segment at a time and the
+ * application regenerates it on retransmissions. When non-zero, each
+ * connection keeps a copy of up to this many segments of UIP_TCP_MSS
+ * bytes, which uIP retransmits itself. The number of segments in
+ * flight is further limited by a congestion window, and lost
+ * segments are resent after three duplicate ACKs. The application is
+ * signalled with uip_acked() as soon as uIP has taken over its data.
+ *
+ * \hideinitializer
+ */
+#ifdef UIP_CONF_TCP_SEND_WINDOW
+#define UIP_TCP_SEND_WINDOW \
+  (UIP_TCP && NETSTACK_CONF_WITH_IPV6 ? UIP_CONF_TCP_SEND_WINDOW : 0)
+#else /* UIP_CONF_TCP_SEND_WINDOW */
+#define UIP_TCP_SEND_WINDOW 0
+#endif /* UIP_CONF_TCP_SEND_WINDOW */
+
 /**
  * The size of the advertised receiver's window.
  *
@@ -570,6 +620,38 @@ void uip_log(char *msg);
 #define SICSLOWPAN_REASS_MAXAGE 20
 #endif
 
+/**
+ * Number of datagrams that can be reassembled at the same time at the
+ * 6lowpan layer. Each reassembly context holds a UIP_BUFSIZE buffer.
+ */
+#ifdef SICSLOWPAN_CONF_REASS_CONTEXTS
+#define SICSLOWPAN_REASS_CONTEXTS (SICSLOWPAN_CONF_REASS_CONTEXTS)
+#else
+#define SICSLOWPAN_REASS_CONTEXTS 1
+#endif
+
+/**
+ * Fragment forwarding (default: off). When enabled on a router, a
+ * fragmented datagram that is not addressed to us is not reassembled:
+ * its first fragment is decompressed to choose the next hop, and the
+ * following fragments are relayed as they arrive.
+ */
+#ifdef SICSLOWPAN_CONF_FRAG_FORWARDING
+#define SICSLOWPAN_FRAG_FORWARDING (SICSLOWPAN_CONF_FRAG_FORWARDING)
+#else
+#define SICSLOWPAN_FRAG_FORWARDING 0
+#endif
+
+/**
+ * Number of datagrams that can be forwarded fragment by fragment at
+ * the same time.
+ */
+#ifdef SICSLOWPAN_CONF_FRAG_FORWARD_ENTRIES
+#define SICSLOWPAN_FRAG_FORWARD_ENTRIES (SICSLOWPAN_CONF_FRAG_FORWARD_ENTRIES)
+#else
+#define SICSLOWPAN_FRAG_FORWARD_ENTRIES 4
+#endif
+
 /**
  * Do we compress the IP header or not (default: no)
  */
@@ -37,6 +37,7 @@
 
 #include "lib/random.h"
 
+#include <stddef.h>
 #include <string.h>
 
 #ifdef IP64_ADDRMAP_CONF_ENTRIES
@@ -45,9 +46,31 @@
 #define NUM_ENTRIES 32
 #endif /* IP64_ADDRMAP_CONF_ENTRIES */
 
+#ifdef IP64_ADDRMAP_CONF_HASH_SIZE
+#define HASH_SIZE IP64_ADDRMAP_CONF_HASH_SIZE
+#else /* IP64_ADDRMAP_CONF_HASH_SIZE */
+#define HASH_SIZE NUM_ENTRIES
+#endif /* IP64_ADDRMAP_CONF_HASH_SIZE */
+
 MEMB(entrymemb, struct ip64_addrmap_entry, NUM_ENTRIES);
 LIST(entrylist);
 
+#if IP64_ADDRMAP_HASH
+static struct ip64_addrmap_entry *hash[HASH_SIZE];
+static struct ip64_addrmap_entry *port_hash[HASH_SIZE];
+
+/* Each mapping is kept in the timing wheel slot in which its lifetime
+   ends. A slot covers WHEEL_TICK clock ticks and the wheel covers more
+   than the default lifetime of a mapping. When a lifetime is extended,
+   the mapping is left in its slot and moved on when the slot is
+   checked. wheel_time is the start of slot wheel_pos. */
+#define WHEEL_SLOTS 64
+#define WHEEL_TICK  (CLOCK_SECOND * 8)
+static struct ip64_addrmap_entry *wheel[WHEEL_SLOTS];
+static clock_time_t wheel_time;
+static uint8_t wheel_pos;
+#endif /* IP64_ADDRMAP_HASH */
+
 #define FIRST_MAPPED_PORT 10000
 #define LAST_MAPPED_PORT  20000
 static uint16_t mapped_port = FIRST_MAPPED_PORT;
@@ -67,7 +90,151 @@ ip64_addrmap_init(void)
   memb_init(&entrymemb);
   list_init(entrylist);
   mapped_port = FIRST_MAPPED_PORT;
+#if IP64_ADDRMAP_HASH
+  memset(hash, 0, sizeof(hash));
+  memset(port_hash, 0, sizeof(port_hash));
+  memset(wheel, 0, sizeof(wheel));
+  wheel_time = clock_time();
+  wheel_pos = 0;
+#endif /* IP64_ADDRMAP_HASH */
+}
+/*---------------------------------------------------------------------------*/
+#if IP64_ADDRMAP_HASH
+static unsigned
+hash_index(const uip_ip6addr_t *ip6addr, uint16_t ip6port,
+           const uip_ip4addr_t *ip4addr, uint16_t ip4port,
+           uint8_t protocol)
+{
+  unsigned h;
+  int i;
+
+  h = protocol;
+  for(i = 0; i < sizeof(uip_ip6addr_t); i++) {
+    h = h * 31 + ip6addr->u8[i];
+  }
+  for(i = 0; i < sizeof(uip_ip4addr_t); i++) {
+    h = h * 31 + ip4addr->u8[i];
+  }
+  h = h * 31 + ip6port;
+  h = h * 31 + ip4port;
+  return h % HASH_SIZE;
+}
+/*---------------------------------------------------------------------------*/
+static void
+chain_remove(struct ip64_addrmap_entry **head, struct ip64_addrmap_entry *m,
+             int offset)
+{
+  /* Walks a chain linked through the pointer at offset in each
+     mapping */
+  struct ip64_addrmap_entry **mp;
+
+  for(mp = head; *mp != NULL;
+      mp = (struct ip64_addrmap_entry **)((char *)*mp + offset)) {
+    if(*mp == m) {
+      *mp = *(struct ip64_addrmap_entry **)((char *)m + offset);
+      return;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static uint8_t
+wheel_slot(const struct ip64_addrmap_entry *m)
+{
+  clock_time_t ticks;
+
+  /* The lifetime of a mapping that is still alive does not end before
+     wheel_time, which is at most one slot behind the current time */
+  ticks = (m->timer.start + m->timer.interval - wheel_time) / WHEEL_TICK;
+  if(ticks >= WHEEL_SLOTS) {
+    /* Check again when the wheel has turned */
+    ticks = WHEEL_SLOTS - 1;
+  }
+  return (wheel_pos + ticks) % WHEEL_SLOTS;
+}
+/*---------------------------------------------------------------------------*/
+static void
+wheel_add(struct ip64_addrmap_entry *m)
+{
+  m->wheel_slot = wheel_slot(m);
+  m->wheel_next = wheel[m->wheel_slot];
+  wheel[m->wheel_slot] = m;
+}
+/*---------------------------------------------------------------------------*/
+static void
+add_entry(struct ip64_addrmap_entry *m)
+{
+  unsigned i;
+
+  list_add(entrylist, m);
+  i = hash_index(&m->ip6addr, m->ip6port, &m->ip4addr, m->ip4port,
+                 m->protocol);
+  m->hash_next = hash[i];
+  hash[i] = m;
+  i = m->mapped_port % HASH_SIZE;
+  m->port_hash_next = port_hash[i];
+  port_hash[i] = m;
+  wheel_add(m);
+}
+#endif /* IP64_ADDRMAP_HASH */
+/*---------------------------------------------------------------------------*/
+static void
+remove_entry(struct ip64_addrmap_entry *m)
+{
+  list_remove(entrylist, m);
+#if IP64_ADDRMAP_HASH
+  chain_remove(&hash[hash_index(&m->ip6addr, m->ip6port, &m->ip4addr,
+                                m->ip4port, m->protocol)],
+               m, offsetof(struct ip64_addrmap_entry, hash_next));
+  chain_remove(&port_hash[m->mapped_port % HASH_SIZE],
+               m, offsetof(struct ip64_addrmap_entry, port_hash_next));
+  chain_remove(&wheel[m->wheel_slot],
+               m, offsetof(struct ip64_addrmap_entry, wheel_next));
+#endif /* IP64_ADDRMAP_HASH */
+  memb_free(&entrymemb, m);
+}
+/*---------------------------------------------------------------------------*/
+#if IP64_ADDRMAP_HASH
+static void
+check_slot(uint8_t slot)
+{
+  struct ip64_addrmap_entry **mp, *m;
+
+  mp = &wheel[slot];
+  while((m = *mp) != NULL) {
+    if(timer_expired(&m->timer)) {
+      /* Unlinks m, so *mp is the next mapping */
+      remove_entry(m);
+    } else if(wheel_slot(m) != slot) {
+      *mp = m->wheel_next;
+      wheel_add(m);
+    } else {
+      mp = &m->wheel_next;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+check_age(void)
+{
+  clock_time_t now;
+
+  /* Check the slots that have passed, and the current one, where
+     lifetimes may just have ended */
+  now = clock_time();
+  if((clock_time_t)(now - wheel_time) >= WHEEL_SLOTS * WHEEL_TICK) {
+    /* Skip whole turns, which leave each mapping in its slot, but
+       still check every slot once */
+    wheel_time += (now - wheel_time) / (WHEEL_SLOTS * WHEEL_TICK) *
+      (WHEEL_SLOTS * WHEEL_TICK) - WHEEL_SLOTS * WHEEL_TICK;
+  }
+  while((clock_time_t)(now - wheel_time) >= WHEEL_TICK) {
+    check_slot(wheel_pos);
+    wheel_pos = (wheel_pos + 1) % WHEEL_SLOTS;
+    wheel_time += WHEEL_TICK;
+  }
+  check_slot(wheel_pos);
 }
+#else /* IP64_ADDRMAP_HASH */
 /*---------------------------------------------------------------------------*/
 static void
 check_age(void)
@@ -79,14 +246,14 @@ check_age(void)
   m = list_head(entrylist);
   while(m != NULL) {
     if(timer_expired(&m->timer)) {
-      list_remove(entrylist, m);
-      memb_free(&entrymemb, m);
+      remove_entry(m);
       m = list_head(entrylist);
     } else {
       m = list_item_next(m);
     }
   }
 }
+#endif /* IP64_ADDRMAP_HASH */
 /*---------------------------------------------------------------------------*/
 static int
 recycle(void)
@@ -116,8 +283,7 @@ recycle(void)
   /* If we found an oldest recyclable entry, remove it and return
      non-zero. */
   if(oldest != NULL) {
-    list_remove(entrylist, oldest);
-    memb_free(&entrymemb, oldest);
+    remove_entry(oldest);
     return 1;
   }
 
@@ -136,7 +302,13 @@ ip64_addrmap_lookup(const uip_ip6addr_t *ip6addr,
   printf("lookup ip4port %d ip6port %d\n", uip_htons(ip4port),
 	 uip_htons(ip6port));
   check_age();
+#if IP64_ADDRMAP_HASH
+  for(m = hash[hash_index(ip6addr, ip6port, ip4addr, ip4port, protocol)];
+      m != NULL;
+      m = m->hash_next) {
+#else /* IP64_ADDRMAP_HASH */
   for(m = list_head(entrylist); m != NULL; m = list_item_next(m)) {
+#endif /* IP64_ADDRMAP_HASH */
     printf("protocol %d %d, ip4port %d %d, ip6port %d %d, ip4 %d ip6 %d\n",
 	   m->protocol, protocol,
 	   m->ip4port, ip4port,
@@ -160,7 +332,12 @@ ip64_addrmap_lookup_port(uint16_t mapped_port, uint8_t protocol)
   struct ip64_addrmap_entry *m;
 
   check_age();
+#if IP64_ADDRMAP_HASH
+  for(m = port_hash[mapped_port % HASH_SIZE]; m != NULL;
+      m = m->port_hash_next) {
+#else /* IP64_ADDRMAP_HASH */
   for(m = list_head(entrylist); m != NULL; m = list_item_next(m)) {
+#endif /* IP64_ADDRMAP_HASH */
     printf("mapped port %d %d, protocol %d %d\n",
 	   m->mapped_port, mapped_port,
 	   m->protocol, protocol);
@@ -179,6 +356,23 @@ increase_mapped_port(void)
     FIRST_MAPPED_PORT;
 }
 /*---------------------------------------------------------------------------*/
+static int
+mapped_port_in_use(uint16_t port)
+{
+  struct ip64_addrmap_entry *n;
+
+#if IP64_ADDRMAP_HASH
+  for(n = port_hash[port % HASH_SIZE]; n != NULL; n = n->port_hash_next) {
+#else /* IP64_ADDRMAP_HASH */
+  for(n = list_head(entrylist); n != NULL; n = list_item_next(n)) {
+#endif /* IP64_ADDRMAP_HASH */
+    if(n->mapped_port == port) {
+      return 1;
+    }
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
 struct ip64_addrmap_entry *
 ip64_addrmap_create(const uip_ip6addr_t *ip6addr,
 		    uint16_t ip6port,
@@ -209,22 +403,17 @@ ip64_addrmap_create(const uip_ip6addr_t *ip6addr,
     /* Pick a new, unused local port. First make sure that the
        mapped_port number does not belong to any active connection. If
        so, we keep increasing the mapped_port until we're free. */
-    {
-      struct ip64_addrmap_entry *n;
-      n = list_head(entrylist);
-      while(n != NULL) {
-	if(n->mapped_port == mapped_port) {
-	  increase_mapped_port();
-	  n = list_head(entrylist);
-	} else {
-	  n = list_item_next(m);
-	}
-      }
+    while(mapped_port_in_use(mapped_port)) {
+      increase_mapped_port();
     }
     m->mapped_port = mapped_port;
     increase_mapped_port();
 
+#if IP64_ADDRMAP_HASH
+    add_entry(m);
+#else /* IP64_ADDRMAP_HASH */
     list_add(entrylist, m);
+#endif /* IP64_ADDRMAP_HASH */
     return m;
   }
   return NULL;
@@ -235,7 +424,21 @@ ip64_addrmap_set_lifetime(struct ip64_addrmap_entry *e,
                           clock_time_t time)
 {
   if(e != NULL) {
+#if IP64_ADDRMAP_HASH
+    clock_time_t left;
+
+    left = timer_expired(&e->timer) ? 0 : timer_remaining(&e->timer);
+    timer_set(&e->timer, time);
+    if(time < left) {
+      /* The lifetime now ends earlier than before, so the mapping may
+         be in a slot that is checked too late */
+      chain_remove(&wheel[e->wheel_slot],
+                   e, offsetof(struct ip64_addrmap_entry, wheel_next));
+      wheel_add(e);
+    }
+#else /* IP64_ADDRMAP_HASH */
     timer_set(&e->timer, time);
+#endif /* IP64_ADDRMAP_HASH */
   }
 }
 /*---------------------------------------------------------------------------*/
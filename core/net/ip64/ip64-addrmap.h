@@ -35,8 +35,27 @@
 #include "sys/timer.h"
 #include "net/ip/uip.h"
 
+/* With IP64_ADDRMAP_HASH, address mappings are also kept in two hash
+   tables, one keyed on the address and port pairs and protocol and one
+   keyed on the mapped port, so that translating a packet in either
+   direction does not walk the list of mappings. Expired mappings are
+   found through a timing wheel instead of checking every mapping on
+   each lookup. */
+#ifdef IP64_ADDRMAP_CONF_HASH
+#define IP64_ADDRMAP_HASH IP64_ADDRMAP_CONF_HASH
+#else /* IP64_ADDRMAP_CONF_HASH */
+#define IP64_ADDRMAP_HASH 0
+#endif /* IP64_ADDRMAP_CONF_HASH */
+
 struct ip64_addrmap_entry {
   struct ip64_addrmap_entry *next;
+#if IP64_ADDRMAP_HASH
+  struct ip64_addrmap_entry *hash_next;
+  struct ip64_addrmap_entry *port_hash_next;
+  /* The next mapping in the same timing wheel slot */
+  struct ip64_addrmap_entry *wheel_next;
+  uint8_t wheel_slot;
+#endif /* IP64_ADDRMAP_HASH */
   struct timer timer;
   uip_ip6addr_t ip6addr;
   uip_ip4addr_t ip4addr;
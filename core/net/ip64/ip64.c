@@ -62,6 +62,7 @@
 #include "ip64-ipv4-dhcp.h"
 #include "contiki-net.h"
 
+#include "net/ip/ip-chksum.h"
 #include "net/ip/uip-debug.h"
 
 #include <string.h> /* for memcpy() */
@@ -265,42 +266,11 @@ ip64_set_ipv6_address(const uip_ip6addr_t *addr)
 }
 /*---------------------------------------------------------------------------*/
 static uint16_t
-chksum(uint16_t sum, const uint8_t *data, uint16_t len)
-{
-  uint16_t t;
-  const uint8_t *dataptr;
-  const uint8_t *last_byte;
-
-  dataptr = data;
-  last_byte = data + len - 1;
-
-  while(dataptr < last_byte) {	/* At least two more bytes */
-    t = (dataptr[0] << 8) + dataptr[1];
-    sum += t;
-    if(sum < t) {
-      sum++;		/* carry */
-    }
-    dataptr += 2;
-  }
-
-  if(dataptr == last_byte) {
-    t = (dataptr[0] << 8) + 0;
-    sum += t;
-    if(sum < t) {
-      sum++;		/* carry */
-    }
-  }
-
-  /* Return sum in host byte order. */
-  return sum;
-}
-/*---------------------------------------------------------------------------*/
-static uint16_t
 ipv4_checksum(struct ipv4_hdr *hdr)
 {
   uint16_t sum;
 
-  sum = chksum(0, (uint8_t *)hdr, IPV4_HDRLEN);
+  sum = ip_chksum_add(0, (uint8_t *)hdr, IPV4_HDRLEN);
   return (sum == 0) ? 0xffff : uip_htons(sum);
 }
 /*---------------------------------------------------------------------------*/
@@ -319,14 +289,14 @@ ipv4_transport_checksum(const uint8_t *packet, uint16_t len, uint8_t proto)
     /* IP protocol and length fields. This addition cannot carry. */
     sum = transport_layer_len + proto;
     /* Sum IP source and destination addresses. */
-    sum = chksum(sum, (uint8_t *)&v4hdr->srcipaddr, 2 * sizeof(uip_ip4addr_t));
+    sum = ip_chksum_add(sum, (uint8_t *)&v4hdr->srcipaddr, 2 * sizeof(uip_ip4addr_t));
   } else {
     /* ping replies' checksums are calculated over the icmp-part only */
     sum = 0;
   }
 
   /* Sum transport layer header and data. */
-  sum = chksum(sum, &packet[IPV4_HDRLEN], transport_layer_len);
+  sum = ip_chksum_add(sum, &packet[IPV4_HDRLEN], transport_layer_len);
 
   return (sum == 0) ? 0xffff : uip_htons(sum);
 }
@@ -345,15 +315,36 @@ ipv6_transport_checksum(const uint8_t *packet, uint16_t len, uint8_t proto)
   /* IP protocol and length fields. This addition cannot carry. */
   sum = transport_layer_len + proto;
   /* Sum IP source and destination addresses. */
-  sum = chksum(sum, (uint8_t *)&v6hdr->srcipaddr, sizeof(uip_ip6addr_t));
-  sum = chksum(sum, (uint8_t *)&v6hdr->destipaddr, sizeof(uip_ip6addr_t));
+  sum = ip_chksum_add(sum, (uint8_t *)&v6hdr->srcipaddr, sizeof(uip_ip6addr_t));
+  sum = ip_chksum_add(sum, (uint8_t *)&v6hdr->destipaddr, sizeof(uip_ip6addr_t));
 
   /* Sum transport layer header and data. */
-  sum = chksum(sum, &packet[IPV6_HDRLEN], transport_layer_len);
+  sum = ip_chksum_add(sum, &packet[IPV6_HDRLEN], transport_layer_len);
 
   return (sum == 0) ? 0xffff : uip_htons(sum);
 }
 /*---------------------------------------------------------------------------*/
+/* Updates the TCP or UDP checksum of a translated packet, whose
+   pseudo header addresses and port numbers have been replaced. The
+   length and protocol fields of the pseudo header are the same for
+   IPv4 and IPv6, so the rest of the packet need not be summed
+   again. */
+static uint16_t
+translated_transport_checksum(uint16_t chksum,
+                              const void *oldaddrs, uint16_t oldaddrlen,
+                              const void *oldports,
+                              const void *newaddrs, uint16_t newaddrlen,
+                              const void *newports)
+{
+  uint16_t old_sum, new_sum;
+
+  old_sum = ip_chksum_add(0, oldaddrs, oldaddrlen);
+  old_sum = ip_chksum_add(old_sum, oldports, 2 * sizeof(uint16_t));
+  new_sum = ip_chksum_add(0, newaddrs, newaddrlen);
+  new_sum = ip_chksum_add(new_sum, newports, 2 * sizeof(uint16_t));
+  return ip_chksum_update(chksum, old_sum, new_sum);
+}
+/*---------------------------------------------------------------------------*/
 int
 ip64_6to4(const uint8_t *ipv6packet, const uint16_t ipv6packet_len,
 	  uint8_t *resultpacket)
@@ -420,27 +411,11 @@ ip64_6to4(const uint8_t *ipv6packet, const uint16_t ipv6packet_len,
   case IP_PROTO_TCP:
     PRINTF("ip64_6to4: TCP header\n");
     v4hdr->proto = IP_PROTO_TCP;
-
-    /* Compute and check the TCP checksum - since we're going to
-       recompute it ourselves, we must ensure that it was correct in
-       the first place. */
-    if(ipv6_transport_checksum(ipv6packet, ipv6len,
-                               IP_PROTO_TCP) != 0xffff) {
-      PRINTF("Bad TCP checksum, dropping packet\n");
-    }
-
     break;
 
   case IP_PROTO_UDP:
     PRINTF("ip64_6to4: UDP header\n");
     v4hdr->proto = IP_PROTO_UDP;
-    /* Compute and check the UDP checksum - since we're going to
-       recompute it ourselves, we must ensure that it was correct in
-       the first place. */
-    if(ipv6_transport_checksum(ipv6packet, ipv6len,
-                               IP_PROTO_UDP) != 0xffff) {
-      PRINTF("Bad UDP checksum, dropping packet\n");
-    }
     break;
 
   case IP_PROTO_ICMPV6:
@@ -594,17 +569,30 @@ ip64_6to4(const uint8_t *ipv6packet, const uint16_t ipv6packet_len,
 
   /* The checksum is in different places in the different protocol
      headers, so we need to be sure that we update the correct
-     field. */
+     field. TCP and UDP checksums are updated rather than recomputed,
+     so a segment that was corrupted on the IPv6 side still has a bad
+     checksum on the IPv4 side. */
   switch(v4hdr->proto) {
   case IP_PROTO_TCP:
-    tcphdr->tcpchksum = 0;
-    tcphdr->tcpchksum = ~(ipv4_transport_checksum(resultpacket, ipv4len,
-						  IP_PROTO_TCP));
+    tcphdr->tcpchksum =
+      translated_transport_checksum(tcphdr->tcpchksum,
+                                    &v6hdr->srcipaddr, 2 * sizeof(uip_ip6addr_t),
+                                    &ipv6packet[IPV6_HDRLEN],
+                                    &v4hdr->srcipaddr, 2 * sizeof(uip_ip4addr_t),
+                                    tcphdr);
     break;
   case IP_PROTO_UDP:
-    udphdr->udpchksum = 0;
-    udphdr->udpchksum = ~(ipv4_transport_checksum(resultpacket, ipv4len,
-						  IP_PROTO_UDP));
+    if(udphdr->udpchksum != 0) {
+      udphdr->udpchksum =
+        translated_transport_checksum(udphdr->udpchksum,
+                                      &v6hdr->srcipaddr, 2 * sizeof(uip_ip6addr_t),
+                                      &ipv6packet[IPV6_HDRLEN],
+                                      &v4hdr->srcipaddr, 2 * sizeof(uip_ip4addr_t),
+                                      udphdr);
+    } else {
+      udphdr->udpchksum = ~(ipv4_transport_checksum(resultpacket, ipv4len,
+                                                    IP_PROTO_UDP));
+    }
     if(udphdr->udpchksum == 0) {
       udphdr->udpchksum = 0xffff;
     }
@@ -817,16 +805,28 @@ ip64_4to6(const uint8_t *ipv4packet, const uint16_t ipv4packet_len,
      field. */
   switch(v6hdr->nxthdr) {
   case IP_PROTO_TCP:
-    tcphdr->tcpchksum = 0;
-    tcphdr->tcpchksum = ~(ipv6_transport_checksum(resultpacket,
-						  ipv6len,
-						  IP_PROTO_TCP));
+    tcphdr->tcpchksum =
+      translated_transport_checksum(tcphdr->tcpchksum,
+                                    &v4hdr->srcipaddr, 2 * sizeof(uip_ip4addr_t),
+                                    &ipv4packet[IPV4_HDRLEN],
+                                    &v6hdr->srcipaddr, 2 * sizeof(uip_ip6addr_t),
+                                    tcphdr);
     break;
   case IP_PROTO_UDP:
-    udphdr->udpchksum = 0;
-    udphdr->udpchksum = ~(ipv6_transport_checksum(resultpacket,
-						  ipv6len,
-						  IP_PROTO_UDP));
+    /* IPv4 hosts may leave out the UDP checksum, which IPv6 requires,
+       so it is computed from scratch. */
+    if(udphdr->udpchksum != 0) {
+      udphdr->udpchksum =
+        translated_transport_checksum(udphdr->udpchksum,
+                                      &v4hdr->srcipaddr, 2 * sizeof(uip_ip4addr_t),
+                                      &ipv4packet[IPV4_HDRLEN],
+                                      &v6hdr->srcipaddr, 2 * sizeof(uip_ip6addr_t),
+                                      udphdr);
+    } else {
+      udphdr->udpchksum = ~(ipv6_transport_checksum(resultpacket,
+                                                    ipv6len,
+                                                    IP_PROTO_UDP));
+    }
     if(udphdr->udpchksum == 0) {
       udphdr->udpchksum = 0xffff;
     }
@@ -58,6 +58,7 @@
 
 #include "net/ip/uip.h"
 #include "net/ip/uip_arch.h"
+#include "net/ip/ip-chksum.h"
 #include "net/ipv4/uip-fw.h"
 #ifdef AODV_COMPLIANCE
 #include "net/ipv4/uaodv-def.h"
@@ -461,15 +462,13 @@ uip_fw_forward(void)
     time_exceeded();
   }
   
-  /* Decrement the TTL (time-to-live) value in the IP header */
+  /* Decrement the TTL (time-to-live) value in the IP header and
+     update the IP checksum, which covers the TTL and protocol fields
+     as one 16-bit word. */
+  BUF->ipchksum = ip_chksum_update(BUF->ipchksum,
+                                   (BUF->ttl << 8) | BUF->proto,
+                                   ((BUF->ttl - 1) << 8) | BUF->proto);
   BUF->ttl = BUF->ttl - 1;
-  
-  /* Update the IP checksum. */
-  if(BUF->ipchksum >= UIP_HTONS(0xffff - 0x0100)) {
-    BUF->ipchksum = BUF->ipchksum + UIP_HTONS(0x0100) + 1;
-  } else {
-    BUF->ipchksum = BUF->ipchksum + UIP_HTONS(0x0100);
-  }
 
   if(uip_len > 0) {
     uip_appdata = &uip_buf[UIP_LLH_LEN + UIP_TCPIP_HLEN];
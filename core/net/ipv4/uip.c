@@ -72,6 +72,7 @@
 
 #include "net/ip/uip.h"
 #include "net/ip/uipopt.h"
+#include "net/ip/ip-chksum.h"
 #include "net/ipv4/uip_arp.h"
 #include "net/ip/uip_arch.h"
 
@@ -267,41 +268,10 @@ uip_add32(uint8_t *op32, uint16_t op16)
 
 #if ! UIP_ARCH_CHKSUM
 /*---------------------------------------------------------------------------*/
-static uint16_t
-chksum(uint16_t sum, const uint8_t *data, uint16_t len)
-{
-  uint16_t t;
-  const uint8_t *dataptr;
-  const uint8_t *last_byte;
-
-  dataptr = data;
-  last_byte = data + len - 1;
-
-  while(dataptr < last_byte) {	/* At least two more bytes */
-    t = (dataptr[0] << 8) + dataptr[1];
-    sum += t;
-    if(sum < t) {
-      sum++;		/* carry */
-    }
-    dataptr += 2;
-  }
-
-  if(dataptr == last_byte) {
-    t = (dataptr[0] << 8) + 0;
-    sum += t;
-    if(sum < t) {
-      sum++;		/* carry */
-    }
-  }
-
-  /* Return sum in host byte order. */
-  return sum;
-}
-/*---------------------------------------------------------------------------*/
 uint16_t
 uip_chksum(uint16_t *data, uint16_t len)
 {
-  return uip_htons(chksum(0, (uint8_t *)data, len));
+  return uip_htons(ip_chksum_add(0, data, len));
 }
 /*---------------------------------------------------------------------------*/
 #ifndef UIP_ARCH_IPCHKSUM
@@ -310,7 +280,7 @@ uip_ipchksum(void)
 {
   uint16_t sum;
 
-  sum = chksum(0, &uip_buf[UIP_LLH_LEN], UIP_IPH_LEN);
+  sum = ip_chksum_add(0, &uip_buf[UIP_LLH_LEN], UIP_IPH_LEN);
   DEBUG_PRINTF("uip_ipchksum: sum 0x%04x\n", sum);
   return (sum == 0) ? 0xffff : uip_htons(sum);
 }
@@ -333,11 +303,11 @@ upper_layer_chksum(uint8_t proto)
   /* IP protocol and length fields. This addition cannot carry. */
   sum = upper_layer_len + proto;
   /* Sum IP source and destination addresses. */
-  sum = chksum(sum, (uint8_t *)&BUF->srcipaddr, 2 * sizeof(uip_ipaddr_t));
+  sum = ip_chksum_add(sum, (uint8_t *)&BUF->srcipaddr, 2 * sizeof(uip_ipaddr_t));
 
   /* Sum TCP header and data. */
-  sum = chksum(sum, &uip_buf[UIP_IPH_LEN + UIP_LLH_LEN],
-	       upper_layer_len);
+  sum = ip_chksum_add(sum, &uip_buf[UIP_IPH_LEN + UIP_LLH_LEN],
+                      upper_layer_len);
 
   return (sum == 0) ? 0xffff : uip_htons(sum);
 }
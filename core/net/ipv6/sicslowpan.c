@@ -69,6 +69,10 @@
 #include "net/ipv6/sicslowpan.h"
 #include "net/netstack.h"
 
+#if UIP_CONF_IPV6_RPL
+#include "net/rpl/rpl.h"
+#endif /* UIP_CONF_IPV6_RPL */
+
 #include <stdio.h>
 
 #define DEBUG DEBUG_NONE
@@ -152,6 +156,8 @@ void uip_log(char *msg);
 #define UIP_UDP_BUF          ((struct uip_udp_hdr *)&uip_buf[UIP_LLIPH_LEN])
 #define UIP_TCP_BUF          ((struct uip_tcp_hdr *)&uip_buf[UIP_LLIPH_LEN])
 #define UIP_ICMP_BUF          ((struct uip_icmp_hdr *)&uip_buf[UIP_LLIPH_LEN])
+#define UIP_HBHO_BUF          ((struct uip_hbho_hdr *)&uip_buf[UIP_LLIPH_LEN])
+#define UIP_EXT_HDR_OPT_RPL_BUF ((struct uip_ext_hdr_opt_rpl *)&uip_buf[UIP_LLIPH_LEN + 2])
 /** @} */
 
 
@@ -221,35 +227,76 @@ static int last_tx_status;
  *  @{
  */
 
-static uint16_t sicslowpan_len;
+/** Datagram tag to be put in the fragments I send. */
+static uint16_t my_tag;
 
 /**
- * The buffer used for the 6lowpan reassembly.
- * This buffer contains only the IPv6 packet (no MAC header, 6lowpan, etc).
- * It has a fix size as we do not use dynamic memory allocation.
+ * A reassembly context. Up to SICSLOWPAN_REASS_CONTEXTS datagrams can
+ * be reassembled at the same time, each identified by the sender, the
+ * datagram tag and the datagram size, and each with its own timer.
  */
-static uip_buf_t sicslowpan_aligned_buf;
-#define sicslowpan_buf (sicslowpan_aligned_buf.u8)
+struct sicslowpan_reass {
+  /**
+   * The buffer used for the 6lowpan reassembly.
+   * This buffer contains only the IPv6 packet (no MAC header, 6lowpan, etc).
+   * It has a fix size as we do not use dynamic memory allocation.
+   */
+  uip_buf_t buf;
+  /** The total length of the IPv6 packet. Zero if the context is free. */
+  uint16_t len;
+  /**
+   * length of the ip packet already received.
+   * It includes IP and transport headers.
+   */
+  uint16_t processed;
+  /** The tag in the fragments being merged. */
+  uint16_t tag;
+  /** The source address of the fragments being merged */
+  linkaddr_t sender;
+  /** Reassembly %process %timer. */
+  struct timer timer;
+};
 
-/** The total length of the IPv6 packet in the sicslowpan_buf. */
+static struct sicslowpan_reass reass_contexts[SICSLOWPAN_REASS_CONTEXTS];
+
+/** The reassembly context of the fragment being processed. */
+static struct sicslowpan_reass *reass;
 
 /**
- * length of the ip packet already sent / received.
- * It includes IP and transport headers.
+ * The buffer that the incoming packet is uncompressed into: the buffer
+ * of its reassembly context, or uip_buf if it is not fragmented.
  */
-static uint16_t processed_ip_in_len;
-
-/** Datagram tag to be put in the fragments I send. */
-static uint16_t my_tag;
+static uip_buf_t *sicslowpan_bufp;
+#define sicslowpan_buf (sicslowpan_bufp->u8)
 
-/** When reassembling, the tag in the fragments being merged. */
-static uint16_t reass_tag;
+struct sicslowpan_reass_stats sicslowpan_reass_stats;
 
-/** When reassembling, the source address of the fragments being merged */
-linkaddr_t frag_sender;
+#if SICSLOWPAN_FRAG_FORWARDING && UIP_CONF_ROUTER
+#define FRAG_FORWARDING 1
+/**
+ * A fragment forwarding entry. It maps the fragments of a datagram
+ * from the previous hop to the next hop and to the tag we relay them
+ * with, so that they need not be reassembled here.
+ */
+struct sicslowpan_fwd {
+  /** The link layer address of the previous hop */
+  linkaddr_t sender;
+  /** The link layer address of the next hop */
+  linkaddr_t next;
+  /** The total length of the IPv6 packet. Zero if the entry is free. */
+  uint16_t len;
+  /** The tag in the fragments we receive. */
+  uint16_t tag;
+  /** The tag in the fragments we send. */
+  uint16_t next_tag;
+  /** Lifetime of the entry, from its first fragment. */
+  struct timer timer;
+};
 
-/** Reassembly %process %timer. */
-static struct timer reass_timer;
+static struct sicslowpan_fwd fwd_entries[SICSLOWPAN_FRAG_FORWARD_ENTRIES];
+#else /* SICSLOWPAN_FRAG_FORWARDING && UIP_CONF_ROUTER */
+#define FRAG_FORWARDING 0
+#endif /* SICSLOWPAN_FRAG_FORWARDING && UIP_CONF_ROUTER */
 
 /** @} */
 #else /* SICSLOWPAN_CONF_FRAG */
@@ -1350,6 +1397,55 @@ send_packet(linkaddr_t *dest)
   watchdog_periodic();
 }
 /*--------------------------------------------------------------------*/
+/**
+ * \brief Compress the headers of the IP packet in uip_buf into packetbuf
+ * \param dest the link layer destination address of the packet
+ */
+static void
+compress_hdr(linkaddr_t *dest)
+{
+  if(uip_len >= COMPRESSION_THRESHOLD) {
+    /* Try to compress the headers */
+#if SICSLOWPAN_COMPRESSION == SICSLOWPAN_COMPRESSION_HC1
+    compress_hdr_hc1(dest);
+#endif /* SICSLOWPAN_COMPRESSION == SICSLOWPAN_COMPRESSION_HC1 */
+#if SICSLOWPAN_COMPRESSION == SICSLOWPAN_COMPRESSION_IPV6
+    compress_hdr_ipv6(dest);
+#endif /* SICSLOWPAN_COMPRESSION == SICSLOWPAN_COMPRESSION_IPV6 */
+#if SICSLOWPAN_COMPRESSION == SICSLOWPAN_COMPRESSION_HC06
+    compress_hdr_hc06(dest);
+#endif /* SICSLOWPAN_COMPRESSION == SICSLOWPAN_COMPRESSION_HC06 */
+  } else {
+    compress_hdr_ipv6(dest);
+  }
+}
+/*--------------------------------------------------------------------*/
+/**
+ * \brief The room left for 6lowpan headers and payload in a frame
+ * \param dest the link layer destination address of the frame
+ */
+static int
+get_max_payload(linkaddr_t *dest)
+{
+  int framer_hdrlen;
+
+  /* Calculate NETSTACK_FRAMER's header length, that will be added in the NETSTACK_RDC.
+   * We calculate it here only to make a better decision of whether the outgoing packet
+   * needs to be fragmented or not. */
+#define USE_FRAMER_HDRLEN 1
+#if USE_FRAMER_HDRLEN
+  packetbuf_set_addr(PACKETBUF_ADDR_RECEIVER, dest);
+  framer_hdrlen = NETSTACK_FRAMER.length();
+  if(framer_hdrlen < 0) {
+    /* Framing failed, we assume the maximum header length */
+    framer_hdrlen = 21;
+  }
+#else /* USE_FRAMER_HDRLEN */
+  framer_hdrlen = 21;
+#endif /* USE_FRAMER_HDRLEN */
+  return MAC_MAX_PAYLOAD - framer_hdrlen - NETSTACK_LLSEC.get_overhead();
+}
+/*--------------------------------------------------------------------*/
 /** \brief Take an IP packet and format it to be sent on an 802.15.4
  *  network using 6lowpan.
  *  \param localdest The MAC address of the destination
@@ -1362,7 +1458,6 @@ send_packet(linkaddr_t *dest)
 static uint8_t
 output(const uip_lladdr_t *localdest)
 {
-  int framer_hdrlen;
   int max_payload;
 
   /* The MAC address of the destination of the packet */
@@ -1416,37 +1511,10 @@ output(const uip_lladdr_t *localdest)
   
   PRINTFO("sicslowpan output: sending packet len %d\n", uip_len);
 
-  if(uip_len >= COMPRESSION_THRESHOLD) {
-    /* Try to compress the headers */
-#if SICSLOWPAN_COMPRESSION == SICSLOWPAN_COMPRESSION_HC1
-    compress_hdr_hc1(&dest);
-#endif /* SICSLOWPAN_COMPRESSION == SICSLOWPAN_COMPRESSION_HC1 */
-#if SICSLOWPAN_COMPRESSION == SICSLOWPAN_COMPRESSION_IPV6
-    compress_hdr_ipv6(&dest);
-#endif /* SICSLOWPAN_COMPRESSION == SICSLOWPAN_COMPRESSION_IPV6 */
-#if SICSLOWPAN_COMPRESSION == SICSLOWPAN_COMPRESSION_HC06
-    compress_hdr_hc06(&dest);
-#endif /* SICSLOWPAN_COMPRESSION == SICSLOWPAN_COMPRESSION_HC06 */
-  } else {
-    compress_hdr_ipv6(&dest);
-  }
+  compress_hdr(&dest);
   PRINTFO("sicslowpan output: header of len %d\n", packetbuf_hdr_len);
 
-  /* Calculate NETSTACK_FRAMER's header length, that will be added in the NETSTACK_RDC.
-   * We calculate it here only to make a better decision of whether the outgoing packet
-   * needs to be fragmented or not. */
-#define USE_FRAMER_HDRLEN 1
-#if USE_FRAMER_HDRLEN
-  packetbuf_set_addr(PACKETBUF_ADDR_RECEIVER, &dest);
-  framer_hdrlen = NETSTACK_FRAMER.length();
-  if(framer_hdrlen < 0) {
-    /* Framing failed, we assume the maximum header length */
-    framer_hdrlen = 21;
-  }
-#else /* USE_FRAMER_HDRLEN */
-  framer_hdrlen = 21;
-#endif /* USE_FRAMER_HDRLEN */
-  max_payload = MAC_MAX_PAYLOAD - framer_hdrlen - NETSTACK_LLSEC.get_overhead();
+  max_payload = get_max_payload(&dest);
 
   if((int)uip_len - (int)uncomp_hdr_len > max_payload - (int)packetbuf_hdr_len) {
 #if SICSLOWPAN_CONF_FRAG
@@ -1576,6 +1644,290 @@ output(const uip_lladdr_t *localdest)
   return 1;
 }
 
+#if SICSLOWPAN_CONF_FRAG
+/*--------------------------------------------------------------------*/
+/** \brief Free the reassembly contexts that have timed out */
+static void
+reass_expire(void)
+{
+  int i;
+
+  for(i = 0; i < SICSLOWPAN_REASS_CONTEXTS; i++) {
+    if(reass_contexts[i].len != 0 && timer_expired(&reass_contexts[i].timer)) {
+      PRINTFI("sicslowpan input: reassembly of tag %d timed out\n",
+              reass_contexts[i].tag);
+      reass_contexts[i].len = 0;
+      sicslowpan_reass_stats.timeouts++;
+    }
+  }
+}
+/*--------------------------------------------------------------------*/
+/** \brief Find the reassembly context of a fragment */
+static struct sicslowpan_reass *
+reass_lookup(const linkaddr_t *sender, uint16_t tag, uint16_t size)
+{
+  int i;
+
+  for(i = 0; i < SICSLOWPAN_REASS_CONTEXTS; i++) {
+    /* A length of 0 marks a free context */
+    if(reass_contexts[i].len != 0 &&
+       reass_contexts[i].len == size &&
+       reass_contexts[i].tag == tag &&
+       linkaddr_cmp(&reass_contexts[i].sender, sender)) {
+      return &reass_contexts[i];
+    }
+  }
+  return NULL;
+}
+/*--------------------------------------------------------------------*/
+/**
+ * \brief Allocate a reassembly context for a new datagram
+ *
+ * If all contexts are in use, the oldest datagram is discarded: we
+ * prioritize new packets as this lessens the negative impacts of too
+ * high SICSLOWPAN_REASS_MAXAGE.
+ */
+static struct sicslowpan_reass *
+reass_allocate(void)
+{
+  struct sicslowpan_reass *oldest;
+  int i;
+
+  oldest = NULL;
+  for(i = 0; i < SICSLOWPAN_REASS_CONTEXTS; i++) {
+    if(reass_contexts[i].len == 0) {
+      return &reass_contexts[i];
+    }
+    if(oldest == NULL ||
+       clock_time() - reass_contexts[i].timer.start >
+       clock_time() - oldest->timer.start) {
+      oldest = &reass_contexts[i];
+    }
+  }
+  PRINTFI("sicslowpan input: discarding datagram with tag %d\n", oldest->tag);
+  sicslowpan_reass_stats.evicted++;
+  return oldest;
+}
+/*--------------------------------------------------------------------*/
+/** \brief Drop the fragment being processed */
+static void
+reass_drop(void)
+{
+  sicslowpan_reass_stats.dropped++;
+  /* A context that holds nothing but the dropped fragment is freed. */
+  if(reass != NULL && reass->processed == 0) {
+    reass->len = 0;
+  }
+}
+#if FRAG_FORWARDING
+/*--------------------------------------------------------------------*/
+/** \brief Find the forwarding entry of a fragment */
+static struct sicslowpan_fwd *
+fwd_lookup(const linkaddr_t *sender, uint16_t tag, uint16_t size)
+{
+  int i;
+
+  for(i = 0; i < SICSLOWPAN_FRAG_FORWARD_ENTRIES; i++) {
+    if(fwd_entries[i].len != 0 && timer_expired(&fwd_entries[i].timer)) {
+      fwd_entries[i].len = 0;
+    }
+    if(fwd_entries[i].len == size &&
+       fwd_entries[i].tag == tag &&
+       linkaddr_cmp(&fwd_entries[i].sender, sender)) {
+      return &fwd_entries[i];
+    }
+  }
+  return NULL;
+}
+/*--------------------------------------------------------------------*/
+/** \brief Allocate a forwarding entry, reusing the oldest if needed */
+static struct sicslowpan_fwd *
+fwd_allocate(void)
+{
+  struct sicslowpan_fwd *oldest;
+  int i;
+
+  oldest = NULL;
+  for(i = 0; i < SICSLOWPAN_FRAG_FORWARD_ENTRIES; i++) {
+    if(fwd_entries[i].len == 0) {
+      return &fwd_entries[i];
+    }
+    if(oldest == NULL ||
+       clock_time() - fwd_entries[i].timer.start >
+       clock_time() - oldest->timer.start) {
+      oldest = &fwd_entries[i];
+    }
+  }
+  return oldest;
+}
+/*--------------------------------------------------------------------*/
+/**
+ * \brief Find the link layer next hop of the packet in uip_buf
+ *
+ * This follows the next hop determination of tcpip_ipv6_output(), but
+ * does not start neighbor discovery: if the next hop is not a known
+ * neighbor, the datagram is left to the IP layer.
+ */
+static const uip_lladdr_t *
+fwd_nexthop(void)
+{
+  uip_ds6_route_t *route;
+  uip_ds6_nbr_t *nbr;
+  uip_ipaddr_t *nexthop;
+
+  if(uip_ds6_is_addr_onlink(&UIP_IP_BUF->destipaddr)) {
+    nexthop = &UIP_IP_BUF->destipaddr;
+  } else {
+    route = uip_ds6_route_lookup(&UIP_IP_BUF->destipaddr);
+    if(route != NULL) {
+      nexthop = uip_ds6_route_nexthop(route);
+    } else {
+      nexthop = uip_ds6_defrt_choose();
+    }
+  }
+  if(nexthop == NULL) {
+    return NULL;
+  }
+  nbr = uip_ds6_nbr_lookup(nexthop);
+  if(nbr == NULL || nbr->state == NBR_INCOMPLETE) {
+    return NULL;
+  }
+  return uip_ds6_nbr_get_ll(nbr);
+}
+/*--------------------------------------------------------------------*/
+/**
+ * \brief Forward a datagram from its first fragment, if possible
+ *
+ * The first fragment has been uncompressed in its reassembly context.
+ * If the datagram is to be routed further, its headers are processed
+ * as uip6.c does for forwarded packets, recompressed for the next hop
+ * and sent with a new tag. A forwarding entry then relays the other
+ * fragments and the reassembly context is released. Otherwise, the
+ * datagram is reassembled as usual.
+ */
+static void
+fwd_first_fragment(void)
+{
+  struct sicslowpan_fwd *fwd;
+  const uip_lladdr_t *next;
+  linkaddr_t dest;
+  uint16_t payload_len;
+
+  if(uip_is_addr_mcast(&SICSLOWPAN_IP_BUF->destipaddr) ||
+     uip_is_addr_link_local(&SICSLOWPAN_IP_BUF->destipaddr) ||
+     uip_is_addr_loopback(&SICSLOWPAN_IP_BUF->destipaddr) ||
+     uip_is_addr_link_local(&SICSLOWPAN_IP_BUF->srcipaddr) ||
+     uip_is_addr_unspecified(&SICSLOWPAN_IP_BUF->srcipaddr) ||
+     uip_ds6_is_my_addr(&SICSLOWPAN_IP_BUF->destipaddr)) {
+    return;
+  }
+  /* Let the IP layer send the Time Exceeded error */
+  if(SICSLOWPAN_IP_BUF->ttl <= 1) {
+    return;
+  }
+
+  /* Process the headers received so far in uip_buf */
+  memcpy((uint8_t *)UIP_IP_BUF, (uint8_t *)SICSLOWPAN_IP_BUF, reass->processed);
+  uip_len = reass->len;
+  uip_ext_len = 0;
+
+  next = fwd_nexthop();
+  if(next == NULL) {
+    uip_len = 0;
+    return;
+  }
+
+#if UIP_CONF_IPV6_RPL
+  /*
+   * Inserting the RPL option would move the data of the following
+   * fragments, so such datagrams are reassembled.
+   */
+  if(UIP_IP_BUF->proto != UIP_PROTO_HBHO ||
+     reass->processed < UIP_IPH_LEN + 8 * (UIP_HBHO_BUF->len + 1) ||
+     UIP_EXT_HDR_OPT_RPL_BUF->opt_type != UIP_EXT_HDR_OPT_RPL) {
+    uip_len = 0;
+    return;
+  }
+  if(rpl_verify_header(2) || rpl_update_header_empty()) {
+    PRINTFI("sicslowpan input: RPL dropped datagram with tag %d\n", reass->tag);
+    uip_len = 0;
+    reass->len = 0;
+    sicslowpan_reass_stats.dropped++;
+    return;
+  }
+#endif /* UIP_CONF_IPV6_RPL */
+  UIP_IP_BUF->ttl = UIP_IP_BUF->ttl - 1;
+
+  linkaddr_copy(&dest, (const linkaddr_t *)next);
+  uncomp_hdr_len = 0;
+  packetbuf_hdr_len = 0;
+  packetbuf_clear();
+  packetbuf_ptr = packetbuf_dataptr();
+  packetbuf_set_attr(PACKETBUF_ATTR_MAX_MAC_TRANSMISSIONS,
+                     SICSLOWPAN_MAX_MAC_TRANSMISSIONS);
+  compress_hdr(&dest);
+
+  /*
+   * The new first fragment carries the same part of the datagram, so
+   * that the offsets of the following fragments remain valid.
+   */
+  payload_len = reass->processed - uncomp_hdr_len;
+  if(reass->processed < uncomp_hdr_len ||
+     SICSLOWPAN_FRAG1_HDR_LEN + packetbuf_hdr_len + payload_len >
+     get_max_payload(&dest)) {
+    PRINTFI("sicslowpan input: first fragment too large to forward\n");
+    uip_len = 0;
+    return;
+  }
+
+  memmove(packetbuf_ptr + SICSLOWPAN_FRAG1_HDR_LEN, packetbuf_ptr, packetbuf_hdr_len);
+  SET16(PACKETBUF_FRAG_PTR, PACKETBUF_FRAG_DISPATCH_SIZE,
+        ((SICSLOWPAN_DISPATCH_FRAG1 << 8) | uip_len));
+  SET16(PACKETBUF_FRAG_PTR, PACKETBUF_FRAG_TAG, my_tag);
+  packetbuf_hdr_len += SICSLOWPAN_FRAG1_HDR_LEN;
+  memcpy(packetbuf_ptr + packetbuf_hdr_len,
+         (uint8_t *)UIP_IP_BUF + uncomp_hdr_len, payload_len);
+  packetbuf_set_datalen(packetbuf_hdr_len + payload_len);
+
+  fwd = fwd_allocate();
+  fwd->len = reass->len;
+  fwd->tag = reass->tag;
+  fwd->next_tag = my_tag;
+  my_tag++;
+  linkaddr_copy(&fwd->sender, &reass->sender);
+  linkaddr_copy(&fwd->next, &dest);
+  timer_set(&fwd->timer, SICSLOWPAN_REASS_MAXAGE * CLOCK_SECOND);
+  PRINTFI("sicslowpan input: forwarding datagram with tag %d as tag %d\n",
+          fwd->tag, fwd->next_tag);
+
+  reass->len = 0;
+  uip_len = 0;
+  sicslowpan_reass_stats.forwarded++;
+  send_packet(&dest);
+}
+/*--------------------------------------------------------------------*/
+/**
+ * \brief Relay the FRAGN fragment in packetbuf to the next hop
+ * \param fwd the forwarding entry of the datagram
+ * \param last non-zero if this is the last fragment of the datagram
+ */
+static void
+fwd_fragment(struct sicslowpan_fwd *fwd, uint8_t last)
+{
+  SET16(PACKETBUF_FRAG_PTR, PACKETBUF_FRAG_TAG, fwd->next_tag);
+  if(last) {
+    fwd->len = 0;
+  }
+
+  /* Reuse the received frame, without its attributes and MAC header */
+  packetbuf_compact();
+  packetbuf_attr_clear();
+  packetbuf_set_attr(PACKETBUF_ATTR_MAX_MAC_TRANSMISSIONS,
+                     SICSLOWPAN_MAX_MAC_TRANSMISSIONS);
+  send_packet(&fwd->next);
+}
+#endif /* FRAG_FORWARDING */
+#endif /* SICSLOWPAN_CONF_FRAG */
 /*--------------------------------------------------------------------*/
 /** \brief Process a received 6lowpan packet.
  *  \param r The MAC layer
@@ -1601,6 +1953,9 @@ input(void)
   /* tag of the fragment */
   uint16_t frag_tag = 0;
   uint8_t first_fragment = 0, last_fragment = 0;
+#if FRAG_FORWARDING
+  struct sicslowpan_fwd *fwd;
+#endif /* FRAG_FORWARDING */
 #endif /*SICSLOWPAN_CONF_FRAG*/
 
   /* init */
@@ -1614,11 +1969,9 @@ input(void)
      want to query us for it later. */
   last_rssi = (signed short)packetbuf_attr(PACKETBUF_ATTR_RSSI);
 #if SICSLOWPAN_CONF_FRAG
-  /* if reassembly timed out, cancel it */
-  if(timer_expired(&reass_timer)) {
-    sicslowpan_len = 0;
-    processed_ip_in_len = 0;
-  }
+  /* free the reassembly contexts that timed out */
+  reass_expire();
+  reass = NULL;
   /*
    * Since we don't support the mesh and broadcast header, the first header
    * we look for is the fragmentation header
@@ -1634,7 +1987,6 @@ input(void)
       PRINTFI("size %d, tag %d, offset %d)\n",
              frag_size, frag_tag, frag_offset);
       packetbuf_hdr_len += SICSLOWPAN_FRAG1_HDR_LEN;
-      /*      printf("frag1 %d %d\n", reass_tag, frag_tag);*/
       first_fragment = 1;
       is_fragment = 1;
       break;
@@ -1650,77 +2002,69 @@ input(void)
       PRINTFI("size %d, tag %d, offset %d)\n",
              frag_size, frag_tag, frag_offset);
       packetbuf_hdr_len += SICSLOWPAN_FRAGN_HDR_LEN;
-
-      /* If this is the last fragment, we may shave off any extrenous
-         bytes at the end. We must be liberal in what we accept. */
-      PRINTFI("last_fragment?: processed_ip_in_len %d packetbuf_payload_len %d frag_size %d\n",
-              processed_ip_in_len, packetbuf_datalen() - packetbuf_hdr_len, frag_size);
-
-      if(processed_ip_in_len + packetbuf_datalen() - packetbuf_hdr_len >= frag_size) {
-        last_fragment = 1;
-      }
       is_fragment = 1;
       break;
     default:
       break;
   }
 
-  /* We are currently reassembling a packet, but have just received the first
-   * fragment of another packet. We can either ignore it and hope to receive
-   * the rest of the under-reassembly packet fragments, or we can discard the
-   * previous packet altogether, and start reassembling the new packet.
-   *
-   * We discard the previous packet, and start reassembling the new packet.
-   * This lessens the negative impacts of too high SICSLOWPAN_REASS_MAXAGE.
-   */
-#define PRIORITIZE_NEW_PACKETS 1
-#if PRIORITIZE_NEW_PACKETS
-
-  if(!is_fragment) {
-    /* Prioritize non-fragment packets too. */
-    sicslowpan_len = 0;
-    processed_ip_in_len = 0;
-  } else if(processed_ip_in_len > 0 && first_fragment
-      && !linkaddr_cmp(&frag_sender, packetbuf_addr(PACKETBUF_ADDR_SENDER))) {
-    sicslowpan_len = 0;
-    processed_ip_in_len = 0;
-  }
-#endif /* PRIORITIZE_NEW_PACKETS */
-
-  if(processed_ip_in_len > 0) {
-    /* reassembly is ongoing */
-    /*    printf("frag %d %d\n", reass_tag, frag_tag);*/
-    if((frag_size > 0 &&
-        (frag_size != sicslowpan_len ||
-         reass_tag  != frag_tag ||
-         !linkaddr_cmp(&frag_sender, packetbuf_addr(PACKETBUF_ADDR_SENDER))))  ||
-       frag_size == 0) {
-      /*
-       * the packet is a fragment that does not belong to the packet
-       * being reassembled or the packet is not a fragment.
-       */
-      PRINTFI("sicslowpan input: Dropping 6lowpan packet that is not a fragment of the packet currently being reassembled\n");
+  if(is_fragment) {
+    if(frag_size == 0) {
+      PRINTFI("sicslowpan input: Dropping 6lowpan fragment of an empty datagram\n");
+      sicslowpan_reass_stats.dropped++;
       return;
     }
-  } else {
-    /*
-     * reassembly is off
-     * start it if we received a fragment
-     */
-    if((frag_size > 0) && (frag_size <= UIP_BUFSIZE)) {
-      /* We are currently not reassembling a packet, but have received a packet fragment
-       * that is not the first one. */
-      if(is_fragment && !first_fragment) {
+#if FRAG_FORWARDING
+    fwd = fwd_lookup(packetbuf_addr(PACKETBUF_ADDR_SENDER),
+                     frag_tag, frag_size);
+    if(fwd != NULL) {
+      if(first_fragment) {
+        PRINTFI("sicslowpan input: Dropping duplicate first fragment\n");
+        sicslowpan_reass_stats.dropped++;
+      } else {
+        fwd_fragment(fwd, (frag_offset << 3) + packetbuf_datalen() -
+                     packetbuf_hdr_len >= frag_size);
+      }
+      return;
+    }
+#endif /* FRAG_FORWARDING */
+    reass = reass_lookup(packetbuf_addr(PACKETBUF_ADDR_SENDER),
+                         frag_tag, frag_size);
+    if(reass == NULL) {
+      /*
+       * We are not reassembling this datagram: start it if this is
+       * its first fragment.
+       */
+      if(!first_fragment || frag_size > UIP_BUFSIZE) {
+        PRINTFI("sicslowpan input: Dropping 6lowpan fragment that is not part of a datagram being reassembled\n");
+        sicslowpan_reass_stats.dropped++;
         return;
       }
-
-      sicslowpan_len = frag_size;
-      reass_tag = frag_tag;
-      timer_set(&reass_timer, SICSLOWPAN_REASS_MAXAGE * CLOCK_SECOND);
+      reass = reass_allocate();
+      reass->len = frag_size;
+      reass->processed = 0;
+      reass->tag = frag_tag;
+      linkaddr_copy(&reass->sender, packetbuf_addr(PACKETBUF_ADDR_SENDER));
+      timer_set(&reass->timer, SICSLOWPAN_REASS_MAXAGE * CLOCK_SECOND);
       PRINTFI("sicslowpan input: INIT FRAGMENTATION (len %d, tag %d)\n",
-             sicslowpan_len, reass_tag);
-      linkaddr_copy(&frag_sender, packetbuf_addr(PACKETBUF_ADDR_SENDER));
+             reass->len, reass->tag);
+    } else if(first_fragment) {
+      PRINTFI("sicslowpan input: Dropping duplicate first fragment\n");
+      sicslowpan_reass_stats.dropped++;
+      return;
+    } else {
+      /* If this is the last fragment, we may shave off any extrenous
+         bytes at the end. We must be liberal in what we accept. */
+      PRINTFI("last_fragment?: processed %d packetbuf_payload_len %d frag_size %d\n",
+              reass->processed, packetbuf_datalen() - packetbuf_hdr_len, frag_size);
+      if(reass->processed + packetbuf_datalen() - packetbuf_hdr_len >= frag_size) {
+        last_fragment = 1;
+      }
     }
+    sicslowpan_bufp = &reass->buf;
+  } else {
+    /* Not fragmented: uncompress directly into uip_buf. */
+    sicslowpan_bufp = &uip_aligned_buf;
   }
 
   if(packetbuf_hdr_len == SICSLOWPAN_FRAGN_HDR_LEN) {
@@ -1758,6 +2102,11 @@ input(void)
       /* unknown header */
       PRINTFI("sicslowpan input: unknown dispatch: %u\n",
              PACKETBUF_HC1_PTR[PACKETBUF_HC1_DISPATCH]);
+#if SICSLOWPAN_CONF_FRAG
+      if(is_fragment) {
+        reass_drop();
+      }
+#endif /* SICSLOWPAN_CONF_FRAG */
       return;
   }
    
@@ -1774,6 +2123,11 @@ input(void)
    */
   if(packetbuf_datalen() < packetbuf_hdr_len) {
     PRINTF("SICSLOWPAN: packet dropped due to header > total packet\n");
+#if SICSLOWPAN_CONF_FRAG
+    if(is_fragment) {
+      reass_drop();
+    }
+#endif /* SICSLOWPAN_CONF_FRAG */
     return;
   }
   packetbuf_payload_len = packetbuf_datalen() - packetbuf_hdr_len;
@@ -1787,72 +2141,82 @@ input(void)
           "SICSLOWPAN: packet dropped, minimum required SICSLOWPAN_IP_BUF size: %d+%d+%d+%d=%d (current size: %d)\n",
           UIP_LLH_LEN, uncomp_hdr_len, (uint16_t)(frag_offset << 3),
           packetbuf_payload_len, req_size, sizeof(sicslowpan_buf));
+#if SICSLOWPAN_CONF_FRAG
+      if(is_fragment) {
+        reass_drop();
+      }
+#endif /* SICSLOWPAN_CONF_FRAG */
       return;
     }
   }
 
   memcpy((uint8_t *)SICSLOWPAN_IP_BUF + uncomp_hdr_len + (uint16_t)(frag_offset << 3), packetbuf_ptr + packetbuf_hdr_len, packetbuf_payload_len);
   
-  /* update processed_ip_in_len if fragment, sicslowpan_len otherwise */
+  /* update the processed length if fragment, uip_len otherwise */
 
 #if SICSLOWPAN_CONF_FRAG
-  if(frag_size > 0) {
+  if(is_fragment) {
     /* Add the size of the header only for the first fragment. */
     if(first_fragment != 0) {
-      processed_ip_in_len += uncomp_hdr_len;
+      reass->processed += uncomp_hdr_len;
     }
     /* For the last fragment, we are OK if there is extrenous bytes at
        the end of the packet. */
     if(last_fragment != 0) {
-      processed_ip_in_len = frag_size;
+      reass->processed = frag_size;
     } else {
-      processed_ip_in_len += packetbuf_payload_len;
+      reass->processed += packetbuf_payload_len;
     }
-    PRINTF("processed_ip_in_len %d, packetbuf_payload_len %d\n", processed_ip_in_len, packetbuf_payload_len);
+    PRINTF("processed %d, packetbuf_payload_len %d\n", reass->processed, packetbuf_payload_len);
 
-  } else {
-#endif /* SICSLOWPAN_CONF_FRAG */
-    sicslowpan_len = packetbuf_payload_len + uncomp_hdr_len;
-#if SICSLOWPAN_CONF_FRAG
-  }
+    if(reass->processed != reass->len) {
+#if FRAG_FORWARDING
+      if(first_fragment != 0) {
+        /* Relay the datagram rather than reassemble it, if we can. */
+        fwd_first_fragment();
+      }
+#endif /* FRAG_FORWARDING */
+      /* Wait for the rest of the datagram. */
+      return;
+    }
 
-  /*
-   * If we have a full IP packet in sicslowpan_buf, deliver it to
-   * the IP stack
-   */
-  PRINTF("sicslowpan_init processed_ip_in_len %d, sicslowpan_len %d\n",
-         processed_ip_in_len, sicslowpan_len);
-  if(processed_ip_in_len == 0 || (processed_ip_in_len == sicslowpan_len)) {
+    /*
+     * We have a full IP packet in the reassembly buffer, deliver it to
+     * the IP stack
+     */
     PRINTFI("sicslowpan input: IP packet ready (length %d)\n",
-           sicslowpan_len);
-    memcpy((uint8_t *)UIP_IP_BUF, (uint8_t *)SICSLOWPAN_IP_BUF, sicslowpan_len);
-    uip_len = sicslowpan_len;
-    sicslowpan_len = 0;
-    processed_ip_in_len = 0;
+           reass->len);
+    memcpy((uint8_t *)UIP_IP_BUF, (uint8_t *)SICSLOWPAN_IP_BUF, reass->len);
+    uip_len = reass->len;
+    reass->len = 0;
+    sicslowpan_reass_stats.completed++;
+    sicslowpan_bufp = &uip_aligned_buf;
+  } else {
+    uip_len = packetbuf_payload_len + uncomp_hdr_len;
+  }
+#else /* SICSLOWPAN_CONF_FRAG */
+  sicslowpan_len = packetbuf_payload_len + uncomp_hdr_len;
 #endif /* SICSLOWPAN_CONF_FRAG */
 
 #if DEBUG
-    {
-      uint16_t ndx;
-      PRINTF("after decompression %u:", SICSLOWPAN_IP_BUF->len[1]);
-      for (ndx = 0; ndx < SICSLOWPAN_IP_BUF->len[1] + 40; ndx++) {
-        uint8_t data = ((uint8_t *) (SICSLOWPAN_IP_BUF))[ndx];
-        PRINTF("%02x", data);
-      }
-      PRINTF("\n");
+  {
+    uint16_t ndx;
+    PRINTF("after decompression %u:", SICSLOWPAN_IP_BUF->len[1]);
+    for (ndx = 0; ndx < SICSLOWPAN_IP_BUF->len[1] + 40; ndx++) {
+      uint8_t data = ((uint8_t *) (SICSLOWPAN_IP_BUF))[ndx];
+      PRINTF("%02x", data);
     }
+    PRINTF("\n");
+  }
 #endif
 
-    /* if callback is set then set attributes and call */
-    if(callback) {
-      set_packet_attrs();
-      callback->input_callback();
-    }
-
-    tcpip_input();
-#if SICSLOWPAN_CONF_FRAG
+  /* if callback is set then set attributes and call */
+  if(callback) {
+    set_packet_attrs();
+    callback->input_callback();
   }
-#endif /* SICSLOWPAN_CONF_FRAG */
+
+  tcpip_input();
 }
 /** @} */
 
@@ -321,6 +321,24 @@ struct sicslowpan_nh_compressor {
 
 int sicslowpan_get_last_rssi(void);
 
+/**
+ * Reassembly statistics, kept when SICSLOWPAN_CONF_FRAG is set.
+ */
+struct sicslowpan_reass_stats {
+  /** Datagrams reassembled and passed to the IP layer */
+  uint16_t completed;
+  /** Fragments dropped, e.g. fragments of unknown datagrams */
+  uint16_t dropped;
+  /** Datagrams discarded because their reassembly timed out */
+  uint16_t timeouts;
+  /** Datagrams discarded to make room for a new datagram */
+  uint16_t evicted;
+  /** Datagrams relayed by fragment forwarding instead of reassembled */
+  uint16_t forwarded;
+};
+
+extern struct sicslowpan_reass_stats sicslowpan_reass_stats;
+
 extern const struct network_driver sicslowpan_driver;
 
 #endif /* SICSLOWPAN_H_ */
@@ -72,6 +72,14 @@ LIST(notificationlist);
 
 static int num_routes = 0;
 
+#if UIP_DS6_ROUTE_HASH
+/* Each route is also kept in the route_hash bucket selected by its
+   prefix and prefix length. The number of routes of each prefix
+   length is kept so that lookups only probe lengths that are in use. */
+static uip_ds6_route_t *route_hash[UIP_DS6_ROUTE_HASH_SIZE];
+static uint16_t routes_per_length[129];
+#endif /* UIP_DS6_ROUTE_HASH */
+
 #undef DEBUG
 #define DEBUG DEBUG_NONE
 #include "net/ip/uip-debug.h"
@@ -143,11 +151,84 @@ uip_ds6_notification_rm(struct uip_ds6_notification *n)
 }
 #endif
 /*---------------------------------------------------------------------------*/
+#if UIP_DS6_ROUTE_HASH
+static unsigned
+route_hash_index(const uip_ipaddr_t *addr, uint8_t length)
+{
+  unsigned h;
+  int i;
+
+  h = length;
+  for(i = 0; i < length / 8; i++) {
+    h = h * 31 + addr->u8[i];
+  }
+  if(length % 8) {
+    h = h * 31 + (addr->u8[i] & (0xff << (8 - length % 8)));
+  }
+  return h % UIP_DS6_ROUTE_HASH_SIZE;
+}
+/*---------------------------------------------------------------------------*/
+static void
+route_hash_add(uip_ds6_route_t *r)
+{
+  unsigned i;
+
+  i = route_hash_index(&r->ipaddr, r->length);
+  r->hash_next = route_hash[i];
+  route_hash[i] = r;
+  routes_per_length[r->length]++;
+}
+/*---------------------------------------------------------------------------*/
+static void
+route_hash_remove(uip_ds6_route_t *r)
+{
+  uip_ds6_route_t **rp;
+
+  for(rp = &route_hash[route_hash_index(&r->ipaddr, r->length)];
+      *rp != NULL;
+      rp = &(*rp)->hash_next) {
+    if(*rp == r) {
+      *rp = r->hash_next;
+      routes_per_length[r->length]--;
+      return;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static uip_ds6_route_t *
+route_hash_lookup(uip_ipaddr_t *addr)
+{
+  uip_ds6_route_t *r;
+  int length;
+
+  /* Probe the prefix lengths in use, longest first. The first match
+     is the longest matching prefix. */
+  for(length = 128; length >= 0; length--) {
+    if(routes_per_length[length] == 0) {
+      continue;
+    }
+    for(r = route_hash[route_hash_index(addr, length)];
+        r != NULL;
+        r = r->hash_next) {
+      if(r->length == length &&
+         uip_ipaddr_prefixcmp(addr, &r->ipaddr, length)) {
+        return r;
+      }
+    }
+  }
+  return NULL;
+}
+#endif /* UIP_DS6_ROUTE_HASH */
+/*---------------------------------------------------------------------------*/
 void
 uip_ds6_route_init(void)
 {
   memb_init(&routememb);
   list_init(routelist);
+#if UIP_DS6_ROUTE_HASH
+  memset(route_hash, 0, sizeof(route_hash));
+  memset(routes_per_length, 0, sizeof(routes_per_length));
+#endif /* UIP_DS6_ROUTE_HASH */
   nbr_table_register(nbr_routes,
                      (nbr_table_callback *)rm_routelist_callback);
 
@@ -205,15 +286,20 @@ uip_ds6_route_num_routes(void)
 uip_ds6_route_t *
 uip_ds6_route_lookup(uip_ipaddr_t *addr)
 {
-  uip_ds6_route_t *r;
   uip_ds6_route_t *found_route;
+#if !UIP_DS6_ROUTE_HASH
+  uip_ds6_route_t *r;
   uint8_t longestmatch;
+#endif /* !UIP_DS6_ROUTE_HASH */
 
   PRINTF("uip-ds6-route: Looking up route for ");
   PRINT6ADDR(addr);
   PRINTF("\n");
 
 
+#if UIP_DS6_ROUTE_HASH
+  found_route = route_hash_lookup(addr);
+#else /* UIP_DS6_ROUTE_HASH */
   found_route = NULL;
   longestmatch = 0;
   for(r = uip_ds6_route_head();
@@ -229,6 +315,7 @@ uip_ds6_route_lookup(uip_ipaddr_t *addr)
       }
     }
   }
+#endif /* UIP_DS6_ROUTE_HASH */
 
   if(found_route != NULL) {
     PRINTF("uip-ds6-route: Found route: ");
@@ -240,6 +327,7 @@ uip_ds6_route_lookup(uip_ipaddr_t *addr)
     PRINTF("uip-ds6-route: No route found\n");
   }
 
+#if !UIP_DS6_ROUTE_HASH
   if(found_route != NULL && found_route != list_head(routelist)) {
     /* If we found a route, we put it at the start of the routeslist
        list. The list is ordered by how recently we looked them up:
@@ -249,6 +337,7 @@ uip_ds6_route_lookup(uip_ipaddr_t *addr)
     list_remove(routelist, found_route);
     list_push(routelist, found_route);
   }
+#endif /* !UIP_DS6_ROUTE_HASH */
 
   return found_route;
 }
@@ -264,6 +353,11 @@ uip_ds6_route_add(uip_ipaddr_t *ipaddr, uint8_t length,
   assert_nbr_routes_list_sane();
 #endif /* DEBUG != DEBUG_NONE */
 
+  if(length > sizeof(uip_ipaddr_t) * 8) {
+    PRINTF("uip_ds6_route_add: invalid prefix length %u\n", length);
+    return NULL;
+  }
+
   /* Get link-layer address of next hop, make sure it is in neighbor table */
   const uip_lladdr_t *nexthop_lladdr = uip_ds6_nbr_lladdr_from_ipaddr(nexthop);
   if(nexthop_lladdr == NULL) {
@@ -371,6 +465,9 @@ uip_ds6_route_add(uip_ipaddr_t *ipaddr, uint8_t length,
 
   uip_ipaddr_copy(&(r->ipaddr), ipaddr);
   r->length = length;
+#if UIP_DS6_ROUTE_HASH
+  route_hash_add(r);
+#endif /* UIP_DS6_ROUTE_HASH */
 
 #ifdef UIP_DS6_ROUTE_STATE_TYPE
   memset(&r->state, 0, sizeof(UIP_DS6_ROUTE_STATE_TYPE));
@@ -409,6 +506,9 @@ uip_ds6_route_rm(uip_ds6_route_t *route)
 
     /* Remove the route from the route list */
     list_remove(routelist, route);
+#if UIP_DS6_ROUTE_HASH
+    route_hash_remove(route);
+#endif /* UIP_DS6_ROUTE_HASH */
 
     /* Find the corresponding neighbor_route and remove it. */
     for(neighbor_route = list_head(route->neighbor_routes->route_list);
@@ -88,6 +88,24 @@ void uip_ds6_notification_rm(struct uip_ds6_notification *n);
 #define UIP_DS6_ROUTE_NB UIP_CONF_MAX_ROUTES
 #endif /* UIP_CONF_MAX_ROUTES */
 
+/* With UIP_DS6_ROUTE_HASH, routes are also kept in a hash table keyed
+   on (prefix, prefix length). A lookup then probes one bucket per
+   distinct prefix length in use instead of walking the whole route
+   list. Routes are no longer moved to the front of the list on lookup,
+   so when the table is full the oldest route, rather than the least
+   recently used one, is dropped. */
+#ifdef UIP_CONF_DS6_ROUTE_HASH
+#define UIP_DS6_ROUTE_HASH UIP_CONF_DS6_ROUTE_HASH
+#else /* UIP_CONF_DS6_ROUTE_HASH */
+#define UIP_DS6_ROUTE_HASH 0
+#endif /* UIP_CONF_DS6_ROUTE_HASH */
+
+#ifdef UIP_CONF_DS6_ROUTE_HASH_SIZE
+#define UIP_DS6_ROUTE_HASH_SIZE UIP_CONF_DS6_ROUTE_HASH_SIZE
+#else /* UIP_CONF_DS6_ROUTE_HASH_SIZE */
+#define UIP_DS6_ROUTE_HASH_SIZE UIP_DS6_ROUTE_NB
+#endif /* UIP_CONF_DS6_ROUTE_HASH_SIZE */
+
 /** \brief define some additional RPL related route state and
  *  neighbor callback for RPL - if not a DS6_ROUTE_STATE is already set */
 #ifndef UIP_DS6_ROUTE_STATE_TYPE
@@ -110,6 +128,10 @@ struct uip_ds6_route_neighbor_routes {
 /** \brief An entry in the routing table */
 typedef struct uip_ds6_route {
   struct uip_ds6_route *next;
+#if UIP_DS6_ROUTE_HASH
+  /* The next route in the same hash bucket. */
+  struct uip_ds6_route *hash_next;
+#endif /* UIP_DS6_ROUTE_HASH */
   /* Each route entry belongs to a specific neighbor. That neighbor
      holds a list of all routing entries that go through it. The
      routes field point to the uip_ds6_route_neighbor_routes that
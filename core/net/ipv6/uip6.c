@@ -73,10 +73,14 @@
 
 #include "net/ip/uip.h"
 #include "net/ip/uipopt.h"
+#include "net/ip/ip-chksum.h"
 #include "net/ipv6/uip-icmp6.h"
 #include "net/ipv6/uip-nd6.h"
 #include "net/ipv6/uip-ds6.h"
 #include "net/ipv6/multicast/uip-mcast6.h"
+#if UIP_TCP_SEND_WINDOW
+#include "net/ip/tcpip.h"
+#endif /* UIP_TCP_SEND_WINDOW */
 
 #include <string.h>
 
@@ -257,6 +261,45 @@ static uint8_t iss[4];
 uint8_t uip_acc32[4];
 static uint8_t opt;
 static uint16_t tmp16;
+
+#if UIP_TCP_SEND_WINDOW
+/* A segment that has been sent but not yet acknowledged. */
+struct tcp_segment {
+  uint16_t len;
+  uint16_t sum;         /* Ones' complement sum of the data */
+  uint8_t data[UIP_TCP_MSS];
+};
+
+/* The send window of a connection. The segments form a ring, oldest
+   first. The connection's snd_nxt holds the sequence number of the
+   oldest unacknowledged byte, and its len field the number of bytes
+   in flight. */
+struct tcp_send_window {
+  struct tcp_segment segments[UIP_TCP_SEND_WINDOW];
+  uint16_t wnd;         /* Window advertised by the peer */
+  uint16_t recover;     /* Bytes in flight when a loss was detected */
+  uint8_t first;        /* Oldest unacknowledged segment */
+  uint8_t count;        /* Number of unacknowledged segments */
+  uint8_t cwnd;         /* Congestion window, in segments */
+  uint8_t ssthresh;     /* Slow start threshold, in segments */
+  uint8_t cwnd_acks;    /* Segments acknowledged since cwnd last grew */
+  uint8_t dupacks;      /* Duplicate ACKs received in a row */
+  uint8_t accepted;     /* Data taken from the application, to be
+                           reported with UIP_ACKDATA */
+  uint8_t closing;      /* The application has closed the connection */
+  uint8_t rexmit;       /* Resend the oldest segment on the next poll */
+};
+
+static struct tcp_send_window tcp_windows[UIP_CONNS];
+#define TCP_WINDOW(conn) (&tcp_windows[(conn) - uip_conns])
+
+/* Offset from snd_nxt of the sequence number of the next segment */
+static uint16_t tcp_seq_offset;
+
+/* The segment being sent from the send window, whose data need not be
+   summed again for the TCP checksum */
+static struct tcp_segment *tcp_segment_sent;
+#endif /* UIP_TCP_SEND_WINDOW */
 #endif /* UIP_TCP */
 /** @} */
 
@@ -272,6 +315,50 @@ struct uip_udp_conn uip_udp_conns[UIP_UDP_CONNS];
 #endif /* UIP_UDP */
 /** @} */
 
+#if UIP_CONN_HASH
+/*---------------------------------------------------------------------------*/
+/**
+ * \name Connection hash tables
+ * @{
+ */
+/* Each table has an array of buckets, holding the index of the first
+   entry in the bucket, and an array with the index of the next entry
+   in the same bucket for each entry. Chains are kept in table order,
+   so that a lookup finds the same entry as a linear search of the
+   table would. */
+#if UIP_CONNS > 255 || UIP_UDP_CONNS > 255 || UIP_LISTENPORTS > 255
+#error UIP_CONF_CONN_HASH supports at most 255 entries per table
+#endif
+#define HASH_NONE 0xff
+
+/* Ports and addresses are in network byte order, so both bytes of the
+   key are folded into the bucket index. */
+#define HASH_FOLD(key) ((((key) >> 8) ^ (key)) % UIP_CONN_HASH_SIZE)
+
+#if UIP_TCP
+/* TCP connections, hashed on local port, remote port and address.
+   Closed connections stay in their bucket until they are reused. */
+static uint8_t tcp_hash[UIP_CONN_HASH_SIZE];
+static uint8_t tcp_hash_next[UIP_CONNS];
+#define TCP_HASH(lport, rport, addr)                                    \
+  HASH_FOLD((lport) + (rport) * 31 + (addr)->u16[6] * 7 + (addr)->u16[7])
+
+/* Listening TCP ports, hashed on the port */
+static uint8_t listen_hash[UIP_CONN_HASH_SIZE];
+static uint8_t listen_hash_next[UIP_LISTENPORTS];
+#endif /* UIP_TCP */
+
+#if UIP_UDP
+/* UDP connections, hashed on the local port only as the remote port
+   and address may be wildcards. */
+static uint8_t udp_hash[UIP_CONN_HASH_SIZE];
+static uint8_t udp_hash_next[UIP_UDP_CONNS];
+#endif /* UIP_UDP */
+
+#define PORT_HASH(port) HASH_FOLD(port)
+/** @} */
+#endif /* UIP_CONN_HASH */
+
 /*---------------------------------------------------------------------------*/
 /**
  * \name ICMPv6 variables
@@ -317,43 +404,185 @@ uip_add32(uint8_t *op32, uint16_t op16)
 
 #endif /* UIP_ARCH_ADD32 && UIP_TCP */
 
-#if ! UIP_ARCH_CHKSUM
+#if UIP_TCP
+/*---------------------------------------------------------------------------*/
+static void
+tcp_update_rtt(struct uip_conn *conn)
+{
+  signed char m;
+  m = conn->rto - conn->timer;
+  /* This is taken directly from VJs original code in his paper */
+  m = m - (conn->sa >> 3);
+  conn->sa += m;
+  if(m < 0) {
+    m = -m;
+  }
+  m = m - (conn->sv >> 2);
+  conn->sv += m;
+  conn->rto = (conn->sa >> 3) + conn->sv;
+}
+#endif /* UIP_TCP */
+
+#if UIP_TCP_SEND_WINDOW
+/*---------------------------------------------------------------------------*/
+static void
+tcp_window_init(struct uip_conn *conn)
+{
+  struct tcp_send_window *w = TCP_WINDOW(conn);
+
+  w->wnd = UIP_TCP_MSS;
+  w->first = 0;
+  w->count = 0;
+  w->cwnd = UIP_TCP_SEND_WINDOW > 1 ? 2 : 1;
+  w->ssthresh = UIP_TCP_SEND_WINDOW;
+  w->cwnd_acks = 0;
+  w->dupacks = 0;
+  w->recover = 0;
+  w->accepted = 0;
+  w->closing = 0;
+  w->rexmit = 0;
+  conn->wnd_mss = UIP_TCP_MSS;
+}
+/*---------------------------------------------------------------------------*/
+/* Returns non-zero if the connection may send another segment. */
+static int
+tcp_window_open(struct uip_conn *conn)
+{
+  struct tcp_send_window *w = TCP_WINDOW(conn);
+
+  if(w->closing || w->count >= w->cwnd) {
+    return 0;
+  }
+  /* Let a single segment probe a closed peer window */
+  return w->count == 0 || conn->len < w->wnd;
+}
+/*---------------------------------------------------------------------------*/
+static uint32_t
+tcp_seq_diff(const uint8_t *a, const uint8_t *b)
+{
+  return (((uint32_t)a[0] << 24) | ((uint32_t)a[1] << 16) |
+          ((uint32_t)a[2] << 8) | a[3]) -
+    (((uint32_t)b[0] << 24) | ((uint32_t)b[1] << 16) |
+     ((uint32_t)b[2] << 8) | b[3]);
+}
 /*---------------------------------------------------------------------------*/
+/* Removes the segments covered by the cumulative ACK in the incoming
+   packet and grows the congestion window. Returns the number of
+   newly acknowledged bytes. */
 static uint16_t
-chksum(uint16_t sum, const uint8_t *data, uint16_t len)
+tcp_window_ack(struct uip_conn *conn)
 {
-  uint16_t t;
-  const uint8_t *dataptr;
-  const uint8_t *last_byte;
+  struct tcp_send_window *w = TCP_WINDOW(conn);
+  struct tcp_segment *seg;
+  uint32_t diff;
+  uint16_t acked, left;
 
-  dataptr = data;
-  last_byte = data + len - 1;
-  
-  while(dataptr < last_byte) {   /* At least two more bytes */
-    t = (dataptr[0] << 8) + dataptr[1];
-    sum += t;
-    if(sum < t) {
-      sum++;      /* carry */
-    }
-    dataptr += 2;
+  diff = tcp_seq_diff(UIP_TCP_BUF->ackno, conn->snd_nxt);
+  if(diff == 0 || diff > conn->len) {
+    return 0;
   }
-  
-  if(dataptr == last_byte) {
-    t = (dataptr[0] << 8) + 0;
-    sum += t;
-    if(sum < t) {
-      sum++;      /* carry */
+  acked = left = (uint16_t)diff;
+
+  uip_add32(conn->snd_nxt, acked);
+  memcpy(conn->snd_nxt, uip_acc32, sizeof(conn->snd_nxt));
+  conn->len -= acked;
+
+  while(left > 0 && w->count > 0) {
+    seg = &w->segments[w->first];
+    if(left < seg->len) {
+      /* Partially acknowledged segment */
+      memmove(seg->data, seg->data + left, seg->len - left);
+      seg->len -= left;
+      seg->sum = ip_chksum_add(0, seg->data, seg->len);
+      break;
+    }
+    left -= seg->len;
+    w->first = (w->first + 1) % UIP_TCP_SEND_WINDOW;
+    w->count--;
+
+    if(w->cwnd < w->ssthresh) {
+      /* Slow start */
+      w->cwnd++;
+    } else if(++w->cwnd_acks >= w->cwnd) {
+      /* Congestion avoidance */
+      w->cwnd_acks = 0;
+      w->cwnd++;
+    }
+    if(w->cwnd > UIP_TCP_SEND_WINDOW) {
+      w->cwnd = UIP_TCP_SEND_WINDOW;
     }
   }
+  w->dupacks = 0;
+  return acked;
+}
+/*---------------------------------------------------------------------------*/
+/* Halves the slow start threshold after a loss. The segments in
+   flight are resent one by one as partial ACKs arrive, until the data
+   that was in flight at the time of the loss has been acknowledged. */
+static void
+tcp_window_loss(struct uip_conn *conn)
+{
+  struct tcp_send_window *w = TCP_WINDOW(conn);
 
-  /* Return sum in host byte order. */
-  return sum;
+  w->ssthresh = w->count / 2 < 2 ? 2 : w->count / 2;
+  w->cwnd_acks = 0;
+  w->dupacks = 0;
+  w->recover = conn->len;
+}
+/*---------------------------------------------------------------------------*/
+/* Returns the number of bytes that the next segment may carry: the MSS,
+   limited by what is left of the peer's window while segments are in
+   flight. */
+static uint16_t
+tcp_window_space(struct uip_conn *conn)
+{
+  struct tcp_send_window *w = TCP_WINDOW(conn);
+
+  if(w->count > 0 && conn->len < w->wnd &&
+     w->wnd - conn->len < conn->mss) {
+    return w->wnd - conn->len;
+  }
+  return conn->mss;
 }
 /*---------------------------------------------------------------------------*/
+/* Reports data taken over since the last call to the application, and
+   limits uip_mss() to the space left in the peer's window. The
+   negotiated MSS in conn->mss is left as it is. */
+static void
+tcp_window_report(struct uip_conn *conn)
+{
+  if(TCP_WINDOW(conn)->accepted) {
+    TCP_WINDOW(conn)->accepted = 0;
+    uip_flags |= UIP_ACKDATA;
+  }
+  conn->wnd_mss = tcp_window_space(conn);
+}
+/*---------------------------------------------------------------------------*/
+/* Computes the TCP checksum of a segment sent from the send window,
+   from the sum of the segment data taken when it was queued. */
+static uint16_t
+tcp_window_chksum(const struct tcp_segment *seg)
+{
+  uint16_t sum;
+
+  sum = uip_len - UIP_IPH_LEN + UIP_PROTO_TCP;
+  sum = ip_chksum_add(sum, &UIP_IP_BUF->srcipaddr, 2 * sizeof(uip_ipaddr_t));
+  sum = ip_chksum_add(sum, UIP_TCP_BUF, UIP_TCPH_LEN);
+  sum = ip_chksum_add16(sum, seg->sum);
+
+  return (sum == 0) ? 0xffff : uip_htons(sum);
+}
+#define TCP_CAN_SEND(conn) tcp_window_open(conn)
+#else /* UIP_TCP_SEND_WINDOW */
+#define TCP_CAN_SEND(conn) (!uip_outstanding(conn))
+#endif /* UIP_TCP_SEND_WINDOW */
+
+#if ! UIP_ARCH_CHKSUM
+/*---------------------------------------------------------------------------*/
 uint16_t
 uip_chksum(uint16_t *data, uint16_t len)
 {
-  return uip_htons(chksum(0, (uint8_t *)data, len));
+  return uip_htons(ip_chksum_add(0, data, len));
 }
 /*---------------------------------------------------------------------------*/
 #ifndef UIP_ARCH_IPCHKSUM
@@ -362,7 +591,7 @@ uip_ipchksum(void)
 {
   uint16_t sum;
 
-  sum = chksum(0, &uip_buf[UIP_LLH_LEN], UIP_IPH_LEN);
+  sum = ip_chksum_add(0, &uip_buf[UIP_LLH_LEN], UIP_IPH_LEN);
   PRINTF("uip_ipchksum: sum 0x%04x\n", sum);
   return (sum == 0) ? 0xffff : uip_htons(sum);
 }
@@ -392,11 +621,11 @@ upper_layer_chksum(uint8_t proto)
   /* IP protocol and length fields. This addition cannot carry. */
   sum = upper_layer_len + proto;
   /* Sum IP source and destination addresses. */
-  sum = chksum(sum, (uint8_t *)&UIP_IP_BUF->srcipaddr, 2 * sizeof(uip_ipaddr_t));
+  sum = ip_chksum_add(sum, (uint8_t *)&UIP_IP_BUF->srcipaddr, 2 * sizeof(uip_ipaddr_t));
 
   /* Sum TCP header and data. */
-  sum = chksum(sum, &uip_buf[UIP_IPH_LEN + UIP_LLH_LEN + uip_ext_len],
-               upper_layer_len);
+  sum = ip_chksum_add(sum, &uip_buf[UIP_IPH_LEN + UIP_LLH_LEN + uip_ext_len],
+                      upper_layer_len);
     
   return (sum == 0) ? 0xffff : uip_htons(sum);
 }
@@ -424,6 +653,64 @@ uip_udpchksum(void)
 }
 #endif /* UIP_UDP && UIP_UDP_CHECKSUMS */
 #endif /* UIP_ARCH_CHKSUM */
+#if UIP_CONN_HASH
+/*---------------------------------------------------------------------------*/
+static void
+hash_link(uint8_t *bucket, uint8_t *next, uint8_t i)
+{
+  while(*bucket != HASH_NONE && *bucket < i) {
+    bucket = &next[*bucket];
+  }
+  next[i] = *bucket;
+  *bucket = i;
+}
+/*---------------------------------------------------------------------------*/
+static void
+hash_unlink(uint8_t *bucket, uint8_t *next, uint8_t i)
+{
+  while(*bucket != HASH_NONE) {
+    if(*bucket == i) {
+      *bucket = next[i];
+      return;
+    }
+    bucket = &next[*bucket];
+  }
+}
+#if UIP_TCP
+/*---------------------------------------------------------------------------*/
+/* Moves a connection that is being reused to the bucket of its new
+   addresses and ports. */
+static void
+tcp_hash_set(struct uip_conn *conn, uint16_t lport, uint16_t rport,
+             const uip_ipaddr_t *ripaddr)
+{
+  uint8_t i = conn - uip_conns;
+
+  hash_unlink(&tcp_hash[TCP_HASH(conn->lport, conn->rport, &conn->ripaddr)],
+              tcp_hash_next, i);
+  conn->lport = lport;
+  conn->rport = rport;
+  uip_ipaddr_copy(&conn->ripaddr, ripaddr);
+  hash_link(&tcp_hash[TCP_HASH(lport, rport, ripaddr)], tcp_hash_next, i);
+}
+#endif /* UIP_TCP */
+#if UIP_UDP
+/*---------------------------------------------------------------------------*/
+void
+uip_udp_bind(struct uip_udp_conn *conn, uint16_t port)
+{
+  uint8_t i = conn - uip_udp_conns;
+
+  if(conn->lport != 0) {
+    hash_unlink(&udp_hash[PORT_HASH(conn->lport)], udp_hash_next, i);
+  }
+  conn->lport = port;
+  if(port != 0) {
+    hash_link(&udp_hash[PORT_HASH(port)], udp_hash_next, i);
+  }
+}
+#endif /* UIP_UDP */
+#endif /* UIP_CONN_HASH */
 /*---------------------------------------------------------------------------*/
 void
 uip_init(void)
@@ -440,6 +727,10 @@ uip_init(void)
   for(c = 0; c < UIP_CONNS; ++c) {
     uip_conns[c].tcpstateflags = UIP_CLOSED;
   }
+#if UIP_CONN_HASH
+  memset(tcp_hash, HASH_NONE, sizeof(tcp_hash));
+  memset(listen_hash, HASH_NONE, sizeof(listen_hash));
+#endif /* UIP_CONN_HASH */
 #endif /* UIP_TCP */
 
 #if UIP_ACTIVE_OPEN || UIP_UDP
@@ -450,6 +741,9 @@ uip_init(void)
   for(c = 0; c < UIP_UDP_CONNS; ++c) {
     uip_udp_conns[c].lport = 0;
   }
+#if UIP_CONN_HASH
+  memset(udp_hash, HASH_NONE, sizeof(udp_hash));
+#endif /* UIP_CONN_HASH */
 #endif /* UIP_UDP */
 
 #if UIP_CONF_IPV6_MULTICAST
@@ -520,9 +814,16 @@ uip_connect(uip_ipaddr_t *ripaddr, uint16_t rport)
   conn->rto = UIP_RTO;
   conn->sa = 0;
   conn->sv = 16;   /* Initial value of the RTT variance. */
+#if UIP_CONN_HASH
+  tcp_hash_set(conn, uip_htons(lastport), rport, ripaddr);
+#else /* UIP_CONN_HASH */
   conn->lport = uip_htons(lastport);
   conn->rport = rport;
   uip_ipaddr_copy(&conn->ripaddr, ripaddr);
+#endif /* UIP_CONN_HASH */
+#if UIP_TCP_SEND_WINDOW
+  tcp_window_init(conn);
+#endif /* UIP_TCP_SEND_WINDOW */
   
   return conn;
 }
@@ -567,11 +868,20 @@ uip_udp_new(const uip_ipaddr_t *ripaddr, uint16_t rport)
     lastport = 4096;
   }
   
+#if UIP_CONN_HASH
+  for(c = udp_hash[PORT_HASH(uip_htons(lastport))]; c != HASH_NONE;
+      c = udp_hash_next[c]) {
+    if(uip_udp_conns[c].lport == uip_htons(lastport)) {
+      goto again;
+    }
+  }
+#else /* UIP_CONN_HASH */
   for(c = 0; c < UIP_UDP_CONNS; ++c) {
     if(uip_udp_conns[c].lport == uip_htons(lastport)) {
       goto again;
     }
   }
+#endif /* UIP_CONN_HASH */
 
   conn = 0;
   for(c = 0; c < UIP_UDP_CONNS; ++c) {
@@ -585,7 +895,7 @@ uip_udp_new(const uip_ipaddr_t *ripaddr, uint16_t rport)
     return 0;
   }
   
-  conn->lport = UIP_HTONS(lastport);
+  uip_udp_bind(conn, UIP_HTONS(lastport));
   conn->rport = rport;
   if(ripaddr == NULL) {
     memset(&conn->ripaddr, 0, sizeof(uip_ipaddr_t));
@@ -605,6 +915,9 @@ uip_unlisten(uint16_t port)
   for(c = 0; c < UIP_LISTENPORTS; ++c) {
     if(uip_listenports[c] == port) {
       uip_listenports[c] = 0;
+#if UIP_CONN_HASH
+      hash_unlink(&listen_hash[PORT_HASH(port)], listen_hash_next, c);
+#endif /* UIP_CONN_HASH */
       return;
     }
   }
@@ -616,6 +929,9 @@ uip_listen(uint16_t port)
   for(c = 0; c < UIP_LISTENPORTS; ++c) {
     if(uip_listenports[c] == 0) {
       uip_listenports[c] = port;
+#if UIP_CONN_HASH
+      hash_link(&listen_hash[PORT_HASH(port)], listen_hash_next, c);
+#endif /* UIP_CONN_HASH */
       return;
     }
   }
@@ -952,9 +1268,26 @@ uip_process(uint8_t flag)
      particular connection. */
   if(flag == UIP_POLL_REQUEST) {
 #if UIP_TCP
+#if UIP_TCP_SEND_WINDOW
     if((uip_connr->tcpstateflags & UIP_TS_MASK) == UIP_ESTABLISHED &&
-       !uip_outstanding(uip_connr)) {
+       TCP_WINDOW(uip_connr)->rexmit) {
+      /* Requested by a partial ACK that carried data, once the data
+         has been taken in */
+      TCP_WINDOW(uip_connr)->rexmit = 0;
+      if(TCP_WINDOW(uip_connr)->count > 0) {
+        UIP_STAT(++uip_stat.tcp.rexmit);
+        goto tcp_window_rexmit;
+      }
+    }
+#endif /* UIP_TCP_SEND_WINDOW */
+    if((uip_connr->tcpstateflags & UIP_TS_MASK) == UIP_ESTABLISHED &&
+       TCP_CAN_SEND(uip_connr)) {
       uip_flags = UIP_POLL;
+#if UIP_TCP_SEND_WINDOW
+      /* The poll may follow right after a segment was sent */
+      uip_slen = 0;
+      tcp_window_report(uip_connr);
+#endif /* UIP_TCP_SEND_WINDOW */
       UIP_APPCALL();
       goto appsend;
 #if UIP_ACTIVE_OPEN
@@ -1049,6 +1382,15 @@ uip_process(uint8_t flag)
 #endif /* UIP_ACTIVE_OPEN */
                      
             case UIP_ESTABLISHED:
+#if UIP_TCP_SEND_WINDOW
+              if(TCP_WINDOW(uip_connr)->count > 0) {
+                /* Resend the oldest segment from the send window and
+                   restart from a congestion window of one segment. */
+                tcp_window_loss(uip_connr);
+                TCP_WINDOW(uip_connr)->cwnd = 1;
+                goto tcp_window_rexmit;
+              }
+#endif /* UIP_TCP_SEND_WINDOW */
               /*
                * In the ESTABLISHED state, we call upon the application
                * to do the actual retransmit after which we jump into
@@ -1072,6 +1414,15 @@ uip_process(uint8_t flag)
          * application for new data.
          */
         uip_flags = UIP_POLL;
+#if UIP_TCP_SEND_WINDOW
+        if(TCP_WINDOW(uip_connr)->closing) {
+          /* Waiting to send the FIN; see appsend */
+          uip_flags = 0;
+          uip_slen = 0;
+          goto appsend;
+        }
+        tcp_window_report(uip_connr);
+#endif /* UIP_TCP_SEND_WINDOW */
         UIP_APPCALL();
         goto appsend;
       }
@@ -1365,6 +1716,24 @@ uip_process(uint8_t flag)
 
         PRINTF("Processing Routing header\n");
         if(UIP_ROUTING_BUF->seg_left > 0) {
+#if UIP_CONF_IPV6_RPL && UIP_CONF_ROUTER
+          /* An RPL source routing header has set the destination to the
+             next hop */
+          if(rpl_process_srh_header()) {
+            if(UIP_IP_BUF->ttl <= 1) {
+              uip_icmp6_error_output(ICMP6_TIME_EXCEEDED,
+                                     ICMP6_TIME_EXCEED_TRANSIT, 0);
+              UIP_STAT(++uip_stat.ip.drop);
+              goto send;
+            }
+            UIP_IP_BUF->ttl = UIP_IP_BUF->ttl - 1;
+            PRINTF("Forwarding source routed packet to ");
+            PRINT6ADDR(&UIP_IP_BUF->destipaddr);
+            PRINTF("\n");
+            UIP_STAT(++uip_stat.ip.forwarded);
+            goto send;
+          }
+#endif /* UIP_CONF_IPV6_RPL && UIP_CONF_ROUTER */
           uip_icmp6_error_output(ICMP6_PARAM_PROB, ICMP6_PARAMPROB_HEADER, UIP_IPH_LEN + uip_ext_len + 2);
           UIP_STAT(++uip_stat.ip.drop);
           UIP_LOG("ip6: unrecognized routing type");
@@ -1504,9 +1873,15 @@ uip_process(uint8_t flag)
   }
 
   /* Demultiplex this UDP packet between the UDP "connections". */
+#if UIP_CONN_HASH
+  for(c = udp_hash[PORT_HASH(UIP_UDP_BUF->destport)]; c != HASH_NONE;
+      c = udp_hash_next[c]) {
+    uip_udp_conn = &uip_udp_conns[c];
+#else /* UIP_CONN_HASH */
   for(uip_udp_conn = &uip_udp_conns[0];
       uip_udp_conn < &uip_udp_conns[UIP_UDP_CONNS];
       ++uip_udp_conn) {
+#endif /* UIP_CONN_HASH */
     /* If the local UDP port is non-zero, the connection is considered
        to be used. If so, the local port number is checked against the
        destination port number in the received packet. If the two port
@@ -1613,8 +1988,15 @@ uip_process(uint8_t flag)
 
   /* Demultiplex this segment. */
   /* First check any active connections. */
+#if UIP_CONN_HASH
+  for(c = tcp_hash[TCP_HASH(UIP_TCP_BUF->destport, UIP_TCP_BUF->srcport,
+                            &UIP_IP_BUF->srcipaddr)];
+      c != HASH_NONE; c = tcp_hash_next[c]) {
+    uip_connr = &uip_conns[c];
+#else /* UIP_CONN_HASH */
   for(uip_connr = &uip_conns[0]; uip_connr <= &uip_conns[UIP_CONNS - 1];
       ++uip_connr) {
+#endif /* UIP_CONN_HASH */
     if(uip_connr->tcpstateflags != UIP_CLOSED &&
        UIP_TCP_BUF->destport == uip_connr->lport &&
        UIP_TCP_BUF->srcport == uip_connr->rport &&
@@ -1633,7 +2015,12 @@ uip_process(uint8_t flag)
   
   tmp16 = UIP_TCP_BUF->destport;
   /* Next, check listening connections. */
+#if UIP_CONN_HASH
+  for(c = listen_hash[PORT_HASH(tmp16)]; c != HASH_NONE;
+      c = listen_hash_next[c]) {
+#else /* UIP_CONN_HASH */
   for(c = 0; c < UIP_LISTENPORTS; ++c) {
+#endif /* UIP_CONN_HASH */
     if(tmp16 == uip_listenports[c]) {
       goto found_listen;
     }
@@ -1734,10 +2121,18 @@ uip_process(uint8_t flag)
   uip_connr->sa = 0;
   uip_connr->sv = 4;
   uip_connr->nrtx = 0;
+#if UIP_CONN_HASH
+  tcp_hash_set(uip_connr, UIP_TCP_BUF->destport, UIP_TCP_BUF->srcport,
+               &UIP_IP_BUF->srcipaddr);
+#else /* UIP_CONN_HASH */
   uip_connr->lport = UIP_TCP_BUF->destport;
   uip_connr->rport = UIP_TCP_BUF->srcport;
   uip_ipaddr_copy(&uip_connr->ripaddr, &UIP_IP_BUF->srcipaddr);
+#endif /* UIP_CONN_HASH */
   uip_connr->tcpstateflags = UIP_SYN_RCVD;
+#if UIP_TCP_SEND_WINDOW
+  tcp_window_init(uip_connr);
+#endif /* UIP_TCP_SEND_WINDOW */
 
   uip_connr->snd_nxt[0] = iss[0];
   uip_connr->snd_nxt[1] = iss[1];
@@ -1861,6 +2256,48 @@ uip_process(uint8_t flag)
      data. If so, we update the sequence number, reset the length of
      the outstanding data, calculate RTT estimations, and reset the
      retransmission timer. */
+#if UIP_TCP_SEND_WINDOW
+  if((UIP_TCP_BUF->flags & TCP_ACK) && TCP_WINDOW(uip_connr)->count > 0) {
+    /* Segments in the send window are acknowledged cumulatively. When
+       the ACK opens the window, the application is polled for more
+       data. */
+    struct tcp_send_window *w = TCP_WINDOW(uip_connr);
+
+    tmp16 = tcp_window_ack(uip_connr);
+    if(tmp16 > 0) {
+      if(uip_connr->nrtx == 0 && w->recover == 0) {
+        tcp_update_rtt(uip_connr);
+      }
+      uip_connr->nrtx = 0;
+      uip_connr->timer = uip_connr->rto;
+      uip_flags = UIP_POLL;
+      if(w->recover > tmp16 && w->count > 0) {
+        /* A partial ACK during loss recovery: the next segment was
+           lost as well. Resend it now and let the application fill
+           the window later. If the segment carries data or a FIN, it
+           is processed first and the resend waits for the poll. */
+        w->recover -= tmp16;
+        tcpip_poll_tcp(uip_connr);
+        if(uip_len == 0 && (UIP_TCP_BUF->flags & (TCP_SYN | TCP_FIN)) == 0) {
+          UIP_STAT(++uip_stat.tcp.rexmit);
+          goto tcp_window_rexmit;
+        }
+        w->rexmit = 1;
+      } else {
+        w->recover = 0;
+      }
+    } else if(uip_len == 0 &&
+              (UIP_TCP_BUF->flags & (TCP_SYN | TCP_FIN)) == 0 &&
+              w->recover == 0 && ++w->dupacks == 3) {
+      /* Fast retransmit of the oldest segment on the third duplicate
+         ACK. */
+      tcp_window_loss(uip_connr);
+      w->cwnd = w->ssthresh;
+      UIP_STAT(++uip_stat.tcp.rexmit);
+      goto tcp_window_rexmit;
+    }
+  } else
+#endif /* UIP_TCP_SEND_WINDOW */
   if((UIP_TCP_BUF->flags & TCP_ACK) && uip_outstanding(uip_connr)) {
     uip_add32(uip_connr->snd_nxt, uip_connr->len);
 
@@ -1876,18 +2313,7 @@ uip_process(uint8_t flag)
    
       /* Do RTT estimation, unless we have done retransmissions. */
       if(uip_connr->nrtx == 0) {
-        signed char m;
-        m = uip_connr->rto - uip_connr->timer;
-        /* This is taken directly from VJs original code in his paper */
-        m = m - (uip_connr->sa >> 3);
-        uip_connr->sa += m;
-        if(m < 0) {
-          m = -m;
-        }
-        m = m - (uip_connr->sv >> 2);
-        uip_connr->sv += m;
-        uip_connr->rto = (uip_connr->sa >> 3) + uip_connr->sv;
-
+        tcp_update_rtt(uip_connr);
       }
       /* Set the acknowledged flag. */
       uip_flags = UIP_ACKDATA;
@@ -2064,6 +2490,9 @@ uip_process(uint8_t flag)
          "persistent timer" and uses the retransmission mechanim.
       */
       tmp16 = ((uint16_t)UIP_TCP_BUF->wnd[0] << 8) + (uint16_t)UIP_TCP_BUF->wnd[1];
+#if UIP_TCP_SEND_WINDOW
+      TCP_WINDOW(uip_connr)->wnd = tmp16;
+#endif /* UIP_TCP_SEND_WINDOW */
       if(tmp16 > uip_connr->initialmss ||
          tmp16 == 0) {
         tmp16 = uip_connr->initialmss;
@@ -2086,7 +2515,19 @@ uip_process(uint8_t flag)
          put into the uip_appdata and the length of the data should be
          put into uip_len. If the application don't have any data to
          send, uip_len must be set to 0. */
+#if UIP_TCP_SEND_WINDOW
+      if(TCP_WINDOW(uip_connr)->closing) {
+        /* The application has closed the connection and must not be
+           called again. Incoming data is only acknowledged. */
+        uip_flags &= UIP_NEWDATA;
+        uip_slen = 0;
+        goto appsend;
+      }
+      if(uip_flags & (UIP_NEWDATA | UIP_ACKDATA | UIP_POLL)) {
+        tcp_window_report(uip_connr);
+#else /* UIP_TCP_SEND_WINDOW */
       if(uip_flags & (UIP_NEWDATA | UIP_ACKDATA)) {
+#endif /* UIP_TCP_SEND_WINDOW */
         uip_slen = 0;
         UIP_APPCALL();
 
@@ -2099,6 +2540,23 @@ uip_process(uint8_t flag)
           goto tcp_send_nodata;
         }
 
+#if UIP_TCP_SEND_WINDOW
+        if(uip_flags & UIP_CLOSE) {
+          /* Send the FIN once the send window has been acknowledged.
+             Until then, the connection is driven by ACKs and the
+             periodic timer without calling the application. */
+          TCP_WINDOW(uip_connr)->closing = 1;
+        }
+        if(TCP_WINDOW(uip_connr)->closing) {
+          if(TCP_WINDOW(uip_connr)->count == 0) {
+            uip_flags |= UIP_CLOSE;
+          } else {
+            uip_flags &= ~UIP_CLOSE;
+            uip_slen = 0;
+          }
+        }
+#endif /* UIP_TCP_SEND_WINDOW */
+
         if(uip_flags & UIP_CLOSE) {
           uip_slen = 0;
           uip_connr->len = 1;
@@ -2108,6 +2566,43 @@ uip_process(uint8_t flag)
           goto tcp_send_nodata;
         }
 
+#if UIP_TCP_SEND_WINDOW
+        /* Data from the application is copied into the send window,
+           if it is open and the data fits, and sent right away. The
+           application is polled again while the window stays open. */
+        if(uip_slen > 0 && tcp_window_open(uip_connr) &&
+           uip_slen <= tcp_window_space(uip_connr)) {
+          struct tcp_send_window *w = TCP_WINDOW(uip_connr);
+          struct tcp_segment *seg;
+
+          seg = &w->segments[(w->first + w->count) % UIP_TCP_SEND_WINDOW];
+          memcpy(seg->data, uip_sappdata, uip_slen);
+          seg->len = uip_slen;
+          seg->sum = ip_chksum_add(0, seg->data, seg->len);
+          if(w->count == 0) {
+            uip_connr->timer = uip_connr->rto;
+            uip_connr->nrtx = 0;
+          }
+          w->count++;
+          w->accepted = 1;
+          tcp_seq_offset = uip_connr->len;
+          uip_connr->len += uip_slen;
+          if(tcp_window_open(uip_connr)) {
+            tcpip_poll_tcp(uip_connr);
+          }
+
+          uip_appdata = uip_sappdata;
+          uip_len = uip_slen + UIP_TCPIP_HLEN;
+          UIP_TCP_BUF->flags = TCP_ACK | TCP_PSH;
+          tcp_segment_sent = seg;
+          goto tcp_send_noopts;
+        }
+        /* The window is full or the data does not fit. The data has
+           not been acknowledged to the application, which sends it
+           again later. */
+        uip_slen = 0;
+#endif /* UIP_TCP_SEND_WINDOW */
+
         /* If uip_slen > 0, the application has data to be sent. */
         if(uip_slen > 0) {
 
@@ -2140,7 +2635,14 @@ uip_process(uint8_t flag)
             uip_slen = uip_connr->len;
           }
         }
+#if UIP_TCP_SEND_WINDOW
+        /* Segments in flight keep their retransmission count */
+        if(TCP_WINDOW(uip_connr)->count == 0) {
+          uip_connr->nrtx = 0;
+        }
+#else /* UIP_TCP_SEND_WINDOW */
         uip_connr->nrtx = 0;
+#endif /* UIP_TCP_SEND_WINDOW */
       apprexmit:
         uip_appdata = uip_sappdata;
       
@@ -2163,6 +2665,19 @@ uip_process(uint8_t flag)
         }
       }
       goto drop;
+#if UIP_TCP_SEND_WINDOW
+    tcp_window_rexmit:
+      {
+        struct tcp_segment *seg;
+
+        seg = &TCP_WINDOW(uip_connr)->segments[TCP_WINDOW(uip_connr)->first];
+        memcpy(uip_sappdata, seg->data, seg->len);
+        uip_len = seg->len + UIP_TCPIP_HLEN;
+        UIP_TCP_BUF->flags = TCP_ACK | TCP_PSH;
+        tcp_segment_sent = seg;
+        goto tcp_send_noopts;
+      }
+#endif /* UIP_TCP_SEND_WINDOW */
     case UIP_LAST_ACK:
       /* We can close this connection if the peer has acknowledged our
          FIN. This is indicated by the UIP_ACKDATA flag. */
@@ -2253,10 +2768,20 @@ uip_process(uint8_t flag)
   UIP_TCP_BUF->ackno[2] = uip_connr->rcv_nxt[2];
   UIP_TCP_BUF->ackno[3] = uip_connr->rcv_nxt[3];
   
-  UIP_TCP_BUF->seqno[0] = uip_connr->snd_nxt[0];
-  UIP_TCP_BUF->seqno[1] = uip_connr->snd_nxt[1];
-  UIP_TCP_BUF->seqno[2] = uip_connr->snd_nxt[2];
-  UIP_TCP_BUF->seqno[3] = uip_connr->snd_nxt[3];
+#if UIP_TCP_SEND_WINDOW
+  if(tcp_seq_offset > 0) {
+    /* A new segment behind those already in flight */
+    uip_add32(uip_connr->snd_nxt, tcp_seq_offset);
+    memcpy(UIP_TCP_BUF->seqno, uip_acc32, sizeof(UIP_TCP_BUF->seqno));
+    tcp_seq_offset = 0;
+  } else
+#endif /* UIP_TCP_SEND_WINDOW */
+  {
+    UIP_TCP_BUF->seqno[0] = uip_connr->snd_nxt[0];
+    UIP_TCP_BUF->seqno[1] = uip_connr->snd_nxt[1];
+    UIP_TCP_BUF->seqno[2] = uip_connr->snd_nxt[2];
+    UIP_TCP_BUF->seqno[3] = uip_connr->snd_nxt[3];
+  }
 
   UIP_TCP_BUF->srcport  = uip_connr->lport;
   UIP_TCP_BUF->destport = uip_connr->rport;
@@ -2289,7 +2814,16 @@ uip_process(uint8_t flag)
   
   /* Calculate TCP checksum. */
   UIP_TCP_BUF->tcpchksum = 0;
+#if UIP_TCP_SEND_WINDOW
+  if(tcp_segment_sent != NULL) {
+    UIP_TCP_BUF->tcpchksum = ~(tcp_window_chksum(tcp_segment_sent));
+    tcp_segment_sent = NULL;
+  } else {
+    UIP_TCP_BUF->tcpchksum = ~(uip_tcpchksum());
+  }
+#else /* UIP_TCP_SEND_WINDOW */
   UIP_TCP_BUF->tcpchksum = ~(uip_tcpchksum());
+#endif /* UIP_TCP_SEND_WINDOW */
   UIP_STAT(++uip_stat.tcp.sent);
 
 #endif /* UIP_TCP */
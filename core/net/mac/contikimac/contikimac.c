@@ -807,7 +807,7 @@ qsend_list(mac_callback_t sent, void *ptr, struct rdc_buf_list *buf_list)
   curr = buf_list;
   do {
     next = list_item_next(curr);
-    queuebuf_to_packetbuf(curr->buf);
+    queuebuf_attach_to_packetbuf(curr->buf);
     if(!packetbuf_attr(PACKETBUF_ATTR_IS_CREATED_AND_SECURED)) {
       /* create and secure this frame */
       if(next != NULL) {
@@ -833,7 +833,7 @@ qsend_list(mac_callback_t sent, void *ptr, struct rdc_buf_list *buf_list)
     next = list_item_next(curr);
 
     /* Prepare the packetbuf */
-    queuebuf_to_packetbuf(curr->buf);
+    queuebuf_attach_to_packetbuf(curr->buf);
     
     /* Send the current packet */
     ret = send_packet(sent, ptr, curr, is_receiver_awake);
@@ -79,6 +79,30 @@
 #endif /* CSMA_CONF_MAX_MAC_TRANSMISSIONS */
 #endif /* CSMA_MAX_MAC_TRANSMISSIONS */
 
+/* CSMA_FAIR_QUEUEING replaces the independent transmission timers
+   of the neighbor queues by a deficit round robin scheduler, and
+   limits each neighbor to its share of the packet pool. */
+#ifdef CSMA_CONF_FAIR_QUEUEING
+#define CSMA_FAIR_QUEUEING CSMA_CONF_FAIR_QUEUEING
+#else
+#define CSMA_FAIR_QUEUEING 0
+#endif /* CSMA_CONF_FAIR_QUEUEING */
+
+/* The number of bytes a neighbor may send per round of the scheduler */
+#ifdef CSMA_CONF_DRR_QUANTUM
+#define CSMA_DRR_QUANTUM CSMA_CONF_DRR_QUANTUM
+#else
+#define CSMA_DRR_QUANTUM PACKETBUF_SIZE
+#endif /* CSMA_CONF_DRR_QUANTUM */
+
+/* CSMA_ADAPTIVE_BACKOFF raises the backoff exponent of retransmissions
+   with the collision rate observed on the channel. */
+#ifdef CSMA_CONF_ADAPTIVE_BACKOFF
+#define CSMA_ADAPTIVE_BACKOFF CSMA_CONF_ADAPTIVE_BACKOFF
+#else
+#define CSMA_ADAPTIVE_BACKOFF 0
+#endif /* CSMA_CONF_ADAPTIVE_BACKOFF */
+
 #if CSMA_MAX_MAC_TRANSMISSIONS < 1
 #error CSMA_CONF_MAX_MAC_TRANSMISSIONS must be at least 1.
 #error Change CSMA_CONF_MAX_MAC_TRANSMISSIONS in contiki-conf.h or in your Makefile.
@@ -98,6 +122,12 @@ struct neighbor_queue {
   struct ctimer transmit_timer;
   uint8_t transmissions;
   uint8_t collisions, deferrals;
+#if CSMA_FAIR_QUEUEING
+  /* Set when the backoff has elapsed and the head packet may be sent */
+  uint8_t ready;
+  /* Bytes the neighbor may still send in the current round */
+  int16_t deficit;
+#endif /* CSMA_FAIR_QUEUEING */
   LIST_STRUCT(queued_packet_list);
 };
 
@@ -124,6 +154,19 @@ LIST(neighbor_list);
 static void packet_sent(void *ptr, int status, int num_transmissions);
 static void transmit_packet_list(void *ptr);
 
+static struct csma_stats stats;
+
+#if CSMA_FAIR_QUEUEING
+/* The neighbor whose turn it is in the round robin */
+static struct neighbor_queue *drr_current;
+static struct ctimer drr_timer;
+#endif /* CSMA_FAIR_QUEUEING */
+
+#if CSMA_ADAPTIVE_BACKOFF
+/* Moving average of the share of transmissions that collided, 0-255 */
+static uint8_t collision_rate;
+#endif /* CSMA_ADAPTIVE_BACKOFF */
+
 /*---------------------------------------------------------------------------*/
 static struct neighbor_queue *
 neighbor_queue_from_addr(const linkaddr_t *addr)
@@ -156,9 +199,92 @@ default_timebase(void)
 }
 /*---------------------------------------------------------------------------*/
 static void
+free_neighbor(struct neighbor_queue *n)
+{
+#if CSMA_FAIR_QUEUEING
+  if(drr_current == n) {
+    drr_current = list_item_next(n);
+  }
+#endif /* CSMA_FAIR_QUEUEING */
+  ctimer_stop(&n->transmit_timer);
+  list_remove(neighbor_list, n);
+  memb_free(&neighbor_memb, n);
+  stats.neighbors--;
+}
+/*---------------------------------------------------------------------------*/
+#if CSMA_FAIR_QUEUEING
+/* Sends the head packet of the next ready neighbor in deficit round
+   robin order. Every time the scheduler passes a ready neighbor that
+   cannot afford its head packet, the neighbor is credited with
+   CSMA_DRR_QUANTUM bytes. */
+static void
+drr_schedule(void *ptr)
+{
+  struct neighbor_queue *n;
+  struct rdc_buf_list *q;
+  int visits;
+  int len;
+
+  n = drr_current;
+  visits = list_length(neighbor_list) *
+    (PACKETBUF_SIZE / CSMA_DRR_QUANTUM + 2);
+  for(; visits > 0; visits--) {
+    if(n == NULL) {
+      n = list_head(neighbor_list);
+      if(n == NULL) {
+        break;
+      }
+    }
+    q = list_head(n->queued_packet_list);
+    if(n->ready && q != NULL) {
+      len = queuebuf_datalen(q->buf);
+      if(n->deficit >= len) {
+        n->ready = 0;
+        n->deficit -= len;
+        drr_current = n;
+        PRINTF("csma: drr sending %d bytes, deficit %d\n", len, n->deficit);
+        NETSTACK_RDC.send_list(packet_sent, n, q);
+        /* Give other ready neighbors their turn */
+        ctimer_set(&drr_timer, 0, drr_schedule, NULL);
+        return;
+      }
+      n->deficit += CSMA_DRR_QUANTUM;
+    }
+    n = list_item_next(n);
+  }
+  drr_current = n;
+}
+/*---------------------------------------------------------------------------*/
+/* Each neighbor gets an equal share of the packet pool, counting
+   one more neighbor than there are queues so that a single busy
+   neighbor always leaves room for traffic to others. */
+static int
+neighbor_quota(void)
+{
+  int quota;
+
+  quota = MAX_QUEUED_PACKETS / (list_length(neighbor_list) + 1);
+  if(quota < 1) {
+    quota = 1;
+  }
+  if(quota > CSMA_MAX_PACKET_PER_NEIGHBOR) {
+    quota = CSMA_MAX_PACKET_PER_NEIGHBOR;
+  }
+  return quota;
+}
+#endif /* CSMA_FAIR_QUEUEING */
+/*---------------------------------------------------------------------------*/
+static void
 transmit_packet_list(void *ptr)
 {
   struct neighbor_queue *n = ptr;
+#if CSMA_FAIR_QUEUEING
+  if(n) {
+    /* The backoff has elapsed, let the scheduler decide when to send */
+    n->ready = 1;
+    drr_schedule(NULL);
+  }
+#else /* CSMA_FAIR_QUEUEING */
   if(n) {
     struct rdc_buf_list *q = list_head(n->queued_packet_list);
     if(q != NULL) {
@@ -168,6 +294,7 @@ transmit_packet_list(void *ptr)
       NETSTACK_RDC.send_list(packet_sent, n, q);
     }
   }
+#endif /* CSMA_FAIR_QUEUEING */
 }
 /*---------------------------------------------------------------------------*/
 static void
@@ -180,6 +307,7 @@ free_packet(struct neighbor_queue *n, struct rdc_buf_list *p)
     queuebuf_free(p->buf);
     memb_free(&metadata_memb, p->ptr);
     memb_free(&packet_memb, p);
+    stats.queued--;
     PRINTF("csma: free_queued_packet, queue length %d, free packets %d\n",
            list_length(n->queued_packet_list), memb_numfree(&packet_memb));
     if(list_head(n->queued_packet_list) != NULL) {
@@ -192,9 +320,7 @@ free_packet(struct neighbor_queue *n, struct rdc_buf_list *p)
                  transmit_packet_list, n);
     } else {
       /* This was the last packet in the queue, we free the neighbor */
-      ctimer_stop(&n->transmit_timer);
-      list_remove(neighbor_list, n);
-      memb_free(&neighbor_memb, n);
+      free_neighbor(n);
     }
   }
 }
@@ -220,14 +346,23 @@ packet_sent(void *ptr, int status, int num_transmissions)
   case MAC_TX_OK:
   case MAC_TX_NOACK:
     n->transmissions += num_transmissions;
+    stats.transmissions += num_transmissions;
     break;
   case MAC_TX_COLLISION:
     n->collisions += num_transmissions;
+    stats.collisions += num_transmissions;
     break;
   case MAC_TX_DEFERRED:
     n->deferrals += num_transmissions;
     break;
   }
+#if CSMA_ADAPTIVE_BACKOFF
+  if(status == MAC_TX_COLLISION) {
+    collision_rate += (255 - collision_rate) >> 3;
+  } else if(status == MAC_TX_OK || status == MAC_TX_NOACK) {
+    collision_rate -= collision_rate >> 3;
+  }
+#endif /* CSMA_ADAPTIVE_BACKOFF */
 
   /* Find out what packet this callback refers to */
   for(q = list_head(n->queued_packet_list);
@@ -270,6 +405,10 @@ packet_sent(void *ptr, int status, int num_transmissions)
          * so that the interval between the transmissions increase with
          * each retransmit. */
         backoff_exponent = num_tx;
+#if CSMA_ADAPTIVE_BACKOFF
+        /* Back off further while the channel is congested */
+        backoff_exponent += (collision_rate * (CSMA_MAX_BACKOFF_EXPONENT + 1)) >> 8;
+#endif /* CSMA_ADAPTIVE_BACKOFF */
 
         /* Truncate the exponent if needed. */
         if(backoff_exponent > CSMA_MAX_BACKOFF_EXPONENT) {
@@ -293,6 +432,7 @@ packet_sent(void *ptr, int status, int num_transmissions)
         } else {
           PRINTF("csma: drop with status %d after %d transmissions, %d collisions\n",
                  status, n->transmissions, n->collisions);
+          stats.drops_transmissions++;
           free_packet(n, q);
           mac_call_sent_callback(sent, cptr, status, num_tx);
         }
@@ -346,16 +486,25 @@ send_packet(mac_callback_t sent, void *ptr)
       n->transmissions = 0;
       n->collisions = 0;
       n->deferrals = 0;
+#if CSMA_FAIR_QUEUEING
+      n->ready = 0;
+      n->deficit = 0;
+#endif /* CSMA_FAIR_QUEUEING */
       /* Init packet list for this neighbor */
       LIST_STRUCT_INIT(n, queued_packet_list);
       /* Add neighbor to the list */
       list_add(neighbor_list, n);
+      stats.neighbors++;
     }
   }
 
   if(n != NULL) {
     /* Add packet to the neighbor's queue */
+#if CSMA_FAIR_QUEUEING
+    if(list_length(n->queued_packet_list) < neighbor_quota()) {
+#else /* CSMA_FAIR_QUEUEING */
     if(list_length(n->queued_packet_list) < CSMA_MAX_PACKET_PER_NEIGHBOR) {
+#endif /* CSMA_FAIR_QUEUEING */
       q = memb_alloc(&packet_memb);
       if(q != NULL) {
         q->ptr = memb_alloc(&metadata_memb);
@@ -381,6 +530,11 @@ send_packet(mac_callback_t sent, void *ptr)
               list_add(n->queued_packet_list, q);
             }
 
+            stats.queued++;
+            if(stats.queued > stats.max_queued) {
+              stats.max_queued = stats.queued;
+            }
+
             PRINTF("csma: send_packet, queue length %d, free packets %d\n",
                    list_length(n->queued_packet_list), memb_numfree(&packet_memb));
             /* If q is the first packet in the neighbor's queue, send asap */
@@ -397,15 +551,17 @@ send_packet(mac_callback_t sent, void *ptr)
       }
       /* The packet allocation failed. Remove and free neighbor entry if empty. */
       if(list_length(n->queued_packet_list) == 0) {
-        list_remove(neighbor_list, n);
-        memb_free(&neighbor_memb, n);
+        free_neighbor(n);
       }
+      stats.drops_no_buffer++;
     } else {
       PRINTF("csma: Neighbor queue full\n");
+      stats.drops_queue_full++;
     }
     PRINTF("csma: could not allocate packet, dropping packet\n");
   } else {
     PRINTF("csma: could not allocate neighbor, dropping packet\n");
+    stats.drops_no_buffer++;
   }
   mac_call_sent_callback(sent, ptr, MAC_TX_ERR, 1);
 }
@@ -437,6 +593,23 @@ channel_check_interval(void)
   return 0;
 }
 /*---------------------------------------------------------------------------*/
+void
+csma_get_stats(struct csma_stats *s)
+{
+  memcpy(s, &stats, sizeof(stats));
+#if CSMA_ADAPTIVE_BACKOFF
+  s->collision_rate = collision_rate;
+#endif /* CSMA_ADAPTIVE_BACKOFF */
+}
+/*---------------------------------------------------------------------------*/
+int
+csma_queue_length(const linkaddr_t *addr)
+{
+  struct neighbor_queue *n = neighbor_queue_from_addr(addr);
+
+  return n == NULL ? 0 : list_length(n->queued_packet_list);
+}
+/*---------------------------------------------------------------------------*/
 static void
 init(void)
 {
@@ -41,9 +41,43 @@
 #ifndef CSMA_H_
 #define CSMA_H_
 
+#include "net/linkaddr.h"
 #include "net/mac/mac.h"
 #include "dev/radio.h"
 
+/**
+ * Queue and drop statistics of the CSMA layer.
+ */
+struct csma_stats {
+  /** Packets currently queued */
+  uint16_t queued;
+  /** Highest number of packets queued at the same time */
+  uint16_t max_queued;
+  /** Neighbors that currently have a queue */
+  uint16_t neighbors;
+  /** Packets dropped because the neighbor's queue was full */
+  uint16_t drops_queue_full;
+  /** Packets dropped because no buffer or neighbor queue was free */
+  uint16_t drops_no_buffer;
+  /** Packets dropped after the maximum number of transmissions */
+  uint16_t drops_transmissions;
+  /** Transmissions reported by the RDC layer */
+  uint16_t transmissions;
+  /** Collisions reported by the RDC layer */
+  uint16_t collisions;
+  /** Moving average of the collision rate, 0-255, when
+      CSMA_CONF_ADAPTIVE_BACKOFF is set */
+  uint8_t collision_rate;
+};
+
+void csma_get_stats(struct csma_stats *stats);
+
+/**
+ * \brief      Get the number of packets queued for a neighbor
+ * \param addr The link-layer address of the neighbor
+ */
+int csma_queue_length(const linkaddr_t *addr);
+
 extern const struct mac_driver csma_driver;
 
 const struct mac_driver *csma_init(const struct mac_driver *r);
@@ -62,6 +62,18 @@ static unsigned num_tables;
 MEMB(neighbor_addr_mem, nbr_table_key_t, NBR_TABLE_MAX_NEIGHBORS);
 LIST(nbr_table_keys);
 
+#if NBR_TABLE_HASH
+/* Hash index over the link-layer addresses of the keys. A slot holds
+ * the index of a key plus one, or zero if the slot is empty. Collisions
+ * are resolved with linear probing. */
+#if NBR_TABLE_MAX_NEIGHBORS < 255
+typedef uint8_t nbr_table_hash_slot_t;
+#else
+typedef uint16_t nbr_table_hash_slot_t;
+#endif
+static nbr_table_hash_slot_t hash_slots[NBR_TABLE_HASH_SIZE];
+#endif /* NBR_TABLE_HASH */
+
 /*---------------------------------------------------------------------------*/
 /* Get a key from a neighbor index */
 static nbr_table_key_t *
@@ -104,17 +116,84 @@ key_from_item(nbr_table_t *table, const nbr_table_item_t *item)
 {
   return key_from_index(index_from_item(table, item));
 }
+#if NBR_TABLE_HASH
+/*---------------------------------------------------------------------------*/
+/* Get the home slot of a link-layer address */
+static unsigned
+hash_home(const linkaddr_t *lladdr)
+{
+  unsigned h;
+  int i;
+
+  h = 0;
+  for(i = 0; i < LINKADDR_SIZE; i++) {
+    h = h * 31 + lladdr->u8[i];
+  }
+  return h % NBR_TABLE_HASH_SIZE;
+}
+/*---------------------------------------------------------------------------*/
+static void
+hash_add(nbr_table_key_t *key)
+{
+  unsigned i;
+
+  for(i = hash_home(&key->lladdr); hash_slots[i] != 0;
+      i = (i + 1) % NBR_TABLE_HASH_SIZE);
+  hash_slots[i] = index_from_key(key) + 1;
+}
+/*---------------------------------------------------------------------------*/
+static void
+hash_remove(nbr_table_key_t *key)
+{
+  unsigned i, j, home;
+
+  for(i = hash_home(&key->lladdr); hash_slots[i] != 0;
+      i = (i + 1) % NBR_TABLE_HASH_SIZE) {
+    if(hash_slots[i] == index_from_key(key) + 1) {
+      break;
+    }
+  }
+  if(hash_slots[i] == 0) {
+    return;
+  }
+
+  /* Shift back the following entries of the probe sequence that
+     would no longer be reachable once slot i is empty. */
+  for(j = (i + 1) % NBR_TABLE_HASH_SIZE; hash_slots[j] != 0;
+      j = (j + 1) % NBR_TABLE_HASH_SIZE) {
+    home = hash_home(&key_from_index(hash_slots[j] - 1)->lladdr);
+    if((j > i && (home <= i || home > j)) ||
+       (j < i && (home <= i && home > j))) {
+      hash_slots[i] = hash_slots[j];
+      i = j;
+    }
+  }
+  hash_slots[i] = 0;
+}
+#endif /* NBR_TABLE_HASH */
 /*---------------------------------------------------------------------------*/
 /* Get the index of a neighbor from its link-layer address */
 static int
 index_from_lladdr(const linkaddr_t *lladdr)
 {
   nbr_table_key_t *key;
+#if NBR_TABLE_HASH
+  unsigned i;
+#endif /* NBR_TABLE_HASH */
   /* Allow lladdr-free insertion, useful e.g. for IPv6 ND.
    * Only one such entry is possible at a time, indexed by linkaddr_null. */
   if(lladdr == NULL) {
     lladdr = &linkaddr_null;
   }
+#if NBR_TABLE_HASH
+  for(i = hash_home(lladdr); hash_slots[i] != 0;
+      i = (i + 1) % NBR_TABLE_HASH_SIZE) {
+    key = key_from_index(hash_slots[i] - 1);
+    if(linkaddr_cmp(lladdr, &key->lladdr)) {
+      return index_from_key(key);
+    }
+  }
+#else /* NBR_TABLE_HASH */
   key = list_head(nbr_table_keys);
   while(key != NULL) {
     if(lladdr && linkaddr_cmp(lladdr, &key->lladdr)) {
@@ -122,6 +201,7 @@ index_from_lladdr(const linkaddr_t *lladdr)
     }
     key = list_item_next(key);
   }
+#endif /* NBR_TABLE_HASH */
   return -1;
 }
 /*---------------------------------------------------------------------------*/
@@ -218,6 +298,9 @@ nbr_table_allocate(void)
       used_map[index_from_key(least_used_key)] = 0;
       /* Remove neighbor from list */
       list_remove(nbr_table_keys, least_used_key);
+#if NBR_TABLE_HASH
+      hash_remove(least_used_key);
+#endif /* NBR_TABLE_HASH */
       /* Return associated key */
       return least_used_key;
     }
@@ -298,6 +381,9 @@ nbr_table_add_lladdr(nbr_table_t *table, const linkaddr_t *lladdr)
 
     /* Set link-layer address */
     linkaddr_copy(&key->lladdr, lladdr);
+#if NBR_TABLE_HASH
+    hash_add(key);
+#endif /* NBR_TABLE_HASH */
   }
 
   /* Get item in the current table */
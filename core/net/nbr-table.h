@@ -46,6 +46,29 @@
 #define NBR_TABLE_MAX_NEIGHBORS 8
 #endif /* NBR_TABLE_CONF_MAX_NEIGHBORS */
 
+/* With NBR_TABLE_CONF_HASH, link-layer addresses are also indexed by an
+ * open-addressing hash table of NBR_TABLE_HASH_SIZE slots, so that
+ * looking up a neighbor does not require scanning all keys. Each slot
+ * costs one or two bytes of RAM. */
+#ifdef NBR_TABLE_CONF_HASH
+#define NBR_TABLE_HASH NBR_TABLE_CONF_HASH
+#else /* NBR_TABLE_CONF_HASH */
+#define NBR_TABLE_HASH 0
+#endif /* NBR_TABLE_CONF_HASH */
+
+/* Must be larger than NBR_TABLE_MAX_NEIGHBORS */
+#ifdef NBR_TABLE_CONF_HASH_SIZE
+#define NBR_TABLE_HASH_SIZE NBR_TABLE_CONF_HASH_SIZE
+#else /* NBR_TABLE_CONF_HASH_SIZE */
+#define NBR_TABLE_HASH_SIZE (2 * NBR_TABLE_MAX_NEIGHBORS)
+#endif /* NBR_TABLE_CONF_HASH_SIZE */
+
+/* A lookup probes until it finds an empty slot, so there must always
+   be one */
+#if NBR_TABLE_HASH && NBR_TABLE_HASH_SIZE <= NBR_TABLE_MAX_NEIGHBORS
+#error "NBR_TABLE_CONF_HASH_SIZE must be larger than NBR_TABLE_CONF_MAX_NEIGHBORS"
+#endif /* NBR_TABLE_HASH && NBR_TABLE_HASH_SIZE <= NBR_TABLE_MAX_NEIGHBORS */
+
 /* An item in a neighbor table */
 typedef void nbr_table_item_t;
 
@@ -60,6 +60,8 @@ static uint8_t hdrptr;
    msp430 or OpenRISC), having a potentially misaligned packet buffer may lead to
    problems when accessing words. */
 static uint32_t packetbuf_aligned[(PACKETBUF_SIZE + PACKETBUF_HDR_SIZE + 3) / 4];
+/* Points to packetbuf_aligned, or to an external buffer given to
+   packetbuf_attach(). */
 static uint8_t *packetbuf = (uint8_t *)packetbuf_aligned;
 
 static uint8_t *packetbufptr;
@@ -79,6 +81,7 @@ packetbuf_clear(void)
   buflen = bufptr = 0;
   hdrptr = PACKETBUF_HDR_SIZE;
 
+  packetbuf = (uint8_t *)packetbuf_aligned;
   packetbufptr = &packetbuf[PACKETBUF_HDR_SIZE];
   packetbuf_attr_clear();
 }
@@ -235,6 +238,25 @@ packetbuf_reference_ptr(void)
   return packetbufptr;
 }
 /*---------------------------------------------------------------------------*/
+void
+packetbuf_attach(void *buf, uint8_t hdrlen, uint16_t len)
+{
+  packetbuf_clear();
+  packetbuf = buf;
+  packetbufptr = &packetbuf[PACKETBUF_HDR_SIZE];
+  hdrptr = PACKETBUF_HDR_SIZE - hdrlen;
+  buflen = len;
+}
+/*---------------------------------------------------------------------------*/
+void *
+packetbuf_attached_buf(void)
+{
+  if(packetbuf == (uint8_t *)packetbuf_aligned) {
+    return NULL;
+  }
+  return packetbuf;
+}
+/*---------------------------------------------------------------------------*/
 uint16_t
 packetbuf_datalen(void)
 {
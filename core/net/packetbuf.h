@@ -219,6 +219,34 @@ int packetbuf_is_reference(void);
  */
 void *packetbuf_reference_ptr(void);
 
+/**
+ * \brief        Let the packetbuf use an external buffer in place
+ * \param buf    A buffer of PACKETBUF_HDR_SIZE + PACKETBUF_SIZE bytes
+ * \param hdrlen The length of the header already in the buffer
+ * \param len    The length of the data in the buffer
+ *
+ *               Unlike packetbuf_reference(), which only replaces the
+ *               data part, this function makes the packetbuf work
+ *               directly on an external buffer laid out like the
+ *               packetbuf itself: header space first, data starting
+ *               at offset PACKETBUF_HDR_SIZE. Headers are allocated
+ *               in the external buffer, so the frame can be sent
+ *               without being copied. A header of hdrlen bytes
+ *               that directly precedes the data is kept.
+ *
+ *               The packetbuf goes back to its own buffer at the
+ *               next call to packetbuf_clear(). The external buffer
+ *               must stay valid until then.
+ */
+void packetbuf_attach(void *buf, uint8_t hdrlen, uint16_t len);
+
+/**
+ * \brief      Get the external buffer the packetbuf is attached to
+ * \retval     The buffer passed to packetbuf_attach(), or NULL if the
+ *             packetbuf uses its own buffer.
+ */
+void *packetbuf_attached_buf(void);
+
 /**
  * \brief      Compact the packetbuf
  *
@@ -77,12 +77,30 @@ struct queuebuf {
 
 /* The actual queuebuf data */
 struct queuebuf_data {
+#if QUEUEBUF_ZERO_COPY
+  /* Header space followed by the data, laid out and aligned like the
+     packetbuf so that the packetbuf can be attached to it */
+  uint32_t frame[(PACKETBUF_HDR_SIZE + PACKETBUF_SIZE + 3) / 4];
+  /* Length of the header built in place in front of the data */
+  uint8_t hdrlen;
+  /* References from the queuebuf and from the attached packetbuf */
+  uint8_t refs;
+#else /* QUEUEBUF_ZERO_COPY */
   uint8_t data[PACKETBUF_SIZE];
+#endif /* QUEUEBUF_ZERO_COPY */
   uint16_t len;
   struct packetbuf_attr attrs[PACKETBUF_NUM_ATTRS];
   struct packetbuf_addr addrs[PACKETBUF_NUM_ADDRS];
 };
 
+#if QUEUEBUF_ZERO_COPY
+#define QUEUEBUF_DATA(d) ((uint8_t *)(d)->frame + PACKETBUF_HDR_SIZE)
+#define QUEUEBUF_HDRLEN(d) ((d)->hdrlen)
+#else /* QUEUEBUF_ZERO_COPY */
+#define QUEUEBUF_DATA(d) ((d)->data)
+#define QUEUEBUF_HDRLEN(d) 0
+#endif /* QUEUEBUF_ZERO_COPY */
+
 struct queuebuf_ref {
   uint16_t len;
   uint8_t *ref;
@@ -147,6 +165,31 @@ LIST(queuebuf_list);
 uint8_t queuebuf_len, queuebuf_ref_len, queuebuf_max_len;
 #endif /* QUEUEBUF_STATS */
 
+struct queuebuf_copy_stats queuebuf_copy_stats;
+
+#if QUEUEBUF_ZERO_COPY
+/* The queuebuf data the packetbuf was last attached to. It holds a
+   reference that is dropped once the packetbuf has let go of it. */
+static struct queuebuf_data *attached;
+/*---------------------------------------------------------------------------*/
+static void
+release_data(struct queuebuf_data *d)
+{
+  if(--d->refs == 0) {
+    memb_free(&buframmem, d);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+release_attached(void)
+{
+  if(attached != NULL && packetbuf_attached_buf() != attached->frame) {
+    release_data(attached);
+    attached = NULL;
+  }
+}
+#endif /* QUEUEBUF_ZERO_COPY */
+
 #if WITH_SWAP
 /*---------------------------------------------------------------------------*/
 static void
@@ -310,6 +353,9 @@ queuebuf_init(void)
 int
 queuebuf_numfree(void)
 {
+#if QUEUEBUF_ZERO_COPY
+  release_attached();
+#endif /* QUEUEBUF_ZERO_COPY */
   if(packetbuf_is_reference()) {
     return memb_numfree(&refbufmem);
   } else {
@@ -337,12 +383,16 @@ queuebuf_new_from_packetbuf(void)
       rbuf->len = packetbuf_datalen();
       rbuf->ref = packetbuf_reference_ptr();
       rbuf->hdrlen = packetbuf_copyto_hdr(rbuf->hdr);
+      queuebuf_copy_stats.bytes_in += rbuf->hdrlen;
     } else {
       PRINTF("queuebuf_new_from_packetbuf: could not allocate a reference queuebuf\n");
     }
     return (struct queuebuf *)rbuf;
   } else {
     struct queuebuf_data *buframptr;
+#if QUEUEBUF_ZERO_COPY
+    release_attached();
+#endif /* QUEUEBUF_ZERO_COPY */
     buf = memb_alloc(&bufmem);
     if(buf != NULL) {
 #if QUEUEBUF_DEBUG
@@ -372,8 +422,13 @@ queuebuf_new_from_packetbuf(void)
       buframptr = buf->ram_ptr;
 #endif
 
-      buframptr->len = packetbuf_copyto(buframptr->data);
+      buframptr->len = packetbuf_copyto(QUEUEBUF_DATA(buframptr));
       packetbuf_attr_copyto(buframptr->attrs, buframptr->addrs);
+      queuebuf_copy_stats.bytes_in += buframptr->len;
+#if QUEUEBUF_ZERO_COPY
+      buframptr->hdrlen = 0;
+      buframptr->refs = 1;
+#endif /* QUEUEBUF_ZERO_COPY */
 
 #if WITH_SWAP
       if(buf->location == IN_CFS) {
@@ -420,7 +475,17 @@ queuebuf_update_from_packetbuf(struct queuebuf *buf)
 {
   struct queuebuf_data *buframptr = queuebuf_load_to_ram(buf);
   packetbuf_attr_copyto(buframptr->attrs, buframptr->addrs);
-  buframptr->len = packetbuf_copyto(buframptr->data);
+#if QUEUEBUF_ZERO_COPY
+  if(packetbuf_attached_buf() == buframptr->frame) {
+    /* The frame was built in place, only its extent has changed */
+    buframptr->hdrlen = packetbuf_hdrlen();
+    buframptr->len = packetbuf_datalen();
+    return;
+  }
+  buframptr->hdrlen = 0;
+#endif /* QUEUEBUF_ZERO_COPY */
+  buframptr->len = packetbuf_copyto(QUEUEBUF_DATA(buframptr));
+  queuebuf_copy_stats.bytes_in += buframptr->len;
 #if WITH_SWAP
   if(buf->location == IN_CFS) {
     queuebuf_flush_tmpdata();
@@ -438,6 +503,8 @@ queuebuf_free(struct queuebuf *buf)
     } else {
       queuebuf_remove_from_file(buf->swap_id);
     }
+#elif QUEUEBUF_ZERO_COPY
+    release_data(buf->ram_ptr);
 #else
     memb_free(&buframmem, buf->ram_ptr);
 #endif
@@ -463,15 +530,58 @@ queuebuf_to_packetbuf(struct queuebuf *b)
   struct queuebuf_ref *r;
   if(memb_inmemb(&bufmem, b)) {
     struct queuebuf_data *buframptr = queuebuf_load_to_ram(b);
-    packetbuf_copyfrom(buframptr->data, buframptr->len);
+    packetbuf_copyfrom(QUEUEBUF_DATA(buframptr) - QUEUEBUF_HDRLEN(buframptr),
+                       QUEUEBUF_HDRLEN(buframptr) + buframptr->len);
     packetbuf_attr_copyfrom(buframptr->attrs, buframptr->addrs);
+    queuebuf_copy_stats.bytes_out += QUEUEBUF_HDRLEN(buframptr) + buframptr->len;
+    ++queuebuf_copy_stats.frames;
   } else if(memb_inmemb(&refbufmem, b)) {
     r = (struct queuebuf_ref *)b;
     packetbuf_clear();
     packetbuf_copyfrom(r->ref, r->len);
     packetbuf_hdralloc(r->hdrlen);
     memcpy(packetbuf_hdrptr(), r->hdr, r->hdrlen);
+    queuebuf_copy_stats.bytes_out += r->len + r->hdrlen;
+    ++queuebuf_copy_stats.frames;
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Used by MAC and RDC layers that load a queued frame only to send
+   it: with QUEUEBUF_ZERO_COPY, the packetbuf is attached to the
+   queuebuf instead of receiving a copy of it. The packetbuf must not
+   be written to before the next packetbuf_clear(), other than by
+   the framer. */
+void
+queuebuf_attach_to_packetbuf(struct queuebuf *b)
+{
+#if QUEUEBUF_ZERO_COPY
+  struct queuebuf_data *buframptr;
+  struct queuebuf_data *previous;
+
+  if(memb_inmemb(&bufmem, b)) {
+    buframptr = queuebuf_load_to_ram(b);
+    /* A link-layer security driver may transform the data in place
+       when the frame is created, so a frame that is yet to be created
+       and secured must be created from a copy. */
+    if(buframptr->attrs[PACKETBUF_ATTR_IS_CREATED_AND_SECURED].val ||
+       NETSTACK_LLSEC.get_overhead() == 0) {
+      packetbuf_attach(buframptr->frame, buframptr->hdrlen, buframptr->len);
+      packetbuf_attr_copyfrom(buframptr->attrs, buframptr->addrs);
+      if(attached != buframptr) {
+        previous = attached;
+        attached = buframptr;
+        ++buframptr->refs;
+        if(previous != NULL) {
+          release_data(previous);
+        }
+      }
+      ++queuebuf_copy_stats.frames;
+      ++queuebuf_copy_stats.frames_attached;
+      return;
+    }
   }
+#endif /* QUEUEBUF_ZERO_COPY */
+  queuebuf_to_packetbuf(b);
 }
 /*---------------------------------------------------------------------------*/
 void *
@@ -481,7 +591,7 @@ queuebuf_dataptr(struct queuebuf *b)
 
   if(memb_inmemb(&bufmem, b)) {
     struct queuebuf_data *buframptr = queuebuf_load_to_ram(b);
-    return buframptr->data;
+    return QUEUEBUF_DATA(buframptr) - QUEUEBUF_HDRLEN(buframptr);
   } else if(memb_inmemb(&refbufmem, b)) {
     r = (struct queuebuf_ref *)b;
     return r->ref;
@@ -493,7 +603,7 @@ int
 queuebuf_datalen(struct queuebuf *b)
 {
   struct queuebuf_data *buframptr = queuebuf_load_to_ram(b);
-  return buframptr->len;
+  return QUEUEBUF_HDRLEN(buframptr) + buframptr->len;
 }
 /*---------------------------------------------------------------------------*/
 linkaddr_t *
@@ -79,6 +79,23 @@
   #define WITH_SWAP 0
 #endif /* QUEUEBUFRAM_CONF_NUM */
 
+/* QUEUEBUF_ZERO_COPY makes queuebuf_attach_to_packetbuf() let the
+   packetbuf work directly on the queuebuf storage instead of copying
+   the frame. The storage then carries header space, and the link
+   layer header is built in place. A frame that has been created and
+   secured once, and stored back with queuebuf_update_from_packetbuf(),
+   is sent again without any copy. Zero copy cannot be combined with
+   swapping. */
+#ifdef QUEUEBUF_CONF_ZERO_COPY
+#define QUEUEBUF_ZERO_COPY QUEUEBUF_CONF_ZERO_COPY
+#else /* QUEUEBUF_CONF_ZERO_COPY */
+#define QUEUEBUF_ZERO_COPY 0
+#endif /* QUEUEBUF_CONF_ZERO_COPY */
+
+#if QUEUEBUF_ZERO_COPY && WITH_SWAP
+#error "QUEUEBUF_CONF_ZERO_COPY cannot be used with QUEUEBUFRAM_CONF_NUM < QUEUEBUF_NUM"
+#endif
+
 #ifdef QUEUEBUF_CONF_DEBUG
 #define QUEUEBUF_DEBUG QUEUEBUF_CONF_DEBUG
 #else /* QUEUEBUF_CONF_DEBUG */
@@ -99,6 +116,7 @@ void queuebuf_update_attr_from_packetbuf(struct queuebuf *b);
 void queuebuf_update_from_packetbuf(struct queuebuf *b);
 
 void queuebuf_to_packetbuf(struct queuebuf *b);
+void queuebuf_attach_to_packetbuf(struct queuebuf *b);
 void queuebuf_free(struct queuebuf *b);
 
 void *queuebuf_dataptr(struct queuebuf *b);
@@ -111,6 +129,24 @@ void queuebuf_debug_print(void);
 
 int queuebuf_numfree(void);
 
+/**
+ * Counters of the bytes that queuebufs copy to and from the
+ * packetbuf. Dividing the total by the number of frames loaded into
+ * the packetbuf gives the bytes copied per transmitted frame.
+ */
+struct queuebuf_copy_stats {
+  /** Bytes copied from the packetbuf into queuebufs */
+  unsigned long bytes_in;
+  /** Bytes copied from queuebufs into the packetbuf */
+  unsigned long bytes_out;
+  /** Frames loaded into the packetbuf from a queuebuf */
+  unsigned long frames;
+  /** Frames of which the packetbuf used the queuebuf in place */
+  unsigned long frames_attached;
+};
+
+extern struct queuebuf_copy_stats queuebuf_copy_stats;
+
 #endif /* __QUEUEBUF_H__ */
 
 /** @} */
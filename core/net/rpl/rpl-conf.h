@@ -70,6 +70,19 @@
 #define RPL_OF rpl_mrhof
 #endif /* RPL_CONF_OF */
 
+/*
+ * Set to 1 to keep the candidate parents of each DAG in a heap ordered
+ * by the path cost that the objective function computes when a parent
+ * changes. Selecting the preferred parent then takes at most one OF
+ * comparison instead of one per neighbor, at the cost of a pointer per
+ * neighbor and DAG.
+ */
+#ifdef RPL_CONF_PARENT_HEAP
+#define RPL_PARENT_HEAP RPL_CONF_PARENT_HEAP
+#else
+#define RPL_PARENT_HEAP 0
+#endif /* RPL_CONF_PARENT_HEAP */
+
 /* This value decides which DAG instance we should participate in by default. */
 #ifdef RPL_CONF_DEFAULT_INSTANCE
 #define RPL_DEFAULT_INSTANCE RPL_CONF_DEFAULT_INSTANCE
@@ -53,6 +53,7 @@
 #include "lib/list.h"
 #include "lib/memb.h"
 #include "sys/ctimer.h"
+#include "sys/rtimer.h"
 
 #include <limits.h>
 #include <string.h>
@@ -81,6 +82,21 @@ NBR_TABLE(rpl_parent_t, rpl_parents);
 rpl_instance_t instance_table[RPL_MAX_INSTANCES];
 rpl_instance_t *default_instance;
 
+/* Set when a parent is flagged RPL_PARENT_FLAG_UPDATED, so that
+   rpl_recalculate_ranks() only walks the parents when one has */
+static uint8_t parents_updated;
+
+#if RPL_CONF_STATS
+#define OF_EVAL(code) do {                            \
+    rtimer_clock_t of_start = RTIMER_NOW();           \
+    code;                                             \
+    rpl_stats.of_ticks += RTIMER_NOW() - of_start;    \
+    rpl_stats.of_evaluations++;                       \
+  } while(0)
+#else
+#define OF_EVAL(code) code
+#endif /* RPL_CONF_STATS */
+
 /*---------------------------------------------------------------------------*/
 uip_ds6_nbr_t *
 rpl_get_nbr(rpl_parent_t *parent)
@@ -106,6 +122,113 @@ rpl_dag_init(void)
   nbr_table_register(rpl_parents, (nbr_table_callback *)nbr_callback);
 }
 /*---------------------------------------------------------------------------*/
+#if RPL_PARENT_HEAP
+#if NBR_TABLE_MAX_NEIGHBORS > 255
+#error "RPL_PARENT_HEAP supports at most 255 neighbors"
+#endif
+
+/* Parents with an infinite rank go after all others */
+#define HEAP_KEY(p) \
+  (((uint32_t)((p)->rank == INFINITE_RANK) << 16) | (p)->path_cost)
+
+static int
+heap_contains(rpl_dag_t *dag, rpl_parent_t *p)
+{
+  return p->heap_index < dag->parent_count && dag->parents[p->heap_index] == p;
+}
+/*---------------------------------------------------------------------------*/
+static void
+heap_set(rpl_dag_t *dag, unsigned i, rpl_parent_t *p)
+{
+  dag->parents[i] = p;
+  p->heap_index = i;
+}
+/*---------------------------------------------------------------------------*/
+static void
+heap_sift_up(rpl_dag_t *dag, unsigned i)
+{
+  rpl_parent_t *p = dag->parents[i];
+  unsigned up;
+
+  while(i > 0) {
+    up = (i - 1) / 2;
+    if(HEAP_KEY(dag->parents[up]) <= HEAP_KEY(p)) {
+      break;
+    }
+    heap_set(dag, i, dag->parents[up]);
+    i = up;
+  }
+  heap_set(dag, i, p);
+}
+/*---------------------------------------------------------------------------*/
+static void
+heap_sift_down(rpl_dag_t *dag, unsigned i)
+{
+  rpl_parent_t *p = dag->parents[i];
+  unsigned down;
+
+  while((down = 2 * i + 1) < dag->parent_count) {
+    if(down + 1 < dag->parent_count &&
+       HEAP_KEY(dag->parents[down + 1]) < HEAP_KEY(dag->parents[down])) {
+      down++;
+    }
+    if(HEAP_KEY(p) <= HEAP_KEY(dag->parents[down])) {
+      break;
+    }
+    heap_set(dag, i, dag->parents[down]);
+    i = down;
+  }
+  heap_set(dag, i, p);
+}
+/*---------------------------------------------------------------------------*/
+static void
+heap_remove(rpl_parent_t *p)
+{
+  rpl_dag_t *dag = p->dag;
+  rpl_parent_t *last;
+
+  if(dag == NULL || !heap_contains(dag, p)) {
+    return;
+  }
+  last = dag->parents[--dag->parent_count];
+  if(last != p) {
+    heap_set(dag, p->heap_index, last);
+    heap_sift_down(dag, last->heap_index);
+    heap_sift_up(dag, last->heap_index);
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Asks the OF for the path cost of a parent and moves the parent to its
+   place in the heap of its DAG. */
+static void
+heap_update(rpl_parent_t *p)
+{
+  rpl_dag_t *dag = p->dag;
+
+  if(dag == NULL || dag->instance == NULL || dag->instance->of == NULL) {
+    /* The DAG is still being set up; rpl_join_instance() adds it */
+    return;
+  }
+  OF_EVAL(p->path_cost = dag->instance->of->parent_path_cost(p));
+  if(!heap_contains(dag, p)) {
+    heap_set(dag, dag->parent_count++, p);
+  }
+  heap_sift_up(dag, p->heap_index);
+  heap_sift_down(dag, p->heap_index);
+}
+#else /* RPL_PARENT_HEAP */
+#define heap_remove(p)
+#define heap_update(p)
+#endif /* RPL_PARENT_HEAP */
+/*---------------------------------------------------------------------------*/
+void
+rpl_parent_changed(rpl_parent_t *p)
+{
+  p->flags |= RPL_PARENT_FLAG_UPDATED;
+  parents_updated = 1;
+  heap_update(p);
+}
+/*---------------------------------------------------------------------------*/
 rpl_parent_t *
 rpl_get_parent(uip_lladdr_t *addr)
 {
@@ -598,6 +721,7 @@ rpl_add_parent(rpl_dag_t *dag, rpl_dio_t *dio, uip_ipaddr_t *addr)
 #if RPL_DAG_MC != RPL_DAG_MC_NONE
       memcpy(&p->mc, &dio->mc, sizeof(p->mc));
 #endif /* RPL_DAG_MC != RPL_DAG_MC_NONE */
+      heap_update(p);
     }
   }
 
@@ -736,6 +860,27 @@ rpl_select_dag(rpl_instance_t *instance, rpl_parent_t *p)
   return best_dag;
 }
 /*---------------------------------------------------------------------------*/
+#if RPL_PARENT_HEAP
+static rpl_parent_t *
+best_parent(rpl_dag_t *dag)
+{
+  rpl_parent_t *best;
+  rpl_parent_t *p;
+
+  if(dag->parent_count == 0 || dag->parents[0]->rank == INFINITE_RANK) {
+    return NULL;
+  }
+  best = dag->parents[0];
+
+  /* The OF may keep the preferred parent if it is nearly as good */
+  p = dag->preferred_parent;
+  if(p != NULL && p != best && p->dag == dag && p->rank != INFINITE_RANK) {
+    OF_EVAL(best = dag->instance->of->best_parent(best, p));
+  }
+
+  return best;
+}
+#else /* RPL_PARENT_HEAP */
 static rpl_parent_t *
 best_parent(rpl_dag_t *dag)
 {
@@ -750,13 +895,14 @@ best_parent(rpl_dag_t *dag)
     } else if(best == NULL) {
       best = p;
     } else {
-      best = dag->instance->of->best_parent(best, p);
+      OF_EVAL(best = dag->instance->of->best_parent(best, p));
     }
     p = nbr_table_next(rpl_parents, p);
   }
 
   return best;
 }
+#endif /* RPL_PARENT_HEAP */
 /*---------------------------------------------------------------------------*/
 rpl_parent_t *
 rpl_select_parent(rpl_dag_t *dag)
@@ -778,6 +924,7 @@ rpl_remove_parent(rpl_parent_t *parent)
   PRINTF("\n");
 
   rpl_nullify_parent(parent);
+  heap_remove(parent);
 
   nbr_table_remove(rpl_parents, parent);
 }
@@ -831,7 +978,9 @@ rpl_move_parent(rpl_dag_t *dag_src, rpl_dag_t *dag_dst, rpl_parent_t *parent)
   PRINT6ADDR(rpl_get_parent_ipaddr(parent));
   PRINTF("\n");
 
+  heap_remove(parent);
   parent->dag = dag_dst;
+  heap_update(parent);
 }
 /*---------------------------------------------------------------------------*/
 rpl_dag_t *
@@ -945,6 +1094,8 @@ rpl_join_instance(uip_ipaddr_t *from, rpl_dio_t *dio)
   /* Copy prefix information from the DIO into the DAG object. */
   memcpy(&dag->prefix_info, &dio->prefix_info, sizeof(rpl_prefix_t));
 
+  /* The OF is known now */
+  heap_update(p);
   rpl_set_preferred_parent(dag, p);
   instance->of->update_metric_container(instance);
   dag->rank = instance->of->calculate_rank(p, 0);
@@ -1123,6 +1274,11 @@ rpl_recalculate_ranks(void)
    * than RPL protocol messages. This periodical recalculation is called
    * from a timer in order to keep the stack depth reasonably low.
    */
+  if(!parents_updated) {
+    return;
+  }
+  parents_updated = 0;
+
   p = nbr_table_head(rpl_parents);
   while(p != NULL) {
     if(p->dag != NULL && p->dag->instance && (p->flags & RPL_PARENT_FLAG_UPDATED)) {
@@ -1333,6 +1489,7 @@ rpl_process_dio(uip_ipaddr_t *from, rpl_dio_t *dio)
 #if RPL_DAG_MC != RPL_DAG_MC_NONE
   memcpy(&p->mc, &dio->mc, sizeof(p->mc));
 #endif /* RPL_DAG_MC != RPL_DAG_MC_NONE */
+  heap_update(p);
   if(rpl_process_parent_event(instance, p) == 0) {
     PRINTF("RPL: The candidate parent is rejected\n");
     return;
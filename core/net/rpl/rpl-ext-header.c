@@ -48,6 +48,7 @@
 #include "net/ip/tcpip.h"
 #include "net/ipv6/uip-ds6.h"
 #include "net/rpl/rpl-private.h"
+#include "net/rpl/rpl-ns.h"
 #include "net/packetbuf.h"
 
 #define DEBUG DEBUG_NONE
@@ -64,6 +65,11 @@
 #define UIP_EXT_HDR_OPT_BUF       ((struct uip_ext_hdr_opt *)&uip_buf[uip_l2_l3_hdr_len + uip_ext_opt_offset])
 #define UIP_EXT_HDR_OPT_PADN_BUF  ((struct uip_ext_hdr_opt_padn *)&uip_buf[uip_l2_l3_hdr_len + uip_ext_opt_offset])
 #define UIP_EXT_HDR_OPT_RPL_BUF   ((struct uip_ext_hdr_opt_rpl *)&uip_buf[uip_l2_l3_hdr_len + uip_ext_opt_offset])
+#define UIP_RH_BUF                ((struct uip_routing_hdr *)&uip_buf[uip_l2_l3_hdr_len])
+
+/* RFC 6554 */
+#define RPL_RH_TYPE_SRH           3
+#define RPL_SRH_HDR_LEN           8
 /*---------------------------------------------------------------------------*/
 int
 rpl_verify_header(int uip_ext_opt_offset)
@@ -379,5 +385,244 @@ rpl_insert_header(void)
   }
 }
 /*---------------------------------------------------------------------------*/
+#if RPL_WITH_NON_STORING
+/* Offset of the source routing header from the IPv6 header, or 0 if the
+   packet has none */
+static unsigned
+srh_offset(void)
+{
+  struct uip_ext_hdr *hbh;
+
+  if(UIP_IP_BUF->proto == UIP_PROTO_ROUTING) {
+    return UIP_IPH_LEN;
+  }
+  if(UIP_IP_BUF->proto == UIP_PROTO_HBHO) {
+    hbh = (struct uip_ext_hdr *)&uip_buf[UIP_LLH_LEN + UIP_IPH_LEN];
+    if(hbh->next == UIP_PROTO_ROUTING) {
+      return UIP_IPH_LEN + (hbh->len << 3) + 8;
+    }
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static int
+common_prefix_len(const uip_ipaddr_t *a, const uip_ipaddr_t *b)
+{
+  int i;
+
+  /* At most 15 bytes can be elided */
+  for(i = 0; i < 15 && a->u8[i] == b->u8[i]; i++);
+  return i;
+}
+/*---------------------------------------------------------------------------*/
+static void
+set_link_local_nexthop(uip_ipaddr_t *nexthop, const uip_ipaddr_t *addr)
+{
+  uip_create_linklocal_prefix(nexthop);
+  memcpy(&nexthop->u8[8], &addr->u8[8], 8);
+}
+/*---------------------------------------------------------------------------*/
+static int
+insert_srh_header(rpl_dag_t *dag, uip_ipaddr_t *nexthop)
+{
+  rpl_ns_node_t *dest_node;
+  rpl_ns_node_t *node;
+  uip_ipaddr_t prev;
+  uip_ipaddr_t cur;
+  uint8_t *srh;
+  uint8_t *hop;
+  uint16_t payload_len;
+  int path_len;
+  int cmpri;
+  int cmpre;
+  int addr_len;
+  int srh_len;
+  int pad;
+  int c;
+  int i;
+
+  dest_node = rpl_ns_get_node(dag, &UIP_IP_BUF->destipaddr);
+  if(dest_node == NULL || dest_node->parent == NULL) {
+    return 0;
+  }
+
+  /* Walk up from the destination to the first hop below the root. The
+     elided bytes of an address are those it shares with the address
+     before it in the route, which is in the destination field when it
+     is processed. */
+  path_len = 0;
+  cmpri = 15;
+  cmpre = 15;
+  uip_ipaddr_copy(&cur, &UIP_IP_BUF->destipaddr);
+  for(node = dest_node; node->parent->parent != NULL; node = node->parent) {
+    rpl_ns_get_node_global_addr(&prev, node->parent);
+    c = common_prefix_len(&prev, &cur);
+    if(path_len == 0) {
+      cmpre = c;
+    } else if(c < cmpri) {
+      cmpri = c;
+    }
+    path_len++;
+    uip_ipaddr_copy(&cur, &prev);
+  }
+
+  if(path_len == 0) {
+    /* A child of the root */
+    set_link_local_nexthop(nexthop, &UIP_IP_BUF->destipaddr);
+    return 1;
+  }
+  if(path_len == 1) {
+    cmpri = cmpre;
+  }
+
+  addr_len = (path_len - 1) * (16 - cmpri) + (16 - cmpre);
+  srh_len = (RPL_SRH_HDR_LEN + addr_len + 7) & ~7;
+  pad = srh_len - RPL_SRH_HDR_LEN - addr_len;
+
+  /* The RPL option is not needed below the root */
+  rpl_remove_header();
+
+  if(uip_len + srh_len > UIP_BUFSIZE - UIP_LLH_LEN ||
+     uip_len + srh_len > UIP_LINK_MTU) {
+    PRINTF("RPL: Packet too long: impossible to add source routing header\n");
+    return -1;
+  }
+
+  PRINTF("RPL: Adding a source routing header of %d hops, CmprI %d, CmprE %d\n",
+         path_len + 1, cmpri, cmpre);
+
+  srh = &uip_buf[UIP_LLH_LEN + UIP_IPH_LEN];
+  memmove(srh + srh_len, srh, uip_len - UIP_IPH_LEN);
+  srh[0] = UIP_IP_BUF->proto;
+  srh[1] = (srh_len >> 3) - 1;
+  srh[2] = RPL_RH_TYPE_SRH;
+  srh[3] = path_len;
+  srh[4] = (cmpri << 4) | cmpre;
+  srh[5] = pad << 4;
+  srh[6] = 0;
+  srh[7] = 0;
+
+  /* Fill in the addresses from the last one, which is the destination */
+  hop = srh + RPL_SRH_HDR_LEN + (path_len - 1) * (16 - cmpri);
+  memcpy(hop, &UIP_IP_BUF->destipaddr.u8[cmpre], 16 - cmpre);
+  memset(hop + 16 - cmpre, 0, pad);
+  node = dest_node->parent;
+  for(i = path_len - 1; i > 0; i--) {
+    hop -= 16 - cmpri;
+    rpl_ns_get_node_global_addr(&cur, node);
+    memcpy(hop, &cur.u8[cmpri], 16 - cmpri);
+    node = node->parent;
+  }
+
+  /* The packet goes to the first hop */
+  rpl_ns_get_node_global_addr(&UIP_IP_BUF->destipaddr, node);
+  set_link_local_nexthop(nexthop, &UIP_IP_BUF->destipaddr);
+
+  UIP_IP_BUF->proto = UIP_PROTO_ROUTING;
+  payload_len = ((uint16_t)UIP_IP_BUF->len[0] << 8) + UIP_IP_BUF->len[1] + srh_len;
+  UIP_IP_BUF->len[0] = payload_len >> 8;
+  UIP_IP_BUF->len[1] = payload_len & 0xff;
+  uip_len += srh_len;
+  uip_ext_len = srh_len;
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+int
+rpl_srh_get_next_hop(uip_ipaddr_t *ipaddr)
+{
+  unsigned offset;
+  rpl_dag_t *dag;
+
+  offset = srh_offset();
+  if(offset != 0) {
+    if(uip_buf[UIP_LLH_LEN + offset + 2] != RPL_RH_TYPE_SRH) {
+      return 0;
+    }
+    /* The destination field holds the next hop of the source route */
+    set_link_local_nexthop(ipaddr, &UIP_IP_BUF->destipaddr);
+    return 1;
+  }
+
+  if(default_instance == NULL ||
+     default_instance->mop != RPL_MOP_NON_STORING) {
+    return 0;
+  }
+  dag = default_instance->current_dag;
+  if(dag == NULL || dag->rank != ROOT_RANK(default_instance) ||
+     !rpl_ns_is_node_reachable(dag, &UIP_IP_BUF->destipaddr)) {
+    return 0;
+  }
+  return insert_srh_header(dag, ipaddr);
+}
+/*---------------------------------------------------------------------------*/
+int
+rpl_process_srh_header(void)
+{
+  uip_ipaddr_t next;
+  uint8_t *srh;
+  uint8_t *hop;
+  int cmpri;
+  int cmpre;
+  int pad;
+  int n;
+  int i;
+  int size;
+
+  if(UIP_RH_BUF->routing_type != RPL_RH_TYPE_SRH ||
+     UIP_RH_BUF->seg_left == 0) {
+    return 0;
+  }
+
+  srh = (uint8_t *)UIP_RH_BUF;
+  cmpri = srh[4] >> 4;
+  cmpre = srh[4] & 0x0f;
+  pad = srh[5] >> 4;
+
+  if((UIP_RH_BUF->len << 3) < pad + 16 - cmpre) {
+    PRINTF("RPL: Source routing header too short\n");
+    return 0;
+  }
+  n = ((UIP_RH_BUF->len << 3) - pad - (16 - cmpre)) / (16 - cmpri) + 1;
+  if(UIP_RH_BUF->seg_left > n) {
+    PRINTF("RPL: Source routing header with too many segments left\n");
+    return 0;
+  }
+
+  /* The next address keeps the elided prefix of ours. The route is not
+     reversed into the header, since RPL routes are not used backwards. */
+  i = n - UIP_RH_BUF->seg_left;
+  size = i == n - 1 ? 16 - cmpre : 16 - cmpri;
+  hop = srh + RPL_SRH_HDR_LEN + i * (16 - cmpri);
+  uip_ipaddr_copy(&next, &UIP_IP_BUF->destipaddr);
+  memcpy(&next.u8[16 - size], hop, size);
+
+  /* The header is left as it is if the packet is dropped */
+  if(uip_is_addr_mcast(&next) || uip_ds6_is_my_addr(&next)) {
+    PRINTF("RPL: Loop or multicast address in source routing header\n");
+    return 0;
+  }
+
+  uip_ipaddr_copy(&UIP_IP_BUF->destipaddr, &next);
+  UIP_RH_BUF->seg_left--;
+
+  PRINTF("RPL: Source routing to ");
+  PRINT6ADDR(&UIP_IP_BUF->destipaddr);
+  PRINTF(", %u segments left\n", UIP_RH_BUF->seg_left);
+  return 1;
+}
+#else /* RPL_WITH_NON_STORING */
+int
+rpl_srh_get_next_hop(uip_ipaddr_t *ipaddr)
+{
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+int
+rpl_process_srh_header(void)
+{
+  return 0;
+}
+#endif /* RPL_WITH_NON_STORING */
+/*---------------------------------------------------------------------------*/
 
 /** @}*/
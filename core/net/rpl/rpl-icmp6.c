@@ -51,6 +51,7 @@
 #include "net/ipv6/uip-nd6.h"
 #include "net/ipv6/uip-icmp6.h"
 #include "net/rpl/rpl-private.h"
+#include "net/rpl/rpl-ns.h"
 #include "net/packetbuf.h"
 #include "net/ipv6/multicast/uip-mcast6.h"
 
@@ -571,6 +572,102 @@ dio_output(rpl_instance_t *instance, uip_ipaddr_t *uc_addr)
 #endif /* RPL_LEAF_ONLY */
 }
 /*---------------------------------------------------------------------------*/
+#if RPL_WITH_NON_STORING
+static void
+dao_input_nonstoring(rpl_instance_t *instance, rpl_dag_t *dag,
+                     unsigned char *buffer, int pos, int buffer_length,
+                     uint8_t flags, uint8_t sequence)
+{
+  uip_ipaddr_t dao_sender_addr;
+  uip_ipaddr_t prefix;
+  uip_ipaddr_t dao_parent_addr;
+  uint8_t lifetime;
+  uint8_t prefixlen;
+  uint8_t subopt_type;
+  int have_parent;
+  int len;
+  int i;
+
+  uip_ipaddr_copy(&dao_sender_addr, &UIP_IP_BUF->srcipaddr);
+  lifetime = instance->default_lifetime;
+  prefixlen = 0;
+  have_parent = 0;
+  memset(&prefix, 0, sizeof(prefix));
+
+  for(i = pos; i < buffer_length; i += len) {
+    subopt_type = buffer[i];
+    if(subopt_type == RPL_OPTION_PAD1) {
+      len = 1;
+    } else {
+      len = 2 + buffer[i + 1];
+    }
+    if(i + len > buffer_length) {
+      PRINTF("RPL: Non-storing DAO option exceeds the message\n");
+      uip_len = 0;
+      return;
+    }
+
+    switch(subopt_type) {
+    case RPL_OPTION_TARGET:
+      if(len < 4) {
+        PRINTF("RPL: Non-storing DAO with a short target option\n");
+        uip_len = 0;
+        return;
+      }
+      prefixlen = buffer[i + 3];
+      if(prefixlen > sizeof(prefix) * CHAR_BIT ||
+         4 + (prefixlen + 7) / CHAR_BIT > len) {
+        PRINTF("RPL: Non-storing DAO with an invalid prefix length %u\n",
+               prefixlen);
+        uip_len = 0;
+        return;
+      }
+      memset(&prefix, 0, sizeof(prefix));
+      memcpy(&prefix, buffer + i + 4, (prefixlen + 7) / CHAR_BIT);
+      break;
+    case RPL_OPTION_TRANSIT:
+      if(len < 6) {
+        PRINTF("RPL: Non-storing DAO with a short transit option\n");
+        uip_len = 0;
+        return;
+      }
+      lifetime = buffer[i + 5];
+      if(buffer[i + 1] >= 20) {
+        memcpy(&dao_parent_addr, buffer + i + 6, 16);
+        have_parent = 1;
+      }
+      break;
+    }
+  }
+
+  if(!have_parent || prefixlen != sizeof(prefix) * CHAR_BIT) {
+    PRINTF("RPL: Non-storing DAO without a parent address or a full target\n");
+    uip_len = 0;
+    return;
+  }
+
+  PRINTF("RPL: Non-storing DAO lifetime: %u, target: ", (unsigned)lifetime);
+  PRINT6ADDR(&prefix);
+  PRINTF(", parent: ");
+  PRINT6ADDR(&dao_parent_addr);
+  PRINTF("\n");
+
+  if(lifetime == RPL_ZERO_LIFETIME) {
+    rpl_ns_expire_parent(dag, &prefix, &dao_parent_addr);
+  } else if(rpl_ns_update_node(dag, &prefix, &dao_parent_addr,
+                                RPL_LIFETIME(instance, lifetime)) == NULL) {
+    PRINTF("RPL: Could not add a link after receiving a DAO\n");
+    uip_len = 0;
+    return;
+  }
+
+  if(flags & RPL_DAO_K_FLAG) {
+    dao_ack_output(instance, &dao_sender_addr, sequence);
+  }
+  uip_len = 0;
+}
+#endif /* RPL_WITH_NON_STORING */
+/*---------------------------------------------------------------------------*/
 static void
 dao_input(void)
 {
@@ -638,6 +735,15 @@ dao_input(void)
     pos += 16;
   }
 
+#if RPL_WITH_NON_STORING
+  if(instance->mop == RPL_MOP_NON_STORING) {
+    /* Only the root receives DAOs; the rest forward them as data */
+    dao_input_nonstoring(instance, dag, buffer, pos, buffer_length,
+                         flags, sequence);
+    return;
+  }
+#endif /* RPL_WITH_NON_STORING */
+
   learned_from = uip_is_addr_mcast(&dao_sender_addr) ?
                  RPL_ROUTE_FROM_MULTICAST_DAO : RPL_ROUTE_FROM_UNICAST_DAO;
 
@@ -653,7 +759,7 @@ dao_input(void)
       PRINTF("RPL: Loop detected when receiving a unicast DAO from a node with a lower rank! (%u < %u)\n",
           DAG_RANK(parent->rank, instance), DAG_RANK(dag->rank, instance));
       parent->rank = INFINITE_RANK;
-      parent->flags |= RPL_PARENT_FLAG_UPDATED;
+      rpl_parent_changed(parent);
       return;
     }
 
@@ -661,7 +767,7 @@ dao_input(void)
     if(parent != NULL && parent == dag->preferred_parent) {
       PRINTF("RPL: Loop detected when receiving a unicast DAO from our parent\n");
       parent->rank = INFINITE_RANK;
-      parent->flags |= RPL_PARENT_FLAG_UPDATED;
+      rpl_parent_changed(parent);
       return;
     }
   }
@@ -675,11 +781,24 @@ dao_input(void)
       /* The option consists of a two-byte header and a payload. */
       len = 2 + buffer[i + 1];
     }
+    if(i + len > buffer_length) {
+      PRINTF("RPL: DAO option exceeds the message\n");
+      return;
+    }
 
     switch(subopt_type) {
     case RPL_OPTION_TARGET:
       /* Handle the target option. */
+      if(len < 4) {
+        PRINTF("RPL: DAO with a short target option\n");
+        return;
+      }
       prefixlen = buffer[i + 3];
+      if(prefixlen > sizeof(prefix) * CHAR_BIT ||
+         4 + (prefixlen + 7) / CHAR_BIT > len) {
+        PRINTF("RPL: DAO with an invalid prefix length %u\n", prefixlen);
+        return;
+      }
       memset(&prefix, 0, sizeof(prefix));
       memcpy(&prefix, buffer + i + 4, (prefixlen + 7) / CHAR_BIT);
       break;
@@ -687,6 +806,10 @@ dao_input(void)
       /* The path sequence and control are ignored. */
       /*      pathcontrol = buffer[i + 3];
               pathsequence = buffer[i + 4];*/
+      if(len < 6) {
+        PRINTF("RPL: DAO with a short transit option\n");
+        return;
+      }
       lifetime = buffer[i + 5];
       /* The parent address is also ignored. */
       break;
@@ -823,6 +946,7 @@ dao_output_target(rpl_parent_t *parent, uip_ipaddr_t *prefix, uint8_t lifetime)
   unsigned char *buffer;
   uint8_t prefixlen;
   int pos;
+  uip_ipaddr_t *parent_addr;
 
   /* Destination Advertisement Object */
 
@@ -852,6 +976,13 @@ dao_output_target(rpl_parent_t *parent, uip_ipaddr_t *prefix, uint8_t lifetime)
     PRINTF("RPL dao_output_target error prefix NULL\n");
     return;
   }
+  /* The non-storing transit option carries the parent address, so it
+     must be known before the option is written */
+  parent_addr = rpl_get_parent_ipaddr(parent);
+  if(parent_addr == NULL) {
+    PRINTF("RPL dao_output_target error parent address NULL\n");
+    return;
+  }
 #ifdef RPL_DEBUG_DAO_OUTPUT
   RPL_DEBUG_DAO_OUTPUT(parent);
 #endif
@@ -888,21 +1019,43 @@ dao_output_target(rpl_parent_t *parent, uip_ipaddr_t *prefix, uint8_t lifetime)
 
   /* Create a transit information sub-option. */
   buffer[pos++] = RPL_OPTION_TRANSIT;
+#if RPL_WITH_NON_STORING
+  buffer[pos++] = instance->mop == RPL_MOP_NON_STORING ? 20 : 4;
+#else /* RPL_WITH_NON_STORING */
   buffer[pos++] = 4;
+#endif /* RPL_WITH_NON_STORING */
   buffer[pos++] = 0; /* flags - ignored */
   buffer[pos++] = 0; /* path control - ignored */
   buffer[pos++] = 0; /* path seq - ignored */
   buffer[pos++] = lifetime;
 
+#if RPL_WITH_NON_STORING
+  if(instance->mop == RPL_MOP_NON_STORING) {
+    /* The root learns the global address of our parent, built from the
+       DAG prefix and the interface identifier of its link-local address.
+       The DAO goes to the root instead of the parent. */
+    memcpy(buffer + pos, &dag->dag_id, 8);
+    memcpy(buffer + pos + 8, &parent_addr->u8[8], 8);
+    pos += 16;
+
+    PRINTF("RPL: Sending non-storing DAO with prefix ");
+    PRINT6ADDR(prefix);
+    PRINTF(" to ");
+    PRINT6ADDR(&dag->dag_id);
+    PRINTF("\n");
+
+    uip_icmp6_send(&dag->dag_id, ICMP6_RPL, RPL_CODE_DAO, pos);
+    return;
+  }
+#endif /* RPL_WITH_NON_STORING */
+
   PRINTF("RPL: Sending DAO with prefix ");
   PRINT6ADDR(prefix);
   PRINTF(" to ");
-  PRINT6ADDR(rpl_get_parent_ipaddr(parent));
+  PRINT6ADDR(parent_addr);
   PRINTF("\n");
 
-  if(rpl_get_parent_ipaddr(parent) != NULL) {
-    uip_icmp6_send(rpl_get_parent_ipaddr(parent), ICMP6_RPL, RPL_CODE_DAO, pos);
-  }
+  uip_icmp6_send(parent_addr, ICMP6_RPL, RPL_CODE_DAO, pos);
 }
 /*---------------------------------------------------------------------------*/
 static void
@@ -56,6 +56,7 @@ static void reset(rpl_dag_t *);
 static void neighbor_link_callback(rpl_parent_t *, int, int);
 static rpl_parent_t *best_parent(rpl_parent_t *, rpl_parent_t *);
 static rpl_dag_t *best_dag(rpl_dag_t *, rpl_dag_t *);
+static uint16_t parent_path_cost(rpl_parent_t *);
 static rpl_rank_t calculate_rank(rpl_parent_t *, rpl_rank_t);
 static void update_metric_container(rpl_instance_t *);
 
@@ -64,6 +65,7 @@ rpl_of_t rpl_mrhof = {
   neighbor_link_callback,
   best_parent,
   best_dag,
+  parent_path_cost,
   calculate_rank,
   update_metric_container,
   1
@@ -235,6 +237,12 @@ best_parent(rpl_parent_t *p1, rpl_parent_t *p2)
   return p1_metric < p2_metric ? p1 : p2;
 }
 
+static uint16_t
+parent_path_cost(rpl_parent_t *p)
+{
+  return calculate_path_metric(p);
+}
+
 #if RPL_DAG_MC == RPL_DAG_MC_NONE
 static void
 update_metric_container(rpl_instance_t *instance)
@@ -0,0 +1,295 @@
+/*
+ * Copyright (c) 2015, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \addtogroup uip6
+ * @{
+ */
+/**
+ * \file
+ *         Topology table of the root in RPL non-storing mode.
+ */
+
+#include "net/rpl/rpl-private.h"
+#include "net/rpl/rpl-ns.h"
+#include "lib/list.h"
+#include "lib/memb.h"
+
+#define DEBUG DEBUG_NONE
+#include "net/ip/uip-debug.h"
+
+#include <string.h>
+
+#if RPL_WITH_NON_STORING
+
+#if RPL_NS_HASH_SIZE & (RPL_NS_HASH_SIZE - 1)
+#error "RPL_NS_HASH_SIZE must be a power of two"
+#endif
+
+static int num_nodes;
+static rpl_ns_node_t *hash_table[RPL_NS_HASH_SIZE];
+LIST(nodelist);
+MEMB(nodememb, rpl_ns_node_t, RPL_NS_LINK_NUM);
+
+/*---------------------------------------------------------------------------*/
+static unsigned
+hash(const uint8_t *link_identifier)
+{
+  unsigned h;
+  int i;
+
+  h = 0;
+  for(i = 0; i < 8; i++) {
+    h = h * 31 + link_identifier[i];
+  }
+  return h & (RPL_NS_HASH_SIZE - 1);
+}
+/*---------------------------------------------------------------------------*/
+static int
+in_dag_prefix(const rpl_dag_t *dag, const uip_ipaddr_t *addr)
+{
+  return memcmp(addr->u8, dag->dag_id.u8, 8) == 0;
+}
+/*---------------------------------------------------------------------------*/
+static rpl_ns_node_t *
+add_node(rpl_dag_t *dag, const uip_ipaddr_t *addr)
+{
+  rpl_ns_node_t *node;
+  unsigned h;
+
+  node = memb_alloc(&nodememb);
+  if(node == NULL) {
+    PRINTF("RPL: Non-storing table full, dropping ");
+    PRINT6ADDR(addr);
+    PRINTF("\n");
+    RPL_STAT(rpl_stats.mem_overflows++);
+    return NULL;
+  }
+
+  node->dag = dag;
+  node->parent = NULL;
+  node->lifetime = 0;
+  memcpy(node->link_identifier, &addr->u8[8], 8);
+
+  h = hash(node->link_identifier);
+  node->hash_next = hash_table[h];
+  hash_table[h] = node;
+  list_add(nodelist, node);
+  num_nodes++;
+  return node;
+}
+/*---------------------------------------------------------------------------*/
+static void
+remove_node(rpl_ns_node_t *node)
+{
+  rpl_ns_node_t **p;
+  rpl_ns_node_t *n;
+
+  /* The nodes below are unreachable until they send a new DAO */
+  for(n = list_head(nodelist); n != NULL; n = list_item_next(n)) {
+    if(n->parent == node) {
+      n->parent = NULL;
+    }
+  }
+
+  for(p = &hash_table[hash(node->link_identifier)]; *p != NULL;
+      p = &(*p)->hash_next) {
+    if(*p == node) {
+      *p = node->hash_next;
+      break;
+    }
+  }
+  list_remove(nodelist, node);
+  memb_free(&nodememb, node);
+  num_nodes--;
+}
+/*---------------------------------------------------------------------------*/
+rpl_ns_node_t *
+rpl_ns_get_node(const rpl_dag_t *dag, const uip_ipaddr_t *addr)
+{
+  rpl_ns_node_t *node;
+
+  if(dag == NULL || addr == NULL || !in_dag_prefix(dag, addr)) {
+    return NULL;
+  }
+
+  for(node = hash_table[hash(&addr->u8[8])]; node != NULL;
+      node = node->hash_next) {
+    if(node->dag == dag &&
+       memcmp(node->link_identifier, &addr->u8[8], 8) == 0) {
+      return node;
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+int
+rpl_ns_is_node_reachable(const rpl_dag_t *dag, const uip_ipaddr_t *addr)
+{
+  rpl_ns_node_t *node;
+  uip_ipaddr_t root;
+  int max_depth;
+
+  /* Bounded, in case the parent pointers form a loop */
+  max_depth = num_nodes;
+  node = rpl_ns_get_node(dag, addr);
+  while(node != NULL && node->parent != NULL && max_depth-- > 0) {
+    node = node->parent;
+  }
+  if(node == NULL || node->parent != NULL) {
+    return 0;
+  }
+
+  /* The path ends at the root, or at a node with an expired parent */
+  rpl_ns_get_node_global_addr(&root, node);
+  return uip_ds6_is_my_addr(&root);
+}
+/*---------------------------------------------------------------------------*/
+void
+rpl_ns_get_node_global_addr(uip_ipaddr_t *addr, const rpl_ns_node_t *node)
+{
+  memcpy(addr->u8, node->dag->dag_id.u8, 8);
+  memcpy(&addr->u8[8], node->link_identifier, 8);
+}
+/*---------------------------------------------------------------------------*/
+rpl_ns_node_t *
+rpl_ns_update_node(rpl_dag_t *dag, const uip_ipaddr_t *child,
+                   const uip_ipaddr_t *parent, uint32_t lifetime)
+{
+  rpl_ns_node_t *child_node;
+  rpl_ns_node_t *parent_node;
+
+  /* Only the interface identifiers are stored */
+  if(!in_dag_prefix(dag, child) || !in_dag_prefix(dag, parent)) {
+    PRINTF("RPL: DAO target or parent outside of the DAG prefix\n");
+    return NULL;
+  }
+
+  child_node = rpl_ns_get_node(dag, child);
+  if(child_node == NULL) {
+    child_node = add_node(dag, child);
+    if(child_node == NULL) {
+      return NULL;
+    }
+  }
+
+  parent_node = rpl_ns_get_node(dag, parent);
+  if(parent_node == NULL) {
+    parent_node = add_node(dag, parent);
+    if(parent_node == NULL) {
+      if(child_node->lifetime == 0) {
+        remove_node(child_node);
+      }
+      return NULL;
+    }
+  }
+
+  /* A node that has not sent a DAO itself, such as the root, stays as
+     long as the nodes below it */
+  if(parent_node->lifetime < lifetime) {
+    parent_node->lifetime = lifetime;
+  }
+
+  child_node->parent = parent_node;
+  child_node->lifetime = lifetime;
+
+  PRINTF("RPL: Non-storing link ");
+  PRINT6ADDR(child);
+  PRINTF(" -> ");
+  PRINT6ADDR(parent);
+  PRINTF(", lifetime %lu\n", (unsigned long)lifetime);
+
+  return child_node;
+}
+/*---------------------------------------------------------------------------*/
+void
+rpl_ns_expire_parent(rpl_dag_t *dag, const uip_ipaddr_t *child,
+                     const uip_ipaddr_t *parent)
+{
+  rpl_ns_node_t *node;
+
+  node = rpl_ns_get_node(dag, child);
+  if(node != NULL && node->parent != NULL &&
+     node->parent == rpl_ns_get_node(dag, parent)) {
+    /* Keep the node, and the pointers of its children, until the DAO
+       for its new parent arrives or the lifetime runs out */
+    node->parent = NULL;
+  }
+}
+/*---------------------------------------------------------------------------*/
+rpl_ns_node_t *
+rpl_ns_node_head(void)
+{
+  return list_head(nodelist);
+}
+/*---------------------------------------------------------------------------*/
+rpl_ns_node_t *
+rpl_ns_node_next(rpl_ns_node_t *item)
+{
+  return list_item_next(item);
+}
+/*---------------------------------------------------------------------------*/
+int
+rpl_ns_num_nodes(void)
+{
+  return num_nodes;
+}
+/*---------------------------------------------------------------------------*/
+void
+rpl_ns_periodic(void)
+{
+  rpl_ns_node_t *node;
+  rpl_ns_node_t *next;
+
+  for(node = list_head(nodelist); node != NULL; node = next) {
+    next = list_item_next(node);
+    if(node->lifetime > 1) {
+      node->lifetime--;
+    } else {
+      PRINTF("RPL: Non-storing node expired\n");
+      remove_node(node);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+rpl_ns_init(void)
+{
+  num_nodes = 0;
+  memset(hash_table, 0, sizeof(hash_table));
+  list_init(nodelist);
+  memb_init(&nodememb);
+}
+/*---------------------------------------------------------------------------*/
+#endif /* RPL_WITH_NON_STORING */
+
+/** @}*/
@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2015, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \addtogroup uip6
+ * @{
+ */
+/**
+ * \file
+ *         Topology table of the root in RPL non-storing mode. The root
+ *         learns the preferred parent of each node from its DAOs and
+ *         keeps one entry per node with a pointer to the entry of the
+ *         parent. Downward paths are read out of the table to build
+ *         source routing headers (RFC 6554).
+ */
+
+#ifndef RPL_NS_H_
+#define RPL_NS_H_
+
+#include "net/rpl/rpl.h"
+
+/* Number of nodes that the root can keep, parents included */
+#ifdef RPL_NS_CONF_LINK_NUM
+#define RPL_NS_LINK_NUM RPL_NS_CONF_LINK_NUM
+#else
+#define RPL_NS_LINK_NUM 32
+#endif /* RPL_NS_CONF_LINK_NUM */
+
+/* Buckets of the table hash, a power of two */
+#ifdef RPL_NS_CONF_HASH_SIZE
+#define RPL_NS_HASH_SIZE RPL_NS_CONF_HASH_SIZE
+#else
+#define RPL_NS_HASH_SIZE 16
+#endif /* RPL_NS_CONF_HASH_SIZE */
+
+typedef struct rpl_ns_node {
+  struct rpl_ns_node *next;
+  /* Next node in the same hash bucket */
+  struct rpl_ns_node *hash_next;
+  /* Seconds */
+  uint32_t lifetime;
+  rpl_dag_t *dag;
+  /* The interface identifier; the prefix is that of the DAG ID */
+  uint8_t link_identifier[8];
+  struct rpl_ns_node *parent;
+} rpl_ns_node_t;
+
+void rpl_ns_init(void);
+
+/* Records that child has parent as its preferred parent, for lifetime
+   seconds. Adds an entry for the parent if there is none. Returns NULL
+   if the table is full. */
+rpl_ns_node_t *rpl_ns_update_node(rpl_dag_t *dag, const uip_ipaddr_t *child,
+                                  const uip_ipaddr_t *parent,
+                                  uint32_t lifetime);
+/* Handles a No-Path DAO: forgets child if it is still under parent */
+void rpl_ns_expire_parent(rpl_dag_t *dag, const uip_ipaddr_t *child,
+                          const uip_ipaddr_t *parent);
+
+rpl_ns_node_t *rpl_ns_get_node(const rpl_dag_t *dag, const uip_ipaddr_t *addr);
+/* Returns non-zero if the parent pointers of addr lead to the root */
+int rpl_ns_is_node_reachable(const rpl_dag_t *dag, const uip_ipaddr_t *addr);
+void rpl_ns_get_node_global_addr(uip_ipaddr_t *addr, const rpl_ns_node_t *node);
+
+rpl_ns_node_t *rpl_ns_node_head(void);
+rpl_ns_node_t *rpl_ns_node_next(rpl_ns_node_t *item);
+int rpl_ns_num_nodes(void);
+
+/* Ages the entries; called once per second */
+void rpl_ns_periodic(void);
+
+#endif /* RPL_NS_H_ */
+
+/** @}*/
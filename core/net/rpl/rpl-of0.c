@@ -49,6 +49,7 @@
 static void reset(rpl_dag_t *);
 static rpl_parent_t *best_parent(rpl_parent_t *, rpl_parent_t *);
 static rpl_dag_t *best_dag(rpl_dag_t *, rpl_dag_t *);
+static uint16_t parent_path_cost(rpl_parent_t *);
 static rpl_rank_t calculate_rank(rpl_parent_t *, rpl_rank_t);
 static void update_metric_container(rpl_instance_t *);
 
@@ -57,6 +58,7 @@ rpl_of_t rpl_of0 = {
   NULL,
   best_parent,
   best_dag,
+  parent_path_cost,
   calculate_rank,
   update_metric_container,
   0
@@ -164,6 +166,23 @@ best_parent(rpl_parent_t *p1, rpl_parent_t *p2)
   }
 }
 
+static uint16_t
+parent_path_cost(rpl_parent_t *p)
+{
+  uint32_t cost;
+  uip_ds6_nbr_t *nbr;
+
+  nbr = rpl_get_nbr(p);
+  if(nbr == NULL) {
+    return 0xffff;
+  }
+
+  /* The same combination of rank and link metric as in best_parent() */
+  cost = (uint32_t)DAG_RANK(p->rank, p->dag->instance) * RPL_MIN_HOPRANKINC +
+    nbr->link_metric;
+  return cost < 0xffff ? cost : 0xffff;
+}
+
 static void
 update_metric_container(rpl_instance_t *instance)
 {
@@ -163,6 +163,14 @@
 #endif /* UIP_IPV6_MULTICAST_RPL */
 #endif /* RPL_CONF_MOP */
 
+/* Support for non-storing mode: the root keeps the topology of the DAG
+   and routes downwards with source routing headers (RFC 6554) */
+#ifdef RPL_CONF_WITH_NON_STORING
+#define RPL_WITH_NON_STORING RPL_CONF_WITH_NON_STORING
+#else
+#define RPL_WITH_NON_STORING (RPL_MOP_DEFAULT == RPL_MOP_NON_STORING)
+#endif /* RPL_CONF_WITH_NON_STORING */
+
 /* Emit a pre-processor error if the user configured multicast with bad MOP */
 #if RPL_CONF_MULTICAST && (RPL_MOP_DEFAULT != RPL_MOP_STORING_MULTICAST)
 #error "RPL Multicast requires RPL_MOP_DEFAULT==3. Check contiki-conf.h"
@@ -246,6 +254,10 @@ struct rpl_stats {
   uint16_t loop_errors;
   uint16_t loop_warnings;
   uint16_t root_repairs;
+  /* Calls to the OF for comparing parents or computing path costs, and
+     the rtimer ticks spent in them */
+  uint32_t of_evaluations;
+  uint32_t of_ticks;
 };
 typedef struct rpl_stats rpl_stats_t;
 
@@ -292,6 +304,7 @@ rpl_parent_t *rpl_find_parent_any_dag(rpl_instance_t *instance, uip_ipaddr_t *ad
 void rpl_nullify_parent(rpl_parent_t *);
 void rpl_remove_parent(rpl_parent_t *);
 void rpl_move_parent(rpl_dag_t *dag_src, rpl_dag_t *dag_dst, rpl_parent_t *parent);
+void rpl_parent_changed(rpl_parent_t *);
 rpl_parent_t *rpl_select_parent(rpl_dag_t *dag);
 rpl_dag_t *rpl_select_dag(rpl_instance_t *instance,rpl_parent_t *parent);
 void rpl_recalculate_ranks(void);
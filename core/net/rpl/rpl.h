@@ -44,6 +44,9 @@
 #include "net/ip/uip.h"
 #include "net/ipv6/uip-ds6.h"
 #include "sys/ctimer.h"
+#if RPL_PARENT_HEAP
+#include "net/nbr-table.h"
+#endif /* RPL_PARENT_HEAP */
 
 /*---------------------------------------------------------------------------*/
 typedef uint16_t rpl_rank_t;
@@ -116,6 +119,12 @@ struct rpl_parent {
   rpl_rank_t rank;
   uint8_t dtsn;
   uint8_t flags;
+#if RPL_PARENT_HEAP
+  /* Path cost from the OF, as of the last change to the parent */
+  uint16_t path_cost;
+  /* Position in the parent heap of the DAG */
+  uint8_t heap_index;
+#endif /* RPL_PARENT_HEAP */
 };
 typedef struct rpl_parent rpl_parent_t;
 /*---------------------------------------------------------------------------*/
@@ -142,6 +151,11 @@ struct rpl_dag {
   rpl_rank_t rank;
   struct rpl_instance *instance;
   rpl_prefix_t prefix_info;
+#if RPL_PARENT_HEAP
+  /* Candidate parents, the one with the lowest path cost first */
+  rpl_parent_t *parents[NBR_TABLE_MAX_NEIGHBORS];
+  uint8_t parent_count;
+#endif /* RPL_PARENT_HEAP */
 };
 typedef struct rpl_dag rpl_dag_t;
 typedef struct rpl_instance rpl_instance_t;
@@ -168,6 +182,12 @@ typedef struct rpl_instance rpl_instance_t;
  *
  *  Compares two DAGs and returns the best one, according to the OF.
  *
+ * parent_path_cost(parent)
+ *
+ *  Returns the cost of the path to the root through a parent, the value
+ *  that best_parent() compares. Lower is better. Only used when
+ *  RPL_PARENT_HEAP is set, to order the candidate parents.
+ *
  * calculate_rank(parent, base_rank)
  *
  *  Calculates a rank value using the parent rank and a base rank.
@@ -186,6 +206,7 @@ struct rpl_of {
   void (*neighbor_link_callback)(rpl_parent_t *, int, int);
   rpl_parent_t *(*best_parent)(rpl_parent_t *, rpl_parent_t *);
   rpl_dag_t *(*best_dag)(rpl_dag_t *, rpl_dag_t *);
+  uint16_t (*parent_path_cost)(rpl_parent_t *);
   rpl_rank_t (*calculate_rank)(rpl_parent_t *, rpl_rank_t);
   void (*update_metric_container)( rpl_instance_t *);
   rpl_ocp_t ocp;
@@ -245,6 +266,8 @@ int rpl_verify_header(int);
 void rpl_insert_header(void);
 void rpl_remove_header(void);
 uint8_t rpl_invert_header(void);
+int rpl_srh_get_next_hop(uip_ipaddr_t *ipaddr);
+int rpl_process_srh_header(void);
 uip_ipaddr_t *rpl_get_parent_ipaddr(rpl_parent_t *nbr);
 rpl_parent_t *rpl_get_parent(uip_lladdr_t *addr);
 rpl_rank_t rpl_get_parent_rank(uip_lladdr_t *addr);
@@ -49,10 +49,268 @@
 #include "sys/etimer.h"
 #include "sys/process.h"
 
+#include <string.h>
+
+#if !ETIMER_CONF_WHEEL
 static struct etimer *timerlist;
+#endif /* !ETIMER_CONF_WHEEL */
 static clock_time_t next_expiration;
 
 PROCESS(etimer_process, "Event timer");
+
+#if ETIMER_CONF_WHEEL
+/*
+ * The timing wheel has WHEEL_LEVELS levels of WHEEL_SLOTS slots
+ * each. A timer that expires less than WHEEL_SLOTS ticks from now is
+ * kept in level 0, in the slot of its expiration tick. A timer that
+ * expires further away is kept in the first level whose span covers
+ * it, and is moved (cascaded) to a lower level when the wheel reaches
+ * the start of its slot. Timers that are further away than the whole
+ * wheel spans are kept on an overflow list.
+ */
+#define WHEEL_BITS   ETIMER_CONF_WHEEL_BITS
+#define WHEEL_LEVELS ETIMER_CONF_WHEEL_LEVELS
+#define WHEEL_SLOTS  (1 << WHEEL_BITS)
+#define WHEEL_MASK   (WHEEL_SLOTS - 1)
+
+#define CLOCK_BITS   (sizeof(clock_time_t) * 8)
+#define CLOCK_HALF   ((clock_time_t)1 << (CLOCK_BITS - 1))
+/* Non-zero if time a comes before time b, taking wraps into account. */
+#define WHEEL_BEFORE(a, b) ((clock_time_t)((a) - (b)) >= CLOCK_HALF)
+
+static struct etimer *wheel[WHEEL_LEVELS][WHEEL_SLOTS];
+static struct etimer *overflow;
+static unsigned int wheel_pending, wheel_level0;
+/* The next tick that has not yet been processed by the wheel. */
+static clock_time_t wheel_now;
+/* Set when next_expiration must be recomputed from the wheel. */
+static unsigned char next_expiration_dirty;
+/*---------------------------------------------------------------------------*/
+static struct etimer **
+wheel_head(unsigned char level, unsigned char slot)
+{
+  if(level >= WHEEL_LEVELS) {
+    return &overflow;
+  }
+  return &wheel[level][slot];
+}
+/*---------------------------------------------------------------------------*/
+static void
+wheel_add(struct etimer *t)
+{
+  clock_time_t expires, delta;
+  struct etimer **head;
+  unsigned char level;
+
+  expires = t->timer.start + t->timer.interval;
+  if(WHEEL_BEFORE(expires, wheel_now)) {
+    /* Already expired: deliver it on the next tick processed. */
+    expires = wheel_now;
+  }
+  delta = expires - wheel_now;
+
+  for(level = 0; level < WHEEL_LEVELS; level++) {
+    if(WHEEL_BITS * (level + 1) >= CLOCK_BITS ||
+       (delta >> (WHEEL_BITS * (level + 1))) == 0) {
+      break;
+    }
+  }
+  t->level = level;
+  t->slot = level < WHEEL_LEVELS ?
+    (expires >> (WHEEL_BITS * level)) & WHEEL_MASK : 0;
+
+  head = wheel_head(t->level, t->slot);
+  t->next = *head;
+  *head = t;
+
+  if(level == 0) {
+    wheel_level0++;
+  }
+  if(wheel_pending++ == 0) {
+    next_expiration = expires;
+    next_expiration_dirty = 0;
+  } else if(!next_expiration_dirty && WHEEL_BEFORE(expires, next_expiration)) {
+    next_expiration = expires;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static int
+wheel_remove(struct etimer *et)
+{
+  struct etimer **tp;
+
+  /* The level and slot of a timer that has never been set may be
+     garbage, so we only trust them after finding the timer. */
+  if(et->level > WHEEL_LEVELS || et->slot >= WHEEL_SLOTS) {
+    return 0;
+  }
+  for(tp = wheel_head(et->level, et->slot); *tp != NULL; tp = &(*tp)->next) {
+    if(*tp == et) {
+      *tp = et->next;
+      if(et->level == 0) {
+        wheel_level0--;
+      }
+      wheel_pending--;
+      if(etimer_expiration_time(et) == next_expiration) {
+        next_expiration_dirty = 1;
+      }
+      return 1;
+    }
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static void
+wheel_cascade(unsigned char level, unsigned char slot)
+{
+  struct etimer *t, *next;
+
+  t = *wheel_head(level, slot);
+  *wheel_head(level, slot) = NULL;
+  for(; t != NULL; t = next) {
+    next = t->next;
+    wheel_pending--;
+    wheel_add(t);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+wheel_run(void)
+{
+  clock_time_t now, boundary;
+  struct etimer *t, *next;
+  unsigned char level, slot;
+
+  now = clock_time();
+  while(!WHEEL_BEFORE(now, wheel_now)) {
+    slot = wheel_now & WHEEL_MASK;
+
+    if(slot == 0) {
+      /* Start of a new round of level 0: move the timers of the
+         next slot of each higher level down. */
+      for(level = 1; level < WHEEL_LEVELS; level++) {
+        if(WHEEL_BITS * level >= CLOCK_BITS) {
+          break;
+        }
+        slot = (wheel_now >> (WHEEL_BITS * level)) & WHEEL_MASK;
+        wheel_cascade(level, slot);
+        if(slot != 0) {
+          break;
+        }
+      }
+      if(level == WHEEL_LEVELS) {
+        wheel_cascade(WHEEL_LEVELS, 0);
+      }
+      slot = 0;
+    }
+
+    t = wheel[0][slot];
+    wheel[0][slot] = NULL;
+    for(; t != NULL; t = next) {
+      next = t->next;
+      wheel_level0--;
+      wheel_pending--;
+      if(process_post(t->p, PROCESS_EVENT_TIMER, t) == PROCESS_ERR_OK) {
+        /* Reset the process ID of the event timer, to signal that the
+           etimer has expired. This is later checked in the
+           etimer_expired() function. */
+        t->p = PROCESS_NONE;
+        t->next = NULL;
+      } else {
+        /* The event queue is full: retry on the next tick. */
+        t->level = 0;
+        t->slot = (wheel_now + 1) & WHEEL_MASK;
+        t->next = wheel[0][t->slot];
+        wheel[0][t->slot] = t;
+        wheel_level0++;
+        wheel_pending++;
+        etimer_request_poll();
+      }
+    }
+    wheel_now++;
+
+    /* Skip over empty level 0 ticks up to the next cascade point. */
+    if(wheel_level0 == 0 && (wheel_now & WHEEL_MASK) != 0) {
+      boundary = (wheel_now | WHEEL_MASK) + 1;
+      wheel_now = WHEEL_BEFORE(now, boundary) ? now + 1 : boundary;
+    }
+  }
+  next_expiration_dirty = 1;
+}
+/*---------------------------------------------------------------------------*/
+static void
+wheel_remove_process(struct process *p)
+{
+  struct etimer **tp;
+  unsigned char level, slot;
+
+  for(level = 0; level <= WHEEL_LEVELS; level++) {
+    for(slot = 0; slot < (level < WHEEL_LEVELS ? WHEEL_SLOTS : 1); slot++) {
+      for(tp = wheel_head(level, slot); *tp != NULL;) {
+        if((*tp)->p == p) {
+          if(level == 0) {
+            wheel_level0--;
+          }
+          wheel_pending--;
+          *tp = (*tp)->next;
+        } else {
+          tp = &(*tp)->next;
+        }
+      }
+    }
+  }
+  next_expiration_dirty = 1;
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Find the earliest time at which the wheel has work to do: either the
+ * first non-empty slot of level 0, or the start of the first non-empty
+ * slot of a higher level. The latter may be earlier than the actual
+ * expiration time, which only results in an extra poll.
+ */
+static void
+update_time(void)
+{
+  clock_time_t t, candidate;
+  unsigned int i;
+  unsigned char level, found;
+
+  next_expiration_dirty = 0;
+  if(wheel_pending == 0) {
+    next_expiration = 0;
+    return;
+  }
+
+  found = 0;
+  candidate = 0;
+  for(i = 0; i < WHEEL_SLOTS && wheel_level0 > 0; i++) {
+    if(wheel[0][(wheel_now + i) & WHEEL_MASK] != NULL) {
+      candidate = wheel_now + i;
+      found = 1;
+      break;
+    }
+  }
+
+  for(level = 1; level <= WHEEL_LEVELS; level++) {
+    if(WHEEL_BITS * level >= CLOCK_BITS) {
+      break;
+    }
+    for(i = 1; i <= WHEEL_SLOTS; i++) {
+      t = (wheel_now >> (WHEEL_BITS * level)) + i;
+      if(level == WHEEL_LEVELS ? overflow != NULL :
+         wheel[level][t & WHEEL_MASK] != NULL) {
+        t <<= WHEEL_BITS * level;
+        if(!found || WHEEL_BEFORE(t, candidate)) {
+          candidate = t;
+          found = 1;
+        }
+        break;
+      }
+    }
+  }
+  next_expiration = candidate;
+}
+#else /* ETIMER_CONF_WHEEL */
 /*---------------------------------------------------------------------------*/
 static void
 update_time(void)
@@ -76,13 +334,32 @@ update_time(void)
     next_expiration = now + tdist;
   }
 }
+#endif /* ETIMER_CONF_WHEEL */
 /*---------------------------------------------------------------------------*/
 PROCESS_THREAD(etimer_process, ev, data)
 {
+#if !ETIMER_CONF_WHEEL
   struct etimer *t, *u;
+#endif /* !ETIMER_CONF_WHEEL */
 	
   PROCESS_BEGIN();
 
+#if ETIMER_CONF_WHEEL
+  memset(wheel, 0, sizeof(wheel));
+  overflow = NULL;
+  wheel_pending = wheel_level0 = 0;
+  wheel_now = clock_time();
+
+  while(1) {
+    PROCESS_YIELD();
+
+    if(ev == PROCESS_EVENT_EXITED) {
+      wheel_remove_process(data);
+    } else if(ev == PROCESS_EVENT_POLL) {
+      wheel_run();
+    }
+  }
+#else /* ETIMER_CONF_WHEEL */
   timerlist = NULL;
   
   while(1) {
@@ -137,6 +414,7 @@ PROCESS_THREAD(etimer_process, ev, data)
     }
     
   }
+#endif /* ETIMER_CONF_WHEEL */
   
   PROCESS_END();
 }
@@ -150,6 +428,15 @@ etimer_request_poll(void)
 static void
 add_timer(struct etimer *timer)
 {
+#if ETIMER_CONF_WHEEL
+  etimer_request_poll();
+
+  if(timer->p != PROCESS_NONE) {
+    wheel_remove(timer);
+  }
+  timer->p = PROCESS_CURRENT();
+  wheel_add(timer);
+#else /* ETIMER_CONF_WHEEL */
   struct etimer *t;
 
   etimer_request_poll();
@@ -171,6 +458,7 @@ add_timer(struct etimer *timer)
   timerlist = timer;
 
   update_time();
+#endif /* ETIMER_CONF_WHEEL */
 }
 /*---------------------------------------------------------------------------*/
 void
@@ -197,6 +485,13 @@ etimer_restart(struct etimer *et)
 void
 etimer_adjust(struct etimer *et, int timediff)
 {
+#if ETIMER_CONF_WHEEL
+  if(wheel_remove(et)) {
+    et->timer.start += timediff;
+    wheel_add(et);
+    return;
+  }
+#endif /* ETIMER_CONF_WHEEL */
   et->timer.start += timediff;
   update_time();
 }
@@ -222,18 +517,30 @@ etimer_start_time(struct etimer *et)
 int
 etimer_pending(void)
 {
+#if ETIMER_CONF_WHEEL
+  return wheel_pending > 0;
+#else /* ETIMER_CONF_WHEEL */
   return timerlist != NULL;
+#endif /* ETIMER_CONF_WHEEL */
 }
 /*---------------------------------------------------------------------------*/
 clock_time_t
 etimer_next_expiration_time(void)
 {
+#if ETIMER_CONF_WHEEL
+  if(next_expiration_dirty) {
+    update_time();
+  }
+#endif /* ETIMER_CONF_WHEEL */
   return etimer_pending() ? next_expiration : 0;
 }
 /*---------------------------------------------------------------------------*/
 void
 etimer_stop(struct etimer *et)
 {
+#if ETIMER_CONF_WHEEL
+  wheel_remove(et);
+#else /* ETIMER_CONF_WHEEL */
   struct etimer *t;
 
   /* First check if et is the first event timer on the list. */
@@ -254,6 +561,7 @@ etimer_stop(struct etimer *et)
       update_time();
     }
   }
+#endif /* ETIMER_CONF_WHEEL */
 
   /* Remove the next pointer from the item to be removed. */
   et->next = NULL;
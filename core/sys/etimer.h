@@ -65,6 +65,26 @@
 #include "sys/timer.h"
 #include "sys/process.h"
 
+/*
+ * With ETIMER_CONF_WHEEL, pending event timers are kept in a
+ * hierarchical timing wheel instead of a single list. Setting,
+ * stopping and expiring a timer then costs (amortized) constant time
+ * regardless of the number of pending timers, at the cost of
+ * ETIMER_CONF_WHEEL_LEVELS * 2^ETIMER_CONF_WHEEL_BITS list heads of
+ * RAM.
+ */
+#ifndef ETIMER_CONF_WHEEL
+#define ETIMER_CONF_WHEEL 0
+#endif /* ETIMER_CONF_WHEEL */
+
+#ifndef ETIMER_CONF_WHEEL_BITS
+#define ETIMER_CONF_WHEEL_BITS 6
+#endif /* ETIMER_CONF_WHEEL_BITS */
+
+#ifndef ETIMER_CONF_WHEEL_LEVELS
+#define ETIMER_CONF_WHEEL_LEVELS 4
+#endif /* ETIMER_CONF_WHEEL_LEVELS */
+
 /**
  * A timer.
  *
@@ -77,6 +97,10 @@ struct etimer {
   struct timer timer;
   struct etimer *next;
   struct process *p;
+#if ETIMER_CONF_WHEEL
+  /* The wheel level and slot that the timer is kept in. */
+  unsigned char level, slot;
+#endif /* ETIMER_CONF_WHEEL */
 };
 
 /**
@@ -44,6 +44,7 @@
  */
 
 #include <stdio.h>
+#include <string.h>
 
 #include "sys/process.h"
 #include "sys/arg.h"
@@ -68,6 +69,18 @@ struct event_data {
 static process_num_events_t nevents, fevent;
 static struct event_data events[PROCESS_CONF_NUMEVENTS];
 
+#if PROCESS_CONF_PRIORITY_QUEUES
+/*
+ * The high-priority lane. Timer events and events posted to processes
+ * marked with PROCESS_PRIORITY_HIGH are queued here and are always
+ * dispatched before anything in the normal queue.
+ */
+static process_num_events_t hnevents, hfevent;
+static struct event_data hevents[PROCESS_CONF_NUMEVENTS_HIGH];
+
+struct process_queue_stats process_queue_stats;
+#endif /* PROCESS_CONF_PRIORITY_QUEUES */
+
 #if PROCESS_CONF_STATS
 process_num_events_t process_maxevents;
 #endif
@@ -185,6 +198,9 @@ call_process(struct process *p, process_event_t ev, process_data_t data)
   if((p->state & PROCESS_STATE_RUNNING) &&
      p->thread != NULL) {
     PRINTF("process: calling process '%s' with event %d\n", PROCESS_NAME_STRING(p), ev);
+#if PROCESS_CONF_PRIORITY_QUEUES
+    p->nevents_handled++;
+#endif /* PROCESS_CONF_PRIORITY_QUEUES */
     process_current = p;
     p->state = PROCESS_STATE_CALLED;
     ret = p->thread(&p->pt, ev, data);
@@ -210,6 +226,10 @@ process_init(void)
   lastevent = PROCESS_EVENT_MAX;
 
   nevents = fevent = 0;
+#if PROCESS_CONF_PRIORITY_QUEUES
+  hnevents = hfevent = 0;
+  memset(&process_queue_stats, 0, sizeof(process_queue_stats));
+#endif /* PROCESS_CONF_PRIORITY_QUEUES */
 #if PROCESS_CONF_STATS
   process_maxevents = 0;
 #endif /* PROCESS_CONF_STATS */
@@ -227,6 +247,17 @@ do_poll(void)
   struct process *p;
 
   poll_requested = 0;
+#if PROCESS_CONF_PRIORITY_QUEUES
+  /* Poll the high-priority processes first so that a long list of
+     normal processes cannot delay them. */
+  for(p = process_list; p != NULL; p = p->next) {
+    if(p->needspoll && p->priority == PROCESS_PRIORITY_HIGH) {
+      p->state = PROCESS_STATE_RUNNING;
+      p->needspoll = 0;
+      call_process(p, PROCESS_EVENT_POLL, NULL);
+    }
+  }
+#endif /* PROCESS_CONF_PRIORITY_QUEUES */
   /* Call the processes that needs to be polled. */
   for(p = process_list; p != NULL; p = p->next) {
     if(p->needspoll) {
@@ -258,6 +289,16 @@ do_event(void)
    * call the poll handlers inbetween.
    */
 
+#if PROCESS_CONF_PRIORITY_QUEUES
+  /* Events in the high-priority lane are always delivered first. */
+  if(hnevents > 0) {
+    ev = hevents[hfevent].ev;
+    data = hevents[hfevent].data;
+    receiver = hevents[hfevent].p;
+    hfevent = (hfevent + 1) % PROCESS_CONF_NUMEVENTS_HIGH;
+    --hnevents;
+  } else
+#endif /* PROCESS_CONF_PRIORITY_QUEUES */
   if(nevents > 0) {
     
     /* There are events that we should deliver. */
@@ -270,31 +311,33 @@ do_event(void)
        and decrease the number of events. */
     fevent = (fevent + 1) % PROCESS_CONF_NUMEVENTS;
     --nevents;
+  } else {
+    return;
+  }
 
-    /* If this is a broadcast event, we deliver it to all events, in
-       order of their priority. */
-    if(receiver == PROCESS_BROADCAST) {
-      for(p = process_list; p != NULL; p = p->next) {
-
-	/* If we have been requested to poll a process, we do this in
-	   between processing the broadcast event. */
-	if(poll_requested) {
-	  do_poll();
-	}
-	call_process(p, ev, data);
-      }
-    } else {
-      /* This is not a broadcast event, so we deliver it to the
-	 specified process. */
-      /* If the event was an INIT event, we should also update the
-	 state of the process. */
-      if(ev == PROCESS_EVENT_INIT) {
-	receiver->state = PROCESS_STATE_RUNNING;
-      }
+  /* If this is a broadcast event, we deliver it to all events, in
+     order of their priority. */
+  if(receiver == PROCESS_BROADCAST) {
+    for(p = process_list; p != NULL; p = p->next) {
 
-      /* Make sure that the process actually is running. */
-      call_process(receiver, ev, data);
+      /* If we have been requested to poll a process, we do this in
+         between processing the broadcast event. */
+      if(poll_requested) {
+        do_poll();
+      }
+      call_process(p, ev, data);
     }
+  } else {
+    /* This is not a broadcast event, so we deliver it to the
+       specified process. */
+    /* If the event was an INIT event, we should also update the
+       state of the process. */
+    if(ev == PROCESS_EVENT_INIT) {
+      receiver->state = PROCESS_STATE_RUNNING;
+    }
+
+    /* Make sure that the process actually is running. */
+    call_process(receiver, ev, data);
   }
 }
 /*---------------------------------------------------------------------------*/
@@ -309,13 +352,17 @@ process_run(void)
   /* Process one event from the queue */
   do_event();
 
-  return nevents + poll_requested;
+  return process_nevents();
 }
 /*---------------------------------------------------------------------------*/
 int
 process_nevents(void)
 {
+#if PROCESS_CONF_PRIORITY_QUEUES
+  return nevents + hnevents + poll_requested;
+#else /* PROCESS_CONF_PRIORITY_QUEUES */
   return nevents + poll_requested;
+#endif /* PROCESS_CONF_PRIORITY_QUEUES */
 }
 /*---------------------------------------------------------------------------*/
 int
@@ -332,6 +379,38 @@ process_post(struct process *p, process_event_t ev, process_data_t data)
 	   p == PROCESS_BROADCAST? "<broadcast>": PROCESS_NAME_STRING(p), nevents);
   }
   
+#if PROCESS_CONF_PRIORITY_QUEUES
+  /* When the high-priority lane is full, the event goes to the normal
+     queue instead: it is delivered later, but it is not lost. */
+  if((ev == PROCESS_EVENT_TIMER ||
+      (p != PROCESS_BROADCAST && p->priority == PROCESS_PRIORITY_HIGH)) &&
+     hnevents < PROCESS_CONF_NUMEVENTS_HIGH) {
+    snum = (process_num_events_t)(hfevent + hnevents) % PROCESS_CONF_NUMEVENTS_HIGH;
+    hevents[snum].ev = ev;
+    hevents[snum].data = data;
+    hevents[snum].p = p;
+    ++hnevents;
+    if(hnevents > process_queue_stats.maxevents_high) {
+      process_queue_stats.maxevents_high = hnevents;
+    }
+    return PROCESS_ERR_OK;
+  }
+
+  if(p == PROCESS_BROADCAST) {
+    /* A broadcast that is identical to one that is still waiting in
+       the queue would be delivered to the same processes with the
+       same data, so we fold it into the pending one. */
+    for(snum = 0; snum < nevents; snum++) {
+      struct event_data *e;
+      e = &events[(fevent + snum) % PROCESS_CONF_NUMEVENTS];
+      if(e->p == PROCESS_BROADCAST && e->ev == ev && e->data == data) {
+        process_queue_stats.folded++;
+        return PROCESS_ERR_OK;
+      }
+    }
+  }
+#endif /* PROCESS_CONF_PRIORITY_QUEUES */
+
   if(nevents == PROCESS_CONF_NUMEVENTS) {
 #if DEBUG
     if(p == PROCESS_BROADCAST) {
@@ -340,6 +419,12 @@ process_post(struct process *p, process_event_t ev, process_data_t data)
       printf("soft panic: event queue is full when event %d was posted to %s from %s\n", ev, PROCESS_NAME_STRING(p), PROCESS_NAME_STRING(process_current));
     }
 #endif /* DEBUG */
+#if PROCESS_CONF_PRIORITY_QUEUES
+    process_queue_stats.dropped++;
+    if(p != PROCESS_BROADCAST) {
+      p->nevents_dropped++;
+    }
+#endif /* PROCESS_CONF_PRIORITY_QUEUES */
     return PROCESS_ERR_FULL;
   }
   
@@ -379,6 +464,14 @@ process_poll(struct process *p)
   }
 }
 /*---------------------------------------------------------------------------*/
+#if PROCESS_CONF_PRIORITY_QUEUES
+void
+process_set_priority(struct process *p, unsigned char priority)
+{
+  p->priority = priority;
+}
+#endif /* PROCESS_CONF_PRIORITY_QUEUES */
+/*---------------------------------------------------------------------------*/
 int
 process_is_running(struct process *p)
 {
@@ -88,6 +88,26 @@ typedef unsigned char process_num_events_t;
 #define PROCESS_CONF_NUMEVENTS 32
 #endif /* PROCESS_CONF_NUMEVENTS */
 
+/*
+ * With PROCESS_CONF_PRIORITY_QUEUES, the kernel keeps a second,
+ * high-priority event queue that is drained before the normal
+ * one. Timer events and events posted to processes that have been
+ * given PROCESS_PRIORITY_HIGH go to this queue, or to the normal one
+ * when it is full. Duplicate broadcast
+ * events are folded into the one already pending, and each process
+ * keeps a count of handled and dropped events.
+ */
+#ifndef PROCESS_CONF_PRIORITY_QUEUES
+#define PROCESS_CONF_PRIORITY_QUEUES 0
+#endif /* PROCESS_CONF_PRIORITY_QUEUES */
+
+#ifndef PROCESS_CONF_NUMEVENTS_HIGH
+#define PROCESS_CONF_NUMEVENTS_HIGH 8
+#endif /* PROCESS_CONF_NUMEVENTS_HIGH */
+
+#define PROCESS_PRIORITY_NORMAL 0
+#define PROCESS_PRIORITY_HIGH   1
+
 #define PROCESS_EVENT_NONE            0x80
 #define PROCESS_EVENT_INIT            0x81
 #define PROCESS_EVENT_POLL            0x82
@@ -323,8 +343,25 @@ struct process {
   PT_THREAD((* thread)(struct pt *, process_event_t, process_data_t));
   struct pt pt;
   unsigned char state, needspoll;
+#if PROCESS_CONF_PRIORITY_QUEUES
+  unsigned char priority;
+  unsigned short nevents_handled, nevents_dropped;
+#endif /* PROCESS_CONF_PRIORITY_QUEUES */
+};
+
+#if PROCESS_CONF_PRIORITY_QUEUES
+struct process_queue_stats {
+  /* Events that could not be posted because their queue was full. */
+  unsigned short dropped;
+  /* Broadcast events folded into an identical pending broadcast. */
+  unsigned short folded;
+  /* High-water mark of the high-priority queue. */
+  process_num_events_t maxevents_high;
 };
 
+extern struct process_queue_stats process_queue_stats;
+#endif /* PROCESS_CONF_PRIORITY_QUEUES */
+
 /**
  * \name Functions called from application programs
  * @{
@@ -452,6 +489,21 @@ process_current = p
  */
 CCIF process_event_t process_alloc_event(void);
 
+#if PROCESS_CONF_PRIORITY_QUEUES
+/**
+ * \brief      Set the scheduling priority of a process.
+ * \param p    The process
+ * \param priority PROCESS_PRIORITY_HIGH or PROCESS_PRIORITY_NORMAL
+ *
+ *             Events posted to a high-priority process are queued in
+ *             the high-priority event queue and the process is polled
+ *             before all normal-priority processes. This is intended
+ *             for a small number of latency-critical processes, such
+ *             as MAC and radio driver processes.
+ */
+void process_set_priority(struct process *p, unsigned char priority);
+#endif /* PROCESS_CONF_PRIORITY_QUEUES */
+
 /** @} */
 
 /**
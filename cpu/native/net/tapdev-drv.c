@@ -85,6 +85,8 @@ pollhandler(void)
     } else {
       uip_len = 0;
     }
+    /* Come back for the next frame */
+    process_poll(&tapdev_process);
   }
 }
 /*---------------------------------------------------------------------------*/
@@ -75,6 +75,37 @@
 #include "tapdev6.h"
 #include "contiki-net.h"
 
+/* With TAPDEV_CONF_QUEUES set, the tap device is opened with that many
+   queues (IFF_MULTI_QUEUE). Each queue has an I/O thread that reads
+   frames in batches into a ring that tapdev_poll() takes them from, and
+   writes the frames that tapdev_send() puts in another ring. The
+   Contiki thread then makes no system calls per frame, and tapdev_fd()
+   is an eventfd that is readable while received frames are waiting.
+   Linux only. */
+#ifdef TAPDEV_CONF_QUEUES
+#define TAPDEV_QUEUES TAPDEV_CONF_QUEUES
+#else
+#define TAPDEV_QUEUES 0
+#endif
+
+/* Frames in each ring; a power of two */
+#ifdef TAPDEV_CONF_RING_SIZE
+#define RING_SIZE TAPDEV_CONF_RING_SIZE
+#else
+#define RING_SIZE 64
+#endif
+
+#if TAPDEV_QUEUES
+#ifndef linux
+#error "TAPDEV_CONF_QUEUES is only supported on Linux"
+#endif /* linux */
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/eventfd.h>
+#endif /* TAPDEV_QUEUES */
+
 #define DROP 0
 
 #if DROP
@@ -83,6 +114,37 @@ static int drop = 0;
 
 static int fd = -1;
 
+#if TAPDEV_QUEUES
+struct frame {
+  uint16_t len;
+  uint8_t data[UIP_BUFSIZE];
+};
+
+/* A ring with one producer and one consumer thread. head is only
+   written by the producer and tail only by the consumer. */
+struct ring {
+  struct frame frames[RING_SIZE];
+  unsigned head;
+  unsigned tail;
+};
+
+static struct queue {
+  int fd;
+  /* eventfd that wakes up the I/O thread */
+  int wake;
+  /* Set by the I/O thread while rx is full */
+  int rx_blocked;
+  pthread_t thread;
+  struct ring rx;
+  struct ring tx;
+} queues[TAPDEV_QUEUES];
+
+/* eventfd that is signalled when an rx ring becomes non-empty */
+static int rx_event = -1;
+static uint8_t next_queue;
+static unsigned long tx_dropped;
+#endif /* TAPDEV_QUEUES */
+
 static unsigned long lasttime;
 
 #define BUF ((struct uip_eth_hdr *)&uip_buf[0])
@@ -100,11 +162,217 @@ static unsigned long lasttime;
 static void do_send(void);
 uint8_t tapdev_send(const uip_lladdr_t *lladdr);
 
+/*---------------------------------------------------------------------------*/
+#if TAPDEV_QUEUES
+static struct frame *
+ring_put_slot(struct ring *r)
+{
+  if(r->head - __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE) == RING_SIZE) {
+    return NULL;
+  }
+  return &r->frames[r->head % RING_SIZE];
+}
+/*---------------------------------------------------------------------------*/
+/* Returns non-zero if the ring was empty, so the consumer may have to
+   be woken up */
+static int
+ring_put(struct ring *r)
+{
+  unsigned head = r->head;
+
+  __atomic_store_n(&r->head, head + 1, __ATOMIC_SEQ_CST);
+  return __atomic_load_n(&r->tail, __ATOMIC_SEQ_CST) == head;
+}
+/*---------------------------------------------------------------------------*/
+static struct frame *
+ring_get_slot(struct ring *r)
+{
+  if(r->tail == __atomic_load_n(&r->head, __ATOMIC_ACQUIRE)) {
+    return NULL;
+  }
+  return &r->frames[r->tail % RING_SIZE];
+}
+/*---------------------------------------------------------------------------*/
+static void
+ring_get(struct ring *r)
+{
+  __atomic_store_n(&r->tail, r->tail + 1, __ATOMIC_SEQ_CST);
+}
+/*---------------------------------------------------------------------------*/
+static void
+signal_event(int efd)
+{
+  uint64_t one = 1;
+
+  if(write(efd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+    perror("tapdev: eventfd");
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void *
+queue_thread(void *arg)
+{
+  struct queue *q = arg;
+  struct pollfd pfd[2];
+  struct frame *f;
+  uint64_t events;
+  int ret;
+
+  pfd[0].fd = q->fd;
+  pfd[1].fd = q->wake;
+  pfd[1].events = POLLIN;
+  while(1) {
+    /* Leave frames in the device while the rx ring is full */
+    pfd[0].events = ring_put_slot(&q->rx) != NULL ? POLLIN : 0;
+    if(poll(pfd, 2, -1) < 0) {
+      if(errno != EINTR) {
+        perror("tapdev: poll");
+      }
+      continue;
+    }
+    if(pfd[1].revents & POLLIN) {
+      ret = read(q->wake, &events, sizeof(events));
+    }
+
+    /* Read all waiting frames; the Contiki thread is woken up once */
+    while((f = ring_put_slot(&q->rx)) != NULL) {
+      ret = read(q->fd, f->data, sizeof(f->data));
+      if(ret <= 0) {
+        break;
+      }
+      f->len = ret;
+      if(ring_put(&q->rx)) {
+        signal_event(rx_event);
+      }
+    }
+    if(f == NULL) {
+      __atomic_store_n(&q->rx_blocked, 1, __ATOMIC_SEQ_CST);
+      if(ring_put_slot(&q->rx) != NULL) {
+        /* Room was made in between */
+        __atomic_store_n(&q->rx_blocked, 0, __ATOMIC_SEQ_CST);
+      }
+    }
+
+    while((f = ring_get_slot(&q->tx)) != NULL) {
+      if(write(q->fd, f->data, f->len) < 0 && errno != EAGAIN) {
+        perror("tapdev: write");
+      }
+      ring_get(&q->tx);
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+static void
+queues_init(void)
+{
+  struct ifreq ifr;
+  sigset_t all, old;
+  int i;
+
+  rx_event = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if(rx_event == -1) {
+    perror("tapdev: eventfd");
+    exit(1);
+  }
+
+  memset(&ifr, 0, sizeof(ifr));
+  for(i = 0; i < TAPDEV_QUEUES; i++) {
+    queues[i].fd = i == 0 ? fd : open(DEVTAP, O_RDWR);
+    ifr.ifr_flags = IFF_TAP | IFF_NO_PI | IFF_MULTI_QUEUE;
+    if(queues[i].fd == -1 ||
+       ioctl(queues[i].fd, TUNSETIFF, (void *)&ifr) < 0) {
+      perror("tapdev: multi-queue TUNSETIFF");
+      exit(1);
+    }
+    fcntl(queues[i].fd, F_SETFL, O_NONBLOCK);
+    queues[i].wake = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if(queues[i].wake == -1) {
+      perror("tapdev: eventfd");
+      exit(1);
+    }
+  }
+
+  /* Signals, such as the rtimer's SIGALRM, are left to the Contiki
+     thread */
+  sigfillset(&all);
+  pthread_sigmask(SIG_SETMASK, &all, &old);
+  for(i = 0; i < TAPDEV_QUEUES; i++) {
+    if(pthread_create(&queues[i].thread, NULL, queue_thread, &queues[i])) {
+      perror("tapdev: pthread_create");
+      exit(1);
+    }
+  }
+  pthread_sigmask(SIG_SETMASK, &old, NULL);
+}
+/*---------------------------------------------------------------------------*/
+static uint16_t
+queues_poll(void)
+{
+  struct queue *q;
+  struct frame *f;
+  uint64_t events;
+  uint16_t len;
+  int cleared;
+  int i;
+
+  for(cleared = 0; cleared < 2; cleared++) {
+    for(i = 0; i < TAPDEV_QUEUES; i++) {
+      q = &queues[next_queue];
+      next_queue = (next_queue + 1) % TAPDEV_QUEUES;
+      f = ring_get_slot(&q->rx);
+      if(f != NULL) {
+        len = f->len;
+        memcpy(uip_buf, f->data, len);
+        ring_get(&q->rx);
+        if(__atomic_exchange_n(&q->rx_blocked, 0, __ATOMIC_SEQ_CST)) {
+          signal_event(q->wake);
+        }
+        return len;
+      }
+    }
+    /* All rings are empty. Clear the event and look again, as a frame
+       may have been added in between. */
+    if(read(rx_event, &events, sizeof(events)) < 0) {
+      break;
+    }
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static void
+queues_send(void)
+{
+  struct queue *q;
+  struct frame *f;
+  uip_ipaddr_t *dest = &IPBUF->destipaddr;
+
+  /* Frames to the same destination use the same queue and stay in
+     order */
+  q = &queues[(dest->u8[12] ^ dest->u8[13] ^ dest->u8[14] ^ dest->u8[15]) %
+              TAPDEV_QUEUES];
+  f = ring_put_slot(&q->tx);
+  if(f == NULL) {
+    tx_dropped++;
+    PRINTF("tapdev: tx ring full, %lu frames dropped\n", tx_dropped);
+    return;
+  }
+  f->len = uip_len;
+  memcpy(f->data, uip_buf, uip_len);
+  if(ring_put(&q->tx)) {
+    signal_event(q->wake);
+  }
+}
+#endif /* TAPDEV_QUEUES */
 /*---------------------------------------------------------------------------*/
 int
 tapdev_fd(void)
 {
+#if TAPDEV_QUEUES
+  return rx_event;
+#else /* TAPDEV_QUEUES */
   return fd;
+#endif /* TAPDEV_QUEUES */
 }
 
 
@@ -114,6 +382,10 @@ tapdev_poll(void)
   fd_set fdset;
   struct timeval tv;
   int ret;
+
+#if TAPDEV_QUEUES
+  return queues_poll();
+#endif /* TAPDEV_QUEUES */
   
   tv.tv_sec = 0;
   tv.tv_usec = 0;
@@ -302,7 +574,9 @@ tapdev_init(void)
     return;
   }
 
-#ifdef linux
+#if TAPDEV_QUEUES
+  queues_init();
+#elif defined(linux)
   {
     struct ifreq ifr;
     memset(&ifr, 0, sizeof(ifr));
@@ -363,6 +637,11 @@ do_send(void)
   }
 #endif /* DROP */
 
+#if TAPDEV_QUEUES
+  queues_send();
+  return;
+#endif /* TAPDEV_QUEUES */
+
   ret = write(fd, uip_buf, uip_len);
 
   if(ret == -1) {
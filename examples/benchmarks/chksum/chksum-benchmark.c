@@ -0,0 +1,276 @@
+/*
+ * Copyright (c) 2015, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Measures the time it takes to compute the Internet checksum of
+ *         packets of different sizes, at even and odd addresses, and
+ *         the time it takes to update the checksum of a translated
+ *         packet instead of computing it again. The results are
+ *         checked against the original 16-bit loop. Build once with
+ *         the default configuration and once with
+ *         DEFINES=IP_CHKSUM_CONF_WIDE=1 to compare. Only meant for the
+ *         native platform.
+ */
+
+#include "contiki.h"
+#include "lib/random.h"
+#include "net/ip/ip-chksum.h"
+#include "net/ip/uip.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef IP_CHKSUM_CONF_WIDE
+#define WIDE IP_CHKSUM_CONF_WIDE
+#else /* IP_CHKSUM_CONF_WIDE */
+#define WIDE 0
+#endif /* IP_CHKSUM_CONF_WIDE */
+
+#define BYTES_PER_ROUND 50000000UL
+#define MAX_LEN         1500
+#define PSEUDO_V6_LEN   36 /* Addresses and ports of an IPv6 packet */
+#define PSEUDO_V4_LEN   12 /* Addresses and ports of an IPv4 packet */
+
+static const uint16_t sizes[] = { 20, 40, 64, 128, 256, 576, 1280, 1500 };
+
+static uint8_t buf[MAX_LEN + 16];
+static volatile uint16_t sink;
+/*---------------------------------------------------------------------------*/
+static unsigned long
+now_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000UL + ts.tv_nsec;
+}
+/*---------------------------------------------------------------------------*/
+/* The checksum loop uIP used before the checksum module. */
+static uint16_t
+reference_chksum(uint16_t sum, const uint8_t *data, uint16_t len)
+{
+  uint16_t t;
+  const uint8_t *dataptr;
+  const uint8_t *last_byte;
+
+  dataptr = data;
+  last_byte = data + len - 1;
+
+  while(dataptr < last_byte) {
+    t = (dataptr[0] << 8) + dataptr[1];
+    sum += t;
+    if(sum < t) {
+      sum++;
+    }
+    dataptr += 2;
+  }
+
+  if(dataptr == last_byte) {
+    t = (dataptr[0] << 8) + 0;
+    sum += t;
+    if(sum < t) {
+      sum++;
+    }
+  }
+
+  return sum;
+}
+/*---------------------------------------------------------------------------*/
+static void
+fill_random(uint8_t *data, int len)
+{
+  int i;
+
+  for(i = 0; i < len; i++) {
+    data[i] = random_rand();
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Compares the module with the reference loop for all lengths, four
+   alignments and random initial sums. Returns the number of
+   differences. */
+static int
+verify_sums(void)
+{
+  int len, offset, errors;
+  uint16_t sum;
+
+  errors = 0;
+  for(len = 0; len <= MAX_LEN; len++) {
+    for(offset = 0; offset < 4; offset++) {
+      fill_random(buf, sizeof(buf));
+      if(len % 7 == 0) {
+        /* Data that sums to many carries */
+        memset(&buf[offset], 0xff, len);
+      }
+      sum = random_rand();
+      if(ip_chksum_add(sum, &buf[offset], len) !=
+         reference_chksum(sum, &buf[offset], len)) {
+        errors++;
+      }
+    }
+  }
+  return errors;
+}
+/*---------------------------------------------------------------------------*/
+/* Translates random packets by replacing their IPv6 addresses and
+   ports with IPv4 ones, updates their checksums and checks them.
+   Returns the number of bad checksums. */
+static int
+verify_updates(void)
+{
+  int i, errors;
+  uint16_t len, chksum, old_sum, new_sum;
+  uint8_t v4[PSEUDO_V4_LEN];
+
+  errors = 0;
+  for(i = 0; i < 10000; i++) {
+    len = PSEUDO_V6_LEN + random_rand() % (MAX_LEN - PSEUDO_V6_LEN);
+    fill_random(buf, len);
+    fill_random(v4, sizeof(v4));
+
+    chksum = uip_htons(~reference_chksum(0, buf, len));
+    old_sum = ip_chksum_add(0, buf, PSEUDO_V6_LEN);
+    new_sum = ip_chksum_add(0, v4, sizeof(v4));
+    chksum = ip_chksum_update(chksum, old_sum, new_sum);
+
+    /* The translated packet, followed by its checksum, must sum to
+       0xffff. */
+    memmove(&buf[PSEUDO_V4_LEN], &buf[PSEUDO_V6_LEN], len - PSEUDO_V6_LEN);
+    memcpy(buf, v4, sizeof(v4));
+    len -= PSEUDO_V6_LEN - PSEUDO_V4_LEN;
+    if(len & 1) {
+      buf[len++] = 0;
+    }
+    memcpy(&buf[len], &chksum, sizeof(chksum));
+    if(reference_chksum(0, buf, len + 2) != 0xffff) {
+      errors++;
+    }
+  }
+  return errors;
+}
+/*---------------------------------------------------------------------------*/
+static unsigned long
+time_reference(const uint8_t *data, uint16_t len, unsigned long n)
+{
+  unsigned long i, start;
+
+  start = now_ns();
+  for(i = 0; i < n; i++) {
+    sink = reference_chksum(sink, data, len);
+  }
+  return now_ns() - start;
+}
+/*---------------------------------------------------------------------------*/
+static unsigned long
+time_module(const uint8_t *data, uint16_t len, unsigned long n)
+{
+  unsigned long i, start;
+
+  start = now_ns();
+  for(i = 0; i < n; i++) {
+    sink = ip_chksum_add(sink, data, len);
+  }
+  return now_ns() - start;
+}
+/*---------------------------------------------------------------------------*/
+/* Compares computing the checksum of a translated packet from scratch
+   with updating it, in ns per packet. */
+static void
+time_translation(uint16_t len, unsigned long n,
+                 unsigned long *full, unsigned long *update)
+{
+  unsigned long i, start;
+  uint16_t old_sum;
+
+  start = now_ns();
+  for(i = 0; i < n; i++) {
+    sink = ip_chksum_add(sink, buf, len);
+  }
+  *full = (now_ns() - start) / n;
+
+  start = now_ns();
+  for(i = 0; i < n; i++) {
+    old_sum = ip_chksum_add(0, buf, PSEUDO_V6_LEN);
+    sink = ip_chksum_update(sink, old_sum,
+                            ip_chksum_add(0, &buf[PSEUDO_V6_LEN],
+                                          PSEUDO_V4_LEN));
+  }
+  *update = (now_ns() - start) / n;
+}
+/*---------------------------------------------------------------------------*/
+PROCESS(chksum_benchmark_process, "Checksum benchmark");
+AUTOSTART_PROCESSES(&chksum_benchmark_process);
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(chksum_benchmark_process, ev, data)
+{
+  static unsigned long n, reference, module, full, update;
+  static int s, offset;
+
+  PROCESS_BEGIN();
+
+  printf("checksum benchmark, %s summing\n",
+         WIDE ? "wide" : "16-bit");
+
+  printf("verification: %d sum errors, %d update errors\n",
+         verify_sums(), verify_updates());
+
+  fill_random(buf, sizeof(buf));
+  printf("bytes  offset  reference ns  module ns  module MB/s\n");
+  for(s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+    for(offset = 0; offset < 2; offset++) {
+      n = BYTES_PER_ROUND / sizes[s];
+      reference = time_reference(&buf[offset], sizes[s], n);
+      module = time_module(&buf[offset], sizes[s], n);
+      printf("%5u  %6d  %12lu  %9lu  %11lu\n",
+             sizes[s], offset, reference / n, module / n,
+             BYTES_PER_ROUND * 1000 / module);
+    }
+  }
+
+  for(s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+    if(sizes[s] < PSEUDO_V6_LEN) {
+      continue;
+    }
+    time_translation(sizes[s], BYTES_PER_ROUND / sizes[s], &full, &update);
+    printf("translating %4u bytes: recompute %4lu ns, update %3lu ns\n",
+           sizes[s], full, update);
+  }
+
+  exit(0);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,141 @@
+/*
+ * Copyright (c) 2015, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Measures the latency of writing new files to a full Coffee
+ *         file system where old files are removed continuously. Build
+ *         once with the default configuration and once with
+ *         DEFINES=COFFEE_GC_INCREMENTAL=1 to compare. Only meant for
+ *         the native platform, where Coffee runs on top of the
+ *         RAM-backed xmem driver.
+ */
+
+#include "contiki.h"
+#include "cfs/cfs.h"
+#include "cfs/cfs-coffee.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define FILES       40
+#define WRITES      5000
+#define WRITE_SIZE  1024
+
+static unsigned long latency[WRITES];
+/*---------------------------------------------------------------------------*/
+static unsigned long
+now_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000UL + ts.tv_nsec;
+}
+/*---------------------------------------------------------------------------*/
+static int
+compare(const void *a, const void *b)
+{
+  unsigned long x = *(const unsigned long *)a;
+  unsigned long y = *(const unsigned long *)b;
+
+  return x < y ? -1 : x > y;
+}
+/*---------------------------------------------------------------------------*/
+/* Writes a new file and returns the number of sectors erased meanwhile. */
+static int
+write_file(const char *name, int *failed)
+{
+  static char buf[WRITE_SIZE];
+  struct cfs_coffee_gc_stats before, after;
+  int fd;
+
+  cfs_coffee_get_gc_stats(&before);
+  fd = cfs_open(name, CFS_WRITE);
+  if(fd < 0 || cfs_write(fd, buf, sizeof(buf)) != sizeof(buf)) {
+    (*failed)++;
+  }
+  cfs_close(fd);
+  cfs_coffee_get_gc_stats(&after);
+  return after.sectors_erased - before.sectors_erased;
+}
+/*---------------------------------------------------------------------------*/
+PROCESS(coffee_gc_benchmark_process, "Coffee GC benchmark");
+AUTOSTART_PROCESSES(&coffee_gc_benchmark_process);
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(coffee_gc_benchmark_process, ev, data)
+{
+  static struct cfs_coffee_gc_stats stats;
+  static unsigned long start;
+  static int i, erased, max_erased, failed;
+  char name[16];
+
+  PROCESS_BEGIN();
+
+  cfs_coffee_format();
+  max_erased = failed = 0;
+
+  for(i = 0; i < WRITES; i++) {
+    sprintf(name, "log-%d", i % FILES);
+    cfs_remove(name);
+
+    start = now_ns();
+    erased = write_file(name, &failed);
+    latency[i] = now_ns() - start;
+    if(erased > max_erased) {
+      max_erased = erased;
+    }
+
+    /* Let the other processes, such as the garbage collector, run. */
+    PROCESS_PAUSE();
+  }
+
+  cfs_coffee_get_gc_stats(&stats);
+  qsort(latency, WRITES, sizeof(latency[0]), compare);
+
+  printf("coffee gc benchmark, %s collection\n",
+         stats.background_steps > 0 ? "incremental" : "synchronous");
+  printf("write latency: median %lu ns, 99th percentile %lu ns, max %lu ns\n",
+         latency[WRITES / 2], latency[WRITES * 99 / 100], latency[WRITES - 1]);
+  printf("at most %d sectors erased during a write, %d failed writes\n",
+         max_erased, failed);
+  printf("%lu sectors erased, %lu pages isolated, %lu collections, %lu background steps\n",
+         stats.sectors_erased, stats.pages_isolated, stats.collections,
+         stats.background_steps);
+
+  exit(0);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
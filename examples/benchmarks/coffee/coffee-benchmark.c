@@ -0,0 +1,179 @@
+/*
+ * Copyright (c) 2015, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Measures the cost of opening files in Coffee as the number of
+ *         files grows. Build once with the default configuration and
+ *         once with DEFINES=COFFEE_NAME_INDEX_SIZE=4096 to compare. Only
+ *         meant for the native platform, where Coffee runs on top of
+ *         the RAM-backed xmem driver.
+ */
+
+#include "contiki.h"
+#include "lib/random.h"
+#include "cfs/cfs.h"
+#include "cfs/cfs-coffee.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define OPENS 20000
+/* "file-" and any int */
+#define NAME_LEN (sizeof("file-") + 11)
+
+static const int rounds[] = { 100, 1000, 3000 };
+/*---------------------------------------------------------------------------*/
+static unsigned long
+now_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000UL + ts.tv_nsec;
+}
+/*---------------------------------------------------------------------------*/
+static void
+file_name(char *name, int i)
+{
+  snprintf(name, NAME_LEN, "file-%d", i);
+}
+/*---------------------------------------------------------------------------*/
+static int
+create_file(int i)
+{
+  char name[NAME_LEN];
+  int fd;
+
+  file_name(name, i);
+  if(cfs_coffee_reserve(name, 32) < 0) {
+    return -1;
+  }
+  fd = cfs_open(name, CFS_WRITE);
+  if(fd < 0) {
+    return -1;
+  }
+  cfs_write(fd, name, strlen(name) + 1);
+  cfs_close(fd);
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+/* Opens the file and checks that it holds its own name. */
+static int
+check_file(int i)
+{
+  char name[NAME_LEN], buf[NAME_LEN];
+  int fd, n;
+
+  file_name(name, i);
+  fd = cfs_open(name, CFS_READ);
+  if(fd < 0) {
+    return 0;
+  }
+  /* Coffee does not count trailing zeroes in the file size. */
+  memset(buf, 0, sizeof(buf));
+  n = cfs_read(fd, buf, sizeof(buf));
+  cfs_close(fd);
+  return n > 0 && strcmp(name, buf) == 0;
+}
+/*---------------------------------------------------------------------------*/
+PROCESS(coffee_benchmark_process, "Coffee benchmark");
+AUTOSTART_PROCESSES(&coffee_benchmark_process);
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(coffee_benchmark_process, ev, data)
+{
+  static unsigned long start, create_ns, open_ns, miss_ns;
+  static int r, i, n, errors;
+  char name[NAME_LEN];
+
+  PROCESS_BEGIN();
+
+#ifdef COFFEE_NAME_INDEX_SIZE
+  printf("coffee benchmark, name index size %d\n", COFFEE_NAME_INDEX_SIZE);
+#else
+  printf("coffee benchmark, no name index\n");
+#endif
+
+  for(r = 0; r < sizeof(rounds) / sizeof(rounds[0]); r++) {
+    n = rounds[r];
+    cfs_coffee_format();
+    errors = 0;
+
+    start = now_ns();
+    for(i = 0; i < n; i++) {
+      if(create_file(i) < 0) {
+        errors++;
+      }
+    }
+    create_ns = now_ns() - start;
+
+    start = now_ns();
+    for(i = 0; i < OPENS; i++) {
+      if(!check_file(random_rand() % n)) {
+        errors++;
+      }
+    }
+    open_ns = now_ns() - start;
+
+    start = now_ns();
+    for(i = 0; i < OPENS; i++) {
+      file_name(name, n + i);
+      if(cfs_open(name, CFS_READ) >= 0) {
+        errors++;
+      }
+    }
+    miss_ns = now_ns() - start;
+
+    /* Remove every other file and check that the rest remain. */
+    for(i = 0; i < n; i += 2) {
+      file_name(name, i);
+      if(cfs_remove(name) < 0) {
+        errors++;
+      }
+    }
+    for(i = 0; i < n; i++) {
+      if(check_file(i) != (i & 1)) {
+        errors++;
+      }
+    }
+
+    printf("%5d files: create %7lu ns/file, open %7lu ns, failed open %7lu ns, %d errors\n",
+           n, create_ns / n, open_ns / OPENS, miss_ns / OPENS, errors);
+  }
+
+  exit(0);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
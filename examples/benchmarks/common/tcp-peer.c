@@ -0,0 +1,287 @@
+/*
+ * Copyright (c) 2015, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         A remote TCP host simulated within a benchmark.
+ */
+
+#include "tcp-peer.h"
+
+#include <string.h>
+
+#define PEER_ISS        1000UL
+#define MAX_PENDING     32
+#define MAX_OUT_OF_ORDER 16
+#define MAX_REPLY       128
+
+#define TCP_SYN         0x02
+#define TCP_ACK         0x10
+#define TCP_OPT_MSS     2
+#define TCP_OPT_MSS_LEN 4
+
+#define UIP_IP_BUF  ((struct uip_ip_hdr *)&uip_buf[UIP_LLH_LEN])
+#define UIP_TCP_BUF ((struct uip_tcpip_hdr *)&uip_buf[UIP_LLH_LEN])
+
+/* A packet from the remote host, delivered at a later time */
+struct pending {
+  struct timer due;
+  uint32_t seqno;
+  uint32_t ackno;
+  uint8_t flags;
+  uint8_t len;
+  uint8_t data[MAX_REPLY];
+};
+
+static struct pending pending[MAX_PENDING];
+static int pending_count;
+
+/* Segments the remote host has received ahead of a lost one */
+struct range {
+  uint32_t seqno;
+  uint16_t len;
+};
+
+static struct range out_of_order[MAX_OUT_OF_ORDER];
+static int out_of_order_count;
+
+static uint16_t peer_port;
+static clock_time_t peer_rtt;
+static uint16_t peer_window;
+static unsigned peer_drop_interval;
+static tcp_peer_input_t peer_input;
+
+static uint16_t local_port;
+static uint32_t rcv_nxt, snd_nxt;
+static uint32_t data_start;
+static uint8_t reply[MAX_REPLY];
+static uint8_t reply_len;
+
+uip_ipaddr_t tcp_peer_addr;
+struct tcp_peer_stats tcp_peer_stats;
+/*---------------------------------------------------------------------------*/
+static uint32_t
+get32(const uint8_t *p)
+{
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+    ((uint32_t)p[2] << 8) | p[3];
+}
+/*---------------------------------------------------------------------------*/
+static void
+put32(uint8_t *p, uint32_t v)
+{
+  p[0] = v >> 24;
+  p[1] = v >> 16;
+  p[2] = v >> 8;
+  p[3] = v;
+}
+/*---------------------------------------------------------------------------*/
+static void
+schedule(uint8_t flags, const uint8_t *data, uint8_t len)
+{
+  if(pending_count < MAX_PENDING) {
+    timer_set(&pending[pending_count].due, peer_rtt);
+    pending[pending_count].seqno = snd_nxt;
+    pending[pending_count].ackno = rcv_nxt;
+    pending[pending_count].flags = flags;
+    pending[pending_count].len = len;
+    memcpy(pending[pending_count].data, data, len);
+    pending_count++;
+    snd_nxt += len;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+receive(uint32_t seqno, uint16_t len)
+{
+  int i, found;
+
+  if((int32_t)(seqno - rcv_nxt) > 0) {
+    if(out_of_order_count < MAX_OUT_OF_ORDER) {
+      out_of_order[out_of_order_count].seqno = seqno;
+      out_of_order[out_of_order_count].len = len;
+      out_of_order_count++;
+    }
+    return;
+  }
+  if((int32_t)(seqno + len - rcv_nxt) <= 0) {
+    /* Already received */
+    return;
+  }
+  tcp_peer_stats.received += seqno + len - rcv_nxt;
+  rcv_nxt = seqno + len;
+
+  /* Take in the segments that are now in order */
+  do {
+    found = 0;
+    for(i = 0; i < out_of_order_count; i++) {
+      if((int32_t)(out_of_order[i].seqno - rcv_nxt) <= 0) {
+        seqno = out_of_order[i].seqno;
+        len = out_of_order[i].len;
+        out_of_order[i] = out_of_order[--out_of_order_count];
+        if((int32_t)(seqno + len - rcv_nxt) > 0) {
+          tcp_peer_stats.received += seqno + len - rcv_nxt;
+          rcv_nxt = seqno + len;
+        }
+        found = 1;
+        break;
+      }
+    }
+  } while(found);
+}
+/*---------------------------------------------------------------------------*/
+/* The remote host receives the packets that uIP sends. */
+static uint8_t
+output(const uip_lladdr_t *lladdr)
+{
+  uint32_t seqno;
+  int hdrlen;
+  int len;
+
+  if(UIP_IP_BUF->proto != UIP_PROTO_TCP) {
+    return 0;
+  }
+  hdrlen = (UIP_TCP_BUF->tcpoffset >> 4) << 2;
+  len = uip_len - UIP_IPH_LEN - hdrlen;
+  seqno = get32(UIP_TCP_BUF->seqno);
+  if(UIP_TCP_BUF->flags & TCP_SYN) {
+    local_port = UIP_TCP_BUF->srcport;
+    rcv_nxt = seqno + 1;
+    data_start = seqno + 1;
+    snd_nxt = PEER_ISS;
+    schedule(TCP_SYN | TCP_ACK, NULL, 0);
+    snd_nxt++;
+  } else if(len > 0) {
+    tcp_peer_stats.segments++;
+    if(peer_drop_interval > 0 &&
+       tcp_peer_stats.segments % peer_drop_interval == 0) {
+      tcp_peer_stats.dropped++;
+      return 0;
+    }
+    if(uip_tcpchksum() != 0xffff) {
+      tcp_peer_stats.bad_checksums++;
+      return 0;
+    }
+    reply_len = 0;
+    peer_input(seqno - data_start,
+               &uip_buf[UIP_LLH_LEN + UIP_IPH_LEN + hdrlen], len);
+    receive(seqno, len);
+    schedule(TCP_ACK, reply, reply_len);
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static void
+deliver(struct pending *p)
+{
+  int hdrlen;
+
+  /* The SYN announces an MSS so that uIP sends full-sized segments */
+  hdrlen = UIP_TCPH_LEN;
+  if(p->flags & TCP_SYN) {
+    hdrlen += TCP_OPT_MSS_LEN;
+  }
+
+  memset(uip_buf, 0, UIP_IPTCPH_LEN + UIP_LLH_LEN + TCP_OPT_MSS_LEN);
+  UIP_IP_BUF->vtc = 0x60;
+  UIP_IP_BUF->len[0] = (hdrlen + p->len) >> 8;
+  UIP_IP_BUF->len[1] = (hdrlen + p->len) & 0xff;
+  UIP_IP_BUF->proto = UIP_PROTO_TCP;
+  UIP_IP_BUF->ttl = 64;
+  uip_ipaddr_copy(&UIP_IP_BUF->srcipaddr, &tcp_peer_addr);
+  uip_ipaddr_copy(&UIP_IP_BUF->destipaddr,
+                  &uip_ds6_get_link_local(-1)->ipaddr);
+  UIP_TCP_BUF->srcport = UIP_HTONS(peer_port);
+  UIP_TCP_BUF->destport = local_port;
+  put32(UIP_TCP_BUF->seqno, p->seqno);
+  put32(UIP_TCP_BUF->ackno, p->ackno);
+  UIP_TCP_BUF->tcpoffset = (hdrlen / 4) << 4;
+  if(p->flags & TCP_SYN) {
+    UIP_TCP_BUF->optdata[0] = TCP_OPT_MSS;
+    UIP_TCP_BUF->optdata[1] = TCP_OPT_MSS_LEN;
+    UIP_TCP_BUF->optdata[2] = UIP_TCP_MSS >> 8;
+    UIP_TCP_BUF->optdata[3] = UIP_TCP_MSS & 0xff;
+  }
+  UIP_TCP_BUF->flags = p->flags;
+  UIP_TCP_BUF->wnd[0] = peer_window >> 8;
+  UIP_TCP_BUF->wnd[1] = peer_window & 0xff;
+  memcpy(&uip_buf[UIP_LLH_LEN + UIP_IPH_LEN + hdrlen], p->data, p->len);
+  uip_len = UIP_IPH_LEN + hdrlen + p->len;
+  UIP_TCP_BUF->tcpchksum = ~uip_tcpchksum();
+  tcpip_input();
+}
+/*---------------------------------------------------------------------------*/
+void
+tcp_peer_init(uint16_t port, clock_time_t rtt, uint16_t window,
+              unsigned drop_interval, tcp_peer_input_t input)
+{
+  uip_ds6_nbr_t *nbr;
+
+  peer_port = port;
+  peer_rtt = rtt;
+  peer_window = window;
+  peer_drop_interval = drop_interval;
+  peer_input = input;
+
+  tcpip_set_outputfunc(output);
+  uip_ip6addr(&tcp_peer_addr, 0xfe80, 0, 0, 0, 0, 0, 0, 1);
+  /* The remote host does not answer neighbor solicitations, so keep
+     it reachable for the whole run. */
+  nbr = uip_ds6_nbr_add(&tcp_peer_addr, (uip_lladdr_t *)&linkaddr_null, 0,
+                        NBR_REACHABLE);
+  stimer_set(&nbr->reachable, 3600);
+}
+/*---------------------------------------------------------------------------*/
+int
+tcp_peer_write(const uint8_t *data, uint8_t len)
+{
+  if(reply_len + len > MAX_REPLY) {
+    return 0;
+  }
+  memcpy(&reply[reply_len], data, len);
+  reply_len += len;
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+void
+tcp_peer_poll(void)
+{
+  struct pending p;
+
+  while(pending_count > 0 && timer_expired(&pending[0].due)) {
+    p = pending[0];
+    pending_count--;
+    memmove(&pending[0], &pending[1], pending_count * sizeof(pending[0]));
+    deliver(&p);
+  }
+}
+/*---------------------------------------------------------------------------*/
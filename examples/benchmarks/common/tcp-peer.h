@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2015, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         A remote TCP host simulated within a benchmark. Packets that
+ *         uIP sends are taken from the IP output function, and the
+ *         host's answers are fed back into uIP after a round-trip
+ *         time. The host accepts one connection, acknowledges the data
+ *         it receives and can send data back in its ACKs.
+ */
+
+#ifndef TCP_PEER_H_
+#define TCP_PEER_H_
+
+#include "contiki.h"
+#include "contiki-net.h"
+
+/**
+ * \brief      Called for each data segment that the remote host receives
+ * \param offset The offset of the data in the byte stream
+ * \param data The data of the segment
+ * \param len  The length of the data
+ *
+ *             The function is called for retransmitted and out of
+ *             order segments as well. It may call tcp_peer_write() to
+ *             send data back in the ACK of the segment.
+ */
+typedef void (*tcp_peer_input_t)(uint32_t offset, const uint8_t *data,
+                                 uint16_t len);
+
+struct tcp_peer_stats {
+  unsigned long received;      /* bytes received in order */
+  unsigned long segments;      /* data segments sent by uIP */
+  unsigned long dropped;       /* data segments dropped on purpose */
+  unsigned long bad_checksums; /* data segments with a bad checksum */
+};
+
+extern uip_ipaddr_t tcp_peer_addr;
+extern struct tcp_peer_stats tcp_peer_stats;
+
+/**
+ * \brief      Start simulating the remote host
+ * \param port The port that the host listens on
+ * \param rtt  The round-trip time
+ * \param window The window that the host advertises
+ * \param drop_interval Drop every Nth data segment, or 0 to drop none
+ * \param input The function called for each received data segment
+ *
+ *             The host has the address fe80::1 and is kept reachable
+ *             for the whole run.
+ */
+void tcp_peer_init(uint16_t port, clock_time_t rtt, uint16_t window,
+                   unsigned drop_interval, tcp_peer_input_t input);
+
+/**
+ * \brief      Send data back in the ACK of the segment being received
+ * \return     1 if the data was added, 0 if it does not fit
+ *
+ *             This function may only be called from the input function.
+ */
+int tcp_peer_write(const uint8_t *data, uint8_t len);
+
+/**
+ * \brief      Feed the packets that are due into uIP
+ *
+ *             This function should be called at least once per clock
+ *             tick.
+ */
+void tcp_peer_poll(void);
+
+#endif /* TCP_PEER_H_ */
@@ -0,0 +1,236 @@
+/*
+ * Copyright (c) 2015, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Measures the per-packet cost of finding the connection an
+ *         incoming TCP segment or UDP datagram belongs to, with a
+ *         growing number of open connections. Build once with the
+ *         default linear search and once with
+ *         DEFINES=UIP_CONF_CONN_HASH=1 to compare. Only meant for the
+ *         native platform.
+ */
+
+#include "contiki.h"
+#include "lib/random.h"
+#include "net/ip/uip.h"
+#include "net/ipv6/uip-ds6.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define PACKETS     200000
+#define LOCAL_PORT  80
+#define REMOTE_PORT 5000
+#define PACKET_LEN  (UIP_IPUDPH_LEN + 8)
+
+#define UIP_IP_BUF   ((struct uip_ip_hdr *)&uip_buf[UIP_LLH_LEN])
+#define UIP_TCP_BUF  ((struct uip_tcpip_hdr *)&uip_buf[UIP_LLH_LEN])
+#define UIP_UDP_BUF  ((struct uip_udpip_hdr *)&uip_buf[UIP_LLH_LEN])
+
+#define TCP_ACK 0x10
+
+static const int rounds[] = { 10, 50, 100, 250 };
+
+/* A prebuilt packet for each connection */
+static uint8_t tcp_packets[UIP_CONNS][UIP_IPTCPH_LEN];
+static uint8_t udp_packets[UIP_UDP_CONNS][PACKET_LEN];
+static struct uip_conn *tcp_conns[UIP_CONNS];
+static struct uip_udp_conn *udp_conns[UIP_UDP_CONNS];
+static int tcp_count, udp_count;
+/*---------------------------------------------------------------------------*/
+static unsigned long
+now_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000UL + ts.tv_nsec;
+}
+/*---------------------------------------------------------------------------*/
+static void
+remote_addr(uip_ipaddr_t *addr, int i)
+{
+  uip_ip6addr(addr, 0xfe80, 0, 0, 0, 0x0200, 0, 0, i + 1);
+}
+/*---------------------------------------------------------------------------*/
+static void
+ip_header(int i, uint8_t proto, int len)
+{
+  memset(uip_buf, 0, UIP_LLH_LEN + len);
+  UIP_IP_BUF->vtc = 0x60;
+  UIP_IP_BUF->len[0] = (len - UIP_IPH_LEN) >> 8;
+  UIP_IP_BUF->len[1] = (len - UIP_IPH_LEN) & 0xff;
+  UIP_IP_BUF->proto = proto;
+  UIP_IP_BUF->ttl = 64;
+  remote_addr(&UIP_IP_BUF->srcipaddr, i);
+  uip_ipaddr_copy(&UIP_IP_BUF->destipaddr,
+                  &uip_ds6_get_link_local(-1)->ipaddr);
+  uip_len = len;
+}
+/*---------------------------------------------------------------------------*/
+/* Opens a TCP connection in the ESTABLISHED state without a handshake
+   and prepares a pure ACK for it, which uIP processes without
+   changing the state of the connection. */
+static void
+add_tcp_conn(void)
+{
+  uip_ipaddr_t addr;
+  struct uip_conn *conn;
+  int i = tcp_count;
+
+  remote_addr(&addr, i);
+  conn = uip_connect(&addr, UIP_HTONS(REMOTE_PORT));
+  if(conn == NULL) {
+    printf("uip_connect failed\n");
+    exit(1);
+  }
+  conn->tcpstateflags = UIP_ESTABLISHED;
+  conn->len = 0;
+
+  ip_header(i, UIP_PROTO_TCP, UIP_IPTCPH_LEN);
+  UIP_TCP_BUF->srcport = conn->rport;
+  UIP_TCP_BUF->destport = conn->lport;
+  memcpy(UIP_TCP_BUF->seqno, conn->rcv_nxt, 4);
+  memcpy(UIP_TCP_BUF->ackno, conn->snd_nxt, 4);
+  UIP_TCP_BUF->tcpoffset = (UIP_TCPH_LEN / 4) << 4;
+  UIP_TCP_BUF->flags = TCP_ACK;
+  UIP_TCP_BUF->wnd[0] = 1;
+  UIP_TCP_BUF->tcpchksum = ~uip_tcpchksum();
+  memcpy(tcp_packets[i], &uip_buf[UIP_LLH_LEN], UIP_IPTCPH_LEN);
+
+  tcp_conns[tcp_count++] = conn;
+}
+/*---------------------------------------------------------------------------*/
+static void
+add_udp_conn(void)
+{
+  struct uip_udp_conn *conn;
+  int i = udp_count;
+
+  conn = uip_udp_new(NULL, 0);
+  if(conn == NULL) {
+    printf("uip_udp_new failed\n");
+    exit(1);
+  }
+  uip_udp_bind(conn, UIP_HTONS(REMOTE_PORT + i));
+
+  ip_header(i, UIP_PROTO_UDP, PACKET_LEN);
+  UIP_UDP_BUF->srcport = UIP_HTONS(LOCAL_PORT);
+  UIP_UDP_BUF->destport = conn->lport;
+  UIP_UDP_BUF->udplen = UIP_HTONS(PACKET_LEN - UIP_IPH_LEN);
+  UIP_UDP_BUF->udpchksum = ~uip_udpchksum();
+  memcpy(udp_packets[i], &uip_buf[UIP_LLH_LEN], PACKET_LEN);
+
+  udp_conns[udp_count++] = conn;
+}
+/*---------------------------------------------------------------------------*/
+/* Feeds packets to uIP, either all for the newest connection, which
+   is the worst case for a linear search, or for random connections.
+   Returns the time per packet. */
+static unsigned long
+run_tcp(int n, int newest, int *misses)
+{
+  unsigned long start;
+  int i, k;
+
+  start = now_ns();
+  for(i = 0; i < PACKETS; i++) {
+    k = newest ? n - 1 : random_rand() % n;
+    memcpy(&uip_buf[UIP_LLH_LEN], tcp_packets[k], UIP_IPTCPH_LEN);
+    uip_len = UIP_IPTCPH_LEN;
+    uip_input();
+    if(uip_conn != tcp_conns[k] || uip_len > 0) {
+      (*misses)++;
+    }
+  }
+  return (now_ns() - start) / PACKETS;
+}
+/*---------------------------------------------------------------------------*/
+static unsigned long
+run_udp(int n, int newest, int *misses)
+{
+  unsigned long start;
+  int i, k;
+
+  start = now_ns();
+  for(i = 0; i < PACKETS; i++) {
+    k = newest ? n - 1 : random_rand() % n;
+    memcpy(&uip_buf[UIP_LLH_LEN], udp_packets[k], PACKET_LEN);
+    uip_len = PACKET_LEN;
+    uip_input();
+    if(uip_udp_conn != udp_conns[k]) {
+      (*misses)++;
+    }
+  }
+  return (now_ns() - start) / PACKETS;
+}
+/*---------------------------------------------------------------------------*/
+PROCESS(conn_demux_benchmark_process, "Connection demux benchmark");
+AUTOSTART_PROCESSES(&conn_demux_benchmark_process);
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(conn_demux_benchmark_process, ev, data)
+{
+  static unsigned long tcp_newest, tcp_random, udp_newest, udp_random;
+  static int r, n, misses;
+
+  PROCESS_BEGIN();
+
+  printf("connection demux benchmark, %s, ns/packet for the newest and "
+         "for random connections\n", UIP_CONN_HASH ? "hashed" : "linear");
+
+  for(r = 0; r < sizeof(rounds) / sizeof(rounds[0]); r++) {
+    n = rounds[r];
+    while(tcp_count < n) {
+      add_tcp_conn();
+    }
+    while(udp_count < n) {
+      add_udp_conn();
+    }
+
+    misses = 0;
+    tcp_newest = run_tcp(n, 1, &misses);
+    tcp_random = run_tcp(n, 0, &misses);
+    udp_newest = run_udp(n, 1, &misses);
+    udp_random = run_udp(n, 0, &misses);
+
+    printf("%4d connections: TCP %4lu / %4lu, UDP %4lu / %4lu, %d misses\n",
+           n, tcp_newest, tcp_random, udp_newest, udp_random, misses);
+  }
+
+  exit(0);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
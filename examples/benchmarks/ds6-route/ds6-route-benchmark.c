@@ -0,0 +1,175 @@
+/*
+ * Copyright (c) 2015, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Measures the per-packet cost of uip_ds6_route_lookup() with a
+ *         growing number of host routes. Build once with the default
+ *         route list and once with DEFINES=UIP_CONF_DS6_ROUTE_HASH=1 to
+ *         compare. Only meant for the native platform.
+ */
+
+#include "contiki.h"
+#include "lib/random.h"
+#include "net/ip/uip.h"
+#include "net/ipv6/uip-ds6.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define NEIGHBORS 8
+#define LOOKUPS   100000
+
+static const int rounds[] = { 10, 100, 500, 1000 };
+/*---------------------------------------------------------------------------*/
+static unsigned long
+now_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000UL + ts.tv_nsec;
+}
+/*---------------------------------------------------------------------------*/
+static void
+neighbor_addr(uip_ipaddr_t *addr, int i)
+{
+  uip_ip6addr(addr, 0xfe80, 0, 0, 0, 0x0200, 0, 0, i + 1);
+}
+/*---------------------------------------------------------------------------*/
+static void
+route_addr(uip_ipaddr_t *addr, int i)
+{
+  uip_ip6addr(addr, 0xaaaa, 0, 0, 0, 0x0200, 0, i >> 16, i & 0xffff);
+}
+/*---------------------------------------------------------------------------*/
+static void
+add_neighbors(void)
+{
+  uip_ipaddr_t addr;
+  uip_lladdr_t lladdr;
+  int i;
+
+  for(i = 0; i < NEIGHBORS; i++) {
+    neighbor_addr(&addr, i);
+    memset(&lladdr, 0, sizeof(lladdr));
+    lladdr.addr[sizeof(lladdr.addr) - 1] = i + 1;
+    uip_ds6_nbr_add(&addr, &lladdr, 1, NBR_REACHABLE);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+remove_routes(void)
+{
+  while(uip_ds6_route_head() != NULL) {
+    uip_ds6_route_rm(uip_ds6_route_head());
+  }
+}
+/*---------------------------------------------------------------------------*/
+static int
+check_longest_match(void)
+{
+  uip_ipaddr_t prefix, host, nexthop;
+  uip_ds6_route_t *r;
+
+  /* uip_ds6_route_add() replaces a covering route that goes through
+     another next hop, so the host route is added first. */
+  remove_routes();
+  route_addr(&host, 1);
+  neighbor_addr(&nexthop, 1);
+  uip_ds6_route_add(&host, 128, &nexthop);
+  uip_ip6addr(&prefix, 0xaaaa, 0, 0, 0, 0, 0, 0, 0);
+  neighbor_addr(&nexthop, 0);
+  uip_ds6_route_add(&prefix, 64, &nexthop);
+
+  r = uip_ds6_route_lookup(&host);
+  if(r == NULL || r->length != 128) {
+    return 0;
+  }
+  route_addr(&host, 2);
+  r = uip_ds6_route_lookup(&host);
+  if(r == NULL || r->length != 64) {
+    return 0;
+  }
+  uip_ip6addr(&host, 0xbbbb, 0, 0, 0, 0, 0, 0, 1);
+  return uip_ds6_route_lookup(&host) == NULL;
+}
+/*---------------------------------------------------------------------------*/
+PROCESS(ds6_route_benchmark_process, "DS6 route benchmark");
+AUTOSTART_PROCESSES(&ds6_route_benchmark_process);
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(ds6_route_benchmark_process, ev, data)
+{
+  static uip_ipaddr_t addr, nexthop;
+  static unsigned long start, add_ns, lookup_ns;
+  static int r, i, n, misses;
+
+  PROCESS_BEGIN();
+
+  printf("ds6 route benchmark, %s, max %d routes\n",
+         UIP_DS6_ROUTE_HASH ? "hashed" : "list", UIP_DS6_ROUTE_NB);
+
+  add_neighbors();
+  printf("longest prefix match: %s\n", check_longest_match() ? "ok" : "FAILED");
+
+  for(r = 0; r < sizeof(rounds) / sizeof(rounds[0]); r++) {
+    n = rounds[r];
+    remove_routes();
+
+    start = now_ns();
+    for(i = 0; i < n; i++) {
+      route_addr(&addr, i);
+      neighbor_addr(&nexthop, i % NEIGHBORS);
+      uip_ds6_route_add(&addr, 128, &nexthop);
+    }
+    add_ns = now_ns() - start;
+
+    misses = 0;
+    start = now_ns();
+    for(i = 0; i < LOOKUPS; i++) {
+      route_addr(&addr, random_rand() % n);
+      if(uip_ds6_route_lookup(&addr) == NULL) {
+        misses++;
+      }
+    }
+    lookup_ns = now_ns() - start;
+
+    printf("%5d routes: add %7lu ns/route, lookup %7lu ns/lookup, %d misses\n",
+           uip_ds6_route_num_routes(), add_ns / n, lookup_ns / LOOKUPS, misses);
+  }
+
+  exit(0);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2015, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Measures the cost of setting, stopping and expiring a large
+ *         number of event timers. Build once with the default timer
+ *         list and once with DEFINES=ETIMER_CONF_WHEEL=1 to compare.
+ *         Only meant for the native platform.
+ */
+
+#include "contiki.h"
+#include "lib/random.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define MAX_TIMERS 4000
+
+static struct etimer timers[MAX_TIMERS];
+static const int rounds[] = { 100, 1000, 2000, 4000 };
+/*---------------------------------------------------------------------------*/
+static unsigned long
+now_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000UL + ts.tv_nsec;
+}
+/*---------------------------------------------------------------------------*/
+static unsigned long
+cpu_us(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+  return ts.tv_sec * 1000000UL + ts.tv_nsec / 1000;
+}
+/*---------------------------------------------------------------------------*/
+PROCESS(etimer_benchmark_process, "Etimer benchmark");
+AUTOSTART_PROCESSES(&etimer_benchmark_process);
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(etimer_benchmark_process, ev, data)
+{
+  static int r, i, n, fired;
+  static unsigned long start, set_ns, stop_ns, cpu_start;
+
+  PROCESS_BEGIN();
+
+  printf("etimer benchmark, %s backend\n",
+         ETIMER_CONF_WHEEL ? "timing wheel" : "list");
+
+  for(r = 0; r < sizeof(rounds) / sizeof(rounds[0]); r++) {
+    n = rounds[r];
+
+    /* Arm long timers that will not expire during the measurement. */
+    start = now_ns();
+    for(i = 0; i < n; i++) {
+      etimer_set(&timers[i], 60 * CLOCK_SECOND +
+                 random_rand() % (60 * CLOCK_SECOND));
+    }
+    set_ns = now_ns() - start;
+
+    start = now_ns();
+    for(i = 0; i < n; i++) {
+      etimer_stop(&timers[i]);
+    }
+    stop_ns = now_ns() - start;
+
+    /* Arm short timers and let all of them expire. */
+    cpu_start = cpu_us();
+    for(i = 0; i < n; i++) {
+      etimer_set(&timers[i], 1 + random_rand() % (CLOCK_SECOND / 5));
+    }
+    fired = 0;
+    while(fired < n) {
+      PROCESS_WAIT_EVENT_UNTIL(ev == PROCESS_EVENT_TIMER);
+      fired++;
+    }
+
+    printf("%5d timers: set %6lu ns/timer, stop %6lu ns/timer, "
+           "set+expire %8lu us cpu\n",
+           n, set_ns / n, stop_ns / n, cpu_us() - cpu_start);
+  }
+
+  exit(0);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,208 @@
+/*
+ * Copyright (c) 2015, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Measures how many UDP packets per second ip64 translates as
+ *         the number of active address mappings grows. Each packet
+ *         from a random flow is translated from IPv6 to IPv4, and its
+ *         reply back from IPv4 to IPv6. Build once with the default
+ *         configuration and once with DEFINES=IP64_ADDRMAP_CONF_HASH=1
+ *         to compare. Only meant for the native platform.
+ */
+
+#include "contiki.h"
+#include "lib/random.h"
+#include "ip64.h"
+#include "ip64-addrmap.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define PACKETS     20000
+#define MAX_FLOWS   9000
+#define PAYLOAD_LEN 16
+
+#define IPV6_HDRLEN 40
+#define IPV4_HDRLEN 20
+#define UDP_HDRLEN  8
+
+#define PROTO_UDP   17
+
+/* The mapped ports are picked from 10000 ports */
+static const int rounds[] = { 10, 100, 1000, 5000, MAX_FLOWS };
+
+static uint16_t mapped_ports[MAX_FLOWS];
+static int flows;
+
+static uint8_t ipv6packet[IPV6_HDRLEN + UDP_HDRLEN + PAYLOAD_LEN];
+static uint8_t ipv4packet[IPV4_HDRLEN + UDP_HDRLEN + PAYLOAD_LEN];
+static uint8_t result[IPV6_HDRLEN + UDP_HDRLEN + PAYLOAD_LEN];
+static unsigned long translated;
+/*---------------------------------------------------------------------------*/
+static unsigned long
+now_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000UL + ts.tv_nsec;
+}
+/*---------------------------------------------------------------------------*/
+/* A request from flow n, from one of the sensors to port 5683 of
+   192.0.2.1 */
+static void
+make_ipv6_packet(int n)
+{
+  uint8_t *udp = &ipv6packet[IPV6_HDRLEN];
+  uint16_t srcport = 1024 + n % 10;
+
+  memset(ipv6packet, 0, IPV6_HDRLEN);
+  ipv6packet[0] = 0x60;
+  ipv6packet[5] = UDP_HDRLEN + PAYLOAD_LEN;
+  ipv6packet[6] = PROTO_UDP;
+  ipv6packet[7] = 64;
+  /* Source fd00::<sensor>, ten flows per sensor */
+  ipv6packet[8] = 0xfd;
+  ipv6packet[22] = (n / 10) >> 8;
+  ipv6packet[23] = (n / 10) & 0xff;
+  /* Destination ::ffff:192.0.2.1 */
+  ipv6packet[34] = 0xff;
+  ipv6packet[35] = 0xff;
+  ipv6packet[36] = 192;
+  ipv6packet[37] = 0;
+  ipv6packet[38] = 2;
+  ipv6packet[39] = 1;
+
+  udp[0] = srcport >> 8;
+  udp[1] = srcport & 0xff;
+  udp[2] = 5683 >> 8;
+  udp[3] = 5683 & 0xff;
+  udp[4] = 0;
+  udp[5] = UDP_HDRLEN + PAYLOAD_LEN;
+  udp[6] = 0x12;
+  udp[7] = 0x34;
+}
+/*---------------------------------------------------------------------------*/
+/* The reply to flow n */
+static void
+make_ipv4_packet(int n)
+{
+  uint8_t *udp = &ipv4packet[IPV4_HDRLEN];
+  uint16_t len = IPV4_HDRLEN + UDP_HDRLEN + PAYLOAD_LEN;
+
+  memset(ipv4packet, 0, IPV4_HDRLEN);
+  ipv4packet[0] = 0x45;
+  ipv4packet[2] = len >> 8;
+  ipv4packet[3] = len & 0xff;
+  ipv4packet[8] = 64;
+  ipv4packet[9] = PROTO_UDP;
+  ipv4packet[12] = 192;
+  ipv4packet[13] = 0;
+  ipv4packet[14] = 2;
+  ipv4packet[15] = 1;
+  ipv4packet[16] = 10;
+  ipv4packet[19] = 1;
+
+  udp[0] = 5683 >> 8;
+  udp[1] = 5683 & 0xff;
+  udp[2] = mapped_ports[n] >> 8;
+  udp[3] = mapped_ports[n] & 0xff;
+  udp[4] = 0;
+  udp[5] = UDP_HDRLEN + PAYLOAD_LEN;
+  udp[6] = 0x12;
+  udp[7] = 0x34;
+}
+/*---------------------------------------------------------------------------*/
+static int
+translate(int n)
+{
+  uint8_t *udp = &result[IPV4_HDRLEN];
+
+  make_ipv6_packet(n);
+  if(ip64_6to4(ipv6packet, sizeof(ipv6packet), result) == 0) {
+    return 0;
+  }
+  mapped_ports[n] = (udp[0] << 8) | udp[1];
+  make_ipv4_packet(n);
+  if(ip64_4to6(ipv4packet, sizeof(ipv4packet), result) == 0 ||
+     memcmp(&result[24], &ipv6packet[8], 16) != 0) {
+    return 0;
+  }
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+PROCESS(ip64_addrmap_benchmark_process, "ip64 address map benchmark");
+AUTOSTART_PROCESSES(&ip64_addrmap_benchmark_process);
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(ip64_addrmap_benchmark_process, ev, data)
+{
+  static uip_ip4addr_t addr, netmask;
+  static unsigned long start, elapsed;
+  static int r, i, n;
+
+  PROCESS_BEGIN();
+
+  ip64_addrmap_init();
+  uip_ipaddr(&addr, 10, 0, 0, 1);
+  uip_ipaddr(&netmask, 255, 255, 255, 0);
+  ip64_set_hostaddr(&addr);
+  ip64_set_netmask(&netmask);
+
+  printf("ip64 address map benchmark, IP64_ADDRMAP_HASH %d, "
+         "packets/s translated in both directions\n", IP64_ADDRMAP_HASH);
+
+  for(r = 0; r < sizeof(rounds) / sizeof(rounds[0]); r++) {
+    n = rounds[r];
+    while(flows < n) {
+      translate(flows++);
+    }
+
+    translated = 0;
+    start = now_ns();
+    for(i = 0; i < PACKETS; i++) {
+      translated += translate(random_rand() % n);
+    }
+    elapsed = now_ns() - start;
+
+    printf("%5d mappings: %8lu packets/s, %s\n", n,
+           (unsigned long)(PACKETS * 1000000000ULL / elapsed),
+           translated == PACKETS ? "all translated" : "FAILED");
+  }
+
+  exit(0);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,197 @@
+/*
+ * Copyright (c) 2015, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Tokenizes a JSON configuration document of about 32 kilobytes
+ *         with jsonparse, which needs the whole document in memory,
+ *         and with jsonstream, which is fed the document in chunks.
+ *         Checks that both report the same tokens and values, and
+ *         prints the throughput and the memory that each one needs.
+ *         Only meant for the native platform.
+ */
+
+#include "contiki.h"
+#include "jsonparse.h"
+#include "jsonstream.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define ENTRIES    300
+#define DOC_SIZE   (ENTRIES * 128)
+#define ROUNDS     200
+
+static const int chunk_sizes[] = { 1, 16, 64, 512 };
+
+static char doc[DOC_SIZE];
+static int doc_len;
+
+struct result {
+  unsigned long tokens;
+  unsigned long sum;
+};
+/*---------------------------------------------------------------------------*/
+static unsigned long
+now_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000UL + ts.tv_nsec;
+}
+/*---------------------------------------------------------------------------*/
+/* Only uses the subset of JSON that jsonparse handles */
+static void
+make_document(void)
+{
+  int i;
+
+  doc_len = sprintf(doc, "{\"interval\": 60,\n \"sensors\": [\n");
+  for(i = 0; i < ENTRIES; i++) {
+    doc_len += sprintf(doc + doc_len,
+                       "  {\"id\": %d, \"name\": \"sensor-%d\", "
+                       "\"unit\": \"celsius\", \"period\": %d,\n"
+                       "   \"limits\": [%d, %d.5], \"tags\": [\"room\", "
+                       "\"floor-%d\"]}%s\n",
+                       i, i, 10 + i % 50, i % 20, 40 + i % 30, i % 8,
+                       i < ENTRIES - 1 ? "," : "");
+  }
+  doc_len += sprintf(doc + doc_len, " ]\n}\n");
+}
+/*---------------------------------------------------------------------------*/
+static unsigned long
+add_value(unsigned long sum, const char *value, int len)
+{
+  while(len-- > 0) {
+    sum = sum * 31 + (unsigned char)*value++;
+  }
+  return sum;
+}
+/*---------------------------------------------------------------------------*/
+static void
+parse(struct result *r)
+{
+  static struct jsonparse_state js;
+  char buf[32];
+  int type;
+
+  jsonparse_setup(&js, doc, doc_len);
+  while((type = jsonparse_next(&js)) != 0) {
+    if(type == JSON_TYPE_PAIR_NAME || type == JSON_TYPE_STRING ||
+       type == JSON_TYPE_NUMBER) {
+      jsonparse_copy_value(&js, buf, sizeof(buf));
+      r->sum = add_value(r->sum, buf, strlen(buf));
+    }
+    if(type != ',' && type != ':') {
+      r->tokens++;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+token(struct jsonstream_state *state, int type, const char *value, int len,
+      int more)
+{
+  struct result *r = state->ptr;
+
+  r->sum = add_value(r->sum, value, len);
+  if(!more) {
+    r->tokens++;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static int
+stream(struct result *r, int chunk_size)
+{
+  static struct jsonstream_state js;
+  int pos, len;
+
+  jsonstream_setup(&js, token, r);
+  for(pos = 0; pos < doc_len; pos += len) {
+    len = doc_len - pos < chunk_size ? doc_len - pos : chunk_size;
+    if(jsonstream_feed(&js, doc + pos, len) != JSON_ERROR_OK) {
+      break;
+    }
+  }
+  return jsonstream_end(&js);
+}
+/*---------------------------------------------------------------------------*/
+PROCESS(json_stream_benchmark_process, "JSON stream benchmark");
+AUTOSTART_PROCESSES(&json_stream_benchmark_process);
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(json_stream_benchmark_process, ev, data)
+{
+  static struct result expected, r;
+  static unsigned long start, elapsed;
+  static int i, c, error;
+
+  PROCESS_BEGIN();
+
+  make_document();
+  printf("JSON stream benchmark, %d byte document\n", doc_len);
+
+  start = now_ns();
+  for(i = 0; i < ROUNDS; i++) {
+    memset(&expected, 0, sizeof(expected));
+    parse(&expected);
+  }
+  elapsed = now_ns() - start;
+  printf("jsonparse:                  %6lu kB/s, %5d bytes of RAM, "
+         "%lu tokens\n",
+         (unsigned long)((unsigned long long)doc_len * ROUNDS *
+                         1000000 / elapsed),
+         doc_len + (int)sizeof(struct jsonparse_state), expected.tokens);
+
+  for(c = 0; c < sizeof(chunk_sizes) / sizeof(chunk_sizes[0]); c++) {
+    start = now_ns();
+    for(i = 0; i < ROUNDS; i++) {
+      memset(&r, 0, sizeof(r));
+      error = stream(&r, chunk_sizes[c]);
+    }
+    elapsed = now_ns() - start;
+    printf("jsonstream, %3d byte chunks: %6lu kB/s, %5d bytes of RAM, "
+           "%lu tokens, %s\n", chunk_sizes[c],
+           (unsigned long)((unsigned long long)doc_len * ROUNDS *
+                           1000000 / elapsed),
+           chunk_sizes[c] + (int)sizeof(struct jsonstream_state), r.tokens,
+           error == JSON_ERROR_OK && r.tokens == expected.tokens &&
+           r.sum == expected.sum ? "same as jsonparse" : "MISMATCH");
+  }
+
+  exit(0);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,279 @@
+/*
+ * Copyright (c) 2015, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Serializes a JSON tree of about 16 kilobytes in blocks of 64
+ *         bytes, as for CoAP block2 or a TCP connection. Compares
+ *         jsontree_print_next() with a putchar function that fills the
+ *         block, with jsontree_print_block(). For CoAP servers that
+ *         serve one block per request, also compares regenerating the
+ *         document up to each block with jsontree_seek(), with a
+ *         fresh context for each request and with a context that is
+ *         kept between requests. Only meant for the native platform.
+ */
+
+#include "contiki.h"
+#include "jsontree.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define ENTRIES    200
+#define BLOCK_SIZE 64
+#define DOC_SIZE   (ENTRIES * 96)
+#define ROUNDS     200
+
+static struct jsontree_string name = JSONTREE_STRING("temperature \"A\"");
+static struct jsontree_string unit = JSONTREE_STRING("celsius");
+static struct jsontree_int period = { JSON_TYPE_INT, 60 };
+static struct jsontree_int limit = { JSON_TYPE_INT, -40 };
+
+static int
+value_output(struct jsontree_context *js_ctx)
+{
+  jsontree_write_int(js_ctx, 2150 + js_ctx->index[js_ctx->depth - 2]);
+  return 0;
+}
+static struct jsontree_callback value =
+  JSONTREE_CALLBACK(value_output, NULL);
+
+JSONTREE_OBJECT(sensor,
+                JSONTREE_PAIR("name", &name),
+                JSONTREE_PAIR("unit", &unit),
+                JSONTREE_PAIR("period", &period),
+                JSONTREE_PAIR("low", &limit),
+                JSONTREE_PAIR("value", &value));
+JSONTREE_ARRAY(sensors, ENTRIES);
+JSONTREE_OBJECT(root,
+                JSONTREE_PAIR("sensors", &sensors));
+
+static char expected[DOC_SIZE];
+static char doc[DOC_SIZE];
+static int doc_len;
+
+static char block[BLOCK_SIZE];
+static int block_pos;
+static char buffer[BLOCK_SIZE + 32];
+static int buffer_pos;
+static uint32_t block_start;
+static uint32_t putchar_pos;
+/*---------------------------------------------------------------------------*/
+static unsigned long
+now_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000UL + ts.tv_nsec;
+}
+/*---------------------------------------------------------------------------*/
+static int
+block_putchar(int c)
+{
+  if(putchar_pos++ >= block_start && block_pos < BLOCK_SIZE) {
+    block[block_pos++] = c;
+  }
+  return c;
+}
+/*---------------------------------------------------------------------------*/
+static void
+send_block(int len)
+{
+  if(doc_len + len <= DOC_SIZE) {
+    memcpy(&doc[doc_len], block, len);
+  }
+  doc_len += len;
+}
+/*---------------------------------------------------------------------------*/
+/* One block at a time from a putchar function, keeping the context.
+   Like json-ws used to do, the buffer has room for the value that
+   crosses the end of the block. */
+static int
+buffer_putchar(int c)
+{
+  if(buffer_pos < sizeof(buffer)) {
+    buffer[buffer_pos++] = c;
+  }
+  return c;
+}
+/*---------------------------------------------------------------------------*/
+static void
+print_next(void)
+{
+  struct jsontree_context js;
+
+  jsontree_setup(&js, (struct jsontree_value *)&root, buffer_putchar);
+  buffer_pos = 0;
+  while(jsontree_print_next(&js)) {
+    if(buffer_pos >= BLOCK_SIZE) {
+      memcpy(block, buffer, BLOCK_SIZE);
+      send_block(BLOCK_SIZE);
+      buffer_pos -= BLOCK_SIZE;
+      memcpy(buffer, &buffer[BLOCK_SIZE], buffer_pos);
+    }
+  }
+  memcpy(block, buffer, buffer_pos);
+  send_block(buffer_pos);
+}
+/*---------------------------------------------------------------------------*/
+static void
+print_block(void)
+{
+  struct jsontree_context js;
+  int len;
+
+  jsontree_setup(&js, (struct jsontree_value *)&root, NULL);
+  while((len = jsontree_print_block(&js, block, BLOCK_SIZE)) > 0) {
+    send_block(len);
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* One block per request, regenerating the document up to the block */
+static void
+print_next_offset(void)
+{
+  struct jsontree_context js;
+
+  block_start = 0;
+  do {
+    jsontree_setup(&js, (struct jsontree_value *)&root, block_putchar);
+    putchar_pos = 0;
+    block_pos = 0;
+    while(jsontree_print_next(&js) && block_pos < BLOCK_SIZE);
+    send_block(block_pos);
+    block_start += BLOCK_SIZE;
+  } while(block_pos == BLOCK_SIZE);
+}
+/*---------------------------------------------------------------------------*/
+static void
+print_block_offset(void)
+{
+  struct jsontree_context js;
+  uint32_t offset = 0;
+  int len;
+
+  do {
+    jsontree_setup(&js, (struct jsontree_value *)&root, NULL);
+    jsontree_seek(&js, offset);
+    len = jsontree_print_block(&js, block, BLOCK_SIZE);
+    send_block(len);
+    offset += len;
+  } while(len == BLOCK_SIZE);
+}
+/*---------------------------------------------------------------------------*/
+/* One block per request, keeping the context between requests. The
+   block in the middle of the document is requested twice, as if the
+   first response had been lost. */
+static void
+print_block_seek(void)
+{
+  struct jsontree_context js;
+  uint32_t offset = 0;
+  int len;
+  int lost = 0;
+
+  jsontree_setup(&js, (struct jsontree_value *)&root, NULL);
+  do {
+    jsontree_seek(&js, offset);
+    len = jsontree_print_block(&js, block, BLOCK_SIZE);
+    if(!lost && offset >= DOC_SIZE / 2) {
+      lost = 1;
+      continue;
+    }
+    send_block(len);
+    offset += len;
+  } while(len == BLOCK_SIZE);
+}
+/*---------------------------------------------------------------------------*/
+static void
+run(const char *name, void (* print)(void), int rounds)
+{
+  unsigned long start, elapsed;
+  int i;
+
+  start = now_ns();
+  for(i = 0; i < rounds; i++) {
+    doc_len = 0;
+    print();
+  }
+  elapsed = now_ns() - start;
+  printf("%-34s %7lu kB/s, %s\n", name,
+         (unsigned long)((unsigned long long)doc_len * rounds * 1000000 /
+                         elapsed),
+         doc_len <= DOC_SIZE && memcmp(doc, expected, doc_len) == 0 ?
+         "same output" : "DIFFERENT");
+}
+/*---------------------------------------------------------------------------*/
+static int
+expected_putchar(int c)
+{
+  if(doc_len < DOC_SIZE) {
+    expected[doc_len++] = c;
+  }
+  return c;
+}
+/*---------------------------------------------------------------------------*/
+PROCESS(jsontree_block_benchmark_process, "jsontree block benchmark");
+AUTOSTART_PROCESSES(&jsontree_block_benchmark_process);
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(jsontree_block_benchmark_process, ev, data)
+{
+  static struct jsontree_context js;
+  static int i;
+
+  PROCESS_BEGIN();
+
+  for(i = 0; i < ENTRIES; i++) {
+    sensors.values[i] = (struct jsontree_value *)&sensor;
+  }
+
+  jsontree_setup(&js, (struct jsontree_value *)&root, expected_putchar);
+  doc_len = 0;
+  while(jsontree_print_next(&js));
+
+  printf("jsontree block benchmark, %d byte document, %d byte blocks\n",
+         doc_len, BLOCK_SIZE);
+
+  run("jsontree_print_next()", print_next, ROUNDS);
+  run("jsontree_print_block()", print_block, ROUNDS);
+  run("jsontree_print_next(), per block", print_next_offset, ROUNDS / 20);
+  run("jsontree_seek(), per block", print_block_offset, ROUNDS / 20);
+  run("jsontree_seek(), kept context", print_block_seek, ROUNDS);
+
+  exit(0);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
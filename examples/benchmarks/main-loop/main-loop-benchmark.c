@@ -0,0 +1,208 @@
+/*
+ * Copyright (c) 2015, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Measures the native main loop: the CPU time used while all
+ *         processes wait for a timer, how late event timers expire and
+ *         the turnaround time of a packet that arrives on an fd
+ *         registered with select_set_callback() and is answered by a
+ *         process. The peer is a child process that echoes each byte
+ *         back over a socket pair. Run with select() and with
+ *         SELECT_CONF_EPOLL. Only meant for Linux.
+ */
+
+#include "contiki.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#define IDLE_TIME    (CLOCK_SECOND * 3)
+#define TIMER_ROUNDS 200
+#define TIMER_DELAY  (CLOCK_SECOND / 100)
+#define ECHO_ROUNDS  5000
+
+static int peer_fd;
+static unsigned long samples[ECHO_ROUNDS];
+
+PROCESS(main_loop_benchmark_process, "Main loop benchmark");
+AUTOSTART_PROCESSES(&main_loop_benchmark_process);
+/*---------------------------------------------------------------------------*/
+static unsigned long
+now_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000UL + ts.tv_nsec;
+}
+/*---------------------------------------------------------------------------*/
+static unsigned long
+cpu_ns(void)
+{
+  struct rusage ru;
+
+  getrusage(RUSAGE_SELF, &ru);
+  return (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000000000UL +
+    (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) * 1000UL;
+}
+/*---------------------------------------------------------------------------*/
+static int
+compare(const void *a, const void *b)
+{
+  unsigned long x = *(const unsigned long *)a;
+  unsigned long y = *(const unsigned long *)b;
+
+  return x < y ? -1 : x > y;
+}
+/*---------------------------------------------------------------------------*/
+static void
+report(const char *name, unsigned long *s, int n)
+{
+  unsigned long sum = 0;
+  int i;
+
+  qsort(s, n, sizeof(s[0]), compare);
+  for(i = 0; i < n; i++) {
+    sum += s[i];
+  }
+  printf("%-20s mean %7lu us  median %7lu us  99%% %7lu us  max %7lu us\n",
+         name, sum / n / 1000, s[n / 2] / 1000, s[n * 99 / 100] / 1000,
+         s[n - 1] / 1000);
+}
+/*---------------------------------------------------------------------------*/
+static int
+peer_set_fd(fd_set *rset, fd_set *wset)
+{
+  FD_SET(peer_fd, rset);
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static void
+peer_handle_fd(fd_set *rset, fd_set *wset)
+{
+  char c;
+
+  if(FD_ISSET(peer_fd, rset) && read(peer_fd, &c, 1) == 1) {
+    process_poll(&main_loop_benchmark_process);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static const struct select_callback peer_callback = {
+  peer_set_fd, peer_handle_fd
+};
+/*---------------------------------------------------------------------------*/
+static void
+start_peer(void)
+{
+  int fds[2];
+  char c;
+
+  if(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+    perror("socketpair");
+    exit(1);
+  }
+  if(fork() == 0) {
+    close(fds[0]);
+    while(read(fds[1], &c, 1) == 1) {
+      if(write(fds[1], &c, 1) != 1) {
+        break;
+      }
+    }
+    _exit(0);
+  }
+  close(fds[1]);
+  peer_fd = fds[0];
+  select_set_callback(peer_fd, &peer_callback);
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(main_loop_benchmark_process, ev, data)
+{
+  static struct etimer et;
+  static unsigned long start, cpu;
+  static int i;
+
+  PROCESS_BEGIN();
+
+  start_peer();
+
+  /* Let the rest of the system settle */
+  etimer_set(&et, CLOCK_SECOND / 10);
+  PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&et));
+
+  cpu = cpu_ns();
+  start = now_ns();
+  etimer_set(&et, IDLE_TIME);
+  PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&et));
+  printf("idle                 %lu ms CPU in %lu ms (%.2f%%)\n",
+         (cpu_ns() - cpu) / 1000000, (now_ns() - start) / 1000000,
+         100.0 * (cpu_ns() - cpu) / (now_ns() - start));
+
+  for(i = 0; i < TIMER_ROUNDS; i++) {
+    start = now_ns();
+    etimer_set(&et, TIMER_DELAY);
+    PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&et));
+    samples[i] = now_ns() - start;
+    samples[i] = samples[i] > TIMER_DELAY * 1000000UL ?
+      samples[i] - TIMER_DELAY * 1000000UL : 0;
+  }
+  report("etimer lateness", samples, TIMER_ROUNDS);
+
+  cpu = cpu_ns();
+  for(i = 0; i < ECHO_ROUNDS; i++) {
+    start = now_ns();
+    if(write(peer_fd, "x", 1) != 1) {
+      perror("write");
+      exit(1);
+    }
+    PROCESS_WAIT_EVENT_UNTIL(ev == PROCESS_EVENT_POLL);
+    samples[i] = now_ns() - start;
+  }
+  cpu = cpu_ns() - cpu;
+  report("fd turnaround", samples, ECHO_ROUNDS);
+  printf("fd turnaround        %lu us CPU per packet\n",
+         cpu / ECHO_ROUNDS / 1000);
+
+  select_set_callback(peer_fd, NULL);
+  close(peer_fd);
+  wait(NULL);
+  exit(0);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
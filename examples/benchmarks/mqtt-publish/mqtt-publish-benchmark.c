@@ -0,0 +1,232 @@
+/*
+ * Copyright (c) 2015, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Measures how many QoS 1 messages per second the MQTT client
+ *         publishes to a broker with a 20 ms round-trip time. The
+ *         broker is simulated within the benchmark: outgoing packets
+ *         are taken from the IP output function, and the broker's TCP
+ *         ACKs, CONNACK and PUBACKs are fed back into uIP after the
+ *         round-trip time. Build once with the default configuration
+ *         and once with, for example, DEFINES=MQTT_CONF_INFLIGHT_WINDOW=8
+ *         to compare.
+ */
+
+#include "contiki.h"
+#include "contiki-net.h"
+#include "mqtt.h"
+#include "tcp-peer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RTT             (CLOCK_SECOND / 50)
+#define MESSAGES        500
+#define PAYLOAD_SIZE    32
+#define BROKER_PORT     1883
+#define PEER_WINDOW     8192
+
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+
+#define MQTT_CONNECT    0x10
+#define MQTT_CONNACK    0x20
+#define MQTT_PUBLISH    0x30
+#define MQTT_PUBACK     0x40
+#define MQTT_PINGREQ    0xC0
+#define MQTT_PINGRESP   0xD0
+
+/* The broker's view of the byte stream */
+static uint8_t packet[MQTT_TCP_OUTPUT_BUFF_SIZE];
+static uint16_t packet_len;
+static uint32_t packet_offset;
+static unsigned long received;
+
+static struct mqtt_connection conn;
+static char client_id[] = "benchmark";
+static char broker_addr[] = "fe80::1";
+static char topic[] = "benchmark/sensor";
+static uint8_t payload[PAYLOAD_SIZE];
+static int connected;
+static struct timer connect_timer;
+static unsigned long acked;
+
+PROCESS(mqtt_publish_benchmark_process, "MQTT publish benchmark");
+AUTOSTART_PROCESSES(&mqtt_publish_benchmark_process);
+/*---------------------------------------------------------------------------*/
+static void
+add_reply(uint8_t type, uint8_t b0, uint8_t b1, int len)
+{
+  uint8_t reply[4];
+
+  reply[0] = type;
+  reply[1] = len;
+  reply[2] = b0;
+  reply[3] = b1;
+  tcp_peer_write(reply, 2 + len);
+}
+/*---------------------------------------------------------------------------*/
+/* Answers a complete MQTT packet like a broker would. */
+static void
+broker_input(const uint8_t *p, uint16_t hdr_len, uint16_t len)
+{
+  const uint8_t *body = p + hdr_len;
+  uint16_t topic_len;
+
+  switch(p[0] & 0xF0) {
+  case MQTT_CONNECT:
+    add_reply(MQTT_CONNACK, 0, 0, 2);
+    break;
+  case MQTT_PUBLISH:
+    received++;
+    if(((p[0] >> 1) & 3) == MQTT_QOS_LEVEL_1) {
+      topic_len = (body[0] << 8) | body[1];
+      add_reply(MQTT_PUBACK, body[2 + topic_len], body[3 + topic_len], 2);
+    }
+    break;
+  case MQTT_PINGREQ:
+    add_reply(MQTT_PINGRESP, 0, 0, 0);
+    break;
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Splits the byte stream from the client into MQTT packets. */
+static void
+broker_receive(uint32_t offset, const uint8_t *data, uint16_t len)
+{
+  uint32_t remaining;
+  uint16_t hdr_len, used;
+  int i;
+
+  if(offset != packet_offset) {
+    /* Only take in the stream in order */
+    return;
+  }
+  packet_offset += len;
+
+  while(len > 0) {
+    used = MIN(len, sizeof(packet) - packet_len);
+    memcpy(&packet[packet_len], data, used);
+    packet_len += used;
+    data += used;
+    len -= used;
+
+    for(;;) {
+      /* Decode the Remaining Length to find the end of the packet */
+      remaining = 0;
+      for(i = 1; i < packet_len && i <= 4; i++) {
+        remaining |= (uint32_t)(packet[i] & 0x7F) << (7 * (i - 1));
+        if((packet[i] & 0x80) == 0) {
+          break;
+        }
+      }
+      if(i >= packet_len) {
+        break;
+      }
+      hdr_len = i + 1;
+      if(packet_len < hdr_len + remaining) {
+        break;
+      }
+      broker_input(packet, hdr_len, hdr_len + remaining);
+      packet_len -= hdr_len + remaining;
+      memmove(packet, &packet[hdr_len + remaining], packet_len);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+mqtt_event(struct mqtt_connection *m, mqtt_event_t event, void *data)
+{
+  if(event == MQTT_EVENT_CONNECTED) {
+    connected = 1;
+    timer_set(&connect_timer, RTT);
+  } else if(event == MQTT_EVENT_PUBACK) {
+    acked++;
+  } else if(event != MQTT_EVENT_DISCONNECTED) {
+    printf("MQTT event %d\n", event);
+  }
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(mqtt_publish_benchmark_process, ev, data)
+{
+  static struct etimer et;
+  static clock_time_t start;
+  static unsigned long published;
+  unsigned long elapsed;
+
+  PROCESS_BEGIN();
+
+  tcp_peer_init(BROKER_PORT, RTT, PEER_WINDOW, 0, broker_receive);
+  memset(payload, 'x', sizeof(payload));
+
+  mqtt_register(&conn, PROCESS_CURRENT(), client_id, mqtt_event,
+                MQTT_TCP_OUTPUT_BUFF_SIZE);
+  mqtt_connect(&conn, broker_addr, BROKER_PORT, 60);
+
+  start = clock_time();
+  while(acked < MESSAGES) {
+    if(connected == 1 && timer_expired(&connect_timer)) {
+      /* The client has finished the connection handshake */
+      connected = 2;
+      start = clock_time();
+    }
+    while(connected == 2 && published < MESSAGES &&
+          mqtt_publish(&conn, NULL, topic, payload, sizeof(payload),
+                       MQTT_QOS_LEVEL_1, MQTT_RETAIN_OFF) == MQTT_STATUS_OK) {
+      published++;
+    }
+
+    etimer_set(&et, 1);
+    PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&et));
+    tcp_peer_poll();
+    if(clock_time() - start > 120 * CLOCK_SECOND) {
+      printf("Publishing did not complete\n");
+      break;
+    }
+  }
+  elapsed = clock_time() - start;
+
+  printf("MQTT_INFLIGHT_WINDOW %d, RTT %lu ms, %d byte payloads\n",
+         MQTT_INFLIGHT_WINDOW, (unsigned long)(RTT * 1000 / CLOCK_SECOND),
+         PAYLOAD_SIZE);
+  printf("%lu messages acknowledged in %lu ms: %lu messages/s, "
+         "%lu received by the broker, %lu segments\n",
+         acked, elapsed * 1000 / CLOCK_SECOND,
+         acked * CLOCK_SECOND / (elapsed > 0 ? elapsed : 1),
+         received, tcp_peer_stats.segments);
+
+  exit(0);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
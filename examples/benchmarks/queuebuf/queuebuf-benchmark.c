@@ -0,0 +1,162 @@
+/*
+ * Copyright (c) 2015, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Counts the bytes copied by queuebufs per transmitted frame,
+ *         and measures the time spent loading and framing each
+ *         frame. Every frame is queued once and transmitted several
+ *         times, as a MAC layer does when retransmitting. Build once
+ *         with the default configuration and once with
+ *         DEFINES=QUEUEBUF_CONF_ZERO_COPY=1 to compare.
+ */
+
+#include "contiki.h"
+#include "net/netstack.h"
+#include "net/packetbuf.h"
+#include "net/queuebuf.h"
+#include "net/mac/rdc.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define FRAMES        10000
+#define TRANSMISSIONS 4
+#define PAYLOAD_LEN   100
+
+static const linkaddr_t receiver = { { 1, 2, 3, 4, 5, 6, 7, 8 } };
+/*---------------------------------------------------------------------------*/
+static unsigned long
+now_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000UL + ts.tv_nsec;
+}
+/*---------------------------------------------------------------------------*/
+static void
+sent(void *ptr, int status, int transmissions)
+{
+}
+/*---------------------------------------------------------------------------*/
+static struct queuebuf *
+queue_frame(void)
+{
+  packetbuf_clear();
+  memset(packetbuf_dataptr(), 0x55, PAYLOAD_LEN);
+  packetbuf_set_datalen(PAYLOAD_LEN);
+  packetbuf_set_addr(PACKETBUF_ADDR_RECEIVER, &receiver);
+  return queuebuf_new_from_packetbuf();
+}
+/*---------------------------------------------------------------------------*/
+/* Lets the RDC layer frame the queued frame on every transmission,
+   as nullrdc does. */
+static void
+send_framed_per_transmission(struct queuebuf *q)
+{
+  struct rdc_buf_list list;
+  int i;
+
+  memset(&list, 0, sizeof(list));
+  list.buf = q;
+  for(i = 0; i < TRANSMISSIONS; i++) {
+    NETSTACK_RDC.send_list(sent, NULL, &list);
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Creates the frame once and stores it back in the queuebuf, as
+   ContikiMAC does, then transmits the stored frame. */
+static void
+send_framed_once(struct queuebuf *q)
+{
+  int i;
+
+  queuebuf_attach_to_packetbuf(q);
+  NETSTACK_FRAMER.create_and_secure();
+  packetbuf_set_attr(PACKETBUF_ATTR_IS_CREATED_AND_SECURED, 1);
+  queuebuf_update_from_packetbuf(q);
+  for(i = 0; i < TRANSMISSIONS; i++) {
+    queuebuf_attach_to_packetbuf(q);
+    NETSTACK_RADIO.send(packetbuf_hdrptr(), packetbuf_totlen());
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+run(const char *name, void (*send)(struct queuebuf *))
+{
+  struct queuebuf *q;
+  unsigned long start, elapsed;
+  unsigned long frames, bytes;
+  int i;
+
+  memset(&queuebuf_copy_stats, 0, sizeof(queuebuf_copy_stats));
+  elapsed = 0;
+  for(i = 0; i < FRAMES; i++) {
+    q = queue_frame();
+    if(q == NULL) {
+      printf("%s: out of queuebufs\n", name);
+      return;
+    }
+    start = now_ns();
+    send(q);
+    elapsed += now_ns() - start;
+    queuebuf_free(q);
+  }
+
+  frames = queuebuf_copy_stats.frames;
+  bytes = queuebuf_copy_stats.bytes_in + queuebuf_copy_stats.bytes_out;
+  printf("%-24s %6lu frames, %3lu%% attached, %5.1f bytes copied/frame, "
+         "%4lu ns/frame\n", name, frames,
+         100 * queuebuf_copy_stats.frames_attached / frames,
+         (double)bytes / frames, elapsed / frames);
+}
+/*---------------------------------------------------------------------------*/
+PROCESS(queuebuf_benchmark_process, "Queuebuf benchmark");
+AUTOSTART_PROCESSES(&queuebuf_benchmark_process);
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(queuebuf_benchmark_process, ev, data)
+{
+  PROCESS_BEGIN();
+
+  printf("QUEUEBUF_ZERO_COPY %d, %d byte payload, %d transmissions\n",
+         QUEUEBUF_ZERO_COPY, PAYLOAD_LEN, TRANSMISSIONS);
+  run("framed per transmission", send_framed_per_transmission);
+  run("framed once", send_framed_once);
+
+  exit(0);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,218 @@
+/*
+ * Copyright (c) 2015, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Measures how many CoAP requests per second the REST engine
+ *         dispatches to their resources as the number of activated
+ *         resources grows. Build once with the default configuration
+ *         and once with DEFINES=REST_RESOURCE_HASH_SIZE=32 to compare.
+ *         Only meant for the native platform.
+ */
+
+#include "contiki.h"
+#include "lib/random.h"
+#include "rest-engine.h"
+#include "er-coap.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define REQUESTS      200000
+#define MAX_RESOURCES 200
+#define URL_LEN       32
+
+static const int rounds[] = { 1, 10, 25, 50, 100, 200 };
+
+static resource_t resources[MAX_RESOURCES];
+static char urls[MAX_RESOURCES][URL_LEN];
+static int count;
+static unsigned long handled;
+static int checked;
+
+/* A parent resource for firmware images, which is activated first */
+static void
+res_get_handler(void *request, void *response, uint8_t *buffer,
+                uint16_t preferred_size, int32_t *offset)
+{
+  handled++;
+}
+/* Set on the one resource that a request should reach */
+static void
+res_check_handler(void *request, void *response, uint8_t *buffer,
+                  uint16_t preferred_size, int32_t *offset)
+{
+  checked++;
+}
+PARENT_RESOURCE(res_firmware, "title=\"Firmware\"", res_get_handler,
+                NULL, NULL, NULL);
+/*---------------------------------------------------------------------------*/
+static unsigned long
+now_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000UL + ts.tv_nsec;
+}
+/*---------------------------------------------------------------------------*/
+static void
+add_resource(void)
+{
+  resource_t *r = &resources[count];
+
+  r->flags = NO_FLAGS;
+  r->attributes = "rt=\"sensor\"";
+  r->get_handler = res_get_handler;
+  snprintf(urls[count], URL_LEN, "sensors/node%d/temp", count);
+  rest_activate_resource(r, urls[count]);
+  count++;
+}
+/*---------------------------------------------------------------------------*/
+static const char *
+newest_url(int n)
+{
+  return urls[n - 1];
+}
+/*---------------------------------------------------------------------------*/
+static const char *
+random_url(int n)
+{
+  return urls[random_rand() % n];
+}
+/*---------------------------------------------------------------------------*/
+static const char *
+sub_resource_url(int n)
+{
+  return "fw/image/3";
+}
+/*---------------------------------------------------------------------------*/
+static void
+request(const char *url, int mid)
+{
+  static coap_packet_t request, response;
+  static uint8_t buffer[REST_MAX_CHUNK_SIZE];
+  int32_t offset;
+
+  coap_init_message(&request, COAP_TYPE_CON, COAP_GET, mid);
+  coap_set_header_uri_path(&request, url);
+  coap_init_message(&response, COAP_TYPE_ACK, CONTENT_2_05, mid);
+  offset = 0;
+  rest_invoke_restful_service(&request, &response, buffer,
+                              sizeof(buffer), &offset);
+}
+/*---------------------------------------------------------------------------*/
+/* Dispatches requests for the URI paths returned by url() and returns
+   the number of requests per second. */
+static unsigned long
+run(const char *(*url)(int n), int n)
+{
+  unsigned long start, elapsed;
+  int i;
+
+  start = now_ns();
+  for(i = 0; i < REQUESTS; i++) {
+    request(url(n), i);
+  }
+  elapsed = now_ns() - start;
+  return REQUESTS * 1000000000ULL / elapsed;
+}
+/*---------------------------------------------------------------------------*/
+/* Requests each resource once with its handler swapped for
+   res_check_handler(), and returns the number of requests that were
+   served by another resource. */
+static int
+check_dispatch(int n)
+{
+  int i, misrouted;
+
+  misrouted = 0;
+  for(i = 0; i < n; i++) {
+    resources[i].get_handler = res_check_handler;
+    checked = 0;
+    request(urls[i], i);
+    if(checked != 1) {
+      misrouted++;
+    }
+    resources[i].get_handler = res_get_handler;
+  }
+  res_firmware.get_handler = res_check_handler;
+  checked = 0;
+  request(sub_resource_url(n), 0);
+  if(checked != 1) {
+    misrouted++;
+  }
+  res_firmware.get_handler = res_get_handler;
+  return misrouted;
+}
+/*---------------------------------------------------------------------------*/
+PROCESS(rest_dispatch_benchmark_process, "REST dispatch benchmark");
+AUTOSTART_PROCESSES(&rest_dispatch_benchmark_process);
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(rest_dispatch_benchmark_process, ev, data)
+{
+  static unsigned long newest, any, sub;
+  static int r, n, misrouted;
+
+  PROCESS_BEGIN();
+
+  rest_init_engine();
+  rest_activate_resource(&res_firmware, "fw");
+
+  printf("REST dispatch benchmark, %d hash buckets, requests/s for the "
+         "newest resource, random resources and a sub-resource\n",
+         REST_RESOURCE_HASH_SIZE);
+
+  for(r = 0; r < sizeof(rounds) / sizeof(rounds[0]); r++) {
+    n = rounds[r];
+    while(count < n) {
+      add_resource();
+    }
+
+    misrouted = check_dispatch(n);
+    handled = 0;
+    newest = run(newest_url, n);
+    any = run(random_url, n);
+    sub = run(sub_resource_url, n);
+
+    printf("%4d resources: %8lu / %8lu / %8lu, %s\n", n, newest, any, sub,
+           handled == 3 * REQUESTS && misrouted == 0 ?
+           "all handled" : "MISSED");
+  }
+
+  exit(0);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
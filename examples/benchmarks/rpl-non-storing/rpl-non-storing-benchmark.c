@@ -0,0 +1,345 @@
+/*
+ * Copyright (c) 2015, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Builds a random DAG of 250 nodes below a non-storing root from
+ *         DAOs, then measures the cost of inserting source routing
+ *         headers at the root and of forwarding on them at each hop.
+ *         For comparison, it measures host route lookups in the table
+ *         the root would need in storing mode, and prints the route
+ *         state kept in the network in both modes. Only meant for the
+ *         native platform.
+ */
+
+#include "contiki.h"
+#include "lib/random.h"
+#include "net/ip/uip.h"
+#include "net/ipv6/uip-ds6.h"
+#include "net/ipv6/uip-icmp6.h"
+#include "net/rpl/rpl-private.h"
+#include "net/rpl/rpl-ns.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define NODES   250
+#define ROUNDS  200
+#define PAYLOAD 32
+
+#define UIP_IP_BUF ((struct uip_ip_hdr *)&uip_buf[UIP_LLH_LEN])
+
+/* Index 0 is the root */
+static uint8_t parent_of[NODES + 1];
+static uint8_t depth[NODES + 1];
+static uip_ipaddr_t addrs[NODES + 1];
+/* Packets as they leave the root */
+static uint8_t routed[NODES + 1][UIP_IPH_LEN + UIP_UDPH_LEN + PAYLOAD + 64];
+static uint16_t routed_len[NODES + 1];
+/*---------------------------------------------------------------------------*/
+static unsigned long
+now_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000UL + ts.tv_nsec;
+}
+/*---------------------------------------------------------------------------*/
+static void
+build_tree(void)
+{
+  int i;
+
+  /* Interface identifiers of the form used by Tmote Sky nodes */
+  for(i = 1; i <= NODES; i++) {
+    uip_ip6addr(&addrs[i], 0xaaaa, 0, 0, 0,
+                0x0212, 0x7400 | i, i, (i << 8) | i);
+    parent_of[i] = random_rand() % i;
+    depth[i] = depth[parent_of[i]] + 1;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+set_ip_header(uint8_t proto, const uip_ipaddr_t *src,
+              const uip_ipaddr_t *dest, int payload_len)
+{
+  memset(UIP_IP_BUF, 0, UIP_IPH_LEN);
+  UIP_IP_BUF->vtc = 0x60;
+  UIP_IP_BUF->proto = proto;
+  UIP_IP_BUF->ttl = 64;
+  uip_ipaddr_copy(&UIP_IP_BUF->srcipaddr, src);
+  uip_ipaddr_copy(&UIP_IP_BUF->destipaddr, dest);
+  UIP_IP_BUF->len[0] = payload_len >> 8;
+  UIP_IP_BUF->len[1] = payload_len & 0xff;
+  uip_len = UIP_IPH_LEN + payload_len;
+  uip_ext_len = 0;
+}
+/*---------------------------------------------------------------------------*/
+/* Sends the DAO of node i with the given target prefix length and
+   with cut bytes missing at the end, to test malformed DAOs */
+static void
+send_dao(int i, uint8_t prefixlen, int cut)
+{
+  unsigned char *buffer;
+  int pos;
+
+  buffer = &uip_buf[UIP_LLH_LEN + UIP_IPH_LEN + UIP_ICMPH_LEN];
+  pos = 0;
+  buffer[pos++] = RPL_DEFAULT_INSTANCE;
+  buffer[pos++] = 0; /* flags */
+  buffer[pos++] = 0; /* reserved */
+  buffer[pos++] = i; /* sequence */
+  buffer[pos++] = RPL_OPTION_TARGET;
+  buffer[pos++] = 18;
+  buffer[pos++] = 0;
+  buffer[pos++] = prefixlen;
+  memcpy(buffer + pos, &addrs[i], 16);
+  pos += 16;
+  buffer[pos++] = RPL_OPTION_TRANSIT;
+  buffer[pos++] = 20;
+  buffer[pos++] = 0;
+  buffer[pos++] = 0;
+  buffer[pos++] = 0;
+  buffer[pos++] = RPL_DEFAULT_LIFETIME;
+  memcpy(buffer + pos, &addrs[parent_of[i]], 16);
+  pos += 16 - cut;
+
+  set_ip_header(UIP_PROTO_ICMP6, &addrs[i], &addrs[0], UIP_ICMPH_LEN + pos);
+  uip_icmp6_input(ICMP6_RPL, RPL_CODE_DAO);
+}
+/*---------------------------------------------------------------------------*/
+static void
+make_packet(int i)
+{
+  set_ip_header(UIP_PROTO_UDP, &addrs[0], &addrs[i],
+                UIP_UDPH_LEN + PAYLOAD);
+}
+/*---------------------------------------------------------------------------*/
+static void
+add_storing_routes(void)
+{
+  uip_ipaddr_t nexthop;
+  uip_lladdr_t lladdr;
+  int i;
+  int hop;
+
+  for(i = 1; i <= NODES; i++) {
+    for(hop = i; parent_of[hop] != 0; hop = parent_of[hop]);
+    uip_create_linklocal_prefix(&nexthop);
+    memcpy(&nexthop.u8[8], &addrs[hop].u8[8], 8);
+    if(uip_ds6_nbr_lookup(&nexthop) == NULL) {
+      memset(&lladdr, 0, sizeof(lladdr));
+      lladdr.addr[sizeof(lladdr.addr) - 1] = hop;
+      uip_ds6_nbr_add(&nexthop, &lladdr, 1, NBR_REACHABLE);
+    }
+    uip_ds6_route_add(&addrs[i], 128, &nexthop);
+  }
+}
+/*---------------------------------------------------------------------------*/
+PROCESS(rpl_non_storing_benchmark_process, "RPL non-storing benchmark");
+AUTOSTART_PROCESSES(&rpl_non_storing_benchmark_process);
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(rpl_non_storing_benchmark_process, ev, data)
+{
+  static unsigned long start, base, elapsed;
+  static unsigned long srh_bytes, hops, forwarded;
+  static unsigned long entries, root_entries, router_entries;
+  static int subtree[NODES + 1];
+  static uip_ipaddr_t prefix;
+  static uip_ipaddr_t nexthop;
+  static rpl_dag_t *dag;
+  static int r, i, n, max_depth, bad;
+
+  PROCESS_BEGIN();
+
+  /* The root, as in the border router */
+  uip_ip6addr(&addrs[0], 0xaaaa, 0, 0, 0, 0, 0, 0, 0);
+  uip_ds6_set_addr_iid(&addrs[0], &uip_lladdr);
+  uip_ds6_addr_add(&addrs[0], 0, ADDR_AUTOCONF);
+  dag = rpl_set_root(RPL_DEFAULT_INSTANCE, &addrs[0]);
+  uip_ip6addr(&prefix, 0xaaaa, 0, 0, 0, 0, 0, 0, 0);
+  rpl_set_prefix(dag, &prefix, 64);
+
+  build_tree();
+  /* Malformed DAOs must not add nodes */
+  n = rpl_ns_num_nodes();
+  send_dao(1, 255, 0);
+  send_dao(1, 128, 8);
+  if(rpl_ns_num_nodes() != n) {
+    printf("A malformed DAO was accepted\n");
+    exit(1);
+  }
+  for(i = 1; i <= NODES; i++) {
+    send_dao(i, 128, 0);
+  }
+
+  hops = 0;
+  max_depth = 0;
+  for(i = 1; i <= NODES; i++) {
+    hops += depth[i];
+    if(depth[i] > max_depth) {
+      max_depth = depth[i];
+    }
+  }
+  printf("rpl non-storing benchmark, %d nodes in the table of the root,"
+         " average depth %.1f, max depth %d\n",
+         rpl_ns_num_nodes(), (double)hops / NODES, max_depth);
+
+  /* Source routing header insertion at the root */
+  srh_bytes = 0;
+  bad = 0;
+  for(i = 1; i <= NODES; i++) {
+    make_packet(i);
+    n = uip_len;
+    if(rpl_srh_get_next_hop(&nexthop) != 1) {
+      bad++;
+    }
+    srh_bytes += uip_len - n;
+    memcpy(routed[i], UIP_IP_BUF, uip_len);
+    routed_len[i] = uip_len;
+  }
+
+  start = now_ns();
+  for(r = 0; r < ROUNDS; r++) {
+    for(i = 1; i <= NODES; i++) {
+      make_packet(i);
+    }
+  }
+  base = now_ns() - start;
+  start = now_ns();
+  for(r = 0; r < ROUNDS; r++) {
+    for(i = 1; i <= NODES; i++) {
+      make_packet(i);
+      rpl_srh_get_next_hop(&nexthop);
+    }
+  }
+  elapsed = now_ns() - start - base;
+  printf("non-storing root: %5lu ns/packet to add the source route,"
+         " %.1f header bytes/packet, %d unreachable\n",
+         elapsed / (ROUNDS * NODES), (double)srh_bytes / NODES, bad);
+
+  /* Forwarding on the source routing header at each hop below */
+  forwarded = 0;
+  for(i = 1; i <= NODES; i++) {
+    memcpy(UIP_IP_BUF, routed[i], routed_len[i]);
+    uip_len = routed_len[i];
+    uip_ext_len = 0;
+    rpl_srh_get_next_hop(&nexthop);
+    n = 0;
+    while(UIP_IP_BUF->proto == UIP_PROTO_ROUTING &&
+          rpl_process_srh_header()) {
+      rpl_srh_get_next_hop(&nexthop);
+      n++;
+    }
+    if(n != depth[i] - 1 ||
+       !uip_ipaddr_cmp(&UIP_IP_BUF->destipaddr, &addrs[i]) ||
+       memcmp(&nexthop.u8[8], &addrs[i].u8[8], 8) != 0) {
+      bad++;
+    }
+    forwarded += n;
+  }
+
+  start = now_ns();
+  for(r = 0; r < ROUNDS; r++) {
+    for(i = 1; i <= NODES; i++) {
+      memcpy(UIP_IP_BUF, routed[i], routed_len[i]);
+    }
+  }
+  base = now_ns() - start;
+  start = now_ns();
+  for(r = 0; r < ROUNDS; r++) {
+    for(i = 1; i <= NODES; i++) {
+      memcpy(UIP_IP_BUF, routed[i], routed_len[i]);
+      uip_ext_len = 0;
+      while(UIP_IP_BUF->proto == UIP_PROTO_ROUTING &&
+            rpl_process_srh_header()) {
+        rpl_srh_get_next_hop(&nexthop);
+      }
+    }
+  }
+  elapsed = now_ns() - start - base;
+  printf("non-storing forwarding: %5lu ns/hop, %lu hops, %d wrong routes\n",
+         elapsed / (ROUNDS * forwarded), forwarded, bad);
+
+  /* The same downward routes in a storing mode table */
+  add_storing_routes();
+  start = now_ns();
+  for(r = 0; r < ROUNDS; r++) {
+    for(i = 1; i <= NODES; i++) {
+      if(uip_ds6_route_lookup(&addrs[i]) == NULL) {
+        bad++;
+      }
+    }
+  }
+  elapsed = now_ns() - start;
+  printf("storing forwarding: %5lu ns/route lookup in the %d route table"
+         " of the root\n",
+         elapsed / (ROUNDS * NODES), uip_ds6_route_num_routes());
+
+  /* In storing mode, each router has a route to every node below it */
+  memset(subtree, 0, sizeof(subtree));
+  for(i = NODES; i >= 1; i--) {
+    subtree[parent_of[i]] += subtree[i] + 1;
+  }
+  entries = 0;
+  router_entries = 0;
+  for(i = 1; i <= NODES; i++) {
+    entries += subtree[i];
+    if(subtree[i] > router_entries) {
+      router_entries = subtree[i];
+    }
+  }
+  root_entries = subtree[0];
+  entries += root_entries;
+
+  printf("route state, non-storing: %d entries, %lu bytes at the root,"
+         " none at other routers\n",
+         rpl_ns_num_nodes(),
+         (unsigned long)(rpl_ns_num_nodes() * sizeof(rpl_ns_node_t)));
+  printf("route state, storing: %lu entries, %lu bytes at the root,"
+         " %lu bytes at the largest other router, %lu bytes in total\n",
+         entries,
+         root_entries * (unsigned long)(sizeof(uip_ds6_route_t) +
+                                        sizeof(struct uip_ds6_route_neighbor_route)),
+         router_entries * (unsigned long)(sizeof(uip_ds6_route_t) +
+                                          sizeof(struct uip_ds6_route_neighbor_route)),
+         entries * (unsigned long)(sizeof(uip_ds6_route_t) +
+                                   sizeof(struct uip_ds6_route_neighbor_route)));
+
+  exit(0);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,184 @@
+/*
+ * Copyright (c) 2015, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Feeds storms of DIOs from a growing number of neighbors into
+ *         rpl_process_dio() and reports the time and the number of
+ *         objective function evaluations per DIO. Build once with the
+ *         default parent set and once with DEFINES=RPL_CONF_PARENT_HEAP=1
+ *         to compare. Only meant for the native platform.
+ */
+
+#include "contiki.h"
+#include "lib/random.h"
+#include "net/packetbuf.h"
+#include "net/ip/uip.h"
+#include "net/ipv6/uip-ds6.h"
+#include "net/rpl/rpl-private.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define ROUNDS 20
+
+extern rpl_of_t RPL_OF;
+
+static const int rounds[] = { 8, 32, 128, 250 };
+static rpl_dio_t dio;
+/*---------------------------------------------------------------------------*/
+static unsigned long
+now_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000UL + ts.tv_nsec;
+}
+/*---------------------------------------------------------------------------*/
+static void
+neighbor_addr(uip_ipaddr_t *addr, int i)
+{
+  uip_ip6addr(addr, 0xfe80, 0, 0, 0, 0x0200, 0, 0, i + 1);
+}
+/*---------------------------------------------------------------------------*/
+static void
+neighbor_lladdr(uip_lladdr_t *lladdr, int i)
+{
+  memset(lladdr, 0, sizeof(*lladdr));
+  lladdr->addr[sizeof(lladdr->addr) - 1] = i + 1;
+}
+/*---------------------------------------------------------------------------*/
+static void
+add_neighbor(int i)
+{
+  uip_ipaddr_t addr;
+  uip_lladdr_t lladdr;
+
+  neighbor_addr(&addr, i);
+  neighbor_lladdr(&lladdr, i);
+  uip_ds6_nbr_add(&addr, &lladdr, 1, NBR_REACHABLE);
+}
+/*---------------------------------------------------------------------------*/
+static void
+init_dio(void)
+{
+  memset(&dio, 0, sizeof(dio));
+  dio.instance_id = RPL_DEFAULT_INSTANCE;
+  dio.version = RPL_LOLLIPOP_INIT;
+  dio.ocp = RPL_OF.ocp;
+  dio.mop = RPL_MOP_DEFAULT;
+  dio.dtsn = RPL_LOLLIPOP_INIT;
+  dio.dag_intdoubl = RPL_DIO_INTERVAL_DOUBLINGS;
+  dio.dag_intmin = RPL_DIO_INTERVAL_MIN;
+  dio.dag_redund = RPL_DIO_REDUNDANCY;
+  dio.dag_min_hoprankinc = RPL_MIN_HOPRANKINC;
+  dio.dag_max_rankinc = RPL_MAX_RANKINC;
+  dio.default_lifetime = RPL_DEFAULT_LIFETIME;
+  dio.lifetime_unit = RPL_DEFAULT_LIFETIME_UNIT;
+  dio.mc.type = RPL_DAG_MC;
+  uip_ip6addr(&dio.dag_id, 0xaaaa, 0, 0, 0, 0, 0, 0, 1);
+}
+/*---------------------------------------------------------------------------*/
+static void
+send_dio(int i)
+{
+  uip_ipaddr_t from;
+
+  /* Ranks vary a little between DIOs, now and then making another
+     neighbor the best parent */
+  dio.rank = 2 * RPL_MIN_HOPRANKINC + (i % 7) * 64 + random_rand() % 96;
+  neighbor_addr(&from, i);
+  rpl_process_dio(&from, &dio);
+}
+/*---------------------------------------------------------------------------*/
+PROCESS(rpl_parents_benchmark_process, "RPL parents benchmark");
+AUTOSTART_PROCESSES(&rpl_parents_benchmark_process);
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(rpl_parents_benchmark_process, ev, data)
+{
+  static unsigned long start, elapsed;
+  static uint32_t evaluations;
+  static uint16_t switches;
+  static rpl_instance_t *instance;
+  static uip_lladdr_t lladdr;
+  static int r, i, j, n, dios;
+
+  PROCESS_BEGIN();
+
+  printf("rpl parents benchmark, %s\n",
+         RPL_PARENT_HEAP ? "parent heap" : "parent table scan");
+
+  init_dio();
+  n = 0;
+  for(r = 0; r < sizeof(rounds) / sizeof(rounds[0]); r++) {
+    for(; n < rounds[r]; n++) {
+      add_neighbor(n);
+      send_dio(n);
+    }
+
+    evaluations = rpl_stats.of_evaluations;
+    switches = rpl_stats.parent_switch;
+    dios = 0;
+    start = now_ns();
+    for(j = 0; j < ROUNDS; j++) {
+      for(i = 0; i < n; i++) {
+        send_dio(i);
+        dios++;
+      }
+      /* Link metric updates from transmissions to a quarter of the
+         neighbors, picked up by the periodic rank recalculation */
+      for(i = 0; i < n; i += 4) {
+        neighbor_lladdr(&lladdr, i);
+        packetbuf_set_addr(PACKETBUF_ADDR_RECEIVER, (linkaddr_t *)&lladdr);
+        uip_ds6_link_neighbor_callback(MAC_TX_OK, 1 + random_rand() % 3);
+      }
+      rpl_recalculate_ranks();
+    }
+    elapsed = now_ns() - start;
+
+    instance = rpl_get_instance(RPL_DEFAULT_INSTANCE);
+    printf("%4d parents: %6lu ns/DIO, %6.1f OF evaluations/DIO,"
+           " %u parent switches, rank %u\n",
+           n, elapsed / dios,
+           (double)(rpl_stats.of_evaluations - evaluations) / dios,
+           (unsigned)(rpl_stats.parent_switch - switches),
+           instance != NULL ? (unsigned)instance->current_dag->rank : 0);
+  }
+
+  exit(0);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,254 @@
+/*
+ * Copyright (c) 2015, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Sends SLIP frames over a socket pair to a child process and
+ *         reports the frames per second that are decoded. Compares the
+ *         byte-at-a-time code that tunslip6 used, which reads through
+ *         stdio and writes one frame per write(), with slip-codec,
+ *         which decodes whole read() chunks and writes up to 16 frames
+ *         per writev(). Only meant for the native platform.
+ */
+
+#include "contiki.h"
+#include "dev/slip-codec.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+
+#define FRAMES 100000
+#define BATCH  16
+
+static uint8_t frames[BATCH][1280];
+static uint8_t out[BATCH][SLIP_CODEC_ENCODED_SIZE(1280)];
+
+PROCESS(slip_codec_benchmark_process, "SLIP codec benchmark");
+AUTOSTART_PROCESSES(&slip_codec_benchmark_process);
+/*---------------------------------------------------------------------------*/
+static unsigned long
+now_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000UL + ts.tv_nsec;
+}
+/*---------------------------------------------------------------------------*/
+/* As tunslip6 used to: one byte at a time into a buffer, one write()
+   per frame */
+static void
+send_bytes(int fd, int size)
+{
+  uint8_t *buf = out[0];
+  int i, j, len;
+
+  for(i = 0; i < FRAMES; i++) {
+    len = 0;
+    for(j = 0; j < size; j++) {
+      switch(frames[i % BATCH][j]) {
+      case SLIP_CODEC_END:
+        buf[len++] = SLIP_CODEC_ESC;
+        buf[len++] = SLIP_CODEC_ESC_END;
+        break;
+      case SLIP_CODEC_ESC:
+        buf[len++] = SLIP_CODEC_ESC;
+        buf[len++] = SLIP_CODEC_ESC_ESC;
+        break;
+      default:
+        buf[len++] = frames[i % BATCH][j];
+        break;
+      }
+    }
+    buf[len++] = SLIP_CODEC_END;
+    if(write(fd, buf, len) != len) {
+      _exit(1);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+send_blocks(int fd, int size)
+{
+  struct iovec iov[BATCH];
+  int i, j;
+
+  for(i = 0; i < FRAMES; i += BATCH) {
+    for(j = 0; j < BATCH; j++) {
+      iov[j].iov_base = out[j];
+      iov[j].iov_len = slip_encode(frames[j], size, out[j], sizeof(out[j]));
+    }
+    if(writev(fd, iov, BATCH) < 0) {
+      _exit(1);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+wait_readable(int fd)
+{
+  fd_set rset;
+
+  FD_ZERO(&rset);
+  FD_SET(fd, &rset);
+  select(fd + 1, &rset, NULL, NULL, NULL);
+}
+/*---------------------------------------------------------------------------*/
+/* The decoding loop tunslip6 used */
+static int
+receive_bytes(int fd, int size)
+{
+  static uint8_t inbuf[2000];
+  FILE *in;
+  int inbufptr = 0;
+  int count = 0;
+  unsigned char c;
+
+  in = fdopen(dup(fd), "r");
+  while(count < FRAMES) {
+    wait_readable(fd);
+    while(fread(&c, 1, 1, in) == 1) {
+      if(c == SLIP_CODEC_END) {
+        if(inbufptr > 0) {
+          count += inbufptr == size && inbuf[0] == frames[count % BATCH][0];
+          inbufptr = 0;
+        }
+        continue;
+      }
+      if(c == SLIP_CODEC_ESC) {
+        if(fread(&c, 1, 1, in) != 1) {
+          clearerr(in);
+          ungetc(SLIP_CODEC_ESC, in);
+          break;
+        }
+        c = c == SLIP_CODEC_ESC_END ? SLIP_CODEC_END : SLIP_CODEC_ESC;
+      }
+      if(inbufptr < sizeof(inbuf)) {
+        inbuf[inbufptr++] = c;
+      }
+    }
+    clearerr(in);
+  }
+  fclose(in);
+  return count;
+}
+/*---------------------------------------------------------------------------*/
+static int
+receive_blocks(int fd, int size)
+{
+  static struct slip_decoder decoder;
+  static uint8_t buf[4096];
+  struct slip_codec_frame *f;
+  int count = 0;
+  int len, pos;
+
+  slip_decoder_init(&decoder);
+  while(count < FRAMES) {
+    wait_readable(fd);
+    while((len = read(fd, buf, sizeof(buf))) > 0) {
+      for(pos = 0; pos < len;) {
+        pos += slip_decoder_input(&decoder, buf + pos, len - pos);
+        while((f = slip_decoder_frame(&decoder)) != NULL) {
+          count += f->len == size &&
+            memcmp(f->data, frames[count % BATCH], size) == 0;
+          slip_decoder_release(&decoder);
+        }
+      }
+    }
+  }
+  return count;
+}
+/*---------------------------------------------------------------------------*/
+static void
+run(const char *name, int size,
+    void (* send)(int, int), int (* receive)(int, int))
+{
+  unsigned long start, elapsed;
+  int fds[2];
+  int count;
+
+  if(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+    perror("socketpair");
+    exit(1);
+  }
+  if(fork() == 0) {
+    close(fds[0]);
+    send(fds[1], size);
+    _exit(0);
+  }
+  close(fds[1]);
+  fcntl(fds[0], F_SETFL, O_NONBLOCK);
+
+  start = now_ns();
+  count = receive(fds[0], size);
+  elapsed = now_ns() - start;
+  close(fds[0]);
+  wait(NULL);
+
+  printf("%-8s %4d bytes: %8.0f frames/s, %6.1f MB/s (%d frames)\n",
+         name, size, FRAMES * 1e9 / elapsed,
+         (double)FRAMES * size * 1000 / elapsed, count);
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(slip_codec_benchmark_process, ev, data)
+{
+  static const int sizes[] = { 64, 127, 1280 };
+  int i, j;
+
+  PROCESS_BEGIN();
+
+  srand(1);
+  for(i = 0; i < BATCH; i++) {
+    for(j = 0; j < sizeof(frames[i]); j++) {
+      frames[i][j] = rand();
+    }
+  }
+
+  for(i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+    run("bytes", sizes[i], send_bytes, receive_bytes);
+    run("blocks", sizes[i], send_blocks, receive_blocks);
+  }
+
+  exit(0);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
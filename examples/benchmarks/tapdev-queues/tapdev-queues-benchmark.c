@@ -0,0 +1,250 @@
+/*
+ * Copyright (c) 2015, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Echoes Ethernet frames through tapdev6. A child process
+ *         sends frames into tap0 with a raw socket, keeping 32 in
+ *         flight, and counts the echoed frames. Reports the frames per
+ *         second, and the CPU time and context switches of the Contiki
+ *         thread per frame, with and without TAPDEV_CONF_QUEUES. Needs
+ *         Linux, /dev/net/tun and root. Only meant for the native
+ *         platform.
+ */
+
+#define _GNU_SOURCE
+#include "contiki.h"
+#include "net/ip/uip.h"
+#include "tapdev6.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <linux/if_packet.h>
+#include <net/ethernet.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#define DURATION   3
+#define WINDOW     32
+
+#define ETH ((struct uip_eth_hdr *)&uip_buf[0])
+
+int tapdev_fd(void);
+
+static const uint8_t peer_mac[6] = { 0x02, 0, 0, 0, 0, 0x01 };
+static int frame_size;
+
+PROCESS(tapdev_queues_benchmark_process, "tapdev queues benchmark");
+AUTOSTART_PROCESSES(&tapdev_queues_benchmark_process);
+/*---------------------------------------------------------------------------*/
+static unsigned long
+now_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000UL + ts.tv_nsec;
+}
+/*---------------------------------------------------------------------------*/
+static void
+run_peer(void)
+{
+  struct sockaddr_ll addr;
+  socklen_t addrlen;
+  struct timeval tv;
+  uint8_t frame[UIP_BUFSIZE];
+  uint8_t reply[UIP_BUFSIZE];
+  unsigned long start;
+  uint32_t seq = 0;
+  int received = 0;
+  int inflight = 0;
+  int s, ret;
+
+  s = socket(AF_PACKET, SOCK_RAW, htons(ETH_P_IPV6));
+  if(s < 0) {
+    perror("socket");
+    _exit(1);
+  }
+  memset(&addr, 0, sizeof(addr));
+  addr.sll_family = AF_PACKET;
+  addr.sll_protocol = htons(ETH_P_IPV6);
+  addr.sll_ifindex = if_nametoindex("tap0");
+  if(bind(s, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+    perror("bind");
+    _exit(1);
+  }
+  tv.tv_sec = 0;
+  tv.tv_usec = 50000;
+  setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+  memset(frame, 0xaa, sizeof(frame));
+  memset(frame, 0xff, 6);
+  memcpy(&frame[6], peer_mac, 6);
+  frame[12] = 0x86;
+  frame[13] = 0xdd;
+
+  start = now_ns();
+  while(now_ns() - start < DURATION * 1000000000UL) {
+    while(inflight < WINDOW) {
+      /* The sequence number is where tapdev6 looks for the destination
+         address, so that the frames are spread over the queues */
+      seq++;
+      memcpy(&frame[sizeof(struct uip_eth_hdr) + 36], &seq, sizeof(seq));
+      if(send(s, frame, frame_size, 0) < 0) {
+        break;
+      }
+      inflight++;
+    }
+    addrlen = sizeof(addr);
+    ret = recvfrom(s, reply, sizeof(reply), 0,
+                   (struct sockaddr *)&addr, &addrlen);
+    if(ret < 0) {
+      /* Lost frames */
+      inflight = 0;
+      continue;
+    }
+    if(addr.sll_pkttype != PACKET_OUTGOING &&
+       memcmp(reply, peer_mac, 6) == 0 && ret == frame_size) {
+      received++;
+      inflight--;
+    }
+  }
+  printf("%5d bytes: %8.0f frames/s", frame_size,
+         received * 1e9 / (now_ns() - start));
+  fflush(stdout);
+  _exit(0);
+}
+/*---------------------------------------------------------------------------*/
+static int
+tap_set_fd(fd_set *rset, fd_set *wset)
+{
+  FD_SET(tapdev_fd(), rset);
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static void
+tap_handle_fd(fd_set *rset, fd_set *wset)
+{
+  if(FD_ISSET(tapdev_fd(), rset)) {
+    process_poll(&tapdev_queues_benchmark_process);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static const struct select_callback tap_callback = {
+  tap_set_fd, tap_handle_fd
+};
+/*---------------------------------------------------------------------------*/
+static unsigned long
+tv_ns(struct timeval *tv)
+{
+  return tv->tv_sec * 1000000000UL + tv->tv_usec * 1000UL;
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(tapdev_queues_benchmark_process, ev, data)
+{
+  static const int sizes[] = { 100, 400 };
+  static struct etimer et;
+  static struct rusage before, after, all_before, all_after;
+  static unsigned long frames;
+  static pid_t child;
+  static int i;
+  uip_lladdr_t peer;
+  int len;
+
+  PROCESS_BEGIN();
+
+  tapdev_init();
+  if(tapdev_fd() < 0) {
+    printf("tapdev-queues needs /dev/net/tun and root\n");
+    exit(1);
+  }
+  select_set_callback(tapdev_fd(), &tap_callback);
+  etimer_set(&et, CLOCK_SECOND / 2);
+  PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&et));
+
+  for(i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+    frame_size = sizes[i];
+    frames = 0;
+    child = fork();
+    if(child == 0) {
+      run_peer();
+    }
+    getrusage(RUSAGE_THREAD, &before);
+    getrusage(RUSAGE_SELF, &all_before);
+    etimer_set(&et, CLOCK_SECOND / 10);
+    while(1) {
+      PROCESS_WAIT_EVENT();
+      if(ev == PROCESS_EVENT_POLL) {
+        while((len = tapdev_poll()) > 0) {
+          if(ETH->type != UIP_HTONS(UIP_ETHTYPE_IPV6) ||
+             memcmp(&ETH->src, peer_mac, 6) != 0) {
+            continue;
+          }
+          memset(&peer, 0, sizeof(peer));
+          memcpy(&peer, &ETH->src, 6);
+          uip_len = len - sizeof(struct uip_eth_hdr);
+          tapdev_send(&peer);
+          frames++;
+        }
+      } else if(etimer_expired(&et)) {
+        if(waitpid(child, NULL, WNOHANG) == child) {
+          break;
+        }
+        etimer_reset(&et);
+      }
+    }
+    getrusage(RUSAGE_THREAD, &after);
+    getrusage(RUSAGE_SELF, &all_after);
+    printf(", Contiki thread %.2f us CPU and %.2f context switches"
+           " per frame, all threads %.2f us CPU per frame\n",
+           (tv_ns(&after.ru_utime) + tv_ns(&after.ru_stime) -
+            tv_ns(&before.ru_utime) - tv_ns(&before.ru_stime)) /
+           1000.0 / frames,
+           (double)(after.ru_nvcsw + after.ru_nivcsw -
+                    before.ru_nvcsw - before.ru_nivcsw) / frames,
+           (tv_ns(&all_after.ru_utime) + tv_ns(&all_after.ru_stime) -
+            tv_ns(&all_before.ru_utime) - tv_ns(&all_before.ru_stime)) /
+           1000.0 / frames);
+  }
+
+  exit(0);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,176 @@
+/*
+ * Copyright (c) 2015, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Measures the throughput of a bulk TCP transfer over a path
+ *         with a long round-trip time. The remote host is simulated
+ *         within the benchmark: outgoing packets are taken from the
+ *         IP output function, and the remote host's ACKs are fed
+ *         back into uIP after the round-trip time. Build once with
+ *         the default configuration and once with, for example,
+ *         DEFINES=UIP_CONF_TCP_SEND_WINDOW=8 to compare.
+ */
+
+#include "contiki.h"
+#include "contiki-net.h"
+#include "net/ip/tcp-socket.h"
+#include "tcp-peer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RTT             (CLOCK_SECOND / 10)
+#define TRANSFER_SIZE   (32 * 1024UL)
+#define PEER_PORT       80
+/* The window advertised by the remote host, for example
+   DEFINES=PEER_WINDOW=100 to test a window smaller than a segment */
+#ifndef PEER_WINDOW
+#define PEER_WINDOW     8192
+#endif
+
+/* Drop every Nth data segment to exercise loss recovery, for example
+   with DEFINES=DROP_INTERVAL=50 */
+#ifndef DROP_INTERVAL
+#define DROP_INTERVAL   0
+#endif
+
+static unsigned long corrupt;
+
+static struct tcp_socket socket;
+static uint8_t inputbuf[64];
+static uint8_t outputbuf[4096];
+static unsigned long queued;
+static uint8_t pattern[256];
+
+PROCESS(tcp_window_benchmark_process, "TCP window benchmark");
+AUTOSTART_PROCESSES(&tcp_window_benchmark_process);
+/*---------------------------------------------------------------------------*/
+/* Checks a segment against the pattern that the application sends:
+   byte n of the stream is n modulo 256. */
+static void
+check(uint32_t offset, const uint8_t *data, uint16_t len)
+{
+  int i;
+
+  for(i = 0; i < len; i++) {
+    if(data[i] != (uint8_t)(offset + i)) {
+      corrupt++;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+fill(void)
+{
+  int len;
+  int offset;
+
+  /* Continue the pattern where the last send left off */
+  while(queued < TRANSFER_SIZE) {
+    offset = queued % sizeof(pattern);
+    len = sizeof(pattern) - offset;
+    if(TRANSFER_SIZE - queued < len) {
+      len = TRANSFER_SIZE - queued;
+    }
+    len = tcp_socket_send(&socket, pattern + offset, len);
+    if(len <= 0) {
+      break;
+    }
+    queued += len;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+event(struct tcp_socket *s, void *ptr, tcp_socket_event_t ev)
+{
+  if(ev == TCP_SOCKET_CONNECTED || ev == TCP_SOCKET_DATA_SENT) {
+    fill();
+  } else if(ev != TCP_SOCKET_CLOSED) {
+    printf("Connection failed (%d)\n", ev);
+    exit(1);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static int
+input(struct tcp_socket *s, void *ptr, const uint8_t *data, int len)
+{
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(tcp_window_benchmark_process, ev, data)
+{
+  static struct etimer et;
+  static clock_time_t start;
+  unsigned long elapsed;
+  int i;
+
+  PROCESS_BEGIN();
+
+  tcp_peer_init(PEER_PORT, RTT, PEER_WINDOW, DROP_INTERVAL, check);
+  for(i = 0; i < sizeof(pattern); i++) {
+    pattern[i] = i;
+  }
+
+  tcp_socket_register(&socket, NULL, inputbuf, sizeof(inputbuf),
+                      outputbuf, sizeof(outputbuf), input, event);
+  start = clock_time();
+  tcp_socket_connect(&socket, &tcp_peer_addr, PEER_PORT);
+
+  while(tcp_peer_stats.received < TRANSFER_SIZE) {
+    etimer_set(&et, 1);
+    PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&et));
+    tcp_peer_poll();
+    if(clock_time() - start > 120 * CLOCK_SECOND) {
+      printf("Transfer did not complete\n");
+      break;
+    }
+  }
+  elapsed = clock_time() - start;
+
+  printf("UIP_TCP_SEND_WINDOW %d, MSS %d, RTT %lu ms\n",
+         UIP_TCP_SEND_WINDOW, UIP_TCP_MSS,
+         (unsigned long)(RTT * 1000 / CLOCK_SECOND));
+  printf("%lu bytes in %lu ms: %lu bytes/s, %lu segments, %lu dropped,"
+         " %lu bad checksums, %lu corrupt bytes\n",
+         tcp_peer_stats.received, elapsed * 1000 / CLOCK_SECOND,
+         tcp_peer_stats.received * CLOCK_SECOND / (elapsed > 0 ? elapsed : 1),
+         tcp_peer_stats.segments, tcp_peer_stats.dropped,
+         tcp_peer_stats.bad_checksums, corrupt);
+
+  exit(tcp_peer_stats.received == TRANSFER_SIZE &&
+       tcp_peer_stats.bad_checksums == 0 && corrupt == 0 ? 0 : 1);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
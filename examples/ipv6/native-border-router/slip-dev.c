@@ -55,6 +55,7 @@
 #include "net/packetbuf.h"
 #include "cmd.h"
 #include "border-router-cmds.h"
+#include "dev/slip-codec.h"
 
 extern int slip_config_verbose;
 extern int slip_config_flowcontrol;
@@ -72,8 +73,6 @@ extern speed_t slip_config_b_rate;
 
 int devopen(const char *dev, int flags);
 
-static FILE *inslip;
-
 /* for statistics */
 long slip_sent = 0;
 long slip_received = 0;
@@ -169,124 +168,150 @@ slip_packet_input(unsigned char *data, int len)
   NETSTACK_RDC.input();
 }
 /*---------------------------------------------------------------------------*/
-/*
- * Read from serial, when we have a packet call slip_packet_input. No output
- * buffering, input buffered by stdio.
- */
-void
-serial_input(FILE *inslip)
+/*---------------------------------------------------------------------------*/
+static void
+frame_input(unsigned char *inbuf, int len)
 {
-  static unsigned char inbuf[2048];
-  static int inbufptr = 0;
-  int ret,i;
-  unsigned char c;
-
-#ifdef linux
-  ret = fread(&c, 1, 1, inslip);
-  if(ret == -1 || ret == 0) err(1, "serial_input: read");
-  goto after_fread;
-#endif
+  int i;
 
- read_more:
-  if(inbufptr >= sizeof(inbuf)) {
-     fprintf(stderr, "*** dropping large %d byte packet\n", inbufptr);
-     inbufptr = 0;
-  }
-  ret = fread(&c, 1, 1, inslip);
-#ifdef linux
- after_fread:
-#endif
-  if(ret == -1) {
-    err(1, "serial_input: read");
-  }
-  if(ret == 0) {
-    clearerr(inslip);
-    return;
-  }
-  slip_received++;
-  switch(c) {
-  case SLIP_END:
-    if(inbufptr > 0) {
-      if(inbuf[0] == '!') {
-	command_context = CMD_CONTEXT_RADIO;
-	cmd_input(inbuf, inbufptr);
-      } else if(inbuf[0] == '?') {
+  if(inbuf[0] == '!') {
+    command_context = CMD_CONTEXT_RADIO;
+    cmd_input(inbuf, len);
+  } else if(inbuf[0] == '?') {
 #define DEBUG_LINE_MARKER '\r'
-      } else if(inbuf[0] == DEBUG_LINE_MARKER) {
-	fwrite(inbuf + 1, inbufptr - 1, 1, stdout);
-      } else if(is_sensible_string(inbuf, inbufptr)) {
-        if(slip_config_verbose == 1) {   /* strings already echoed below for verbose>1 */
-          fwrite(inbuf, inbufptr, 1, stdout);
-        }
-      } else {
-        if(slip_config_verbose > 2) {
-          printf("Packet from SLIP of length %d - write TUN\n", inbufptr);
-          if(slip_config_verbose > 4) {
+  } else if(inbuf[0] == DEBUG_LINE_MARKER) {
+    fwrite(inbuf + 1, len - 1, 1, stdout);
+  } else if(is_sensible_string(inbuf, len)) {
+    if(slip_config_verbose == 1) {   /* strings already echoed below for verbose>1 */
+      fwrite(inbuf, len, 1, stdout);
+    }
+  } else {
+    if(slip_config_verbose > 2) {
+      printf("Packet from SLIP of length %d - write TUN\n", len);
+      if(slip_config_verbose > 4) {
 #if WIRESHARK_IMPORT_FORMAT
-            printf("0000");
-	    for(i = 0; i < inbufptr; i++) printf(" %02x", inbuf[i]);
+        printf("0000");
+        for(i = 0; i < len; i++) printf(" %02x", inbuf[i]);
 #else
-            printf("         ");
-            for(i = 0; i < inbufptr; i++) {
-              printf("%02x", inbuf[i]);
-              if((i & 3) == 3) printf(" ");
-              if((i & 15) == 15) printf("\n         ");
-            }
-#endif
-            printf("\n");
-          }
+        printf("         ");
+        for(i = 0; i < len; i++) {
+          printf("%02x", inbuf[i]);
+          if((i & 3) == 3) printf(" ");
+          if((i & 15) == 15) printf("\n         ");
         }
-	slip_packet_input(inbuf, inbufptr);
+#endif
+        printf("\n");
       }
-      inbufptr = 0;
     }
-    break;
+    slip_packet_input(inbuf, len);
+  }
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Echo lines as they are received for verbose=2,3,5+. Each line that
+ * is a sensible string is printed and removed. Returns the number of
+ * bytes left.
+ */
+static int
+echo_lines(unsigned char *inbuf, int len)
+{
+  int i;
 
-  case SLIP_ESC:
-    if(fread(&c, 1, 1, inslip) != 1) {
-      clearerr(inslip);
-      /* Put ESC back and give up! */
-      ungetc(SLIP_ESC, inslip);
-      return;
+  for(i = 0; i < len; i++) {
+    if(inbuf[i] == '\n' && is_sensible_string(inbuf, i + 1)) {
+      fwrite(inbuf, i + 1, 1, stdout);
+      len -= i + 1;
+      memmove(inbuf, inbuf + i + 1, len);
+      i = -1;
     }
+  }
+  return len;
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Read from serial, when we have a packet call slip_packet_input. The
+ * serial line is read in blocks until it has no more data.
+ */
+static void
+serial_input(int fd)
+{
+  static struct slip_decoder decoder;
+  static int initialized;
+  unsigned char buf[2048];
+  struct slip_codec_frame *f;
+  uint32_t dropped;
+  int ret, pos, n, i;
+  int first = 1;
+
+  if(!initialized) {
+    slip_decoder_init(&decoder);
+    initialized = 1;
+  }
 
-    switch(c) {
-    case SLIP_ESC_END:
-      c = SLIP_END;
-      break;
-    case SLIP_ESC_ESC:
-      c = SLIP_ESC;
-      break;
+  while(1) {
+    ret = read(fd, buf, sizeof(buf));
+    if(ret == -1 && (errno == EAGAIN || errno == EINTR) && !first) {
+      return;
     }
-    /* FALLTHROUGH */
-  default:
-    inbuf[inbufptr++] = c;
+    if(ret == -1 || (ret == 0 && first)) {
+      err(1, "serial_input: read");
+    }
+    if(ret == 0) {
+      return;
+    }
+    first = 0;
+    slip_received += ret;
 
-    /* Echo lines as they are received for verbose=2,3,5+ */
     /* Echo all printable characters for verbose==4 */
     if(slip_config_verbose == 4) {
-      if(c == 0 || c == '\r' || c == '\n' || c == '\t' || (c >= ' ' && c <= '~')) {
-	fwrite(&c, 1, 1, stdout);
+      for(i = 0; i < ret; i++) {
+        unsigned char c = buf[i];
+        if(c == 0 || c == '\r' || c == '\n' || c == '\t' || (c >= ' ' && c <= '~')) {
+          fwrite(&c, 1, 1, stdout);
+        }
       }
-    } else if(slip_config_verbose >= 2) {
-      if(c == '\n' && is_sensible_string(inbuf, inbufptr)) {
-        fwrite(inbuf, inbufptr, 1, stdout);
-        inbufptr = 0;
+    }
+
+    for(pos = 0; pos < ret; pos += n) {
+      dropped = decoder.dropped;
+      n = slip_decoder_input(&decoder, buf + pos, ret - pos);
+      if(decoder.dropped != dropped) {
+        fprintf(stderr, "*** dropping large packet\n");
+      }
+
+      while((f = slip_decoder_frame(&decoder)) != NULL) {
+        if(slip_config_verbose >= 2 && slip_config_verbose != 4) {
+          f->len = echo_lines(f->data, f->len);
+        }
+        if(f->len > 0) {
+          frame_input(f->data, f->len);
+        }
+        slip_decoder_release(&decoder);
+      }
+
+      if(slip_config_verbose >= 2 && slip_config_verbose != 4) {
+        f = slip_decoder_partial(&decoder);
+        f->len = echo_lines(f->data, f->len);
       }
     }
-    break;
   }
-
-  goto read_more;
 }
 
 unsigned char slip_buf[2048];
 int slip_end, slip_begin, slip_packet_end, slip_packet_count;
-static struct timer send_delay_timer;
+/* A ctimer, so that a main loop that sleeps until the next timer
+   expires wakes up when the delay is over */
+static struct ctimer send_delay_timer;
 /* delay between slip packets */
 static clock_time_t send_delay = SEND_DELAY;
 /*---------------------------------------------------------------------------*/
 static void
+send_delay_over(void *ptr)
+{
+  /* The buffer is flushed from handle_fd() */
+}
+/*---------------------------------------------------------------------------*/
+static void
 slip_send(int fd, unsigned char c)
 {
   if(slip_end >= sizeof(slip_buf)) {
@@ -345,7 +370,7 @@ slip_flushbuf(int fd)
         }
         /* a delay between slip packets to avoid losing data */
         if(send_delay > 0) {
-          timer_set(&send_delay_timer, send_delay);
+          ctimer_set(&send_delay_timer, send_delay, send_delay_over, NULL);
         }
       }
     }
@@ -385,22 +410,16 @@ write_to_serial(int outfd, const uint8_t *inbuf, int len)
    */
   /* slip_send(outfd, SLIP_END); */
 
-  for(i = 0; i < len; i++) {
-    switch(p[i]) {
-    case SLIP_END:
-      slip_send(outfd, SLIP_ESC);
-      slip_send(outfd, SLIP_ESC_END);
-      break;
-    case SLIP_ESC:
-      slip_send(outfd, SLIP_ESC);
-      slip_send(outfd, SLIP_ESC_ESC);
-      break;
-    default:
-      slip_send(outfd, p[i]);
-      break;
-    }
+  i = slip_encode(p, len, slip_buf + slip_end, sizeof(slip_buf) - slip_end);
+  if(i < 0) {
+    err(1, "slip_send overflow");
+  }
+  slip_end += i;
+  slip_sent += i;
+  slip_packet_count++;
+  if(slip_packet_end == 0) {
+    slip_packet_end = slip_end;
   }
-  slip_send(outfd, SLIP_END);
   PROGRESS("t");
 }
 /*---------------------------------------------------------------------------*/
@@ -463,7 +482,7 @@ static int
 set_fd(fd_set *rset, fd_set *wset)
 {
   /* Anything to flush? */
-  if(!slip_empty() && (send_delay == 0 || timer_expired(&send_delay_timer))) {
+  if(!slip_empty() && (send_delay == 0 || ctimer_expired(&send_delay_timer))) {
     FD_SET(slipfd, wset);
   }
 
@@ -475,7 +494,7 @@ static void
 handle_fd(fd_set *rset, fd_set *wset)
 {
   if(FD_ISSET(slipfd, rset)) {
-    serial_input(inslip);
+    serial_input(slipfd);
   }
 
   if(FD_ISSET(slipfd, wset)) {
@@ -536,11 +555,6 @@ slip_init(void)
     stty_telos(slipfd);
   }
 
-  timer_set(&send_delay_timer, 0);
   slip_send(slipfd, SLIP_END);
-  inslip = fdopen(slipfd, "r");
-  if(inslip == NULL) {
-    err(1, "main: fdopen");
-  }
 }
 /*---------------------------------------------------------------------------*/
@@ -78,9 +78,40 @@
 #define SELECT_MAX 8
 #endif
 
+/* With SELECT_CONF_EPOLL set, the main loop waits in epoll_wait() on
+   the registered fds and on a timerfd armed for the next etimer
+   expiration, instead of polling with select() every millisecond.
+   Linux only. */
+#ifdef SELECT_CONF_EPOLL
+#define SELECT_EPOLL SELECT_CONF_EPOLL
+#else
+#define SELECT_EPOLL 0
+#endif
+
+#if SELECT_EPOLL
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#endif /* SELECT_EPOLL */
+
 static const struct select_callback *select_callback[SELECT_MAX];
 static int select_max = 0;
 
+#if SELECT_EPOLL
+static int epoll_fd = -1;
+static int timer_fd = -1;
+static clock_time_t timer_deadline;
+/* The events each fd is registered for in the epoll set */
+static uint32_t epoll_events[SELECT_MAX];
+/* Fds that epoll does not support, such as regular files. select()
+   always reports them ready, so they are handled the same way. */
+static uint8_t epoll_unsupported[SELECT_MAX];
+
+static void epoll_update(int fd, uint32_t events);
+#endif /* SELECT_EPOLL */
+
 SENSORS(&pir_sensor, &vib_sensor, &button_sensor);
 
 static uint8_t serial_id[] = {0x01,0x02,0x03,0x04,0x05,0x06,0x07,0x08};
@@ -97,6 +128,13 @@ select_set_callback(int fd, const struct select_callback *callback)
       callback = NULL;
     }
 
+#if SELECT_EPOLL
+    if(epoll_fd >= 0 && callback != select_callback[fd]) {
+      epoll_update(fd, 0);
+      epoll_unsupported[fd] = 0;
+    }
+#endif /* SELECT_EPOLL */
+
     select_callback[fd] = callback;
 
     /* Update fd max */
@@ -131,6 +169,9 @@ stdin_handle_fd(fd_set *rset, fd_set *wset)
   if(FD_ISSET(STDIN_FILENO, rset)) {
     if(read(STDIN_FILENO, &c, 1) > 0) {
       serial_line_input_byte(c);
+    } else if(!isatty(STDIN_FILENO)) {
+      /* Stdin is a closed pipe or /dev/null; stop waking up for it */
+      select_set_callback(STDIN_FILENO, NULL);
     }
   }
 }
@@ -138,6 +179,187 @@ const static struct select_callback stdin_fd = {
   stdin_set_fd, stdin_handle_fd
 };
 /*---------------------------------------------------------------------------*/
+#if SELECT_EPOLL
+static void
+epoll_init(void)
+{
+  struct epoll_event ev;
+
+  epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  timer_fd = timerfd_create(CLOCK_REALTIME, TFD_NONBLOCK | TFD_CLOEXEC);
+  if(epoll_fd < 0 || timer_fd < 0) {
+    perror("epoll");
+    exit(1);
+  }
+
+  memset(&ev, 0, sizeof(ev));
+  ev.events = EPOLLIN;
+  ev.data.fd = timer_fd;
+  if(epoll_ctl(epoll_fd, EPOLL_CTL_ADD, timer_fd, &ev) < 0) {
+    perror("epoll_ctl");
+    exit(1);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+epoll_update(int fd, uint32_t events)
+{
+  struct epoll_event ev;
+  int op;
+
+  if(events == epoll_events[fd] || epoll_unsupported[fd]) {
+    return;
+  }
+
+  memset(&ev, 0, sizeof(ev));
+  ev.events = events;
+  ev.data.fd = fd;
+  if(events == 0) {
+    op = EPOLL_CTL_DEL;
+  } else if(epoll_events[fd] == 0) {
+    op = EPOLL_CTL_ADD;
+  } else {
+    op = EPOLL_CTL_MOD;
+  }
+
+  if(epoll_ctl(epoll_fd, op, fd, &ev) < 0) {
+    if(op == EPOLL_CTL_MOD && errno == ENOENT) {
+      /* The fd was closed and reopened without being unregistered */
+      op = EPOLL_CTL_ADD;
+      if(epoll_ctl(epoll_fd, op, fd, &ev) == 0) {
+        epoll_events[fd] = events;
+        return;
+      }
+    }
+    if(errno == EPERM) {
+      epoll_unsupported[fd] = 1;
+    } else if(op != EPOLL_CTL_DEL) {
+      perror("epoll_ctl");
+    }
+    events = 0;
+  }
+  epoll_events[fd] = events;
+}
+/*---------------------------------------------------------------------------*/
+static int
+epoll_timeout(void)
+{
+  struct itimerspec its;
+  struct timespec ts;
+  clock_time_t next;
+  clock_time_t now;
+  long delay;
+  long ms;
+
+  if(!etimer_pending()) {
+    return -1;
+  }
+
+  /* clock_time() counts milliseconds of the real-time clock, so the
+     timerfd can be armed for the exact millisecond the next etimer
+     expires in */
+  next = etimer_next_expiration_time();
+  clock_gettime(CLOCK_REALTIME, &ts);
+  now = ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+  delay = (long)(next - now);
+  if(delay <= 0) {
+    return 0;
+  }
+
+  if(next != timer_deadline) {
+    ms = ts.tv_nsec / 1000000 + delay;
+    memset(&its, 0, sizeof(its));
+    its.it_value.tv_sec = ts.tv_sec + ms / 1000;
+    its.it_value.tv_nsec = (ms % 1000) * 1000000;
+    if(timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &its, NULL) < 0) {
+      perror("timerfd_settime");
+      return delay;
+    }
+    timer_deadline = next;
+  }
+  return -1;
+}
+/*---------------------------------------------------------------------------*/
+static void
+epoll_run(int pending)
+{
+  struct epoll_event events[SELECT_MAX + 1];
+  fd_set fdr;
+  fd_set fdw;
+  fd_set r;
+  fd_set w;
+  uint64_t expirations;
+  uint32_t want;
+  int i;
+  int n;
+  int fd;
+
+  FD_ZERO(&fdr);
+  FD_ZERO(&fdw);
+  for(i = 0; i <= select_max; i++) {
+    want = 0;
+    if(select_callback[i] != NULL) {
+      FD_ZERO(&r);
+      FD_ZERO(&w);
+      if(select_callback[i]->set_fd(&r, &w)) {
+        if(FD_ISSET(i, &r)) {
+          want |= EPOLLIN;
+        }
+        if(FD_ISSET(i, &w)) {
+          want |= EPOLLOUT;
+        }
+      }
+    }
+    epoll_update(i, want);
+    if(want != 0 && epoll_unsupported[i]) {
+      if(want & EPOLLIN) {
+        FD_SET(i, &fdr);
+      }
+      if(want & EPOLLOUT) {
+        FD_SET(i, &fdw);
+      }
+      pending = 1;
+    }
+  }
+
+  n = epoll_wait(epoll_fd, events, SELECT_MAX + 1,
+                 pending ? 0 : epoll_timeout());
+  if(n < 0) {
+    if(errno != EINTR) {
+      perror("epoll_wait");
+    }
+    return;
+  }
+
+  for(i = 0; i < n; i++) {
+    fd = events[i].data.fd;
+    if(fd == timer_fd) {
+      if(read(timer_fd, &expirations, sizeof(expirations)) > 0) {
+        timer_deadline = 0;
+      }
+      continue;
+    }
+    /* As select(), report errors and hangups as readiness */
+    if(events[i].events & (EPOLLERR | EPOLLHUP)) {
+      events[i].events |= epoll_events[fd];
+    }
+    if(events[i].events & EPOLLIN) {
+      FD_SET(fd, &fdr);
+    }
+    if(events[i].events & EPOLLOUT) {
+      FD_SET(fd, &fdw);
+    }
+  }
+
+  for(i = 0; i <= select_max; i++) {
+    if(select_callback[i] != NULL &&
+       (FD_ISSET(i, &fdr) || FD_ISSET(i, &fdw))) {
+      select_callback[i]->handle_fd(&fdr, &fdw);
+    }
+  }
+}
+#endif /* SELECT_EPOLL */
+/*---------------------------------------------------------------------------*/
 static void
 set_rime_addr(void)
 {
@@ -248,7 +470,13 @@ main(int argc, char **argv)
   setvbuf(stdout, (char *)NULL, _IONBF, 0);
 
   select_set_callback(STDIN_FILENO, &stdin_fd);
+#if SELECT_EPOLL
+  epoll_init();
+#endif /* SELECT_EPOLL */
   while(1) {
+#if SELECT_EPOLL
+    epoll_run(process_run());
+#else /* SELECT_EPOLL */
     fd_set fdr;
     fd_set fdw;
     int maxfd;
@@ -283,6 +511,7 @@ main(int argc, char **argv)
         }
       }
     }
+#endif /* SELECT_EPOLL */
 
     etimer_request_poll();
 
@@ -55,6 +55,9 @@
 #include <netdb.h>
 
 #include <err.h>
+#include <sys/uio.h>
+
+#include "slip-codec.h"
 
 int verbose = 1;
 const char *ipaddr;
@@ -151,174 +154,222 @@ is_sensible_string(const unsigned char *s, int len)
 }
 
 /*
- * Read from serial, when we have a packet write it to tun. No output
- * buffering, input buffered by stdio.
+ * Handle a frame received from serial: a command, a debug message or a
+ * packet that is written to tun.
  */
 void
-serial_to_tun(FILE *inslip, int outfd)
+handle_frame(unsigned char *inbuf, int len, int outfd)
 {
-  static union {
-    unsigned char inbuf[2000];
-  } uip;
-  static int inbufptr = 0;
-  int ret,i;
-  unsigned char c;
-
-#ifdef linux
-  ret = fread(&c, 1, 1, inslip);
-  if(ret == -1 || ret == 0) err(1, "serial_to_tun: read");
-  goto after_fread;
-#endif
+  int i;
 
- read_more:
-  if(inbufptr >= sizeof(uip.inbuf)) {
-     if(timestamp) stamptime();
-     fprintf(stderr, "*** dropping large %d byte packet\n",inbufptr);
-	 inbufptr = 0;
-  }
-  ret = fread(&c, 1, 1, inslip);
-#ifdef linux
- after_fread:
-#endif
-  if(ret == -1) {
-    err(1, "serial_to_tun: read");
-  }
-  if(ret == 0) {
-    clearerr(inslip);
-    return;
-  }
-  /*  fprintf(stderr, ".");*/
-  switch(c) {
-  case SLIP_END:
-    if(inbufptr > 0) {
-      if(uip.inbuf[0] == '!') {
-	if(uip.inbuf[1] == 'M') {
-	  /* Read gateway MAC address and autoconfigure tap0 interface */
-	  char macs[24];
-	  int i, pos;
-	  for(i = 0, pos = 0; i < 16; i++) {
-	    macs[pos++] = uip.inbuf[2 + i];
-	    if((i & 1) == 1 && i < 14) {
-	      macs[pos++] = ':';
-	    }
-	  }
-          if(timestamp) stamptime();
-	  macs[pos] = '\0';
-//	  printf("*** Gateway's MAC address: %s\n", macs);
-	  fprintf(stderr,"*** Gateway's MAC address: %s\n", macs);
-          if (timestamp) stamptime();
-	  ssystem("ifconfig %s down", tundev);
-          if (timestamp) stamptime();
-	  ssystem("ifconfig %s hw ether %s", tundev, &macs[6]);
-          if (timestamp) stamptime();
-	  ssystem("ifconfig %s up", tundev);
-	}
-      } else if(uip.inbuf[0] == '?') {
-	if(uip.inbuf[1] == 'P') {
-          /* Prefix info requested */
-          struct in6_addr addr;
-	  int i;
-	  char *s = strchr(ipaddr, '/');
-	  if(s != NULL) {
-	    *s = '\0';
-	  }
-          inet_pton(AF_INET6, ipaddr, &addr);
-          if(timestamp) stamptime();
-          fprintf(stderr,"*** Address:%s => %02x%02x:%02x%02x:%02x%02x:%02x%02x\n",
- //         printf("*** Address:%s => %02x%02x:%02x%02x:%02x%02x:%02x%02x\n",
-		 ipaddr, 
-		 addr.s6_addr[0], addr.s6_addr[1],
-		 addr.s6_addr[2], addr.s6_addr[3],
-		 addr.s6_addr[4], addr.s6_addr[5],
-		 addr.s6_addr[6], addr.s6_addr[7]);
-	  slip_send(slipfd, '!');
-	  slip_send(slipfd, 'P');
-	  for(i = 0; i < 8; i++) {
-	    /* need to call the slip_send_char for stuffing */
-	    slip_send_char(slipfd, addr.s6_addr[i]);
-	  }
-	  slip_send(slipfd, SLIP_END);
+  if(inbuf[0] == '!') {
+    if(inbuf[1] == 'M') {
+      /* Read gateway MAC address and autoconfigure tap0 interface */
+      char macs[24];
+      int i, pos;
+      for(i = 0, pos = 0; i < 16; i++) {
+        macs[pos++] = inbuf[2 + i];
+        if((i & 1) == 1 && i < 14) {
+          macs[pos++] = ':';
         }
+      }
+      if(timestamp) stamptime();
+      macs[pos] = '\0';
+//    printf("*** Gateway's MAC address: %s\n", macs);
+      fprintf(stderr,"*** Gateway's MAC address: %s\n", macs);
+      if (timestamp) stamptime();
+      ssystem("ifconfig %s down", tundev);
+      if (timestamp) stamptime();
+      ssystem("ifconfig %s hw ether %s", tundev, &macs[6]);
+      if (timestamp) stamptime();
+      ssystem("ifconfig %s up", tundev);
+    }
+  } else if(inbuf[0] == '?') {
+    if(inbuf[1] == 'P') {
+      /* Prefix info requested */
+      struct in6_addr addr;
+      int i;
+      char *s = strchr(ipaddr, '/');
+      if(s != NULL) {
+        *s = '\0';
+      }
+      inet_pton(AF_INET6, ipaddr, &addr);
+      if(timestamp) stamptime();
+      fprintf(stderr,"*** Address:%s => %02x%02x:%02x%02x:%02x%02x:%02x%02x\n",
+//    printf("*** Address:%s => %02x%02x:%02x%02x:%02x%02x:%02x%02x\n",
+              ipaddr,
+              addr.s6_addr[0], addr.s6_addr[1],
+              addr.s6_addr[2], addr.s6_addr[3],
+              addr.s6_addr[4], addr.s6_addr[5],
+              addr.s6_addr[6], addr.s6_addr[7]);
+      slip_send(slipfd, '!');
+      slip_send(slipfd, 'P');
+      for(i = 0; i < 8; i++) {
+        /* need to call the slip_send_char for stuffing */
+        slip_send_char(slipfd, addr.s6_addr[i]);
+      }
+      slip_send(slipfd, SLIP_END);
+    }
 #define DEBUG_LINE_MARKER '\r'
-      } else if(uip.inbuf[0] == DEBUG_LINE_MARKER) {    
-	fwrite(uip.inbuf + 1, inbufptr - 1, 1, stdout);
-      } else if(is_sensible_string(uip.inbuf, inbufptr)) {
-        if(verbose==1) {   /* strings already echoed below for verbose>1 */
-          if (timestamp) stamptime();
-          fwrite(uip.inbuf, inbufptr, 1, stdout);
-        }
-      } else {
-        if(verbose>2) {
-          if (timestamp) stamptime();
-          printf("Packet from SLIP of length %d - write TUN\n", inbufptr);
-          if (verbose>4) {
+  } else if(inbuf[0] == DEBUG_LINE_MARKER) {
+    fwrite(inbuf + 1, len - 1, 1, stdout);
+  } else if(is_sensible_string(inbuf, len)) {
+    if(verbose==1) {   /* strings already echoed below for verbose>1 */
+      if (timestamp) stamptime();
+      fwrite(inbuf, len, 1, stdout);
+    }
+  } else {
+    if(verbose>2) {
+      if (timestamp) stamptime();
+      printf("Packet from SLIP of length %d - write TUN\n", len);
+      if (verbose>4) {
 #if WIRESHARK_IMPORT_FORMAT
-            printf("0000");
-	        for(i = 0; i < inbufptr; i++) printf(" %02x",uip.inbuf[i]);
+        printf("0000");
+        for(i = 0; i < len; i++) printf(" %02x",inbuf[i]);
 #else
-            printf("         ");
-            for(i = 0; i < inbufptr; i++) {
-              printf("%02x", uip.inbuf[i]);
-              if((i & 3) == 3) printf(" ");
-              if((i & 15) == 15) printf("\n         ");
-            }
-#endif
-            printf("\n");
-          }
+        printf("         ");
+        for(i = 0; i < len; i++) {
+          printf("%02x", inbuf[i]);
+          if((i & 3) == 3) printf(" ");
+          if((i & 15) == 15) printf("\n         ");
         }
-	if(write(outfd, uip.inbuf, inbufptr) != inbufptr) {
-	  err(1, "serial_to_tun: write");
-	}
+#endif
+        printf("\n");
       }
-      inbufptr = 0;
     }
-    break;
+    if(write(outfd, inbuf, len) != len) {
+      err(1, "serial_to_tun: write");
+    }
+  }
+}
 
-  case SLIP_ESC:
-    if(fread(&c, 1, 1, inslip) != 1) {
-      clearerr(inslip);
-      /* Put ESC back and give up! */
-      ungetc(SLIP_ESC, inslip);
-      return;
+/*
+ * Echo lines as they are received for verbose=2,3,5+. Each line that
+ * is a sensible string is printed and removed from the buffer.
+ * Returns the number of bytes left.
+ */
+int
+echo_lines(unsigned char *inbuf, int len)
+{
+  int i;
+
+  for(i = 0; i < len; i++) {
+    if(inbuf[i] == '\n' && is_sensible_string(inbuf, i + 1)) {
+      if (timestamp) stamptime();
+      fwrite(inbuf, i + 1, 1, stdout);
+      len -= i + 1;
+      memmove(inbuf, inbuf + i + 1, len);
+      i = -1;
     }
+  }
+  return len;
+}
 
-    switch(c) {
-    case SLIP_ESC_END:
-      c = SLIP_END;
-      break;
-    case SLIP_ESC_ESC:
-      c = SLIP_ESC;
-      break;
+/*
+ * Read from serial, when we have a packet write it to tun. The serial
+ * line is read in blocks until it has no more data, and the blocks are
+ * decoded into a ring of frames.
+ */
+void
+serial_to_tun(int infd, int outfd)
+{
+  static struct slip_decoder decoder;
+  static int initialized = 0;
+  unsigned char buf[4096];
+  struct slip_codec_frame *f;
+  uint32_t dropped;
+  int ret, pos, n, i;
+  int first = 1;
+
+  if(!initialized) {
+    slip_decoder_init(&decoder);
+    initialized = 1;
+  }
+
+  while(1) {
+    ret = read(infd, buf, sizeof(buf));
+    if(ret == -1 && (errno == EAGAIN || errno == EINTR) && !first) {
+      return;
     }
-    /* FALLTHROUGH */
-  default:
-    uip.inbuf[inbufptr++] = c;
+    if(ret == -1 || (ret == 0 && first)) {
+      err(1, "serial_to_tun: read");
+    }
+    if(ret == 0) {
+      return;
+    }
+    first = 0;
 
-    /* Echo lines as they are received for verbose=2,3,5+ */
     /* Echo all printable characters for verbose==4 */
-    if((verbose==2) || (verbose==3) || (verbose>4)) {
-      if(c=='\n') {
-        if(is_sensible_string(uip.inbuf, inbufptr)) {
-          if (timestamp) stamptime();
-          fwrite(uip.inbuf, inbufptr, 1, stdout);
-          inbufptr=0;
+    if(verbose==4) {
+      for(i = 0; i < ret; i++) {
+        unsigned char c = buf[i];
+        if(c == 0 || c == '\r' || c == '\n' || c == '\t' || (c >= ' ' && c <= '~')) {
+          fwrite(&c, 1, 1, stdout);
+          if(c=='\n') if(timestamp) stamptime();
         }
       }
-    } else if(verbose==4) {
-      if(c == 0 || c == '\r' || c == '\n' || c == '\t' || (c >= ' ' && c <= '~')) {
-	fwrite(&c, 1, 1, stdout);
-        if(c=='\n') if(timestamp) stamptime();
+    }
+
+    for(pos = 0; pos < ret; pos += n) {
+      dropped = decoder.dropped;
+      n = slip_decoder_input(&decoder, buf + pos, ret - pos);
+      if(decoder.dropped != dropped) {
+        if(timestamp) stamptime();
+        fprintf(stderr, "*** dropping large packet\n");
+      }
+
+      while((f = slip_decoder_frame(&decoder)) != NULL) {
+        if((verbose==2) || (verbose==3) || (verbose>4)) {
+          f->len = echo_lines(f->data, f->len);
+        }
+        if(f->len > 0) {
+          handle_frame(f->data, f->len, outfd);
+        }
+        slip_decoder_release(&decoder);
+      }
+
+      if((verbose==2) || (verbose==3) || (verbose>4)) {
+        f = slip_decoder_partial(&decoder);
+        f->len = echo_lines(f->data, f->len);
       }
     }
-    
-    break;
   }
+}
 
-  goto read_more;
+/*
+ * Frames waiting to be written to serial. They are written with one
+ * writev() call.
+ */
+#define OUT_FRAMES 16
+struct out_frame {
+  unsigned char buf[SLIP_CODEC_ENCODED_SIZE(2000)];
+  int len;
+};
+struct out_frame out_frames[OUT_FRAMES];
+int out_first, out_count, out_offset;
+/* The frame that slip_send() adds to, until it sends SLIP_END */
+struct out_frame *out_open;
+
+struct out_frame *
+out_alloc(void)
+{
+  struct out_frame *o;
+
+  if(out_count == OUT_FRAMES) {
+    err(1, "slip_send overflow");
+  }
+  o = &out_frames[(out_first + out_count) % OUT_FRAMES];
+  out_count++;
+  o->len = 0;
+  return o;
 }
 
-unsigned char slip_buf[2000];
-int slip_end, slip_begin;
+/* One frame is kept free for replies to commands from serial */
+int
+out_full(void)
+{
+  return out_count >= OUT_FRAMES - 1;
+}
 
 void
 slip_send_char(int fd, unsigned char c)
@@ -341,39 +392,57 @@ slip_send_char(int fd, unsigned char c)
 void
 slip_send(int fd, unsigned char c)
 {
-  if(slip_end >= sizeof(slip_buf)) {
+  if(out_open == NULL) {
+    out_open = out_alloc();
+  }
+  if(out_open->len >= sizeof(out_open->buf)) {
     err(1, "slip_send overflow");
   }
-  slip_buf[slip_end] = c;
-  slip_end++;
+  out_open->buf[out_open->len++] = c;
+  if(c == SLIP_END) {
+    out_open = NULL;
+  }
 }
 
 int
 slip_empty()
 {
-  return slip_end == 0;
+  return out_count == 0;
 }
 
 void
 slip_flushbuf(int fd)
 {
-  int n;
-  
+  struct iovec iov[OUT_FRAMES];
+  struct out_frame *o;
+  int i, n;
+
   if(slip_empty()) {
     return;
   }
 
-  n = write(fd, slip_buf + slip_begin, (slip_end - slip_begin));
+  for(i = 0; i < out_count; i++) {
+    o = &out_frames[(out_first + i) % OUT_FRAMES];
+    iov[i].iov_base = o->buf;
+    iov[i].iov_len = o->len;
+  }
+  iov[0].iov_base = out_frames[out_first].buf + out_offset;
+  iov[0].iov_len -= out_offset;
+
+  n = writev(fd, iov, out_count);
 
   if(n == -1 && errno != EAGAIN) {
     err(1, "slip_flushbuf write failed");
   } else if(n == -1) {
     PROGRESS("Q");		/* Outqueueis full! */
   } else {
-    slip_begin += n;
-    if(slip_begin == slip_end) {
-      slip_begin = slip_end = 0;
+    n += out_offset;
+    while(out_count > 0 && n >= out_frames[out_first].len) {
+      n -= out_frames[out_first].len;
+      out_first = (out_first + 1) % OUT_FRAMES;
+      out_count--;
     }
+    out_offset = n;
   }
 }
 
@@ -381,6 +450,7 @@ void
 write_to_serial(int outfd, void *inbuf, int len)
 {
   u_int8_t *p = inbuf;
+  struct out_frame *o;
   int i;
 
   if(verbose>2) {
@@ -407,28 +477,19 @@ write_to_serial(int outfd, void *inbuf, int len)
    */
   /* slip_send(outfd, SLIP_END); */
 
-  for(i = 0; i < len; i++) {
-    switch(p[i]) {
-    case SLIP_END:
-      slip_send(outfd, SLIP_ESC);
-      slip_send(outfd, SLIP_ESC_END);
-      break;
-    case SLIP_ESC:
-      slip_send(outfd, SLIP_ESC);
-      slip_send(outfd, SLIP_ESC_ESC);
-      break;
-    default:
-      slip_send(outfd, p[i]);
-      break;
-    }
+  o = out_alloc();
+  o->len = slip_encode(p, len, o->buf, sizeof(o->buf));
+  if(o->len < 0) {
+    err(1, "slip_send overflow");
   }
-  slip_send(outfd, SLIP_END);
   PROGRESS("t");
 }
 
 
 /*
- * Read from tun, write to slip.
+ * Read from tun, write to slip. Reads packets until tun has no more or
+ * the output queue is full, or only one packet if there is a delay
+ * between packets. Returns the size of the last packet.
  */
 int
 tun_to_serial(int infd, int outfd)
@@ -436,14 +497,24 @@ tun_to_serial(int infd, int outfd)
   struct {
     unsigned char inbuf[2000];
   } uip;
-  int size;
+  int size, last = 0;
 
-  if((size = read(infd, uip.inbuf, 2000)) == -1) err(1, "tun_to_serial: read");
+  while(!out_full()) {
+    if((size = read(infd, uip.inbuf, 2000)) == -1) {
+      if(errno == EAGAIN) {
+        break;
+      }
+      err(1, "tun_to_serial: read");
+    }
 
-  write_to_serial(outfd, uip.inbuf, size);
-  return size;
+    write_to_serial(outfd, uip.inbuf, size);
+    last = size;
+    if(basedelay) {
+      break;
+    }
+  }
+  return last;
 }
-
 #ifndef BAUDRATE
 #define BAUDRATE B115200
 #endif
@@ -692,7 +763,6 @@ main(int argc, char **argv)
   int tunfd, maxfd;
   int ret;
   fd_set rset, wset;
-  FILE *inslip;
   const char *siodev = NULL;
   const char *host = NULL;
   const char *port = NULL;
@@ -912,11 +982,10 @@ exit(1);
     stty_telos(slipfd);
   }
   slip_send(slipfd, SLIP_END);
-  inslip = fdopen(slipfd, "r");
-  if(inslip == NULL) err(1, "main: fdopen");
 
   tunfd = tun_alloc(tundev, tap);
   if(tunfd == -1) err(1, "main: open");
+  fcntl(tunfd, F_SETFL, O_NONBLOCK);
   if (timestamp) stamptime();
   fprintf(stderr, "opened %s device ``/dev/%s''\n",
           tap ? "tap" : "tun", tundev);
@@ -951,8 +1020,9 @@ exit(1);
     FD_SET(slipfd, &rset);	/* Read from slip ASAP! */
     if(slipfd > maxfd) maxfd = slipfd;
     
-    /* We only have one packet at a time queued for slip output. */
-    if(slip_empty()) {
+    /* With a delay between packets, only one packet at a time is
+       queued for slip output */
+    if(basedelay ? slip_empty() : !out_full()) {
       FD_SET(tunfd, &rset);
       if(tunfd > maxfd) maxfd = tunfd;
     }
@@ -962,7 +1032,7 @@ exit(1);
       err(1, "select");
     } else if(ret > 0) {
       if(FD_ISSET(slipfd, &rset)) {
-        serial_to_tun(inslip, tunfd);
+        serial_to_tun(slipfd, tunfd);
       }
       
       if(FD_ISSET(slipfd, &wset)) {
@@ -982,7 +1052,8 @@ exit(1);
       }
       if(delaymsec==0) {
         int size;
-        if(slip_empty() && FD_ISSET(tunfd, &rset)) {
+        if((basedelay ? slip_empty() : !out_full()) &&
+           FD_ISSET(tunfd, &rset)) {
           size=tun_to_serial(tunfd, slipfd);
           slip_flushbuf(slipfd);
           sigalarm_reset();